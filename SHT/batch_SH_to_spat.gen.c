@@ -0,0 +1,510 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+# This file is meta-code for SHT.c (spherical harmonic transform).
+# it is intended for "make" to generate C code for similar SHT functions,
+# from one generic function + tags.
+# > See Makefile and SHT.c
+# Basically, there are tags at the beginning of lines that are information
+# to keep or remove the line depending on the function to build.
+# tags :
+# Q : line for scalar transform
+# V : line for vector transform (both spheroidal and toroidal)
+# S : line for vector transfrom, spheroidal component
+# T : line for vector transform, toroidal component.
+#
+# Batched synthesis: the same transform is applied to nf independent fields.
+# For each m and each block of NWAY latitudes, the associated Legendre functions
+# are computed once by recurrence, stored in a small buffer (yl) by blocks of BATCH_LBLK pairs of degrees,
+# and then applied to all the fields. Partial sums of each field are kept in acc between blocks.
+
+QX	static void GEN3(SH_to_spat_batch,NWAY,SUFFIX)(shtns_cfg shtns, int nf, cplx **Qlm, double **Vr, const long int llim) {
+VX	static void GEN3(SHsphtor_to_spat_batch,NWAY,SUFFIX)(shtns_cfg shtns, int nf, cplx **Slm, cplx **Tlm, double **Vt, double **Vp, const long int llim) {
+
+Q	v2d *BrF[nf];
+V	v2d *BtF[nf], *BpF[nf];
+Q	#define qr(l) vall(creal(Ql[l]))
+Q	#define qi(l) vall(cimag(Ql[l]))
+V	#define vr(l) vall( ((double*) VWl)[4*(l)]   )
+V	#define vi(l) vall( ((double*) VWl)[4*(l)+1] )
+V	#define wr(l) vall( ((double*) VWl)[4*(l)+2] )
+V	#define wi(l) vall( ((double*) VWl)[4*(l)+3] )
+	long int nk, imlim;
+
+	for (int f=0; f<nf; f++) {
+Q		BrF[f] = (v2d*) Vr[f];
+V		BtF[f] = (v2d*) Vt[f];	BpF[f] = (v2d*) Vp[f];
+	}
+	#ifdef _GCC_VEC_
+	if (shtns->fftc_mode > 0) {		// alloc memory for the FFT
+		unsigned long nv = shtns->nspat;
+QX		BrF[0] = (v2d*) shtns_scratch(SCRATCH_FFT, nf*nv * sizeof(double) );
+VX		BtF[0] = (v2d*) shtns_scratch(SCRATCH_FFT, 2*nf*nv * sizeof(double) );
+		for (int f=0; f<nf; f++) {
+Q			BrF[f] = BrF[0] + f*(nv/2);
+V			BtF[f] = BtF[0] + f*(nv/2);		BpF[f] = BtF[0] + (nf+f)*(nv/2);
+		}
+	}
+	#else
+	if (shtns->ncplx_fft > 0) {		// alloc memory for the FFT
+		unsigned long nv = shtns->ncplx_fft;
+QX		BrF[0] = shtns_scratch(SCRATCH_FFT, nf*nv * sizeof(cplx) );
+VX		BtF[0] = shtns_scratch(SCRATCH_FFT, 2*nf*nv * sizeof(cplx) );
+		for (int f=0; f<nf; f++) {
+Q			BrF[f] = BrF[0] + f*nv;
+V			BtF[f] = BtF[0] + f*nv;		BpF[f] = BtF[0] + (nf+f)*nv;
+		}
+	}
+	#endif
+	imlim = MTR;
+	#ifdef SHT_VAR_LTR
+		if (imlim*MRES > (unsigned) llim) imlim = ((unsigned) llim)/MRES;		// 32bit mul and div should be faster
+	#endif
+	nk = NLAT_2;
+	#if _GCC_VEC_
+		nk = ((unsigned)(nk+VSIZE2-1)) / VSIZE2;
+	#endif
+
+  #pragma omp parallel num_threads(shtns->nthreads)
+  {
+	s2d* const ct = (s2d*) shtns->ct;
+	s2d* const st = (s2d*) shtns->st;
+	rnd yl[(2*BATCH_LBLK+2)*NWAY];		// Legendre functions for one block of latitudes and degrees, shared by all fields.
+Q	rnd acc[nf*4*NWAY];		// partial sums for each field.
+V	rnd acc[nf*8*NWAY];		// partial sums for each field.
+V	v2d* const VWbuf = (v2d*) shtns_scratch(SCRATCH_BATCH, nf*(2*llim+4) * sizeof(v2d) );		// scalar-like representation of all vector fields, for one m.
+
+	#pragma omp for schedule(dynamic)
+	for (long int im=0; im<=imlim; ++im) {
+		long int k, l, m;
+		double *alm, *al;
+	  #if _GCC_VEC_
+		const long int ofs = im*NLAT_2;		// offset of m=im*MRES in the fourier buffers.
+	  #else
+		const long int ofs = im*NLAT;
+	  #endif
+	  if (im == 0) {
+		alm = shtns->alm;
+		k=0;
+		do {
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(ct, j+k);
+V				sint[j] = -vread(st, j+k);
+V				#ifdef SHTNS4MAGIC
+V				sint[j] *= -sint[j];
+V				#endif
+				y0[j] = vall(al[0]);
+V				dy0[j] = vall(0.0);
+			}
+			for (int j=0; j<NWAY; ++j) {
+				y1[j]  = vall(al[0]*al[1]) * cost[j];
+V				dy1[j] = vall(al[0]*al[1]) * sint[j];
+			}
+Q			for (long int i=0; i<nf*4*NWAY; ++i) acc[i] = vall(0.0);
+V			for (long int i=0; i<nf*8*NWAY; ++i) acc[i] = vall(0.0);
+			for (int j=0; j<NWAY; ++j) {
+Q				yl[j] = y0[j];		yl[NWAY+j] = y1[j];
+V				yl[j] = dy0[j];		yl[NWAY+j] = dy1[j];
+			}
+			al+=2;	l=2;
+			long int lb = 0;		// first degree of the current block
+			long int nb = 1;		// number of pairs of degrees in the current block
+			while (1) {
+				rnd* y = yl + 2*nb*NWAY;
+				while ((l<llim) && (nb<BATCH_LBLK)) {
+					for (int j=0; j<NWAY; ++j) {
+V						dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+						y0[j]  = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+V						dy1[j] = vall(al[3])*(cost[j]*dy0[j] + y0[j]*sint[j]) + vall(al[2])*dy1[j];
+						y1[j]  = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+Q						y[j] = y0[j];		y[NWAY+j] = y1[j];
+V						y[j] = dy0[j];		y[NWAY+j] = dy1[j];
+					}
+					al+=4;	l+=2;	y+=2*NWAY;	nb++;
+				}
+				if (l==llim) {
+					for (int j=0; j<NWAY; ++j) {
+V						dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+						y0[j]  = vall(al[1])*cost[j]*y1[j] + vall(al[0])*y0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+Q						y[j] = y0[j];
+V						y[j] = dy0[j];
+					}
+				}
+				for (int f=0; f<nf; f++) {		// apply to all fields.
+Q					double* const Ql0 = (double*) Qlm[f];		// real part only for m=0
+S					double* const Sl0 = (double*) Slm[f];
+T					double* const Tl0 = (double*) Tlm[f];
+Q					rnd* const af = acc + f*4*NWAY;
+V					rnd* const af = acc + f*8*NWAY;
+Q					rnd re[NWAY], ro[NWAY];		// local copies, kept in registers.
+S					rnd te[NWAY], to[NWAY];
+T					rnd pe[NWAY], po[NWAY];
+					for (int j=0; j<NWAY; ++j) {
+Q						re[j] = af[j];		ro[j] = af[NWAY+j];
+S						te[j] = af[j];		to[j] = af[NWAY+j];
+T						pe[j] = af[2*NWAY+j];		po[j] = af[3*NWAY+j];
+					}
+					y = yl;
+					for (long int i=0, ll=lb; i<nb; i++, ll+=2) {
+						for (int j=0; j<NWAY; ++j) {
+Q							re[j] += y[j] * vall(Ql0[2*ll]);		ro[j] += y[NWAY+j] * vall(Ql0[2*ll+2]);
+S							to[j] += y[j] * vall(Sl0[2*ll]);		te[j] += y[NWAY+j] * vall(Sl0[2*ll+2]);
+T							po[j] -= y[j] * vall(Tl0[2*ll]);		pe[j] -= y[NWAY+j] * vall(Tl0[2*ll+2]);
+						}
+						y+=2*NWAY;
+					}
+					if (l==llim) {
+						for (int j=0; j<NWAY; ++j) {
+Q							re[j] += y[j] * vall(Ql0[2*l]);
+S							to[j] += y[j] * vall(Sl0[2*l]);
+T							po[j] -= y[j] * vall(Tl0[2*l]);
+						}
+					}
+					for (int j=0; j<NWAY; ++j) {
+Q						af[j] = re[j];		af[NWAY+j] = ro[j];
+S						af[j] = te[j];		af[NWAY+j] = to[j];
+T						af[2*NWAY+j] = pe[j];		af[3*NWAY+j] = po[j];
+					}
+				}
+				if (l >= llim) break;
+				lb = l;		nb = 0;
+			}
+			for (int f=0; f<nf; f++) {
+Q				rnd* const re = acc + f*4*NWAY;		rnd* const ro = re + NWAY;
+S				rnd* const te = acc + f*8*NWAY;		rnd* const to = te + NWAY;
+T				rnd* const pe = acc + f*8*NWAY + 2*NWAY;		rnd* const po = pe + NWAY;
+			#ifndef SHTNS4MAGIC
+				for (int j=0; j<NWAY; ++j) {
+Q					S2D_STORE(BrF[f], j+k, re[j], ro[j])
+S					S2D_STORE(BtF[f], j+k, te[j], to[j])
+T					S2D_STORE(BpF[f], j+k, pe[j], po[j])
+				}
+			#else
+				for (int j=0; j<NWAY; ++j) {
+					if ((k+j)>=nk) break;
+Q					S2D_STORE_4MAGIC(BrF[f], j+k, re[j], ro[j])
+S					S2D_STORE_4MAGIC(BtF[f], j+k, te[j], to[j])
+T					S2D_STORE_4MAGIC(BpF[f], j+k, pe[j], po[j])
+				}
+			#endif
+			}
+			k+=NWAY;
+		} while (k < nk);
+
+	  } else {		// im > 0
+		m = im*MRES;
+		l = LiM(shtns, 0, im);
+		alm = shtns->alm + ALM_IDX(shtns, im);
+
+V		for (int f=0; f<nf; f++) {	// convert from vector SH to scalar SH
+V			// Vlm =  st*d(Slm)/dtheta + I*m*Tlm
+V			// Wlm = -st*d(Tlm)/dtheta + I*m*Slm
+V			// store interleaved: VWlm(2*l) = Vlm(l);	VWlm(2*l+1) = Vlm(l);
+V			double* mx = shtns->mx_stdt + 2*l;
+V			v2d* const VWl = VWbuf + f*(2*llim+4);
+S			v2d* Sl = (v2d*) &Slm[f][l];	// virtual pointer for l=0 and im
+T			v2d* Tl = (v2d*) &Tlm[f][l];
+V			s2d em = vdup(m);
+S			v2d sl = Sl[m];
+T			v2d tl = Tl[m];
+V			v2d vs = vdup( 0.0 );
+V			v2d wt = vdup( 0.0 );
+V			for (int l=m; l<=llim; l++) {
+V				s2d mxu = vdup( mx[2*l] );
+V				s2d mxl = vdup( mx[2*l+1] );		// mxl for next iteration
+T				vs = addi( vs ,  em*tl );
+S				wt = addi( wt ,  em*sl );
+S				v2d vs1 = mxl*sl;			// vs for next iter
+T				v2d wt1 = -mxl*tl;			// wt for next iter
+V				if (l<llim) {
+S					sl = Sl[l+1];		// kept for next iteration
+T					tl = Tl[l+1];
+S					vs += mxu*sl;
+T					wt -= mxu*tl;
+V				}
+V				VWl[2*l]   = vs;
+V				VWl[2*l+1] = wt;
+V				vs = vdup( 0.0 );		wt = vdup( 0.0 );
+S				vs = vs1;
+T				wt = wt1;
+V			}
+V			VWl[2*llim+2] = vs;
+V			VWl[2*llim+3] = wt;
+V		}
+
+		for (int f=0; f<nf; f++) {
+Q			v2d* const BrFm = BrF[f] + ofs;
+V			v2d* const BtFm = BtF[f] + ofs;		v2d* const BpFm = BpF[f] + ofs;
+			k=0;	l=shtns->tm[im];
+		#if _GCC_VEC_
+			l>>=1;		// stay on a 16 byte boundary
+			while (k<l) {	// polar optimization
+			#ifndef SHTNS4MAGIC
+Q				BrFm[k] = vdup(0.0);				BrFm[(NPHI-2*im)*NLAT_2 + k] = vdup(0.0);
+Q				BrFm[NLAT_2-l+k] = vdup(0.0);	BrFm[(NPHI+1-2*im)*NLAT_2 -l+k] = vdup(0.0);
+V				BtFm[k] = vdup(0.0);				BtFm[(NPHI-2*im)*NLAT_2 + k] = vdup(0.0);
+V				BtFm[NLAT_2-l+k] = vdup(0.0);	BtFm[(NPHI+1-2*im)*NLAT_2 -l+k] = vdup(0.0);
+V				BpFm[k] = vdup(0.0);				BpFm[(NPHI-2*im)*NLAT_2 + k] = vdup(0.0);
+V				BpFm[NLAT_2-l+k] = vdup(0.0);	BpFm[(NPHI+1-2*im)*NLAT_2 -l+k] = vdup(0.0);
+			#else
+Q				BrFm[2*k] = vdup(0.0);			BrFm[(NPHI-2*im)*NLAT_2 + 2*k] = vdup(0.0);
+Q				BrFm[2*k+1] = vdup(0.0);			BrFm[(NPHI-2*im)*NLAT_2 +2*k+1] = vdup(0.0);
+V				BtFm[2*k] = vdup(0.0);			BtFm[(NPHI-2*im)*NLAT_2 + 2*k] = vdup(0.0);
+V				BtFm[2*k+1] = vdup(0.0);			BtFm[(NPHI-2*im)*NLAT_2 +2*k+1] = vdup(0.0);
+V				BpFm[2*k] = vdup(0.0);			BpFm[(NPHI-2*im)*NLAT_2 + 2*k] = vdup(0.0);
+V				BpFm[2*k+1] = vdup(0.0);			BpFm[(NPHI-2*im)*NLAT_2 +2*k+1] = vdup(0.0);
+			#endif
+				++k;
+			}
+		#else
+			while (k<l) {	// polar optimization
+			  #ifndef SHTNS4MAGIC
+Q				BrFm[k] = 0.0;		BrFm[NLAT-l+k] = 0.0;
+V				BtFm[k] = 0.0;		BtFm[NLAT-l+k] = 0.0;
+V				BpFm[k] = 0.0;		BpFm[NLAT-l+k] = 0.0;
+			  #else
+Q				BrFm[2*k] = 0.0;		BrFm[2*k+1] = 0.0;
+V				BtFm[2*k] = 0.0;		BtFm[2*k+1] = 0.0;
+V				BpFm[2*k] = 0.0;		BpFm[2*k+1] = 0.0;
+			  #endif
+				++k;
+			}
+		#endif
+		}
+
+		k = shtns->tm[im];
+	#if _GCC_VEC_
+		k = ((unsigned) (k>>1)) / (VSIZE2/2);
+	#endif
+		while (k < nk) {		// a latitude block may be entirely polar (no work).
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(st, k+j);
+				y0[j] = vall(1.0);
+			}
+Q			l=m;
+V		#ifndef SHTNS4MAGIC
+V			l=m-1;
+V		#else
+V			l=m;
+V		#endif
+			long int ny = 0;
+		  if ((int)llim <= SHT_L_RESCALE_FLY) {
+			do {		// sin(theta)^m
+				if (l&1) for (int j=0; j<NWAY; ++j) y0[j] *= cost[j];
+				for (int j=0; j<NWAY; ++j) cost[j] *= cost[j];
+			} while(l >>= 1);
+		  } else {
+			long int nsint = 0;
+			do {		// sin(theta)^m		(use rescaling to avoid underflow)
+				if (l&1) {
+					for (int j=NWAY-1; j>=0; --j) y0[j] *= cost[j];
+					ny += nsint;
+					if (vlo(y0[NWAY-1]) < (SHT_ACCURACY+1.0/SHT_SCALE_FACTOR)) {
+						ny--;
+						for (int j=NWAY-1; j>=0; --j) y0[j] *= vall(SHT_SCALE_FACTOR);
+					}
+				}
+				for (int j=NWAY-1; j>=0; --j) cost[j] *= cost[j];
+				nsint += nsint;
+				if (vlo(cost[NWAY-1]) < 1.0/SHT_SCALE_FACTOR) {
+					nsint--;
+					for (int j=NWAY-1; j>=0; --j) cost[j] *= vall(SHT_SCALE_FACTOR);
+				}
+			} while(l >>= 1);
+		  }
+			for (int j=0; j<NWAY; ++j) {
+				y0[j] *= vall(al[0]);
+				cost[j] = vread(ct, j+k);
+			}
+			for (int j=0; j<NWAY; ++j) {
+				y1[j]  = (vall(al[1])*y0[j]) *cost[j];		//	y1[j] = vall(al[1])*cost[j]*y0[j];
+			}
+			l=m;		al+=2;
+			while ((ny<0) && (l<llim)) {		// ylm treated as zero and ignored if ny < 0
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = (vall(al[1])*cost[j])*y1[j] + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = (vall(al[3])*cost[j])*y0[j] + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+				if (fabs(vlo(y0[NWAY-1])) > SHT_ACCURACY*SHT_SCALE_FACTOR + 1.0) {		// rescale when value is significant
+					++ny;
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] *= vall(1.0/SHT_SCALE_FACTOR);		y1[j] *= vall(1.0/SHT_SCALE_FACTOR);
+					}
+				}
+			}
+Q			for (long int i=0; i<nf*4*NWAY; ++i) acc[i] = vall(0.0);
+V			for (long int i=0; i<nf*8*NWAY; ++i) acc[i] = vall(0.0);
+		  if (ny == 0) {
+			long int lb = l;		// first degree of the current block (first degree with significant ylm)
+			while (1) {
+				rnd* y = yl;
+				long int nb = 0;		// number of pairs of degrees in the current block
+				while ((l<llim) && (nb<BATCH_LBLK)) {	// compute and store the ylm once for all fields
+					for (int j=0; j<NWAY; ++j) {
+						y[j] = y0[j];		y[NWAY+j] = y1[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+						y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+					}
+					l+=2;	al+=4;	y+=2*NWAY;	nb++;
+				}
+				const int last = (l >= llim);
+				if (last) {
+					for (int j=0; j<NWAY; ++j) {
+						y[j] = y0[j];		y[NWAY+j] = y1[j];
+					}
+				}
+				for (int f=0; f<nf; f++) {		// apply to all fields.
+Q					cplx* const Ql = Qlm[f] + LiM(shtns, 0, im);	// virtual pointer for l=0 and im
+V					v2d* const VWl = VWbuf + f*(2*llim+4);
+Q					rnd* const af = acc + f*4*NWAY;
+V					rnd* const af = acc + f*8*NWAY;
+Q					rnd rer[NWAY], rei[NWAY], ror[NWAY], roi[NWAY];		// local copies, kept in registers.
+V					rnd ter[NWAY], tei[NWAY], tor[NWAY], toi[NWAY];
+V					rnd per[NWAY], pei[NWAY], por[NWAY], poi[NWAY];
+					for (int j=0; j<NWAY; ++j) {
+Q						rer[j] = af[j];		rei[j] = af[NWAY+j];		ror[j] = af[2*NWAY+j];		roi[j] = af[3*NWAY+j];
+V						ter[j] = af[j];		tei[j] = af[NWAY+j];		tor[j] = af[2*NWAY+j];		toi[j] = af[3*NWAY+j];
+V						per[j] = af[4*NWAY+j];		pei[j] = af[5*NWAY+j];		por[j] = af[6*NWAY+j];		poi[j] = af[7*NWAY+j];
+					}
+					y = yl;
+					for (long int i=0, ll=lb; i<nb; i++, ll+=2) {	// compute even and odd parts
+Q						for (int j=0; j<NWAY; ++j) {	rer[j] += y[j]  * qr(ll);		rei[j] += y[j] * qi(ll);	}
+V						for (int j=0; j<NWAY; ++j) {	ter[j] += y[j]  * vr(ll);		tei[j] += y[j] * vi(ll);	}
+V						for (int j=0; j<NWAY; ++j) {	per[j] += y[j]  * wr(ll);		pei[j] += y[j] * wi(ll);	}
+Q						for (int j=0; j<NWAY; ++j) {	ror[j] += y[NWAY+j]  * qr(ll+1);		roi[j] += y[NWAY+j] * qi(ll+1);	}
+V						for (int j=0; j<NWAY; ++j) {	tor[j] += y[NWAY+j]  * vr(ll+1);		toi[j] += y[NWAY+j] * vi(ll+1);	}
+V						for (int j=0; j<NWAY; ++j) {	por[j] += y[NWAY+j]  * wr(ll+1);		poi[j] += y[NWAY+j] * wi(ll+1);	}
+						y+=2*NWAY;
+					}
+					if (last) {
+V						for (int j=0; j<NWAY; ++j) {	ter[j] += y[j]  * vr(l);		tei[j] += y[j] * vi(l);	}
+V						for (int j=0; j<NWAY; ++j) {	per[j] += y[j]  * wr(l);		pei[j] += y[j] * wi(l);	}
+						if (l==llim) {
+Q							for (int j=0; j<NWAY; ++j) {	rer[j] += y[j]  * qr(l);		rei[j] += y[j] * qi(l);	}
+V							for (int j=0; j<NWAY; ++j) {	tor[j] += y[NWAY+j]  * vr(l+1);		toi[j] += y[NWAY+j] * vi(l+1);	}
+V							for (int j=0; j<NWAY; ++j) {	por[j] += y[NWAY+j]  * wr(l+1);		poi[j] += y[NWAY+j] * wi(l+1);	}
+						}
+					}
+					for (int j=0; j<NWAY; ++j) {
+Q						af[j] = rer[j];		af[NWAY+j] = rei[j];		af[2*NWAY+j] = ror[j];		af[3*NWAY+j] = roi[j];
+V						af[j] = ter[j];		af[NWAY+j] = tei[j];		af[2*NWAY+j] = tor[j];		af[3*NWAY+j] = toi[j];
+V						af[4*NWAY+j] = per[j];		af[5*NWAY+j] = pei[j];		af[6*NWAY+j] = por[j];		af[7*NWAY+j] = poi[j];
+					}
+				}
+				if (last) break;
+				lb = l;
+			}
+		  }
+			for (int f=0; f<nf; f++) {
+Q				v2d* const BrFm = BrF[f] + ofs;
+V				v2d* const BtFm = BtF[f] + ofs;		v2d* const BpFm = BpF[f] + ofs;
+Q				rnd* const rer = acc + f*4*NWAY;		rnd* const rei = rer + NWAY;
+Q				rnd* const ror = rer + 2*NWAY;		rnd* const roi = rer + 3*NWAY;
+V				rnd* const ter = acc + f*8*NWAY;		rnd* const tei = ter + NWAY;
+V				rnd* const tor = ter + 2*NWAY;		rnd* const toi = ter + 3*NWAY;
+V				rnd* const per = ter + 4*NWAY;		rnd* const pei = ter + 5*NWAY;
+V				rnd* const por = ter + 6*NWAY;		rnd* const poi = ter + 7*NWAY;
+			#ifndef SHTNS4MAGIC
+				for (int j=0; j<NWAY; ++j) {
+Q					S2D_CSTORE(BrFm, k+j, rer[j], ror[j], rei[j], roi[j])
+V					S2D_CSTORE(BtFm, k+j, ter[j], tor[j], tei[j], toi[j])
+V					S2D_CSTORE(BpFm, k+j, per[j], por[j], pei[j], poi[j])
+				}
+			#else
+				for (int j=0; j<NWAY; ++j) {
+					if ((k+j)>=nk) break;
+Q					S2D_CSTORE_4MAGIC(BrFm, k+j, rer[j], ror[j], rei[j], roi[j])
+V					S2D_CSTORE_4MAGIC(BtFm, k+j, ter[j], tor[j], tei[j], toi[j])
+V					S2D_CSTORE_4MAGIC(BpFm, k+j, per[j], por[j], pei[j], poi[j])
+				}
+			#endif
+			}
+			k+=NWAY;
+		}
+	  }
+	}
+
+	#pragma omp for schedule(static)
+	for (int f=0; f<nf; f++) {
+	  #if _GCC_VEC_
+Q		v2d* const BrFm = BrF[f] + (imlim+1)*NLAT_2;
+V		v2d* const BtFm = BtF[f] + (imlim+1)*NLAT_2;		v2d* const BpFm = BpF[f] + (imlim+1)*NLAT_2;
+		for (long int k=0; k < NLAT_2*(NPHI-1-2*imlim); ++k) {	// padding for high m's
+Q			BrFm[k] = vdup(0.0);
+V			BtFm[k] = vdup(0.0);	BpFm[k] = vdup(0.0);
+		}
+	  #else
+Q		v2d* const BrFm = BrF[f] + (imlim+1)*NLAT;
+V		v2d* const BtFm = BtF[f] + (imlim+1)*NLAT;		v2d* const BpFm = BpF[f] + (imlim+1)*NLAT;
+		for (long int k=0; k < NLAT*((NPHI>>1) -imlim); ++k) {	// padding for high m's
+Q			BrFm[k] = 0.0;
+V			BtFm[k] = 0.0;	BpFm[k] = 0.0;
+		}
+	  #endif
+	}
+  }
+
+	// FFTs: one call per field, reusing the single-field plan (new-array execute is thread-safe).
+	#if _GCC_VEC_
+  	if (shtns->fftc_mode >= 0) {
+		for (int f=0; f<nf; f++) {
+			if (shtns->fftc_mode != 1) {
+Q				fftw_execute_dft(shtns->ifftc, (cplx *) BrF[f], (cplx *) Vr[f]);
+V				fftw_execute_dft(shtns->ifftc, (cplx *) BtF[f], (cplx *) Vt[f]);
+V				fftw_execute_dft(shtns->ifftc, (cplx *) BpF[f], (cplx *) Vp[f]);
+			} else {		// split dft
+Q				fftw_execute_split_dft(shtns->ifftc,((double*)BrF[f])+1, ((double*)BrF[f]), Vr[f]+NPHI, Vr[f]);
+V				fftw_execute_split_dft(shtns->ifftc,((double*)BtF[f])+1, ((double*)BtF[f]), Vt[f]+NPHI, Vt[f]);
+V				fftw_execute_split_dft(shtns->ifftc,((double*)BpF[f])+1, ((double*)BpF[f]), Vp[f]+NPHI, Vp[f]);
+			}
+		}
+	}
+	#else
+	if (shtns->ncplx_fft >= 0) {
+		for (int f=0; f<nf; f++) {
+Q			fftw_execute_dft_c2r(shtns->ifft, (cplx *) BrF[f], Vr[f]);
+V			fftw_execute_dft_c2r(shtns->ifft, (cplx *) BtF[f], Vt[f]);
+V			fftw_execute_dft_c2r(shtns->ifft, (cplx *) BpF[f], Vp[f]);
+		}
+	}
+	#endif
+
+Q	#undef qr
+Q	#undef qi
+V	#undef vr
+V	#undef vi
+V	#undef wr
+V	#undef wi
+  }
@@ -0,0 +1,457 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+# This file is meta-code for SHT.c (spherical harmonic transform).
+# it is intended for "make" to generate C code for similar SHT functions,
+# from one generic function + tags.
+# > See Makefile and SHT.c
+# Basically, there are tags at the beginning of lines that are information
+# to keep or remove the line depending on the function to build.
+# tags :
+# Q : line for scalar transform
+# V : line for vector transform (both spheroidal and toroidal)
+# S : line for vector transfrom, spheroidal component
+# T : line for vector transform, toroidal component.
+#
+# Batched analysis: the same transform is applied to nf independent fields.
+# For each m and each block of NWAY latitudes, the (weighted) associated Legendre functions
+# are computed once by recurrence, stored in a small buffer (yl) by blocks of BATCH_LBLK pairs of degrees,
+# and then applied to all the fields.
+
+QX	static void GEN3(spat_to_SH_batch,NWAY,SUFFIX)(shtns_cfg shtns, int nf, double **Vr, cplx **Qlm, const long int llim) {
+VX	static void GEN3(spat_to_SHsphtor_batch,NWAY,SUFFIX)(shtns_cfg shtns, int nf, double **Vt, double **Vp, cplx **Slm, cplx **Tlm, const long int llim) {
+
+Q	double *BrF[nf];		// contains the Fourier transformed data
+V	double *BtF[nf], *BpF[nf];	// contains the Fourier transformed data
+	long int nk, imlim;
+	int k_inc, m_inc;
+
+	for (int f=0; f<nf; f++) {
+Q		BrF[f] = Vr[f];
+V		BtF[f] = Vt[f];		BpF[f] = Vp[f];
+	}
+	if (shtns->fftc_mode >= 0) {
+		if (shtns->fftc_mode > 0) {		// alloc memory for out-of-place transforms
+			unsigned long nv = shtns->nspat;
+QX			BrF[0] = (double*) shtns_scratch(SCRATCH_FFT, nf*nv * sizeof(double) );
+VX			BtF[0] = (double*) shtns_scratch(SCRATCH_FFT, 2*nf*nv * sizeof(double) );
+			for (int f=0; f<nf; f++) {
+Q				BrF[f] = BrF[0] + f*nv;
+V				BtF[f] = BtF[0] + f*nv;		BpF[f] = BtF[0] + (nf+f)*nv;
+			}
+		}
+		// FFTs: one call per field, reusing the single-field plan (new-array execute is thread-safe).
+		for (int f=0; f<nf; f++) {
+		    if (shtns->fftc_mode != 1) {	// regular FFT
+Q				fftw_execute_dft(shtns->fftc,(cplx*)Vr[f], (cplx*)BrF[f]);
+V				fftw_execute_dft(shtns->fftc,(cplx*)Vt[f], (cplx*)BtF[f]);
+V				fftw_execute_dft(shtns->fftc,(cplx*)Vp[f], (cplx*)BpF[f]);
+			} else {	// split dft
+Q				fftw_execute_split_dft(shtns->fftc, Vr[f]+NPHI, Vr[f], BrF[f]+1, BrF[f]);
+V				fftw_execute_split_dft(shtns->fftc, Vt[f]+NPHI, Vt[f], BtF[f]+1, BtF[f]);
+V				fftw_execute_split_dft(shtns->fftc, Vp[f]+NPHI, Vp[f], BpF[f]+1, BpF[f]);
+		    }
+		}
+	}
+	imlim = MTR;
+	#ifdef SHT_VAR_LTR
+		if (imlim*MRES > (unsigned) llim) imlim = ((unsigned) llim)/MRES;		// 32bit mul and div should be faster
+	#endif
+
+	// ACCESS PATTERN
+	k_inc = shtns->k_stride_a;
+	m_inc = shtns->m_stride_a;
+
+	nk = NLAT_2;	// copy NLAT_2 to a local variable for faster access (inner loop limit)
+	#if _GCC_VEC_
+	  nk = ((unsigned) nk+(VSIZE2-1))/VSIZE2;
+	#endif
+
+  #pragma omp parallel num_threads(shtns->nthreads)
+  {
+	double* const wg = shtns->wg;
+	double* const ct = shtns->ct;
+	double* const st = shtns->st;
+V	double* const l_2 = shtns->l_2;
+	rnd yl[(2*BATCH_LBLK+2)*NWAY];		// Legendre functions for one block of latitudes and degrees, shared by all fields.
+	// symmetric and anti-symmetric parts of all fields (padded for the multi-way algorithm), followed by the partial sums.
+	const long int nsa = ((NLAT_2 + NWAY*VSIZE2 + VSIZE2-1)/VSIZE2)*VSIZE2;
+Q	const long int nqq = 2*llim+4;
+V	const long int nqq = 4*llim+8;
+Q	double* const sa = (double*) shtns_scratch(SCRATCH_BATCH, nf*(4*nsa*sizeof(double) + nqq*sizeof(rnd)) );
+V	double* const sa = (double*) shtns_scratch(SCRATCH_BATCH, nf*(8*nsa*sizeof(double) + nqq*sizeof(rnd)) );
+Q	rnd* const qqbuf = (rnd*) (sa + 4*nf*nsa);
+V	rnd* const qqbuf = (rnd*) (sa + 8*nf*nsa);
+Q	for (long int i=0; i<4*nf*nsa; i++) sa[i] = 0.0;		// padding must be zero (never written).
+V	for (long int i=0; i<8*nf*nsa; i++) sa[i] = 0.0;		// padding must be zero (never written).
+
+	#pragma omp for schedule(dynamic)
+	for (long int im=0; im<=imlim; ++im) {
+		long int k, l, m;
+		double *alm, *al;
+	  if (im == 0) {
+		alm = shtns->blm;
+		for (int f=0; f<nf; f++) {
+			// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
+Q			double* const rer = sa + 4*f*nsa;		double* const ror = rer + nsa;
+V			double* const ter = sa + 8*f*nsa;		double* const tor = ter + nsa;
+V			double* const per = ter + 2*nsa;		double* const por = ter + 3*nsa;
+Q			rnd* const qq = qqbuf + f*nqq;
+V			rnd* const vw = qqbuf + f*nqq;
+Q			double r0 = 0.0;
+Q			SYM_ASYM_M0_Q(BrF[f], rer, ror, r0)
+Q			Qlm[f][0] = r0 * alm[0];			// l=0 is done.
+V			SYM_ASYM_M0_V(BtF[f], ter, tor)
+V			SYM_ASYM_M0_V(BpF[f], per, por)
+V			Slm[f][0] = 0.0;		Tlm[f][0] = 0.0;		// l=0 is zero for the vector transform.
+			for (l=0;l<llim;++l) {
+Q				qq[l] = vall(0.0);
+V				vw[2*l] = vall(0.0);		vw[2*l+1] = vall(0.0);
+			}
+		}
+		k = 0;
+		do {
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(ct, k+j);
+				y0[j] = vall(al[0]) * vread(wg, k+j);		// weight of Gauss quadrature appears here
+V				dy0[j] = vall(0.0);
+V				sint[j] = -vread(st, k+j);
+				y1[j] =  (vall(al[1])*y0[j]) * cost[j];
+V				dy1[j] = (vall(al[1])*y0[j]) * sint[j];
+			}
+			al+=2;	l=1;
+			while (1) {
+				rnd* y = yl;
+				const long int lb = l;		// first degree of the current block
+				long int nb = 0;		// number of pairs of degrees in the current block
+				while ((l<llim) && (nb<BATCH_LBLK)) {
+					for (int j=0; j<NWAY; ++j) {
+Q						y[j] = y1[j];
+V						y[j] = dy1[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+V						dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+						y0[j]  = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+Q						y[NWAY+j] = y0[j];
+V						y[NWAY+j] = dy0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+V						dy1[j] = vall(al[3])*(cost[j]*dy0[j] + y0[j]*sint[j]) + vall(al[2])*dy1[j];
+						y1[j]  = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+					}
+					al+=4;	l+=2;	y+=2*NWAY;	nb++;
+				}
+				if (l==llim) {
+					for (int j=0; j<NWAY; ++j) {
+Q						y[j] = y1[j];
+V						y[j] = dy1[j];
+					}
+				}
+				for (int f=0; f<nf; f++) {		// apply to all fields.
+Q					double* const rer = sa + 4*f*nsa;		double* const ror = rer + nsa;
+V					double* const ter = sa + 8*f*nsa;		double* const tor = ter + nsa;
+V					double* const per = ter + 2*nsa;		double* const por = ter + 3*nsa;
+Q					rnd* const qq = qqbuf + f*nqq;
+V					rnd* const vw = qqbuf + f*nqq;
+Q					rnd rerk[NWAY], rork[NWAY];		// help the compiler to cache into registers.
+V					rnd terk[NWAY], tork[NWAY], perk[NWAY], pork[NWAY];
+					for (int j=0; j<NWAY; ++j) {
+Q						rerk[j] = vread(rer, k+j);		rork[j] = vread(ror, k+j);		// cache into registers.
+V						terk[j] = vread(ter, k+j);		tork[j] = vread(tor, k+j);
+V						perk[j] = vread(per, k+j);		pork[j] = vread(por, k+j);
+					}
+					y = yl;
+					for (long int i=0, ll=lb; i<nb; i++, ll+=2) {		// ll is odd
+Q						rnd q0 = vall(0.0);		rnd q1 = vall(0.0);		// local sums do not alias yl
+V						rnd v0 = vall(0.0);		rnd v1 = vall(0.0);		rnd v2 = vall(0.0);		rnd v3 = vall(0.0);		// local sums do not alias yl
+						for (int j=0; j<NWAY; ++j) {
+Q							q0 += y[j] * rork[j];
+V							v0 += y[j] * terk[j];
+V							v1 -= y[j] * perk[j];
+						}
+						for (int j=0; j<NWAY; ++j) {
+Q							q1 += y[NWAY+j] * rerk[j];
+V							v2 += y[NWAY+j] * tork[j];
+V							v3 -= y[NWAY+j] * pork[j];
+						}
+Q						qq[ll-1] += q0;		qq[ll] += q1;
+V						vw[2*ll-2] += v0;		vw[2*ll-1] += v1;		vw[2*ll] += v2;		vw[2*ll+1] += v3;
+						y+=2*NWAY;
+					}
+					if (l==llim) {
+						for (int j=0; j<NWAY; ++j) {
+Q							qq[l-1]   += y[j] * rork[j];
+V							vw[2*l-2] += y[j] * terk[j];
+V							vw[2*l-1] -= y[j] * perk[j];
+						}
+					}
+				}
+				if (l >= llim) break;
+			}
+			k+=NWAY;
+		} while (k < nk);		// limit: k=nk-1   =>  k=nk-1+NWAY is never read.
+		for (int f=0; f<nf; f++) {
+Q			rnd* const qq = qqbuf + f*nqq;
+V			rnd* const vw = qqbuf + f*nqq;
+			for (l=1; l<=llim; ++l) {
+				#if _GCC_VEC_
+Q					((v2d*)Qlm[f])[l] = v2d_reduce(qq[l-1], vall(0));
+V					((v2d*)Slm[f])[l] = v2d_reduce(vw[2*l-2], vall(0)) * vdup(l_2[l]);
+V					((v2d*)Tlm[f])[l] = v2d_reduce(vw[2*l-1], vall(0)) * vdup(l_2[l]);
+				#else
+Q					Qlm[f][l] = qq[l-1];
+V					Slm[f][l] = vw[2*l-2]*l_2[l];		Tlm[f][l] = vw[2*l-1]*l_2[l];
+				#endif
+			}
+			#ifdef SHT_VAR_LTR
+				for (l=llim+1; l<= LMAX; ++l) {
+Q					Qlm[f][l] = 0.0;
+V					Slm[f][l] = 0.0;		Tlm[f][l] = 0.0;
+				}
+			#endif
+		}
+
+	  } else {		// im > 0
+		m = im*MRES;
+		alm = shtns->blm + ALM_IDX(shtns, im);
+		const long int k0 = shtns->tm[im] / VSIZE2;
+		for (int f=0; f<nf; f++) {
+			// compute symmetric and anti-symmetric parts:
+Q			double* const rer = sa + 4*f*nsa;		double* const ror = rer + nsa;
+Q			double* const rei = rer + 2*nsa;		double* const roi = rer + 3*nsa;
+V			double* const ter = sa + 8*f*nsa;		double* const tor = ter + nsa;
+V			double* const tei = ter + 2*nsa;		double* const toi = ter + 3*nsa;
+V			double* const per = ter + 4*nsa;		double* const por = ter + 5*nsa;
+V			double* const pei = ter + 6*nsa;		double* const poi = ter + 7*nsa;
+QX			SYM_ASYM_Q(BrF[f], rer, ror, rei, roi, k0)
+V			SYM_ASYM_V(BtF[f], ter, tor, tei, toi, k0)
+V			SYM_ASYM_V(BpF[f], per, por, pei, poi, k0)
+Q			rnd* q = qqbuf + f*nqq;
+V			rnd* v = qqbuf + f*nqq;
+			for (l=llim+1-m; l>=0; l--) {
+Q				q[0] = vall(0.0);		q[1] = vall(0.0);		q+=2;
+V				v[0] = vall(0.0);		v[1] = vall(0.0);
+V				v[2] = vall(0.0);		v[3] = vall(0.0);		v+=4;
+			}
+		}
+		k=k0;
+		while (k < nk) {		// a latitude block may be entirely polar (no work).
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(st, k+j);
+				y0[j] = vall(0.5);
+			}
+Q			l=m;
+V			l=m-1;
+			long int ny = 0;	// exponent to extend double precision range.
+		if ((int)llim <= SHT_L_RESCALE_FLY) {
+			do {		// sin(theta)^m
+				if (l&1) for (int j=0; j<NWAY; ++j) y0[j] *= cost[j];
+				for (int j=0; j<NWAY; ++j) cost[j] *= cost[j];
+			} while(l >>= 1);
+		} else {
+			long int nsint = 0;
+			do {		// sin(theta)^m		(use rescaling to avoid underflow)
+				if (l&1) {
+					for (int j=NWAY-1; j>=0; --j) y0[j] *= cost[j];
+					ny += nsint;
+					if (vlo(y0[NWAY-1]) < (SHT_ACCURACY+1.0/SHT_SCALE_FACTOR)) {
+						ny--;
+						for (int j=NWAY-1; j>=0; --j) y0[j] *= vall(SHT_SCALE_FACTOR);
+					}
+				}
+				for (int j=NWAY-1; j>=0; --j) cost[j] *= cost[j];
+				nsint += nsint;
+				if (vlo(cost[NWAY-1]) < 1.0/SHT_SCALE_FACTOR) {
+					nsint--;
+					for (int j=NWAY-1; j>=0; --j) cost[j] *= vall(SHT_SCALE_FACTOR);
+				}
+			} while(l >>= 1);
+		}
+			for (int j=0; j<NWAY; ++j) {
+				y0[j] *= vall(al[0]);
+				cost[j] = vread(ct, k+j);
+				y1[j]  = (vall(al[1])*y0[j]) *cost[j];
+			}
+			l=m;	al+=2;
+			while ((ny<0) && (l<llim)) {		// ylm treated as zero and ignored if ny < 0
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+				if (fabs(vlo(y0[NWAY-1])) > SHT_ACCURACY*SHT_SCALE_FACTOR + 1.0) {		// rescale when value is significant
+					++ny;
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] *= vall(1.0/SHT_SCALE_FACTOR);		y1[j] *= vall(1.0/SHT_SCALE_FACTOR);
+					}
+				}
+			}
+		  if (ny == 0) {
+			long int lb = l;		// first degree of the current block (first degree with significant ylm)
+			for (int j=0; j<NWAY; ++j) {
+				y0[j] *= vread(wg, k+j);		y1[j] *= vread(wg, k+j);		// weight appears here (must be after the previous accuracy loop).
+			}
+			while (1) {
+				rnd* y = yl;
+				long int nb = 0;		// number of pairs of degrees in the current block
+				while ((l<llim) && (nb<BATCH_LBLK)) {	// compute and store the ylm once for all fields
+					for (int j=0; j<NWAY; ++j) {
+						y[j] = y0[j];		y[NWAY+j] = y1[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+					}
+					for (int j=0; j<NWAY; ++j) {
+						y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+					}
+					l+=2;	al+=4;	y+=2*NWAY;	nb++;
+				}
+				const int last = (l >= llim);
+				if (last) {
+					for (int j=0; j<NWAY; ++j) {
+						y[j] = y0[j];		y[NWAY+j] = y1[j];
+					}
+				}
+				for (int f=0; f<nf; f++) {		// apply to all fields.
+Q					double* const rer = sa + 4*f*nsa;		double* const ror = rer + nsa;
+Q					double* const rei = rer + 2*nsa;		double* const roi = rer + 3*nsa;
+V					double* const ter = sa + 8*f*nsa;		double* const tor = ter + nsa;
+V					double* const tei = ter + 2*nsa;		double* const toi = ter + 3*nsa;
+V					double* const per = ter + 4*nsa;		double* const por = ter + 5*nsa;
+V					double* const pei = ter + 6*nsa;		double* const poi = ter + 7*nsa;
+Q					rnd* q = qqbuf + f*nqq + 2*(lb-m);
+V					rnd* v = qqbuf + f*nqq + 4*(lb-m);
+Q					rnd rerk[NWAY], reik[NWAY], rork[NWAY], roik[NWAY];		// help the compiler to cache into registers.
+V					rnd terk[NWAY], teik[NWAY], tork[NWAY], toik[NWAY];
+V					rnd perk[NWAY], peik[NWAY], pork[NWAY], poik[NWAY];
+					for (int j=0; j<NWAY; ++j) {	// prefetch
+Q						rerk[j] = vread( rer, k+j);		reik[j] = vread( rei, k+j);		rork[j] = vread( ror, k+j);		roik[j] = vread( roi, k+j);
+V						terk[j] = vread( ter, k+j);		teik[j] = vread( tei, k+j);		tork[j] = vread( tor, k+j);		toik[j] = vread( toi, k+j);
+V						perk[j] = vread( per, k+j);		peik[j] = vread( pei, k+j);		pork[j] = vread( por, k+j);		poik[j] = vread( poi, k+j);
+					}
+					y = yl;
+					for (long int i=0; i<nb; i++) {	// compute even and odd parts
+Q						rnd q0 = vall(0.0);		rnd q1 = vall(0.0);		rnd q2 = vall(0.0);		rnd q3 = vall(0.0);		// local sums do not alias yl
+V						rnd v0 = vall(0.0);		rnd v1 = vall(0.0);		rnd v2 = vall(0.0);		rnd v3 = vall(0.0);		// local sums do not alias yl
+V						rnd v4 = vall(0.0);		rnd v5 = vall(0.0);		rnd v6 = vall(0.0);		rnd v7 = vall(0.0);
+Q						for (int j=0; j<NWAY; ++j)	{	q0 += y[j] * rerk[j];	q1 += y[j] * reik[j];	}
+V						for (int j=0; j<NWAY; ++j)	{	v0 += y[j] * terk[j];	v1 += y[j] * teik[j];	}
+V						for (int j=0; j<NWAY; ++j)	{	v2 += y[j] * perk[j];	v3 += y[j] * peik[j];	}
+Q						for (int j=0; j<NWAY; ++j)	{	q2 += y[NWAY+j] * rork[j];	q3 += y[NWAY+j] * roik[j];	}
+V						for (int j=0; j<NWAY; ++j)	{	v4 += y[NWAY+j] * tork[j];	v5 += y[NWAY+j] * toik[j];	}
+V						for (int j=0; j<NWAY; ++j)	{	v6 += y[NWAY+j] * pork[j];	v7 += y[NWAY+j] * poik[j];	}
+Q						q[0] += q0;		q[1] += q1;		q[2] += q2;		q[3] += q3;
+V						v[0] += v0;		v[1] += v1;		v[2] += v2;		v[3] += v3;
+V						v[4] += v4;		v[5] += v5;		v[6] += v6;		v[7] += v7;
+Q						q+=4;
+V						v+=8;
+						y+=2*NWAY;
+					}
+					if (last) {
+V						for (int j=0; j<NWAY; ++j)	{	v[0] += y[j] * terk[j];	v[1] += y[j] * teik[j];	}
+V						for (int j=0; j<NWAY; ++j)	{	v[2] += y[j] * perk[j];	v[3] += y[j] * peik[j];	}
+						if (l==llim) {
+Q							for (int j=0; j<NWAY; ++j)	{	q[0] += y[j] * rerk[j];	q[1] += y[j] * reik[j];	}
+V							for (int j=0; j<NWAY; ++j)	{	v[4] += y[NWAY+j] * tork[j];	v[5] += y[NWAY+j] * toik[j];	}
+V							for (int j=0; j<NWAY; ++j)	{	v[6] += y[NWAY+j] * pork[j];	v[7] += y[NWAY+j] * poik[j];	}
+						}
+					}
+				}
+				if (last) break;
+				lb = l;
+			}
+		  }
+			k+=NWAY;
+		}		// limit: k=nk-1   =>  k=nk-1+NWAY is never read.
+
+		for (int f=0; f<nf; f++) {
+Q			rnd* const qq = qqbuf + f*nqq;
+V			rnd* const vw = qqbuf + f*nqq;
+			l = LiM(shtns, m, im);
+Q			v2d * const Ql = (v2d*) &Qlm[f][l];
+V			v2d * const Sl = (v2d*) &Slm[f][l];
+V			v2d * const Tl = (v2d*) &Tlm[f][l];
+Q			#if _GCC_VEC_
+Q				for (l=0; l<=llim-m; ++l) {
+Q					Ql[l] = v2d_reduce(qq[2*l], qq[2*l+1]);
+Q				}
+Q			#else
+Q				for (l=0; l<=llim-m; ++l) {
+Q					Ql[l] = qq[2*l] + I*qq[2*l+1];
+Q				}
+Q			#endif
+
+V			{	// convert from the two scalar SH to vector SH
+V				// Slm = - (I*m*Wlm + MX*Vlm) / (l*(l+1))
+V				// Tlm = - (I*m*Vlm - MX*Wlm) / (l*(l+1))
+V				double* mx = shtns->mx_van + 2*LM(shtns,m,m);
+V				s2d em = vdup(m);
+V				v2d vl = v2d_reduce(vw[0], vw[1]);
+V				v2d wl = v2d_reduce(vw[2], vw[3]);
+V				v2d sl = vdup( 0.0 );
+V				v2d tl = vdup( 0.0 );
+V				for (int l=0; l<=llim-m; l++) {
+V					s2d mxu = vdup( mx[2*l] );
+V					s2d mxl = vdup( mx[2*l+1] );		// mxl for next iteration
+V					sl = addi( sl ,  em*wl );
+V					tl = addi( tl ,  em*vl );
+V					v2d sl1 =  mxl*vl;			// vs for next iter
+V					v2d tl1 = -mxl*wl;			// wt for next iter
+V					vl = v2d_reduce(vw[4*l+4], vw[4*l+5]);		// kept for next iteration
+V					wl = v2d_reduce(vw[4*l+6], vw[4*l+7]);
+V					sl += mxu*vl;
+V					tl -= mxu*wl;
+V					Sl[l] = -sl * vdup(l_2[l+m]);
+V					Tl[l] = -tl * vdup(l_2[l+m]);
+V					sl = sl1;
+V					tl = tl1;
+V				}
+V			}
+
+			#ifdef SHT_VAR_LTR
+				for (l=llim+1-m; l<=LMAX-m; ++l) {
+Q					Ql[l] = vdup(0.0);
+V					Sl[l] = vdup(0.0);		Tl[l] = vdup(0.0);
+				}
+			#endif
+		}
+	  }
+	}
+  }
+
+	#ifdef SHT_VAR_LTR
+	if (imlim < MMAX) {
+		for (int f=0; f<nf; f++) {
+			long int l = LiM(shtns, (imlim+1)*MRES, imlim+1);
+			do {
+Q				((v2d*)Qlm[f])[l] = vdup(0.0);
+V				((v2d*)Slm[f])[l] = vdup(0.0);		((v2d*)Tlm[f])[l] = vdup(0.0);
+			} while(++l < shtns->nlm);
+		}
+	}
+	#endif
+
+  }
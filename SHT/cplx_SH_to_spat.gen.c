@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+# This file is meta-code for SHT.c (spherical harmonic transform).
+# it is intended for "make" to generate C code for similar SHT functions,
+# from one generic function + tags.
+# > See Makefile and SHT.c
+# Basically, there are tags at the beginning of lines that are information
+# to keep or remove the line depending on the function to build.
+# tags :
+# Q : line for scalar transform
+# V : line for vector transform (both spheroidal and toroidal)
+# S : line for vector transfrom, spheroidal component
+# T : line for vector transform, toroidal component.
+#
+# Synthesis of complex-valued fields (coefficients stored at LM_cplx(l,m), with -l <= m <= l).
+# The orders m and -m share the same associated Legendre functions, which are computed once by recurrence
+# and applied to both orders (the coefficients of -m are multiplied by (-1)^m beforehand).
+# The Fourier coefficients of order m are written to column m and those of order -m to column NPHI-m,
+# so that a single complex fft of the whole field yields the spatial data.
+# If xs is not NULL, the result is multiplied by xs[theta] (which must be symmetric with respect to the equator).
+
+QX	static void GEN3(SH_to_spat_cplx,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Zlm, cplx *z, const long int llim) {
+VX	static void GEN3(SHsphtor_to_spat_cplx,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, cplx *Tlm, cplx *zt, cplx *zp, const double *xs, const long int llim) {
+
+Q	cplx *BrF;
+V	cplx *BtF, *BpF;
+Q	#define qr(l) vall( ((double*) Ql)[4*(l)]   )
+Q	#define qi(l) vall( ((double*) Ql)[4*(l)+1] )
+Q	#define nr(l) vall( ((double*) Ql)[4*(l)+2] )
+Q	#define ni(l) vall( ((double*) Ql)[4*(l)+3] )
+V	#define vr(l) vall( ((double*) VWl)[4*(l)]   )
+V	#define vi(l) vall( ((double*) VWl)[4*(l)+1] )
+V	#define wr(l) vall( ((double*) VWl)[4*(l)+2] )
+V	#define wi(l) vall( ((double*) VWl)[4*(l)+3] )
+V	#define vnr(l) vall( ((double*) VWn)[4*(l)]   )
+V	#define vni(l) vall( ((double*) VWn)[4*(l)+1] )
+V	#define wnr(l) vall( ((double*) VWn)[4*(l)+2] )
+V	#define wni(l) vall( ((double*) VWn)[4*(l)+3] )
+	long int nk, imlim;
+
+Q	BrF = z;
+V	BtF = zt;	BpF = zp;
+	if ((shtns->fftc_mode >= 0) && (shtns->layout & SHT_PHI_CONTIGUOUS)) {		// the fft is done out-of-place
+		const long int nspat = ((long int) NLAT) * NPHI;
+QX		BrF = (cplx*) shtns_scratch(SCRATCH_CPLX, nspat * sizeof(cplx));
+VX		BtF = (cplx*) shtns_scratch(SCRATCH_CPLX, 2*nspat * sizeof(cplx));
+VX		BpF = BtF + nspat;
+	}
+
+	imlim = MTR;
+	#ifdef SHT_VAR_LTR
+		if (imlim*MRES > (unsigned) llim) imlim = ((unsigned) llim)/MRES;
+	#endif
+	nk = NLAT_2;
+	#if _GCC_VEC_
+		nk = ((unsigned)(nk+VSIZE2-1)) / VSIZE2;
+	#endif
+
+  #pragma omp parallel num_threads(shtns->nthreads)
+  {
+	s2d* const ct = (s2d*) shtns->ct;
+	s2d* const st = (s2d*) shtns->st;
+Q	v2d Ql[2*llim+4];		// coefficients of order m and (-1)^m times those of order -m, interleaved.
+S	v2d Sl[2*llim+4];
+T	v2d Tl[2*llim+4];
+V	v2d VWl[2*llim+4];		// scalar coefficients for order m...
+V	v2d VWn[2*llim+4];		// ...and for order -m
+
+	#pragma omp for schedule(dynamic)
+	for (long int im=0; im<=imlim; ++im) {
+		long int k, l;
+		const long int m = im*MRES;
+		double* const alm = shtns->alm + ALM_IDX(shtns, im);
+		double* al;
+Q		v2d* const BrFp = (v2d*) (BrF + im*NLAT);		// order m
+V		v2d* const BtFp = (v2d*) (BtF + im*NLAT);		v2d* const BpFp = (v2d*) (BpF + im*NLAT);
+Q		v2d* const BrFn = (v2d*) (BrF + (NPHI-im)*NLAT);		// order -m (not used for m=0)
+V		v2d* const BtFn = (v2d*) (BtF + (NPHI-im)*NLAT);		v2d* const BpFn = (v2d*) (BpF + (NPHI-im)*NLAT);
+
+	  if (im == 0) {
+Q		cplx* const Ql0 = (cplx*) Ql;
+S		cplx* const Sl0 = (cplx*) Sl;
+T		cplx* const Tl0 = (cplx*) Tl;
+		for (l=0; l<=llim; l++) {
+Q			Ql0[l] = Zlm[LM_cplx(shtns, l, 0)];
+S			Sl0[l] = Slm[LM_cplx(shtns, l, 0)];
+T			Tl0[l] = Tlm[LM_cplx(shtns, l, 0)];
+		}
+Q		Ql0[llim+1] = 0.0;		// read but not used if llim is even.
+S		Sl0[llim+1] = 0.0;
+T		Tl0[llim+1] = 0.0;
+		k=0;
+		do {
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
+Q			rnd rer[NWAY], rei[NWAY], ror[NWAY], roi[NWAY];
+S			rnd ter[NWAY], tei[NWAY], tor[NWAY], toi[NWAY];
+T			rnd per[NWAY], pei[NWAY], por[NWAY], poi[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(ct, j+k);
+V				sint[j] = -vread(st, j+k);
+				y0[j] = vall(al[0]);
+V				dy0[j] = vall(0.0);
+Q				rer[j] = y0[j] * vall(creal(Ql0[0]));		rei[j] = y0[j] * vall(cimag(Ql0[0]));
+S				tor[j] = vall(0.0);		toi[j] = vall(0.0);
+T				por[j] = vall(0.0);		poi[j] = vall(0.0);
+			}
+			for (int j=0; j<NWAY; ++j) {
+				y1[j]  = vall(al[0]*al[1]) * cost[j];
+V				dy1[j] = vall(al[0]*al[1]) * sint[j];
+			}
+			for (int j=0; j<NWAY; ++j) {
+Q				ror[j] = y1[j] * vall(creal(Ql0[1]));		roi[j] = y1[j] * vall(cimag(Ql0[1]));
+S				ter[j] = dy1[j] * vall(creal(Sl0[1]));		tei[j] = dy1[j] * vall(cimag(Sl0[1]));
+T				per[j] = -dy1[j] * vall(creal(Tl0[1]));		pei[j] = -dy1[j] * vall(cimag(Tl0[1]));
+			}
+			al+=2;	l=2;
+			while(l<llim) {
+				for (int j=0; j<NWAY; ++j) {
+V					dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+					y0[j]  = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+Q					rer[j] += y0[j] * vall(creal(Ql0[l]));		rei[j] += y0[j] * vall(cimag(Ql0[l]));
+S					tor[j] += dy0[j] * vall(creal(Sl0[l]));		toi[j] += dy0[j] * vall(cimag(Sl0[l]));
+T					por[j] -= dy0[j] * vall(creal(Tl0[l]));		poi[j] -= dy0[j] * vall(cimag(Tl0[l]));
+				}
+				for (int j=0; j<NWAY; ++j) {
+V					dy1[j] = vall(al[3])*(cost[j]*dy0[j] + y0[j]*sint[j]) + vall(al[2])*dy1[j];
+					y1[j]  = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+Q					ror[j] += y1[j] * vall(creal(Ql0[l+1]));		roi[j] += y1[j] * vall(cimag(Ql0[l+1]));
+S					ter[j] += dy1[j] * vall(creal(Sl0[l+1]));		tei[j] += dy1[j] * vall(cimag(Sl0[l+1]));
+T					per[j] -= dy1[j] * vall(creal(Tl0[l+1]));		pei[j] -= dy1[j] * vall(cimag(Tl0[l+1]));
+				}
+				al+=4;	l+=2;
+			}
+			if (l==llim) {
+				for (int j=0; j<NWAY; ++j) {
+V					dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+					y0[j]  = vall(al[1])*cost[j]*y1[j] + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+Q					rer[j] += y0[j] * vall(creal(Ql0[l]));		rei[j] += y0[j] * vall(cimag(Ql0[l]));
+S					tor[j] += dy0[j] * vall(creal(Sl0[l]));		toi[j] += dy0[j] * vall(cimag(Sl0[l]));
+T					por[j] -= dy0[j] * vall(creal(Tl0[l]));		poi[j] -= dy0[j] * vall(cimag(Tl0[l]));
+				}
+			}
+V			if (xs) for (int j=0; j<NWAY; ++j) {
+V				const rnd x = vread(xs, k+j);
+V				ter[j] *= x;	tei[j] *= x;	tor[j] *= x;	toi[j] *= x;
+V				per[j] *= x;	pei[j] *= x;	por[j] *= x;	poi[j] *= x;
+V			}
+			for (int j=0; j<NWAY; ++j) {
+				if ((k+j)>=nk) break;
+Q				S2D_CSTORE2(BrFp, k+j, rer[j], ror[j], rei[j], roi[j])
+S				S2D_CSTORE2(BtFp, k+j, ter[j], tor[j], tei[j], toi[j])
+T				S2D_CSTORE2(BpFp, k+j, per[j], por[j], pei[j], poi[j])
+			}
+			k+=NWAY;
+		} while (k < nk);
+
+	  } else {	// im > 0
+		const double parity = (m&1) ? -1.0 : 1.0;		// (-1)^m
+		for (l=m; l<=llim; l++) {		// gather the coefficients of orders m and -m
+			const long int lm = LM_cplx(shtns, l, 0);
+Q			Ql[2*l]   = ((v2d*)Zlm)[lm+m];
+Q			Ql[2*l+1] = ((v2d*)Zlm)[lm-m] * vdup(parity);
+S			Sl[2*l]   = ((v2d*)Slm)[lm+m];
+S			Sl[2*l+1] = ((v2d*)Slm)[lm-m] * vdup(parity);
+T			Tl[2*l]   = ((v2d*)Tlm)[lm+m];
+T			Tl[2*l+1] = ((v2d*)Tlm)[lm-m] * vdup(parity);
+		}
+Q		Ql[2*llim+2] = vdup(0.0);		Ql[2*llim+3] = vdup(0.0);		// read but not used if llim-m is even.
+
+V		for (int s=0; s<2; s++) {	// convert from vector SH to scalar SH, for order m (s=0) and -m (s=1)
+V			v2d* const VW = (s==0) ? VWl : VWn;
+V			double* mx = shtns->mx_stdt + 2*LiM(shtns, 0, im);
+V			s2d em = vdup( (s==0) ? m : -m );
+S			v2d sl = Sl[2*m+s];
+T			v2d tl = Tl[2*m+s];
+V			v2d vs = vdup( 0.0 );
+V			v2d wt = vdup( 0.0 );
+V			for (long int l=m; l<=llim; l++) {
+V				s2d mxu = vdup( mx[2*l] );
+V				s2d mxl = vdup( mx[2*l+1] );		// mxl for next iteration
+T				vs = addi( vs ,  em*tl );
+S				wt = addi( wt ,  em*sl );
+S				v2d vs1 = mxl*sl;			// vs for next iter
+T				v2d wt1 = -mxl*tl;			// wt for next iter
+V				if (l<llim) {
+S					sl = Sl[2*l+2+s];		// kept for next iteration
+T					tl = Tl[2*l+2+s];
+S					vs += mxu*sl;
+T					wt -= mxu*tl;
+V				}
+V				VW[2*l]   = vs;
+V				VW[2*l+1] = wt;
+V				vs = vdup( 0.0 );		wt = vdup( 0.0 );
+S				vs = vs1;
+T				wt = wt1;
+V			}
+V			VW[2*llim+2] = vs;
+V			VW[2*llim+3] = wt;
+V		}
+
+		l = shtns->tm[im];
+		for (k=0; k<l; ++k) {	// polar optimization
+Q			BrFp[k] = vdup(0.0);		BrFp[NLAT-1-k] = vdup(0.0);
+Q			BrFn[k] = vdup(0.0);		BrFn[NLAT-1-k] = vdup(0.0);
+V			BtFp[k] = vdup(0.0);		BtFp[NLAT-1-k] = vdup(0.0);
+V			BpFp[k] = vdup(0.0);		BpFp[NLAT-1-k] = vdup(0.0);
+V			BtFn[k] = vdup(0.0);		BtFn[NLAT-1-k] = vdup(0.0);
+V			BpFn[k] = vdup(0.0);		BpFn[NLAT-1-k] = vdup(0.0);
+		}
+
+		k = ((unsigned) l) / VSIZE2;
+		while (k < nk) {
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+Q			rnd rer[NWAY], rei[NWAY], ror[NWAY], roi[NWAY];		// order m
+Q			rnd rern[NWAY], rein[NWAY], rorn[NWAY], roin[NWAY];		// order -m
+V			rnd ter[NWAY], tei[NWAY], tor[NWAY], toi[NWAY];
+V			rnd per[NWAY], pei[NWAY], por[NWAY], poi[NWAY];
+V			rnd tern[NWAY], tein[NWAY], torn[NWAY], toin[NWAY];
+V			rnd pern[NWAY], pein[NWAY], porn[NWAY], poin[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(st, k+j);
+				y0[j] = vall(1.0);
+			}
+Q			l=m;
+V			l=m-1;
+			long int ny = 0;
+		  if ((int)llim <= SHT_L_RESCALE_FLY) {
+			do {		// sin(theta)^m
+				if (l&1) for (int j=0; j<NWAY; ++j) y0[j] *= cost[j];
+				for (int j=0; j<NWAY; ++j) cost[j] *= cost[j];
+			} while(l >>= 1);
+		  } else {
+			long int nsint = 0;
+			do {		// sin(theta)^m		(use rescaling to avoid underflow)
+				if (l&1) {
+					for (int j=NWAY-1; j>=0; --j) y0[j] *= cost[j];
+					ny += nsint;
+					if (vlo(y0[NWAY-1]) < (SHT_ACCURACY+1.0/SHT_SCALE_FACTOR)) {
+						ny--;
+						for (int j=NWAY-1; j>=0; --j) y0[j] *= vall(SHT_SCALE_FACTOR);
+					}
+				}
+				for (int j=NWAY-1; j>=0; --j) cost[j] *= cost[j];
+				nsint += nsint;
+				if (vlo(cost[NWAY-1]) < 1.0/SHT_SCALE_FACTOR) {
+					nsint--;
+					for (int j=NWAY-1; j>=0; --j) cost[j] *= vall(SHT_SCALE_FACTOR);
+				}
+			} while(l >>= 1);
+		  }
+			for (int j=0; j<NWAY; ++j) {
+				y0[j] *= vall(al[0]);
+				cost[j] = vread(ct, j+k);
+Q				rer[j] = vall(0.0);		rei[j] = vall(0.0);		ror[j] = vall(0.0);		roi[j] = vall(0.0);
+Q				rern[j] = vall(0.0);	rein[j] = vall(0.0);	rorn[j] = vall(0.0);	roin[j] = vall(0.0);
+			}
+			for (int j=0; j<NWAY; ++j) {
+				y1[j]  = (vall(al[1])*y0[j]) *cost[j];
+V				ter[j] = vall(0.0);		tei[j] = vall(0.0);		tor[j] = vall(0.0);		toi[j] = vall(0.0);
+V				per[j] = vall(0.0);		pei[j] = vall(0.0);		por[j] = vall(0.0);		poi[j] = vall(0.0);
+V				tern[j] = vall(0.0);	tein[j] = vall(0.0);	torn[j] = vall(0.0);	toin[j] = vall(0.0);
+V				pern[j] = vall(0.0);	pein[j] = vall(0.0);	porn[j] = vall(0.0);	poin[j] = vall(0.0);
+			}
+			l=m;		al+=2;
+			while ((ny<0) && (l<llim)) {		// ylm treated as zero and ignored if ny < 0
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = (vall(al[1])*cost[j])*y1[j] + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = (vall(al[3])*cost[j])*y0[j] + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+				if (fabs(vlo(y0[NWAY-1])) > SHT_ACCURACY*SHT_SCALE_FACTOR + 1.0) {		// rescale when value is significant
+					++ny;
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] *= vall(1.0/SHT_SCALE_FACTOR);		y1[j] *= vall(1.0/SHT_SCALE_FACTOR);
+					}
+				}
+			}
+		  if (ny == 0) {
+			while (l<llim) {	// compute even and odd parts, for both m and -m
+Q				for (int j=0; j<NWAY; ++j) {	rer[j] += y0[j] * qr(l);		rei[j] += y0[j] * qi(l);	}
+Q				for (int j=0; j<NWAY; ++j) {	rern[j] += y0[j] * nr(l);		rein[j] += y0[j] * ni(l);	}
+V				for (int j=0; j<NWAY; ++j) {	ter[j] += y0[j] * vr(l);		tei[j] += y0[j] * vi(l);	}
+V				for (int j=0; j<NWAY; ++j) {	per[j] += y0[j] * wr(l);		pei[j] += y0[j] * wi(l);	}
+V				for (int j=0; j<NWAY; ++j) {	tern[j] += y0[j] * vnr(l);		tein[j] += y0[j] * vni(l);	}
+V				for (int j=0; j<NWAY; ++j) {	pern[j] += y0[j] * wnr(l);		pein[j] += y0[j] * wni(l);	}
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+Q				for (int j=0; j<NWAY; ++j) {	ror[j] += y1[j] * qr(l+1);		roi[j] += y1[j] * qi(l+1);	}
+Q				for (int j=0; j<NWAY; ++j) {	rorn[j] += y1[j] * nr(l+1);		roin[j] += y1[j] * ni(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	tor[j] += y1[j] * vr(l+1);		toi[j] += y1[j] * vi(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	por[j] += y1[j] * wr(l+1);		poi[j] += y1[j] * wi(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	torn[j] += y1[j] * vnr(l+1);	toin[j] += y1[j] * vni(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	porn[j] += y1[j] * wnr(l+1);	poin[j] += y1[j] * wni(l+1);	}
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+			}
+V				for (int j=0; j<NWAY; ++j) {	ter[j] += y0[j] * vr(l);		tei[j] += y0[j] * vi(l);	}
+V				for (int j=0; j<NWAY; ++j) {	per[j] += y0[j] * wr(l);		pei[j] += y0[j] * wi(l);	}
+V				for (int j=0; j<NWAY; ++j) {	tern[j] += y0[j] * vnr(l);		tein[j] += y0[j] * vni(l);	}
+V				for (int j=0; j<NWAY; ++j) {	pern[j] += y0[j] * wnr(l);		pein[j] += y0[j] * wni(l);	}
+			if (l==llim) {
+Q				for (int j=0; j<NWAY; ++j) {	rer[j] += y0[j] * qr(l);		rei[j] += y0[j] * qi(l);	}
+Q				for (int j=0; j<NWAY; ++j) {	rern[j] += y0[j] * nr(l);		rein[j] += y0[j] * ni(l);	}
+V				for (int j=0; j<NWAY; ++j) {	tor[j] += y1[j] * vr(l+1);		toi[j] += y1[j] * vi(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	por[j] += y1[j] * wr(l+1);		poi[j] += y1[j] * wi(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	torn[j] += y1[j] * vnr(l+1);	toin[j] += y1[j] * vni(l+1);	}
+V				for (int j=0; j<NWAY; ++j) {	porn[j] += y1[j] * wnr(l+1);	poin[j] += y1[j] * wni(l+1);	}
+			}
+V			if (xs) for (int j=0; j<NWAY; ++j) {
+V				const rnd x = vread(xs, k+j);
+V				ter[j] *= x;	tei[j] *= x;	tor[j] *= x;	toi[j] *= x;
+V				per[j] *= x;	pei[j] *= x;	por[j] *= x;	poi[j] *= x;
+V				tern[j] *= x;	tein[j] *= x;	torn[j] *= x;	toin[j] *= x;
+V				pern[j] *= x;	pein[j] *= x;	porn[j] *= x;	poin[j] *= x;
+V			}
+		  }
+			for (int j=0; j<NWAY; ++j) {
+				if ((k+j)>=nk) break;
+Q				S2D_CSTORE2(BrFp, k+j, rer[j], ror[j], rei[j], roi[j])
+Q				S2D_CSTORE2(BrFn, k+j, rern[j], rorn[j], rein[j], roin[j])
+V				S2D_CSTORE2(BtFp, k+j, ter[j], tor[j], tei[j], toi[j])
+V				S2D_CSTORE2(BpFp, k+j, per[j], por[j], pei[j], poi[j])
+V				S2D_CSTORE2(BtFn, k+j, tern[j], torn[j], tein[j], toin[j])
+V				S2D_CSTORE2(BpFn, k+j, pern[j], porn[j], pein[j], poin[j])
+			}
+			k+=NWAY;
+		}
+	  }
+	}
+
+	#pragma omp for schedule(static)
+	for (long int k = (imlim+1)*NLAT; k < (NPHI-imlim)*NLAT; ++k) {		// zero for the orders not computed
+Q		BrF[k] = 0.0;
+V		BtF[k] = 0.0;		BpF[k] = 0.0;
+	}
+  }
+
+	if (shtns->fftc_mode >= 0) {		// a single complex fft for all orders, -imlim <= m <= imlim
+Q		fftw_execute_dft(shtns->ifft_cplx, BrF, z);
+V		fftw_execute_dft(shtns->ifft_cplx, BtF, zt);
+V		fftw_execute_dft(shtns->ifft_cplx, BpF, zp);
+	}
+
+Q	#undef qr
+Q	#undef qi
+Q	#undef nr
+Q	#undef ni
+V	#undef vr
+V	#undef vi
+V	#undef wr
+V	#undef wi
+V	#undef vnr
+V	#undef vni
+V	#undef wnr
+V	#undef wni
+  }
@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+# This file is meta-code for SHT.c (spherical harmonic transform).
+# it is intended for "make" to generate C code for similar SHT functions,
+# from one generic function + tags.
+# > See Makefile and SHT.c
+# Basically, there are tags at the beginning of lines that are information
+# to keep or remove the line depending on the function to build.
+# tags :
+# Q : line for scalar transform
+# V : line for vector transform (both spheroidal and toroidal)
+# S : line for vector transfrom, spheroidal component
+# T : line for vector transform, toroidal component.
+#
+# Analysis of complex-valued fields (coefficients stored at LM_cplx(l,m), with -l <= m <= l).
+# A single complex fft of the whole field gives the Fourier coefficients of order m in column m and
+# those of order -m in column NPHI-m. The associated Legendre functions are computed once by recurrence
+# and used to project both orders (the result for -m is multiplied by (-1)^m afterwards).
+# If xs is not NULL, the field is multiplied by xs[theta] (which must be symmetric with respect to the equator).
+
+QX	static void GEN3(spat_cplx_to_SH,NWAY,SUFFIX)(shtns_cfg shtns, cplx *z, cplx *Zlm, const long int llim) {
+VX	static void GEN3(spat_cplx_to_SHsphtor,NWAY,SUFFIX)(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *Slm, cplx *Tlm, const double *xs, const long int llim) {
+
+Q	cplx *BrF;
+V	cplx *BtF, *BpF;
+	long int nk, imlim;
+
+Q	BrF = z;
+V	BtF = zt;	BpF = zp;
+	if (shtns->fftc_mode >= 0) {		// the fft is done in a scratch array, which leaves the spatial field unchanged.
+		const long int nspat = ((long int) NLAT) * NPHI;
+QX		BrF = (cplx*) shtns_scratch(SCRATCH_CPLX, nspat * sizeof(cplx));
+VX		BtF = (cplx*) shtns_scratch(SCRATCH_CPLX, 2*nspat * sizeof(cplx));
+VX		BpF = BtF + nspat;
+		if (shtns->layout & SHT_PHI_CONTIGUOUS) {		// out-of-place fft, with transposition.
+Q			fftw_execute_dft(shtns->fft_cplx, z, BrF);
+V			fftw_execute_dft(shtns->fft_cplx, zt, BtF);
+V			fftw_execute_dft(shtns->fft_cplx, zp, BpF);
+		} else {		// copy and in-place fft: much faster than the strided out-of-place fft.
+Q			memcpy(BrF, z, nspat * sizeof(cplx));
+V			memcpy(BtF, zt, nspat * sizeof(cplx));
+V			memcpy(BpF, zp, nspat * sizeof(cplx));
+Q			fftw_execute_dft(shtns->fft_cplx, BrF, BrF);
+V			fftw_execute_dft(shtns->fft_cplx, BtF, BtF);
+V			fftw_execute_dft(shtns->fft_cplx, BpF, BpF);
+		}
+	}
+
+	imlim = MTR;
+	#ifdef SHT_VAR_LTR
+		if (imlim*MRES > (unsigned) llim) imlim = ((unsigned) llim)/MRES;
+	#endif
+	nk = NLAT_2;	// copy NLAT_2 to a local variable for faster access (inner loop limit)
+	#if _GCC_VEC_
+	  nk = ((unsigned) nk+(VSIZE2-1))/VSIZE2;
+	#endif
+
+  #pragma omp parallel num_threads(shtns->nthreads)
+  {
+	double* const wg = shtns->wg;
+	double* const ct = shtns->ct;
+	double* const st = shtns->st;
+V	double* const l_2 = shtns->l_2;
+Q	rnd qq[4*llim+8];		// accumulators for order m and -m, interleaved.
+V	rnd vw[8*llim+16];
+
+Q	double rer[NLAT_2 + NWAY*VSIZE2] SSE;		// even and odd parts of order m...
+Q	double rei[NLAT_2 + NWAY*VSIZE2] SSE;
+Q	double ror[NLAT_2 + NWAY*VSIZE2] SSE;
+Q	double roi[NLAT_2 + NWAY*VSIZE2] SSE;
+Q	double rern[NLAT_2 + NWAY*VSIZE2] SSE;		// ...and of order -m
+Q	double rein[NLAT_2 + NWAY*VSIZE2] SSE;
+Q	double rorn[NLAT_2 + NWAY*VSIZE2] SSE;
+Q	double roin[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double ter[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double tei[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double tor[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double toi[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double per[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double pei[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double por[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double poi[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double tern[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double tein[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double torn[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double toin[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double pern[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double pein[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double porn[NLAT_2 + NWAY*VSIZE2] SSE;
+V	double poin[NLAT_2 + NWAY*VSIZE2] SSE;
+
+	for (long int k=nk*VSIZE2; k<(nk-1+NWAY)*VSIZE2; ++k) {		// the last group of blocks may extend beyond nk: read zeros there.
+Q		rer[k] = 0.0;		rei[k] = 0.0;		ror[k] = 0.0;		roi[k] = 0.0;
+Q		rern[k] = 0.0;		rein[k] = 0.0;		rorn[k] = 0.0;		roin[k] = 0.0;
+V		ter[k] = 0.0;		tei[k] = 0.0;		tor[k] = 0.0;		toi[k] = 0.0;
+V		per[k] = 0.0;		pei[k] = 0.0;		por[k] = 0.0;		poi[k] = 0.0;
+V		tern[k] = 0.0;		tein[k] = 0.0;		torn[k] = 0.0;		toin[k] = 0.0;
+V		pern[k] = 0.0;		pein[k] = 0.0;		porn[k] = 0.0;		poin[k] = 0.0;
+	}
+
+	#pragma omp for schedule(dynamic)
+	for (long int im=0; im<=MMAX; ++im) {
+		long int k, l;
+		const long int m = im*MRES;
+		double* const alm = shtns->blm + ALM_IDX(shtns, im);
+		double* al;
+		double alm0_rescale;
+Q		cplx* const BrFp = BrF + im*NLAT;		// order m
+V		cplx* const BtFp = BtF + im*NLAT;		cplx* const BpFp = BpF + im*NLAT;
+Q		cplx* const BrFn = BrF + (NPHI-im)*NLAT;		// order -m (not used for m=0)
+V		cplx* const BtFn = BtF + (NPHI-im)*NLAT;		cplx* const BpFn = BpF + (NPHI-im)*NLAT;
+
+	  if (im > imlim) {		// orders not computed.
+		for (l=m; l<=LMAX; l++) {
+			const long int lm = LM_cplx(shtns, l, 0);
+Q			Zlm[lm+m] = 0.0;		Zlm[lm-m] = 0.0;
+V			Slm[lm+m] = 0.0;		Slm[lm-m] = 0.0;
+V			Tlm[lm+m] = 0.0;		Tlm[lm-m] = 0.0;
+		}
+	  } else if (im == 0) {
+Q		cplx r0 = 0.0;
+		for (k=0; k<nk*VSIZE2; ++k) {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
+Q			cplx n = BrFp[k];		cplx s = BrFp[NLAT-1-k];
+Q			rer[k] = creal(n+s);	rei[k] = cimag(n+s);
+Q			ror[k] = creal(n-s);	roi[k] = cimag(n-s);
+Q			r0 += (n+s)*wg[k];
+V			const double x = (xs) ? xs[k] : 1.0;
+V			cplx n = BtFp[k]*x;		cplx s = BtFp[NLAT-1-k]*x;
+V			ter[k] = creal(n+s);	tei[k] = cimag(n+s);
+V			tor[k] = creal(n-s);	toi[k] = cimag(n-s);
+V			n = BpFp[k]*x;			s = BpFp[NLAT-1-k]*x;
+V			per[k] = creal(n+s);	pei[k] = cimag(n+s);
+V			por[k] = creal(n-s);	poi[k] = cimag(n-s);
+		}
+		alm0_rescale = alm[0];		// the weights wg include the normalization of the (unnormalized) complex fft.
+Q		Zlm[0] = r0 * alm0_rescale;			// l=0 is done.
+V		Slm[0] = 0.0;		Tlm[0] = 0.0;		// l=0 is zero for the vector transform.
+		for (l=0; l<2*llim; ++l) {
+Q			qq[l] = vall(0.0);
+V			vw[2*l] = vall(0.0);		vw[2*l+1] = vall(0.0);
+		}
+		k = 0;
+		while (k < nk) {
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(ct, k+j);
+				y0[j] = vall(alm0_rescale) * vread(wg, k+j);		// weight of Gauss quadrature appears here
+V				dy0[j] = vall(0.0);
+V				sint[j] = -vread(st, k+j);
+				y1[j] =  (vall(al[1])*y0[j]) * cost[j];
+V				dy1[j] = (vall(al[1])*y0[j]) * sint[j];
+			}
+			al+=2;	l=1;
+			while(l<llim) {
+				for (int j=0; j<NWAY; ++j) {
+V					dy0[j] = vall(al[1])*(cost[j]*dy1[j] + y1[j]*sint[j]) + vall(al[0])*dy0[j];
+					y0[j]  = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+Q					qq[2*l-2] += y1[j] * vread(ror, k+j);		qq[2*l-1] += y1[j] * vread(roi, k+j);
+V					vw[4*l-4] += dy1[j] * vread(ter, k+j);		vw[4*l-3] += dy1[j] * vread(tei, k+j);
+V					vw[4*l-2] -= dy1[j] * vread(per, k+j);		vw[4*l-1] -= dy1[j] * vread(pei, k+j);
+				}
+				for (int j=0; j<NWAY; ++j) {
+V					dy1[j] = vall(al[3])*(cost[j]*dy0[j] + y0[j]*sint[j]) + vall(al[2])*dy1[j];
+					y1[j]  = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+Q					qq[2*l] += y0[j] * vread(rer, k+j);		qq[2*l+1] += y0[j] * vread(rei, k+j);
+V					vw[4*l]   += dy0[j] * vread(tor, k+j);		vw[4*l+1] += dy0[j] * vread(toi, k+j);
+V					vw[4*l+2] -= dy0[j] * vread(por, k+j);		vw[4*l+3] -= dy0[j] * vread(poi, k+j);
+				}
+				al+=4;	l+=2;
+			}
+			if (l==llim) {
+				for (int j=0; j<NWAY; ++j) {
+Q					qq[2*l-2] += y1[j] * vread(ror, k+j);		qq[2*l-1] += y1[j] * vread(roi, k+j);
+V					vw[4*l-4] += dy1[j] * vread(ter, k+j);		vw[4*l-3] += dy1[j] * vread(tei, k+j);
+V					vw[4*l-2] -= dy1[j] * vread(per, k+j);		vw[4*l-1] -= dy1[j] * vread(pei, k+j);
+				}
+			}
+			k+=NWAY;
+		}
+		for (l=1; l<=llim; ++l) {
+			const long int lm = LM_cplx(shtns, l, 0);
+			#if _GCC_VEC_
+Q				((v2d*)Zlm)[lm] = v2d_reduce(qq[2*l-2], qq[2*l-1]);
+V				((v2d*)Slm)[lm] = v2d_reduce(vw[4*l-4], vw[4*l-3]) * vdup(l_2[l]);
+V				((v2d*)Tlm)[lm] = v2d_reduce(vw[4*l-2], vw[4*l-1]) * vdup(l_2[l]);
+			#else
+Q				Zlm[lm] = qq[2*l-2] + I*qq[2*l-1];
+V				Slm[lm] = (vw[4*l-4] + I*vw[4*l-3])*l_2[l];		Tlm[lm] = (vw[4*l-2] + I*vw[4*l-1])*l_2[l];
+			#endif
+		}
+		for (l=llim+1; l<=LMAX; ++l) {
+			const long int lm = LM_cplx(shtns, l, 0);
+Q			Zlm[lm] = 0.0;
+V			Slm[lm] = 0.0;		Tlm[lm] = 0.0;
+		}
+
+	  } else {		// im > 0
+		l = shtns->tm[im] / VSIZE2;
+		k = ((l*VSIZE2)>>1)*2;		// k must be even here.
+		while (k < nk*VSIZE2) {	// compute symmetric and antisymmetric parts, for m and -m.
+Q			cplx n = BrFp[k];		cplx s = BrFp[NLAT-1-k];
+Q			rer[k] = creal(n+s);	rei[k] = cimag(n+s);
+Q			ror[k] = creal(n-s);	roi[k] = cimag(n-s);
+Q			n = BrFn[k];			s = BrFn[NLAT-1-k];
+Q			rern[k] = creal(n+s);	rein[k] = cimag(n+s);
+Q			rorn[k] = creal(n-s);	roin[k] = cimag(n-s);
+V			const double x = (xs) ? xs[k] : 1.0;
+V			cplx n = BtFp[k]*x;		cplx s = BtFp[NLAT-1-k]*x;
+V			ter[k] = creal(n+s);	tei[k] = cimag(n+s);
+V			tor[k] = creal(n-s);	toi[k] = cimag(n-s);
+V			n = BpFp[k]*x;			s = BpFp[NLAT-1-k]*x;
+V			per[k] = creal(n+s);	pei[k] = cimag(n+s);
+V			por[k] = creal(n-s);	poi[k] = cimag(n-s);
+V			n = BtFn[k]*x;			s = BtFn[NLAT-1-k]*x;
+V			tern[k] = creal(n+s);	tein[k] = cimag(n+s);
+V			torn[k] = creal(n-s);	toin[k] = cimag(n-s);
+V			n = BpFn[k]*x;			s = BpFn[NLAT-1-k]*x;
+V			pern[k] = creal(n+s);	pein[k] = cimag(n+s);
+V			porn[k] = creal(n-s);	poin[k] = cimag(n-s);
+			++k;
+		}
+
+		k = l;
+		#if _GCC_VEC_
+Q			rnd* q = qq;
+V			rnd* v = vw;
+		#else
+Q			double* q = (double *) qq;
+V			double* v = (double *) vw;
+		#endif
+		for (l=llim+1-m; l>=0; l--) {		// one more for the vector conversion below (reads l=llim+1)
+Q			q[0] = vall(0.0);		q[1] = vall(0.0);		q[2] = vall(0.0);		q[3] = vall(0.0);		q+=4;
+V			v[0] = vall(0.0);		v[1] = vall(0.0);		v[2] = vall(0.0);		v[3] = vall(0.0);
+V			v[4] = vall(0.0);		v[5] = vall(0.0);		v[6] = vall(0.0);		v[7] = vall(0.0);		v+=8;
+		}
+		alm0_rescale = alm[0] * 2;
+		while (k < nk) {
+		#if _GCC_VEC_
+Q			rnd* q = qq;
+V			rnd* v = vw;
+		#else
+Q			double* q = (double *) qq;
+V			double* v = (double *) vw;
+		#endif
+			al = alm;
+			rnd cost[NWAY], y0[NWAY], y1[NWAY];
+			for (int j=0; j<NWAY; ++j) {
+				cost[j] = vread(st, k+j);
+				y0[j] = vall(0.5);
+			}
+Q			l=m;
+V			l=m-1;
+			long int ny = 0;	// exponent to extend double precision range.
+		if ((int)llim <= SHT_L_RESCALE_FLY) {
+			do {		// sin(theta)^m
+				if (l&1) for (int j=0; j<NWAY; ++j) y0[j] *= cost[j];
+				for (int j=0; j<NWAY; ++j) cost[j] *= cost[j];
+			} while(l >>= 1);
+		} else {
+			long int nsint = 0;
+			do {		// sin(theta)^m		(use rescaling to avoid underflow)
+				if (l&1) {
+					for (int j=NWAY-1; j>=0; --j) y0[j] *= cost[j];
+					ny += nsint;
+					if (vlo(y0[NWAY-1]) < (SHT_ACCURACY+1.0/SHT_SCALE_FACTOR)) {
+						ny--;
+						for (int j=NWAY-1; j>=0; --j) y0[j] *= vall(SHT_SCALE_FACTOR);
+					}
+				}
+				for (int j=NWAY-1; j>=0; --j) cost[j] *= cost[j];
+				nsint += nsint;
+				if (vlo(cost[NWAY-1]) < 1.0/SHT_SCALE_FACTOR) {
+					nsint--;
+					for (int j=NWAY-1; j>=0; --j) cost[j] *= vall(SHT_SCALE_FACTOR);
+				}
+			} while(l >>= 1);
+		}
+			for (int j=0; j<NWAY; ++j) {
+				y0[j] *= vall(alm0_rescale);
+				cost[j] = vread(ct, k+j);
+				y1[j]  = (vall(al[1])*y0[j]) *cost[j];
+			}
+			l=m;	al+=2;
+			while ((ny<0) && (l<llim)) {		// ylm treated as zero and ignored if ny < 0
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+				if (fabs(vlo(y0[NWAY-1])) > SHT_ACCURACY*SHT_SCALE_FACTOR + 1.0) {		// rescale when value is significant
+					++ny;
+					for (int j=0; j<NWAY; ++j) {
+						y0[j] *= vall(1.0/SHT_SCALE_FACTOR);		y1[j] *= vall(1.0/SHT_SCALE_FACTOR);
+					}
+				}
+			}
+		  if (ny == 0) {
+Q			rnd rerk[NWAY], reik[NWAY], rork[NWAY], roik[NWAY];		// help the compiler to cache into registers.
+Q			rnd rernk[NWAY], reink[NWAY], rornk[NWAY], roink[NWAY];
+V			rnd terk[NWAY], teik[NWAY], tork[NWAY], toik[NWAY];
+V			rnd perk[NWAY], peik[NWAY], pork[NWAY], poik[NWAY];
+V			rnd ternk[NWAY], teink[NWAY], tornk[NWAY], toink[NWAY];
+V			rnd pernk[NWAY], peink[NWAY], pornk[NWAY], poink[NWAY];
+Q			q+=4*(l-m);
+V			v+=8*(l-m);
+			for (int j=0; j<NWAY; ++j) {	// prefetch
+				y0[j] *= vread(wg, k+j);		y1[j] *= vread(wg, k+j);		// weight appears here (must be after the previous accuracy loop).
+Q				rerk[j] = vread( rer, k+j);		reik[j] = vread( rei, k+j);		rork[j] = vread( ror, k+j);		roik[j] = vread( roi, k+j);
+Q				rernk[j] = vread( rern, k+j);	reink[j] = vread( rein, k+j);	rornk[j] = vread( rorn, k+j);	roink[j] = vread( roin, k+j);
+V				terk[j] = vread( ter, k+j);		teik[j] = vread( tei, k+j);		tork[j] = vread( tor, k+j);		toik[j] = vread( toi, k+j);
+V				perk[j] = vread( per, k+j);		peik[j] = vread( pei, k+j);		pork[j] = vread( por, k+j);		poik[j] = vread( poi, k+j);
+V				ternk[j] = vread( tern, k+j);	teink[j] = vread( tein, k+j);	tornk[j] = vread( torn, k+j);	toink[j] = vread( toin, k+j);
+V				pernk[j] = vread( pern, k+j);	peink[j] = vread( pein, k+j);	pornk[j] = vread( porn, k+j);	poink[j] = vread( poin, k+j);
+			}
+			while (l<llim) {	// compute even and odd parts
+Q				for (int j=0; j<NWAY; ++j)	{	q[0] += y0[j] * rerk[j];	q[1] += y0[j] * reik[j];	}
+Q				for (int j=0; j<NWAY; ++j)	{	q[2] += y0[j] * rernk[j];	q[3] += y0[j] * reink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[0] += y0[j] * terk[j];	v[1] += y0[j] * teik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[2] += y0[j] * perk[j];	v[3] += y0[j] * peik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[4] += y0[j] * ternk[j];	v[5] += y0[j] * teink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[6] += y0[j] * pernk[j];	v[7] += y0[j] * peink[j];	}
+				for (int j=0; j<NWAY; ++j) {
+					y0[j] = vall(al[1])*(cost[j]*y1[j]) + vall(al[0])*y0[j];
+				}
+Q				for (int j=0; j<NWAY; ++j)	{	q[4] += y1[j] * rork[j];	q[5] += y1[j] * roik[j];	}
+Q				for (int j=0; j<NWAY; ++j)	{	q[6] += y1[j] * rornk[j];	q[7] += y1[j] * roink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[8]  += y1[j] * tork[j];	v[9]  += y1[j] * toik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[10] += y1[j] * pork[j];	v[11] += y1[j] * poik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[12] += y1[j] * tornk[j];	v[13] += y1[j] * toink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[14] += y1[j] * pornk[j];	v[15] += y1[j] * poink[j];	}
+Q				q+=8;
+V				v+=16;
+				for (int j=0; j<NWAY; ++j) {
+					y1[j] = vall(al[3])*(cost[j]*y0[j]) + vall(al[2])*y1[j];
+				}
+				l+=2;	al+=4;
+			}
+V				for (int j=0; j<NWAY; ++j)	{	v[0] += y0[j] * terk[j];	v[1] += y0[j] * teik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[2] += y0[j] * perk[j];	v[3] += y0[j] * peik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[4] += y0[j] * ternk[j];	v[5] += y0[j] * teink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[6] += y0[j] * pernk[j];	v[7] += y0[j] * peink[j];	}
+			if (l==llim) {
+Q				for (int j=0; j<NWAY; ++j)	{	q[0] += y0[j] * rerk[j];	q[1] += y0[j] * reik[j];	}
+Q				for (int j=0; j<NWAY; ++j)	{	q[2] += y0[j] * rernk[j];	q[3] += y0[j] * reink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[8]  += y1[j] * tork[j];	v[9]  += y1[j] * toik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[10] += y1[j] * pork[j];	v[11] += y1[j] * poik[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[12] += y1[j] * tornk[j];	v[13] += y1[j] * toink[j];	}
+V				for (int j=0; j<NWAY; ++j)	{	v[14] += y1[j] * pornk[j];	v[15] += y1[j] * poink[j];	}
+			}
+		  }
+			k+=NWAY;
+		}
+
+		const double parity = (m&1) ? -1.0 : 1.0;		// (-1)^m
+Q		for (l=m; l<=llim; ++l) {		// scatter the coefficients of orders m and -m
+Q			const long int lm = LM_cplx(shtns, l, 0);
+Q		#if _GCC_VEC_
+Q			((v2d*)Zlm)[lm+m] = v2d_reduce(qq[4*(l-m)], qq[4*(l-m)+1]);
+Q			((v2d*)Zlm)[lm-m] = v2d_reduce(qq[4*(l-m)+2], qq[4*(l-m)+3]) * vdup(parity);
+Q		#else
+Q			Zlm[lm+m] = qq[4*(l-m)] + I*qq[4*(l-m)+1];
+Q			Zlm[lm-m] = (qq[4*(l-m)+2] + I*qq[4*(l-m)+3]) * parity;
+Q		#endif
+Q		}
+
+V		for (int s=0; s<2; s++) {	// convert from the two scalar SH to vector SH, for order m (s=0) and -m (s=1)
+V			// Slm = - (I*m*Wlm + MX*Vlm) / (l*(l+1))
+V			// Tlm = - (I*m*Vlm - MX*Wlm) / (l*(l+1))
+V			double* mx = shtns->mx_van + 2*LM(shtns,m,m);
+V			const long int sm = (s==0) ? m : -m;
+V			s2d em = vdup( sm );
+V			s2d sgn = vdup( (s==0) ? 1.0 : parity );
+V			rnd* const vws = vw + 4*s;
+V			v2d vl = v2d_reduce(vws[0], vws[1]);
+V			v2d wl = v2d_reduce(vws[2], vws[3]);
+V			v2d sl = vdup( 0.0 );
+V			v2d tl = vdup( 0.0 );
+V			for (long int l=0; l<=llim-m; l++) {
+V				s2d mxu = vdup( mx[2*l] );
+V				s2d mxl = vdup( mx[2*l+1] );		// mxl for next iteration
+V				sl = addi( sl ,  em*wl );
+V				tl = addi( tl ,  em*vl );
+V				v2d sl1 =  mxl*vl;			// vs for next iter
+V				v2d tl1 = -mxl*wl;			// wt for next iter
+V				vl = v2d_reduce(vws[8*l+8], vws[8*l+9]);		// kept for next iteration
+V				wl = v2d_reduce(vws[8*l+10], vws[8*l+11]);
+V				sl += mxu*vl;
+V				tl -= mxu*wl;
+V				const long int lm = LM_cplx(shtns, l+m, sm);
+V				((v2d*)Slm)[lm] = -sl * vdup(l_2[l+m]) * sgn;
+V				((v2d*)Tlm)[lm] = -tl * vdup(l_2[l+m]) * sgn;
+V				sl = sl1;
+V				tl = tl1;
+V			}
+V		}
+
+		for (l=llim+1; l<=LMAX; ++l) {
+			const long int lm = LM_cplx(shtns, l, 0);
+Q			Zlm[lm+m] = 0.0;		Zlm[lm-m] = 0.0;
+V			Slm[lm+m] = 0.0;		Slm[lm-m] = 0.0;
+V			Tlm[lm+m] = 0.0;		Tlm[lm-m] = 0.0;
+		}
+	  }
+	}
+  }
+  }
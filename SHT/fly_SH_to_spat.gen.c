@@ -35,6 +35,7 @@ VX	static void GEN3(SHsphtor_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm
 S	static void GEN3(SHsph_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, double *Vt, double *Vp, const long int llim) {
 T	static void GEN3(SHtor_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Tlm, double *Vt, double *Vp, const long int llim) {
   #endif
+	STATS_BEGIN
 
   #ifndef SHT_AXISYM
 Q	v2d *BrF;
@@ -63,10 +64,10 @@ V	BtF = (v2d*) Vt;	BpF = (v2d*) Vp;
 	#ifdef _GCC_VEC_
 	if (shtns->fftc_mode > 0) {		// alloc memory for the FFT
 		unsigned long nv = shtns->nspat;
-QX		BrF = (v2d*) VMALLOC( nv * sizeof(double) );
-VX		BtF = (v2d*) VMALLOC( 2*nv * sizeof(double) );
+QX		BrF = (v2d*) shtns_scratch(SCRATCH_FFT, nv * sizeof(double) );
+VX		BtF = (v2d*) shtns_scratch(SCRATCH_FFT, 2*nv * sizeof(double) );
 VX		BpF = BtF + nv/2;
-3		BrF = (v2d*) VMALLOC( 3*nv * sizeof(double) );
+3		BrF = (v2d*) shtns_scratch(SCRATCH_FFT, 3*nv * sizeof(double) );
 3		BtF = BrF + nv/2;		BpF = BrF + nv;
 	}
 	  #ifdef SHT_GRAD
@@ -75,10 +76,10 @@ T		k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT_2);
 	  #endif
 	#else
 	if (shtns->ncplx_fft > 0) {		// alloc memory for the FFT
-QX		BrF = VMALLOC( shtns->ncplx_fft * sizeof(cplx) );
-VX		BtF = VMALLOC( 2* shtns->ncplx_fft * sizeof(cplx) );
+QX		BrF = shtns_scratch(SCRATCH_FFT, shtns->ncplx_fft * sizeof(cplx) );
+VX		BtF = shtns_scratch(SCRATCH_FFT, 2* shtns->ncplx_fft * sizeof(cplx) );
 VX		BpF = BtF + shtns->ncplx_fft;
-3		BrF = VMALLOC( 3* shtns->ncplx_fft * sizeof(cplx) );
+3		BrF = shtns_scratch(SCRATCH_FFT, 3* shtns->ncplx_fft * sizeof(cplx) );
 3		BtF = BrF + shtns->ncplx_fft;		BpF = BtF + shtns->ncplx_fft;
 	}
 	  #ifdef SHT_GRAD
@@ -431,8 +432,6 @@ V			fftw_execute_dft(shtns->ifftc, (cplx *) BpF, (cplx *) Vp);
 Q			fftw_execute_split_dft(shtns->ifftc,((double*)BrF)+1, ((double*)BrF), Vr+NPHI, Vr);
 V			fftw_execute_split_dft(shtns->ifftc,((double*)BtF)+1, ((double*)BtF), Vt+NPHI, Vt);
 V			fftw_execute_split_dft(shtns->ifftc,((double*)BpF)+1, ((double*)BpF), Vp+NPHI, Vp);
-Q			VFREE(BrF);
-VX			VFREE(BtF);		// this frees also BpF.
 		}
 	}
 	#else
@@ -440,10 +439,6 @@ VX			VFREE(BtF);		// this frees also BpF.
 Q		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BrF, Vr);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BtF, Vt);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BpF, Vp);
-		if (shtns->ncplx_fft > 0) {		// free memory
-Q			VFREE(BrF);
-VX			VFREE(BtF);		// this frees also BpF.
-		}
 	}
 	#endif
   #endif
@@ -454,17 +449,27 @@ S	#undef sr
 S	#undef si
 T	#undef tr
 T	#undef ti
+3	STATS_END(SHT_TYP_3SY)
+QX	STATS_END(SHT_TYP_SSY)
+  #ifndef SHT_GRAD
+VX	STATS_END(SHT_TYP_VSY)
+  #else
+S	STATS_END(SHT_TYP_GSP)
+T	STATS_END(SHT_TYP_GTO)
+  #endif
   }
 
   #ifndef SHT_AXISYM
 
-3	static void GEN3(SHqst_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, const long int llim) {
-QX	static void GEN3(SH_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Vr, const long int llim) {
+	/// \internal synthesis for a single m, restricted to the latitude blocks k0 <= k < k1 (and their mirror in the southern hemisphere).
+	static
+3	void GEN3(_sy3_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, const long int llim, long int k0, long int k1) {
+QX	void GEN3(_sy1_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Vr, const long int llim, long int k0, long int k1) {
   #ifndef SHT_GRAD
-VX	static void GEN3(SHsphtor_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+VX	void GEN3(_sy2_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim, long int k0, long int k1) {
   #else
-S	static void GEN3(SHsph_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Vt, cplx *Vp, const long int llim) {
-T	static void GEN3(SHtor_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+S	void GEN3(_sy1s_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Vt, cplx *Vp, const long int llim, long int k0, long int k1) {
+T	void GEN3(_sy1t_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim, long int k0, long int k1) {
   #endif
 
 Q	v2d *BrF;
@@ -494,8 +499,8 @@ S		double Sl0[llim];
 T		double Tl0[llim];
 
 		#ifdef SHT_GRAD
-S			k=0; do { BpF[k]=vdup(0.0); } while(++k<NLAT);
-T			k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT);
+S			if (k0 == 0) { k=0; do { BpF[k]=vdup(0.0); } while(++k<NLAT); }
+T			if (k0 == 0) { k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT); }
 		#endif
 
  		l=1;
@@ -507,8 +512,8 @@ S			Sl0[l-1] = (double) Slm[l];	//	Sl[l] = (double) Slm[l+1];
 T			Tl0[l-1] = (double) Tlm[l];	//	Tl[l] = (double) Tlm[l+1];
 			++l;
 		} while(l<=llim);
-		k=0;
-		do {
+		k=k0;
+		while (k < k1) {
 			l=0;	al = alm;
 			rnd cost[NWAY], y0[NWAY], y1[NWAY];
 V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
@@ -571,20 +576,21 @@ T					po[j] -= dy0[j] * vall(Tl0[l-1]);
 			}
 		#ifndef SHTNS4MAGIC
 			for (int j=0; j<NWAY; ++j) {
+				if ((k+j)>=k1) break;		// do not write past the last block (Vr is not padded).
 Q				S2D_CSTORE2(BrF, k+j, re[j], ro[j], vall(0), vall(0))
 S				S2D_CSTORE2(BtF, k+j, te[j], to[j], vall(0), vall(0))
 T				S2D_CSTORE2(BpF, k+j, pe[j], po[j], vall(0), vall(0))
 			}
 		#else
 			for (int j=0; j<NWAY; ++j) {
-				if ((k+j)>=nk) break;
+				if ((k+j)>=k1) break;
 Q				S2D_CSTORE2_4MAGIC(BrF, k+j, re[j], ro[j], vall(0), vall(0))
 S				S2D_CSTORE2_4MAGIC(BtF, k+j, te[j], to[j], vall(0), vall(0))
 T				S2D_CSTORE2_4MAGIC(BpF, k+j, pe[j], po[j], vall(0), vall(0))
 			}
 		#endif
 			k+=NWAY;
-		} while (k < nk);
+		}
 
 	} else {	// im > 0
 V		v2d VWl[llim*2+4];
@@ -625,12 +631,13 @@ V			VWl[2*llim+2] = vs;
 V			VWl[2*llim+3] = wt;
 V		}
 
-		k=0;	l=shtns->tm[im];
-		while (k<l) {	// polar optimization
+		l=shtns->tm[im];
+		k = k0*VSIZE2;
+		while ((k<l) && (k<k1*VSIZE2)) {	// polar optimization
 		  #ifndef SHTNS4MAGIC
-Q			BrF[k] = vdup(0.0);		BrF[NLAT-l+k] = vdup(0.0);
-V			BtF[k] = vdup(0.0);		BtF[NLAT-l+k] = vdup(0.0);
-V			BpF[k] = vdup(0.0);		BpF[NLAT-l+k] = vdup(0.0);
+Q			BrF[k] = vdup(0.0);		BrF[NLAT-1-k] = vdup(0.0);
+V			BtF[k] = vdup(0.0);		BtF[NLAT-1-k] = vdup(0.0);
+V			BpF[k] = vdup(0.0);		BpF[NLAT-1-k] = vdup(0.0);
 		  #else
 Q			BrF[2*k] = vdup(0.0);		BrF[2*k+1] = vdup(0.0);
 V			BtF[2*k] = vdup(0.0);		BtF[2*k+1] = vdup(0.0);
@@ -640,7 +647,8 @@ V			BpF[2*k] = vdup(0.0);		BpF[2*k+1] = vdup(0.0);
 		}
 
 		k = ((unsigned) l) / VSIZE2;
-		do {
+		if (k < k0) k = k0;
+		while (k < k1) {
 			al = alm;
 			rnd cost[NWAY], y0[NWAY], y1[NWAY];
 Q			rnd rer[NWAY], rei[NWAY], ror[NWAY], roi[NWAY];
@@ -740,20 +748,21 @@ V				for (int j=0; j<NWAY; ++j) {	por[j] += y1[j]  * wr(l+1);		poi[j] += y1[j] *
 		  }
 		#ifndef SHTNS4MAGIC
 			for (int j=0; j<NWAY; ++j) {
+				if ((k+j)>=k1) break;
 Q				S2D_CSTORE2(BrF, k+j, rer[j], ror[j], rei[j], roi[j])
 V				S2D_CSTORE2(BtF, k+j, ter[j], tor[j], tei[j], toi[j])
 V				S2D_CSTORE2(BpF, k+j, per[j], por[j], pei[j], poi[j])
 			}
 		#else
 			for (int j=0; j<NWAY; ++j) {
-				if ((k+j)>=nk) break;
+				if ((k+j)>=k1) break;
 Q				S2D_CSTORE2_4MAGIC(BrF, k+j, rer[j], ror[j], rei[j], roi[j])
 V				S2D_CSTORE2_4MAGIC(BtF, k+j, ter[j], tor[j], tei[j], toi[j])
 V				S2D_CSTORE2_4MAGIC(BpF, k+j, per[j], por[j], pei[j], poi[j])
 			}
 		#endif
 			k+=NWAY;
-		} while (k < nk);
+		}
 	}
 
 Q	#undef qr
@@ -764,4 +773,55 @@ T	#undef tr
 T	#undef ti
   }
 
+
+3	static void GEN3(SHqst_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, const long int llim) {
+QX	static void GEN3(SH_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Vr, const long int llim) {
+  #ifndef SHT_GRAD
+VX	static void GEN3(SHsphtor_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+  #else
+S	static void GEN3(SHsph_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Vt, cplx *Vp, const long int llim) {
+T	static void GEN3(SHtor_m_to_spat_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+  #endif
+	const long int nk = ((unsigned)(NLAT_2+VSIZE2-1)) / VSIZE2;
+3	GEN3(_sy3_m,NWAY,SUFFIX)(shtns, im, Qlm, Slm, Tlm, Vr, Vt, Vp, llim, 0, nk);
+QX	GEN3(_sy1_m,NWAY,SUFFIX)(shtns, im, Qlm, Vr, llim, 0, nk);
+  #ifndef SHT_GRAD
+VX	GEN3(_sy2_m,NWAY,SUFFIX)(shtns, im, Slm, Tlm, Vt, Vp, llim, 0, nk);
+  #else
+S	GEN3(_sy1s_m,NWAY,SUFFIX)(shtns, im, Slm, Vt, Vp, llim, 0, nk);
+T	GEN3(_sy1t_m,NWAY,SUFFIX)(shtns, im, Tlm, Vt, Vp, llim, 0, nk);
+  #endif
+  }
+
+  #ifdef _OPENMP
+	/// \internal synthesis for a single m, with the latitudes split among threads.
+	/// Falls back to the sequential kernel when called from a parallel region (e.g. by SH_to_fourier).
+3	static void GEN3(SHqst_m_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, const long int llim) {
+QX	static void GEN3(SH_m_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Qlm, cplx *Vr, const long int llim) {
+  #ifndef SHT_GRAD
+VX	static void GEN3(SHsphtor_m_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+  #else
+S	static void GEN3(SHsph_m_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Slm, cplx *Vt, cplx *Vp, const long int llim) {
+T	static void GEN3(SHtor_m_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Tlm, cplx *Vt, cplx *Vp, const long int llim) {
+  #endif
+	const long int nk = ((unsigned)(NLAT_2+VSIZE2-1)) / VSIZE2;
+	const long int kt = shtns->tm[im] / VSIZE2;		// first block outside the polar region.
+	int nth = omp_m_threads(shtns, nk, kt, NWAY);
+
+	#pragma omp parallel num_threads(nth) if(nth > 1)
+	{
+		long int k0, k1;
+		omp_krange(nk, kt, NWAY, omp_get_thread_num(), omp_get_num_threads(), &k0, &k1);
+3		GEN3(_sy3_m,NWAY,SUFFIX)(shtns, im, Qlm, Slm, Tlm, Vr, Vt, Vp, llim, k0, k1);
+QX		GEN3(_sy1_m,NWAY,SUFFIX)(shtns, im, Qlm, Vr, llim, k0, k1);
+	  #ifndef SHT_GRAD
+VX		GEN3(_sy2_m,NWAY,SUFFIX)(shtns, im, Slm, Tlm, Vt, Vp, llim, k0, k1);
+	  #else
+S		GEN3(_sy1s_m,NWAY,SUFFIX)(shtns, im, Slm, Vt, Vp, llim, k0, k1);
+T		GEN3(_sy1t_m,NWAY,SUFFIX)(shtns, im, Tlm, Vt, Vp, llim, k0, k1);
+	  #endif
+	}
+  }
+  #endif
+
   #endif
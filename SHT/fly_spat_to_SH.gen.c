@@ -27,6 +27,7 @@
 QX	static void GEN3(spat_to_SH_fly,NWAY,SUFFIX)(shtns_cfg shtns, double *Vr, cplx *Qlm, const long int llim) {
 VX	static void GEN3(spat_to_SHsphtor_fly,NWAY,SUFFIX)(shtns_cfg shtns, double *Vt, double *Vp, cplx *Slm, cplx *Tlm, const long int llim) {
 3	static void GEN3(spat_to_SHqst_fly,NWAY,SUFFIX)(shtns_cfg shtns, double *Vr, double *Vt, double *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, const long int llim) {
+	STATS_BEGIN
 
 Q	double *BrF;		// contains the Fourier transformed data
 V	double *BtF, *BpF;	// contains the Fourier transformed data
@@ -64,10 +65,10 @@ V	BtF = Vt;	BpF = Vp;
 	if (shtns->fftc_mode >= 0) {
 		if (shtns->fftc_mode > 0) {		// alloc memory for out-of-place transforms
 			unsigned long nv = shtns->nspat;
-QX			BrF = (double*) VMALLOC( nv * sizeof(double) );
-VX			BtF = (double*) VMALLOC( 2*nv * sizeof(double) );
+QX			BrF = (double*) shtns_scratch(SCRATCH_FFT, nv * sizeof(double) );
+VX			BtF = (double*) shtns_scratch(SCRATCH_FFT, 2*nv * sizeof(double) );
 VX			BpF = BtF + nv;
-3			BrF = (double*) VMALLOC( 3*nv * sizeof(double) );
+3			BrF = (double*) shtns_scratch(SCRATCH_FFT, 3*nv * sizeof(double) );
 3			BtF = BrF + nv;		BpF = BtF + nv;			
 		}
 	    if (shtns->fftc_mode != 1) {	// regular FFT
@@ -369,21 +370,22 @@ V			((v2d*)Slm)[l] = vdup(0.0);		((v2d*)Tlm)[l] = vdup(0.0);
 		} while(++l < shtns->nlm);
 	}
 	#endif
-
-  	if (shtns->fftc_mode > 0) {		// free memory
-Q	    VFREE(BrF);
-VX	    VFREE(BtF);	// this frees also BpF.
-	}
   #endif
 
+QX	STATS_END(SHT_TYP_SAN)
+VX	STATS_END(SHT_TYP_VAN)
+3	STATS_END(SHT_TYP_3AN)
   }
 
 
   #ifndef SHT_AXISYM
 
-QX	static void GEN3(spat_to_SH_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Qlm, long int llim) {
-VX	static void GEN3(spat_to_SHsphtor_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, long int llim) {
-3	static void GEN3(spat_to_SHqst_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, long int llim) {
+	/// \internal analysis for a single m, restricted to the latitude blocks k0 <= k < k1 (and their mirror in the southern hemisphere).
+	/// The result is the contribution of these latitudes only.
+	static
+QX	void GEN3(_an1_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Qlm, long int llim, long int k0, long int k1) {
+VX	void GEN3(_an2_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, long int llim, long int k0, long int k1) {
+3	void GEN3(_an3_m,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, long int llim, long int k0, long int k1) {
 
 	double *alm, *al;
 	double *wg, *ct, *st;
@@ -413,7 +415,7 @@ V	double poi[NLAT_2 + NWAY*VSIZE2] SSE;
 	wg = shtns->wg;		ct = shtns->ct;		st = shtns->st;
 V	l_2 = shtns->l_2;
 
-	for (k=nk*VSIZE2; k<(nk-1+NWAY)*VSIZE2; ++k) {
+	for (k=k1*VSIZE2; k<(k1-1+NWAY)*VSIZE2; ++k) {		// the last group of blocks may extend beyond k1: read zeros there.
 Q		rer[k] = 0.0;		ror[k] = 0.0;
 V		ter[k] = 0.0;		tor[k] = 0.0;
 V		per[k] = 0.0;		por[k] = 0.0;
@@ -421,7 +423,7 @@ V		per[k] = 0.0;		por[k] = 0.0;
 
 	if (im == 0) {		// im=0
 		alm = shtns->blm;
-V		k=0;	do {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
+V		for (k=k0*VSIZE2; k<k1*VSIZE2; ++k) {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
 V			#ifndef SHTNS4MAGIC
 V			double n = creal(Vt[k]);		double s = creal(Vt[NLAT-1-k]);
 V			#else
@@ -429,8 +431,8 @@ V			double st_1 = shtns->st_1[k];
 V			double n = creal(Vt[2*k])*st_1;		double s = creal(Vt[2*k+1])*st_1;
 V			#endif
 V			ter[k] = n+s;			tor[k] = n-s;
-V		} while(++k < nk*VSIZE2);
-V		k=0;	do {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
+V		}
+V		for (k=k0*VSIZE2; k<k1*VSIZE2; ++k) {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
 V			#ifndef SHTNS4MAGIC
 V			double n = creal(Vp[k]);		double s = creal(Vp[NLAT-1-k]);
 V			#else
@@ -438,9 +440,9 @@ V			double st_1 = shtns->st_1[k];
 V			double n = creal(Vp[2*k])*st_1;		double s = creal(Vp[2*k+1])*st_1;
 V			#endif
 V			per[k] = n+s;			por[k] = n-s;
-V		} while(++k < nk*VSIZE2);
+V		}
 Q		double r0 = 0.0;
-Q		k=0;	do {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
+Q		for (k=k0*VSIZE2; k<k1*VSIZE2; ++k) {	// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
 Q			#ifndef SHTNS4MAGIC
 Q			double n = creal(Vr[k]);		double s = creal(Vr[NLAT-1-k]);
 Q			#else
@@ -448,16 +450,16 @@ Q			double n = creal(Vr[2*k]);		double s = creal(Vr[2*k+1]);
 Q			#endif
 Q			rer[k] = n+s;			ror[k] = n-s;
 Q			r0 += (n+s)*wg[k];
-Q		} while(++k < nk*VSIZE2);
+Q		}
 		alm0_rescale = alm[0] * shtns->nphi;	// alm[0] takes into account the fftw normalization, *nphi cancels it
 V		Slm[0] = 0.0;		Tlm[0] = 0.0;		// l=0 is zero for the vector transform.
 Q		Qlm[0] = r0 * alm0_rescale;			// l=0 is done.
-		k = 0;
+		k = k0;
 		for (l=0;l<llim;++l) {
 Q			qq[l] = vall(0.0);
 V			vw[2*l] = vall(0.0);		vw[2*l+1] = vall(0.0);
 		}
-		do {
+		while (k < k1) {
 			al = alm;
 			rnd cost[NWAY], y0[NWAY], y1[NWAY];
 V			rnd sint[NWAY], dy0[NWAY], dy1[NWAY];
@@ -504,7 +506,7 @@ V					vw[2*l-1] -= dy1[j] * perk[j];
 				}
 			}
 			k+=NWAY;
-		} while (k < nk);
+		}
 		for (l=1; l<=llim; ++l) {
 			#if _GCC_VEC_
 Q				((v2d*)Qlm)[l] = v2d_reduce(qq[l-1], vall(0));
@@ -524,7 +526,7 @@ V				((v2d*)Slm)[l] = vdup(0.0);		((v2d*)Tlm)[l] = vdup(0.0);
 		
 	} else {		// im > 0
 
-		for (k=nk*VSIZE2; k<(nk-1+NWAY)*VSIZE2; ++k) {
+		for (k=k1*VSIZE2; k<(k1-1+NWAY)*VSIZE2; ++k) {
 Q			rei[k] = 0.0;		roi[k] = 0.0;
 V			tei[k] = 0.0;		toi[k] = 0.0;
 V			pei[k] = 0.0;		poi[k] = 0.0;
@@ -534,7 +536,8 @@ V			pei[k] = 0.0;		poi[k] = 0.0;
 		l = shtns->tm[im] / VSIZE2;
 		alm = shtns->blm + im*(2*(LMAX+1) -m+MRES);
 Q		k = ((l*VSIZE2)>>1)*2;		// k must be even here.
-Q		do {	// compute symmetric and antisymmetric parts.
+Q		if (k < k0*VSIZE2) k = k0*VSIZE2;
+Q		while (k < k1*VSIZE2) {	// compute symmetric and antisymmetric parts.
 3			double sink = st[k];
 Q			#ifndef SHTNS4MAGIC
 Q			cplx n = Vr[k];			cplx s = Vr[NLAT-1-k];
@@ -544,9 +547,11 @@ Q			#endif
 3			n *= sink;				s *= sink;
 Q			rer[k] = creal(n+s);	rei[k] = cimag(n+s);
 Q			ror[k] = creal(n-s);	roi[k] = cimag(n-s);
-Q		} while (++k<nk*VSIZE2);
+Q			++k;
+Q		}
 V		k = ((l*VSIZE2)>>1)*2;		// k must be even here.
-V		do {	// compute symmetric and antisymmetric parts.
+V		if (k < k0*VSIZE2) k = k0*VSIZE2;
+V		while (k < k1*VSIZE2) {	// compute symmetric and antisymmetric parts.
 V			#ifndef SHTNS4MAGIC
 V			cplx n = Vt[k];			cplx s = Vt[NLAT-1-k];
 V			#else
@@ -555,9 +560,11 @@ V			cplx n = Vt[2*k]*st_1;	cplx s = Vt[2*k+1]*st_1;
 V			#endif
 V			ter[k] = creal(n+s);	tei[k] = cimag(n+s);
 V			tor[k] = creal(n-s);	toi[k] = cimag(n-s);
-V		} while (++k<nk*VSIZE2);
+V			++k;
+V		}
 V		k = ((l*VSIZE2)>>1)*2;		// k must be even here.
-V		do {	// compute symmetric and antisymmetric parts.
+V		if (k < k0*VSIZE2) k = k0*VSIZE2;
+V		while (k < k1*VSIZE2) {	// compute symmetric and antisymmetric parts.
 V			#ifndef SHTNS4MAGIC
 V			cplx n = Vp[k];			cplx s = Vp[NLAT-1-k];
 V			#else
@@ -566,9 +573,10 @@ V			cplx n = Vp[2*k]*st_1;	cplx s = Vp[2*k+1]*st_1;
 V			#endif
 V			per[k] = creal(n+s);	pei[k] = cimag(n+s);
 V			por[k] = creal(n-s);	poi[k] = cimag(n-s);
-V		} while (++k<nk*VSIZE2);
+V			++k;
+V		}
 
-		k=l;
+		k = (l < k0) ? k0 : l;
 		#if _GCC_VEC_
 Q			rnd* q = qq;
 V			rnd* v = vw;
@@ -577,13 +585,13 @@ Q			double* q = (double *) qq;	//Qlm;
 V			double* v = (double *) vw;
 V			double* t = (double *) vw;
 		#endif
-		for (l=llim-m; l>=0; l--) {
+		for (l=llim+1-m; l>=0; l--) {		// one more for the vector conversion below (reads l=llim+1)
 Q			q[0] = vall(0.0);		q[1] = vall(0.0);		q+=2;
 V			v[0] = vall(0.0);		v[1] = vall(0.0);
 V			v[2] = vall(0.0);		v[3] = vall(0.0);		v+=4;
 		}
 		alm0_rescale = alm[0] * (shtns->nphi*2);
-		do {
+		while (k < k1) {
 		#if _GCC_VEC_
 Q			rnd* q = qq;
 V			rnd* v = vw;
@@ -684,7 +692,7 @@ V				for (int j=0; j<NWAY; ++j)	{	v[6] += y1[j] * pork[j];	v[7] += y1[j] * poik[
 			}
 		  }
 			k+=NWAY;
-		} while (k < nk);
+		}
 
 Q		#if _GCC_VEC_
 Q			for (l=0; l<=llim-m; ++l) {
@@ -733,4 +741,64 @@ V				((v2d*)Slm)[l] = vdup(0.0);		((v2d*)Tlm)[l] = vdup(0.0);
 
   }
 
+
+QX	static void GEN3(spat_to_SH_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Qlm, long int llim) {
+VX	static void GEN3(spat_to_SHsphtor_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, long int llim) {
+3	static void GEN3(spat_to_SHqst_m_fly,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, long int llim) {
+	const long int nk = ((unsigned)(NLAT_2+VSIZE2-1)) / VSIZE2;
+QX	GEN3(_an1_m,NWAY,SUFFIX)(shtns, im, Vr, Qlm, llim, 0, nk);
+VX	GEN3(_an2_m,NWAY,SUFFIX)(shtns, im, Vt, Vp, Slm, Tlm, llim, 0, nk);
+3	GEN3(_an3_m,NWAY,SUFFIX)(shtns, im, Vr, Vt, Vp, Qlm, Slm, Tlm, llim, 0, nk);
+  }
+
+  #ifdef _OPENMP
+	/// \internal analysis for a single m, with the latitudes split among threads.
+	/// Each thread computes the contribution of its latitudes, which are then summed (in a fixed order, for reproducible results).
+	/// Falls back to the sequential kernel when called from a parallel region (e.g. by fourier_to_SH).
+QX	static void GEN3(spat_to_SH_m_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Qlm, long int llim) {
+VX	static void GEN3(spat_to_SHsphtor_m_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, long int llim) {
+3	static void GEN3(spat_to_SHqst_m_omp,NWAY,SUFFIX)(shtns_cfg shtns, int im, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, long int llim) {
+	const long int nk = ((unsigned)(NLAT_2+VSIZE2-1)) / VSIZE2;
+	const long int kt = shtns->tm[im] / VSIZE2;		// first block outside the polar region.
+	const int nth = omp_m_threads(shtns, nk, kt, NWAY);
+	if (nth <= 1) {
+QX		GEN3(_an1_m,NWAY,SUFFIX)(shtns, im, Vr, Qlm, llim, 0, nk);
+VX		GEN3(_an2_m,NWAY,SUFFIX)(shtns, im, Vt, Vp, Slm, Tlm, llim, 0, nk);
+3		GEN3(_an3_m,NWAY,SUFFIX)(shtns, im, Vr, Vt, Vp, Qlm, Slm, Tlm, llim, 0, nk);
+		return;
+	}
+QX	const long int nr = 1;
+VX	const long int nr = 2;
+3	const long int nr = 3;
+	const long int nl = LMAX+1 - im*MRES;		// number of coefficients written by the kernel.
+	cplx* const red = (cplx*) shtns_scratch(SCRATCH_FFT, (nth-1)*nr*nl * sizeof(cplx));		// contribution of threads ith>0
+
+	#pragma omp parallel num_threads(nth)
+	{
+		const int ith = omp_get_thread_num();
+		const int n = omp_get_num_threads();
+		long int k0, k1;
+		omp_krange(nk, kt, NWAY, ith, n, &k0, &k1);
+Q		cplx* q = Qlm;
+V		cplx* s = Slm;		cplx* t = Tlm;
+		if (ith > 0) {		// thread 0 writes directly to the output.
+V			s = red + (ith-1)*nr*nl;	t = s + nl;
+Q			q = red + ((ith-1)*nr + nr-1)*nl;
+		}
+QX		GEN3(_an1_m,NWAY,SUFFIX)(shtns, im, Vr, q, llim, k0, k1);
+VX		GEN3(_an2_m,NWAY,SUFFIX)(shtns, im, Vt, Vp, s, t, llim, k0, k1);
+3		GEN3(_an3_m,NWAY,SUFFIX)(shtns, im, Vr, Vt, Vp, q, s, t, llim, k0, k1);
+		#pragma omp barrier
+		#pragma omp for schedule(static)
+		for (long int l=0; l<nl; l++) {
+			for (int i=1; i<n; i++) {
+V				Slm[l] += red[(i-1)*nr*nl + l];
+V				Tlm[l] += red[((i-1)*nr+1)*nl + l];
+Q				Qlm[l] += red[((i-1)*nr + nr-1)*nl + l];
+			}
+		}
+	}
+  }
+  #endif
+
   #endif
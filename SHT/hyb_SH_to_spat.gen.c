@@ -65,6 +65,7 @@ VX	static void GEN3(SHsphtor_to_spat_,ID_NME,SUFFIX)(shtns_cfg shtns, cplx *Slm,
 S	static void GEN3(SHsph_to_spat_,ID_NME,SUFFIX)(shtns_cfg shtns, cplx *Slm, double *Vt, double *Vp, long int llim) {
 T	static void GEN3(SHtor_to_spat_,ID_NME,SUFFIX)(shtns_cfg shtns, cplx *Tlm, double *Vt, double *Vp, long int llim) {
   #endif
+	STATS_BEGIN
 
 Q	v2d *BrF;
   #ifndef SHT_AXISYM
@@ -101,11 +102,11 @@ T	s2d Tl0[(llim+3)>>1];		// we need some zero-padding (icc 14 bug: needs 1 more
   #ifndef SHT_AXISYM
 Q	BrF = (v2d *) Vr;
 V	BtF = (v2d *) Vt;	BpF = (v2d *) Vp;
-	if (shtns->ncplx_fft > 0) {		// alloc memory for the FFT
-QX		BrF = VMALLOC( shtns->ncplx_fft * sizeof(cplx) );
-VX		BtF = VMALLOC( 2* shtns->ncplx_fft * sizeof(cplx) );
+	if (shtns->ncplx_fft > 0) {		// scratch memory for the FFT (kept by the thread from one call to the next)
+QX		BrF = shtns_scratch(SCRATCH_FFT, shtns->ncplx_fft * sizeof(cplx) );
+VX		BtF = shtns_scratch(SCRATCH_FFT, 2* shtns->ncplx_fft * sizeof(cplx) );
 VX		BpF = BtF + shtns->ncplx_fft;
-3		BrF = VMALLOC( 3* shtns->ncplx_fft * sizeof(cplx) );
+3		BrF = shtns_scratch(SCRATCH_FFT, 3* shtns->ncplx_fft * sizeof(cplx) );
 3		BtF = BrF + shtns->ncplx_fft;		BpF = BtF + shtns->ncplx_fft;
 	}
 	imlim = MTR;
@@ -550,14 +551,18 @@ V			}
 Q		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BrF, Vr);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BtF, Vt);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BpF, Vp);
-		if (shtns->ncplx_fft > 0) {		// free memory
-Q			VFREE(BrF);
-VX			VFREE(BtF);	// this frees also BpF.
-		}
 	}
   #endif
 
 Q	#undef BR0
 V	#undef BT0
 V	#undef BP0
+3	STATS_END(SHT_TYP_3SY)
+QX	STATS_END(SHT_TYP_SSY)
+  #ifndef SHT_GRAD
+VX	STATS_END(SHT_TYP_VSY)
+  #else
+S	STATS_END(SHT_TYP_GSP)
+T	STATS_END(SHT_TYP_GTO)
+  #endif
   }
@@ -47,6 +47,7 @@ VX	static void GEN3(spat_to_SHsphtor_,ID_NME,SUFFIX)(shtns_cfg shtns, double *Vt
 S	static void GEN3(spat_to_SHsph_,ID_NME,SUFFIX)(shtns_cfg shtns, double *Vt, cplx *Slm, long int llim) {
 T	static void GEN3(spat_to_SHtor_,ID_NME,SUFFIX)(shtns_cfg shtns, double *Vp, cplx *Tlm, long int llim) {
   #endif
+	STATS_BEGIN
 
 Q	double *zl;
 V	double *dzl0;
@@ -96,11 +97,11 @@ Q	BrF = (cplx *) Vr;
 S	BtF = (cplx *) Vt;
 T	BpF = (cplx *) Vp;
 	if (shtns->ncplx_fft >= 0) {
-	    if (shtns->ncplx_fft > 0) {		// alloc memory for the FFT
-QX	    	BrF = VMALLOC( shtns->ncplx_fft * sizeof(cplx) );
-VX	    	BtF = VMALLOC( 2* shtns->ncplx_fft * sizeof(cplx) );
+	    if (shtns->ncplx_fft > 0) {		// scratch memory for the FFT (kept by the thread from one call to the next)
+QX	    	BrF = shtns_scratch(SCRATCH_FFT, shtns->ncplx_fft * sizeof(cplx) );
+VX	    	BtF = shtns_scratch(SCRATCH_FFT, 2* shtns->ncplx_fft * sizeof(cplx) );
 VX	    	BpF = BtF + shtns->ncplx_fft;
-3	    	BrF = VMALLOC( 3* shtns->ncplx_fft * sizeof(cplx) );
+3	    	BrF = shtns_scratch(SCRATCH_FFT, 3* shtns->ncplx_fft * sizeof(cplx) );
 3	    	BtF = BrF + shtns->ncplx_fft;		BpF = BtF + shtns->ncplx_fft;
 	    }
 Q	    fftw_execute_dft_r2c(shtns->fft,Vr, BrF);
@@ -484,10 +485,6 @@ V			((v2d*)Slm)[l] = vdup(0.0);		((v2d*)Tlm)[l] = vdup(0.0);
 	}
 	#endif
 
-  	if (shtns->ncplx_fft > 0) {		// free memory
-Q	    VFREE(BrF - NLAT*imlim);
-VX	    VFREE(BtF - NLAT*imlim);	// this frees also BpF.
-	}
   #endif
 
 Q	#undef ZL
@@ -510,4 +507,9 @@ Q	#undef reo0
 V	#undef tpeo0
 V	#undef vteo0
 V	#undef vpeo0
+QX	STATS_END(SHT_TYP_SAN)
+3	STATS_END(SHT_TYP_3AN)
+  #ifndef SHT_GRAD
+VX	STATS_END(SHT_TYP_VAN)
+  #endif
   }
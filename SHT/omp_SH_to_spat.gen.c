@@ -28,13 +28,13 @@
 # T : line for vector transform, toroidal component.
 
 	static
-3	void GEN3(_sy3,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, v2d *BrF, v2d *BtF, v2d *BpF, const long int llim, const int imlim) {
-QX	void GEN3(_sy1,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Qlm, v2d *BrF, long int llim, const int imlim) {
+3	void GEN3(_sy3,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, v2d *BrF, v2d *BtF, v2d *BpF, const long int llim, const int imlim, unsigned* im_next) {
+QX	void GEN3(_sy1,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Qlm, v2d *BrF, long int llim, const int imlim, unsigned* im_next) {
   #ifndef SHT_GRAD
-VX	void GEN3(_sy2,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, cplx *Tlm, v2d *BtF, v2d *BpF, const long int llim, const int imlim) {
+VX	void GEN3(_sy2,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, cplx *Tlm, v2d *BtF, v2d *BpF, const long int llim, const int imlim, unsigned* im_next) {
   #else
-S	void GEN3(_sy1s,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, v2d *BtF, v2d *BpF, const long int llim, const int imlim) {
-T	void GEN3(_sy1t,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Tlm, v2d *BtF, v2d *BpF, const long int llim, const int imlim) {
+S	void GEN3(_sy1s,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, v2d *BtF, v2d *BpF, const long int llim, const int imlim, unsigned* im_next) {
+T	void GEN3(_sy1t,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Tlm, v2d *BtF, v2d *BpF, const long int llim, const int imlim, unsigned* im_next) {
   #endif
 
   #ifndef SHT_AXISYM
@@ -45,15 +45,17 @@ V	#define vi(l) vall( ((double*) VWl)[4*(l)+1] )
 V	#define wr(l) vall( ((double*) VWl)[4*(l)+2] )
 V	#define wi(l) vall( ((double*) VWl)[4*(l)+3] )
 	unsigned im;
+	long int m;
+	double *st = shtns->st;
   #endif
 	unsigned m0, mstep;
-	long int nk,k,l,m;
+	long int nk,k,l;
 	double *alm, *al;
-	double *ct, *st;
+	double *ct;
 QX	double Ql0[llim+2];
 V	v2d VWl[llim*2+4];
 
-	ct = shtns->ct;		st = shtns->st;
+	ct = shtns->ct;
 	nk = NLAT_2;
 	#if _GCC_VEC_
 		nk = ((unsigned)(nk+VSIZE2-1)) / VSIZE2;
@@ -64,9 +66,12 @@ V	v2d VWl[llim*2+4];
 	#else
 		m0 = omp_get_thread_num();
 		mstep = omp_get_num_threads();
+	  #ifndef SHT_AXISYM
 		if (m0 == 0)
+	  #endif
 	#endif
-	{	//	im=0;
+	{	//	im=0;	(axisymmetric transforms: the latitudes are split among all threads)
+		long int k1 = nk;
 S		double* const Sl0 = (double*) VWl;
 T		double* const Tl0 = (double*) VWl + llim+2;
 3		double* const Ql0 = (double*) (VWl + llim+2);
@@ -80,8 +85,8 @@ S				k=0; do { BpF[k]=vdup(0.0); } while(++k<NLAT);
 T				k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT);
 			#endif
 		  #else
-S			if (BpF != NULL) { int k=0; do { BpF[k]=vdup(0.0); } while(++k<NLAT_2); }
-T			if (BtF != NULL) { int k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT_2); }
+S			if ((BpF != NULL) && (m0 == 0)) { int k=0; do { BpF[k]=vdup(0.0); } while(++k<NLAT_2); }
+T			if ((BtF != NULL) && (m0 == 0)) { int k=0; do { BtF[k]=vdup(0.0); } while(++k<NLAT_2); }
 		  #endif
 		#endif
  		l=1;
@@ -94,6 +99,10 @@ T			Tl0[l-1] = (double) Tlm[l];	//	Tl[l] = (double) Tlm[l+1];
 			++l;
 		} while(l<=llim);
 		k=0;
+	  #ifdef SHT_AXISYM
+		omp_krange(nk, 0, NWAY, m0, mstep, &k, &k1);
+		if (k < k1)
+	  #endif
 		do {
 			l=0;	al = alm;
 			rnd cost[NWAY], y0[NWAY], y1[NWAY];
@@ -103,7 +112,7 @@ S			rnd te[NWAY], to[NWAY];
 T			rnd pe[NWAY], po[NWAY];
 			for (int j=0; j<NWAY; ++j) {
 				cost[j] = vread(ct, j+k);
-V				sint[j] = -vread(st, j+k);
+V				sint[j] = -vread(shtns->st, j+k);
 V			#ifdef SHTNS4MAGIC
 V				sint[j] *= -sint[j];
 V			#endif
@@ -179,19 +188,25 @@ T				S2D_STORE_4MAGIC(Bp0, j+k, pe[j], po[j])
 			}
 		#endif
 			k+=NWAY;
-		} while (k < nk);
-		m0=mstep;
+		} while (k < k1);
 	}
 
   #ifndef SHT_AXISYM
+Q	v2d* const BrF0 = BrF;
+V	v2d* const BtF0 = BtF;		v2d* const BpF0 = BpF;
+	#ifndef _OPENMP
+	for (im=1; im<imlim; im++) {
+	#else
+	for (unsigned it=0; (im = omp_next_im(shtns, it, im_next, imlim)) < imlim; it++) {
+	#endif
+		TRACE_M_BEGIN
 	#if _GCC_VEC_
-Q		BrF += m0*NLAT_2;
-V		BtF += m0*NLAT_2;	BpF += m0*NLAT_2;
+Q		BrF = BrF0 + im*NLAT_2;
+V		BtF = BtF0 + im*NLAT_2;		BpF = BpF0 + im*NLAT_2;
 	#else
-Q		BrF += m0*NLAT;
-V		BtF += m0*NLAT;		BpF += m0*NLAT;
+Q		BrF = BrF0 + im*NLAT;
+V		BtF = BtF0 + im*NLAT;		BpF = BpF0 + im*NLAT;
 	#endif
-	for (im=m0; im<imlim; im+=mstep) {
 		m = im*MRES;
 		//l = LiM(shtns, 0,im);
 		l = (im*(2*(LMAX+1)-(m+MRES)))>>1;
@@ -384,36 +399,28 @@ V				S2D_CSTORE_4MAGIC(BpF, k+j, per[j], por[j], pei[j], poi[j])
 		#endif
 			k+=NWAY;
 		} while (k < nk);
-	#if _GCC_VEC_
-Q		BrF += mstep*NLAT_2;
-V		BtF += mstep*NLAT_2;	BpF += mstep*NLAT_2;
-	#else
-Q		BrF += mstep*NLAT;
-V		BtF += mstep*NLAT;	BpF += mstep*NLAT;
-	#endif
+		TRACE_M_END(m)
 	}
 
 	#if _GCC_VEC_
-	while(im <= NPHI-imlim) {	// padding for high m's
+	for (im=imlim+m0; im <= NPHI-imlim; im+=mstep) {	// padding for high m's
+Q		BrF = BrF0 + im*NLAT_2;
+V		BtF = BtF0 + im*NLAT_2;		BpF = BpF0 + im*NLAT_2;
 		k=0;
 		do {
 Q			BrF[k] = vdup(0.0);
 V			BtF[k] = vdup(0.0);		BpF[k] = vdup(0.0);
 		} while (++k < NLAT_2);
-Q		BrF += mstep*NLAT_2;
-V		BtF += mstep*NLAT_2;	BpF += mstep*NLAT_2;
-	  im+=mstep;
 	}
 	#else
-	while(im <= NPHI/2) {	// padding for high m's
+	for (im=imlim+m0; im <= NPHI/2; im+=mstep) {	// padding for high m's
+Q		BrF = BrF0 + im*NLAT;
+V		BtF = BtF0 + im*NLAT;		BpF = BpF0 + im*NLAT;
 		k=0;
 		do {
 Q			BrF[k] = 0.0;
 V			BtF[k] = 0.0;	BpF[k] = 0.0;
 		} while (++k < NLAT);
-Q		BrF += mstep*NLAT;
-V		BtF += mstep*NLAT;	BpF += mstep*NLAT;
-	  im+=mstep;
 	}
 	#endif
   #endif
@@ -434,6 +441,7 @@ VX	static void GEN3(SHsphtor_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm
 S	static void GEN3(SHsph_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Slm, double *Vt, double *Vp, long int llim) {
 T	static void GEN3(SHtor_to_spat_omp,NWAY,SUFFIX)(shtns_cfg shtns, cplx *Tlm, double *Vt, double *Vp, long int llim) {
   #endif
+	STATS_BEGIN
 
 	int k;
 	unsigned imlim = 0;
@@ -448,33 +456,35 @@ V	v2d* BtF = (v2d*) Vt;	v2d* BpF = (v2d*) Vp;
 	#ifdef _GCC_VEC_
 	if (shtns->fftc_mode > 0) {		// alloc memory for the FFT
 		unsigned long nv = shtns->nspat;
-QX		BrF = (v2d*) VMALLOC( nv * sizeof(double) );
-VX		BtF = (v2d*) VMALLOC( 2*nv * sizeof(double) );
+QX		BrF = (v2d*) shtns_scratch(SCRATCH_FFT, nv * sizeof(double) );
+VX		BtF = (v2d*) shtns_scratch(SCRATCH_FFT, 2*nv * sizeof(double) );
 VX		BpF = BtF + nv/2;
-3		BrF = (v2d*) VMALLOC( 3*nv * sizeof(double) );
+3		BrF = (v2d*) shtns_scratch(SCRATCH_FFT, 3*nv * sizeof(double) );
 3		BtF = BrF + nv/2;		BpF = BrF + nv;
 	}
 	#else
 	if (shtns->ncplx_fft > 0) {		// alloc memory for the FFT
-QX		BrF = VMALLOC( shtns->ncplx_fft * sizeof(cplx) );
-VX		BtF = VMALLOC( 2* shtns->ncplx_fft * sizeof(cplx) );
+QX		BrF = shtns_scratch(SCRATCH_FFT, shtns->ncplx_fft * sizeof(cplx) );
+VX		BtF = shtns_scratch(SCRATCH_FFT, 2* shtns->ncplx_fft * sizeof(cplx) );
 VX		BpF = BtF + shtns->ncplx_fft;
-3		BrF = VMALLOC( 3* shtns->ncplx_fft * sizeof(cplx) );
+3		BrF = shtns_scratch(SCRATCH_FFT, 3* shtns->ncplx_fft * sizeof(cplx) );
 3		BtF = BrF + shtns->ncplx_fft;		BpF = BtF + shtns->ncplx_fft;
 	}
 	#endif
   #endif
 	imlim += 1;
+	unsigned im_next = 1;		// next m to process (shared by all threads)
   
   #pragma omp parallel num_threads(shtns->nthreads)
   {
-3	GEN3(_sy3,NWAY,SUFFIX)(shtns, Qlm, Slm, Tlm, BrF, BtF, BpF, llim, imlim);
-QX	GEN3(_sy1,NWAY,SUFFIX)(shtns, Qlm, BrF, llim, imlim);
+	STATS_THREAD_BEGIN
+3	GEN3(_sy3,NWAY,SUFFIX)(shtns, Qlm, Slm, Tlm, BrF, BtF, BpF, llim, imlim, &im_next);
+QX	GEN3(_sy1,NWAY,SUFFIX)(shtns, Qlm, BrF, llim, imlim, &im_next);
 	#ifndef SHT_GRAD
-VX		GEN3(_sy2,NWAY,SUFFIX)(shtns, Slm, Tlm, BtF, BpF, llim, imlim);
+VX		GEN3(_sy2,NWAY,SUFFIX)(shtns, Slm, Tlm, BtF, BpF, llim, imlim, &im_next);
 	#else
-S		GEN3(_sy1s,NWAY,SUFFIX)(shtns, Slm, BtF, BpF, llim, imlim);
-T		GEN3(_sy1t,NWAY,SUFFIX)(shtns, Tlm, BtF, BpF, llim, imlim);
+S		GEN3(_sy1s,NWAY,SUFFIX)(shtns, Slm, BtF, BpF, llim, imlim, &im_next);
+T		GEN3(_sy1t,NWAY,SUFFIX)(shtns, Tlm, BtF, BpF, llim, imlim, &im_next);
 	#endif
 
   #ifndef SHT_AXISYM
@@ -509,6 +519,7 @@ V	  #endif
 V	#endif
   #endif
 
+	STATS_THREAD_END
   }
 
   #ifndef SHT_AXISYM
@@ -527,8 +538,6 @@ Q			fftw_execute_split_dft(shtns->ifftc,((double*)BrF)+1, ((double*)BrF), Vr+NPH
 V			fftw_execute_split_dft(shtns->ifftc,((double*)BtF)+1, ((double*)BtF), Vt+NPHI, Vt);
 V			fftw_execute_split_dft(shtns->ifftc,((double*)BpF)+1, ((double*)BpF), Vp+NPHI, Vp);
 V		  #endif
-Q			VFREE(BrF);
-VX			VFREE(BtF);		// this frees also BpF.
 		}
 	}
 	#else
@@ -538,12 +547,16 @@ Q		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BrF, Vr);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BtF, Vt);
 V		fftw_execute_dft_c2r(shtns->ifft, (cplx *) BpF, Vp);
 V	  #endif
-		if (shtns->ncplx_fft > 0) {		// free memory
-Q			VFREE(BrF);
-VX			VFREE(BtF);		// this frees also BpF.
-		}
 	}
 	#endif
   #endif
 
+3	STATS_END(SHT_TYP_3SY)
+QX	STATS_END(SHT_TYP_SSY)
+  #ifndef SHT_GRAD
+VX	STATS_END(SHT_TYP_VSY)
+  #else
+S	STATS_END(SHT_TYP_GSP)
+T	STATS_END(SHT_TYP_GTO)
+  #endif
   }
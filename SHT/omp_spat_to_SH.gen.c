@@ -25,18 +25,21 @@
 //////////////////////////////////////////////////
 
 	static
-QX	void GEN3(_an1,NWAY,SUFFIX)(shtns_cfg shtns, double *BrF, cplx *Qlm, const long int llim, const int imlim) {
-VX	void GEN3(_an2,NWAY,SUFFIX)(shtns_cfg shtns, double *BtF, double *BpF, cplx *Slm, cplx *Tlm, const long int llim, const int imlim) {
-3	void GEN3(_an3,NWAY,SUFFIX)(shtns_cfg shtns, double *BrF, double *BtF, double *BpF, cplx *Qlm, cplx *Slm, cplx *Tlm, const long int llim, const int imlim) {
+QX	void GEN3(_an1,NWAY,SUFFIX)(shtns_cfg shtns, double *BrF, cplx *Qlm, const long int llim, const int imlim, unsigned* im_next, double* red) {
+VX	void GEN3(_an2,NWAY,SUFFIX)(shtns_cfg shtns, double *BtF, double *BpF, cplx *Slm, cplx *Tlm, const long int llim, const int imlim, unsigned* im_next, double* red) {
+3	void GEN3(_an3,NWAY,SUFFIX)(shtns_cfg shtns, double *BrF, double *BtF, double *BpF, cplx *Qlm, cplx *Slm, cplx *Tlm, const long int llim, const int imlim, unsigned* im_next, double* red) {
 
 	double *alm, *al;
-	double *wg, *ct, *st;
+	double *wg, *ct;
 V	double *l_2;
-	long int nk, k, l,m;
-	int k_inc, m_inc;
-	unsigned m0, mstep;
+	long int nk, k, l;
+	int k_inc;
+	unsigned m0;
   #ifndef SHT_AXISYM
 	unsigned im;
+	long int m;
+	int m_inc;
+	double *st;
   #endif
 Q	rnd qq[2*llim+4];
 V	rnd vw[4*llim+8];
@@ -58,13 +61,16 @@ V	double poi[NLAT_2 + NWAY*VSIZE2] SSE;
 
 	// ACCESS PATTERN
 	k_inc = shtns->k_stride_a;
+  #ifndef SHT_AXISYM
 	m_inc = shtns->m_stride_a;
+	st = shtns->st;
+  #endif
 
 	nk = NLAT_2;	// copy NLAT_2 to a local variable for faster access (inner loop limit)
 	#if _GCC_VEC_
 	  nk = ((unsigned) nk+(VSIZE2-1))/VSIZE2;
 	#endif
-	wg = shtns->wg;		ct = shtns->ct;		st = shtns->st;
+	wg = shtns->wg;		ct = shtns->ct;
 V	l_2 = shtns->l_2;
 	for (k=nk*VSIZE2; k<(nk-1+NWAY)*VSIZE2; ++k) {		// never written, so this is now done for all m's
 Q		rer[k] = 0.0;		ror[k] = 0.0;
@@ -78,26 +84,37 @@ V		pei[k] = 0.0;		poi[k] = 0.0;
 	}
 
 	#ifndef _OPENMP
-		m0 = 0;		mstep = 1;
+		m0 = 0;
 	#else
 		m0 = omp_get_thread_num();
-		mstep = omp_get_num_threads();
+	  #ifndef SHT_AXISYM
 		if (m0 == 0)
+	  #endif
 	#endif
-	{		// im=0 : dzl.p = 0.0 and evrything is REAL
+	{		// im=0 : dzl.p = 0.0 and evrything is REAL	(axisymmetric transforms: the latitudes are split among all threads)
+		long int k0 = 0;	long int k1 = nk;
+	  #ifdef SHT_AXISYM
+		const unsigned nth = omp_get_num_threads();
+		omp_krange(nk, 0, NWAY, m0, nth, &k0, &k1);
+	  #endif
 		alm = shtns->blm;
 		// compute symmetric and antisymmetric parts. (do not weight here, it is cheaper to weight y0)
-V		SYM_ASYM_M0_V(BtF, ter, tor)
-V		SYM_ASYM_M0_V(BpF, per, por)
+V		SYM_ASYM_M0_V_K(BtF, ter, tor, k0*VSIZE2, k1*VSIZE2)
+V		SYM_ASYM_M0_V_K(BpF, per, por, k0*VSIZE2, k1*VSIZE2)
 Q		double r0 = 0.0;
-Q		SYM_ASYM_M0_Q(BrF, rer, ror, r0)
+Q		SYM_ASYM_M0_Q_K(BrF, rer, ror, r0, k0*VSIZE2, k1*VSIZE2)
+	  #ifndef SHT_AXISYM
 Q		Qlm[0] = r0 * alm[0];			// l=0 is done.
 V		Slm[0] = 0.0;		Tlm[0] = 0.0;		// l=0 is zero for the vector transform.
-		k = 0;
+	  #endif
+		k = k0;
 		for (l=0;l<llim;++l) {
 Q			qq[l] = vall(0.0);
 V			vw[2*l] = vall(0.0);		vw[2*l+1] = vall(0.0);
 		}
+	  #ifdef SHT_AXISYM
+		if (k < k1)
+	  #endif
 		do {
 			al = alm;
 			rnd cost[NWAY], y0[NWAY], y1[NWAY];
@@ -108,7 +125,7 @@ V			rnd terk[NWAY], tork[NWAY], perk[NWAY], pork[NWAY];
 				cost[j] = vread(ct, k+j);
 				y0[j] = vall(al[0]) * vread(wg, k+j);		// weight of Gauss quadrature appears here
 V				dy0[j] = vall(0.0);
-V				sint[j] = -vread(st, k+j);
+V				sint[j] = -vread(shtns->st, k+j);
 				y1[j] =  (vall(al[1])*y0[j]) * cost[j];
 V				dy1[j] = (vall(al[1])*y0[j]) * sint[j];
 Q				rerk[j] = vread(rer, k+j);		rork[j] = vread(ror, k+j);		// cache into registers.
@@ -145,7 +162,8 @@ V					vw[2*l-1] -= dy1[j] * perk[j];
 				}
 			}
 			k+=NWAY;
-		} while (k < nk);
+		} while (k < k1);
+	  #ifndef SHT_AXISYM
 		for (l=1; l<=llim; ++l) {
 			#if _GCC_VEC_
 Q				((v2d*)Qlm)[l] = v2d_reduce(qq[l-1], vall(0));
@@ -156,6 +174,38 @@ Q				Qlm[l] = qq[l-1];
 V				Slm[l] = vw[2*l-2]*l_2[l];		Tlm[l] = vw[2*l-1]*l_2[l];
 			#endif
 		}
+	  #else
+		// store the partial sums of this thread, then sum over threads (in a fixed order, for reproducible results).
+QX		const long int nr = 1;
+VX		const long int nr = 2;
+3		const long int nr = 3;
+S		double* const rs = red + m0*nr*(llim+1);
+T		double* const rt = red + (m0*nr+1)*(llim+1);
+Q		double* const rq = red + (m0*nr+nr-1)*(llim+1);
+Q		rq[0] = r0 * alm[0];
+		for (l=1; l<=llim; ++l) {
+Q			rq[l] = reduce_add(qq[l-1]);
+S			rs[l] = reduce_add(vw[2*l-2]);
+T			rt[l] = reduce_add(vw[2*l-1]);
+		}
+		#pragma omp barrier
+		#pragma omp for schedule(static)
+		for (l=0; l<=llim; ++l) {
+Q			double q = 0.0;
+S			double s = 0.0;
+T			double t = 0.0;
+			for (unsigned i=0; i<nth; i++) {
+Q				q += red[(i*nr+nr-1)*(llim+1) + l];
+S				s += red[i*nr*(llim+1) + l];
+T				t += red[(i*nr+1)*(llim+1) + l];
+			}
+Q			Qlm[l] = q;
+S			Slm[l] = s*l_2[l];
+T			Tlm[l] = t*l_2[l];
+		}
+		if (m0 != 0) return;		// the remaining work is done by thread 0.
+V		Slm[0] = 0.0;		Tlm[0] = 0.0;		// l=0 is zero for the vector transform.
+	  #endif
 		#ifdef SHT_VAR_LTR
 			for (l=llim+1; l<= LMAX; ++l) {
 Q				((v2d*)Qlm)[l] = vdup(0.0);
@@ -171,11 +221,15 @@ V					((v2d*)Slm)[l] = vdup(0.0);		((v2d*)Tlm)[l] = vdup(0.0);
 			}
 			#endif
 		#endif
-		m0=mstep;
 	}
 
   #ifndef SHT_AXISYM
-	for (im=m0; im<imlim; im+=mstep) {
+	#ifndef _OPENMP
+	for (im=1; im<imlim; im++) {
+	#else
+	for (unsigned it=0; (im = omp_next_im(shtns, it, im_next, imlim)) < imlim; it++) {
+	#endif
+		TRACE_M_BEGIN
 		m = im*MRES;
 		l = shtns->tm[im] / VSIZE2;
 		//alm = shtns->blm[im];
@@ -347,6 +401,7 @@ Q				Ql[l] = vdup(0.0);
 V				Sl[l] = vdup(0.0);		Tl[l] = vdup(0.0);
 			}
 		#endif
+		TRACE_M_END(m)
 	}
   #endif
   }
@@ -355,6 +410,7 @@ V				Sl[l] = vdup(0.0);		Tl[l] = vdup(0.0);
 QX	static void GEN3(spat_to_SH_omp,NWAY,SUFFIX)(shtns_cfg shtns, double *Vr, cplx *Qlm, long int llim) {
 VX	static void GEN3(spat_to_SHsphtor_omp,NWAY,SUFFIX)(shtns_cfg shtns, double *Vt, double *Vp, cplx *Slm, cplx *Tlm, long int llim) {
 3	static void GEN3(spat_to_SHqst_omp,NWAY,SUFFIX)(shtns_cfg shtns, double *Vr, double *Vt, double *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, long int llim) {
+	STATS_BEGIN
 
 Q	double *BrF;		// contains the Fourier transformed data
 V	double *BtF, *BpF;	// contains the Fourier transformed data
@@ -370,10 +426,10 @@ V	BtF = Vt;	BpF = Vp;
 	if (shtns->fftc_mode >= 0) {
 		if (shtns->fftc_mode > 0) {		// out-of-place
 			unsigned long nv = shtns->nspat;
-QX			BrF = (double*) VMALLOC( nv * sizeof(double) );
-VX			BtF = (double*) VMALLOC( 2*nv * sizeof(double) );
+QX			BrF = (double*) shtns_scratch(SCRATCH_FFT, nv * sizeof(double) );
+VX			BtF = (double*) shtns_scratch(SCRATCH_FFT, 2*nv * sizeof(double) );
 VX			BpF = BtF + nv;
-3			BrF = (double*) VMALLOC( 3*nv * sizeof(double) );
+3			BrF = (double*) shtns_scratch(SCRATCH_FFT, 3*nv * sizeof(double) );
 3			BtF = BrF + nv;		BpF = BtF + nv;			
 		}
 V	  #ifdef HAVE_LIBFFTW3_OMP
@@ -390,9 +446,17 @@ V	  #endif
 	}
   #endif
 	imlim += 1;
+	unsigned im_next = 1;		// next m to process (shared by all threads)
+	double* red = 0;			// partial sums of each thread (axisymmetric only)
+  #ifdef SHT_AXISYM
+QX	red = (double*) shtns_scratch(SCRATCH_FFT, shtns->nthreads*(llim+1) * sizeof(double) );
+VX	red = (double*) shtns_scratch(SCRATCH_FFT, 2*shtns->nthreads*(llim+1) * sizeof(double) );
+3	red = (double*) shtns_scratch(SCRATCH_FFT, 3*shtns->nthreads*(llim+1) * sizeof(double) );
+  #endif
 
   #pragma omp parallel num_threads(shtns->nthreads)
   {
+	STATS_THREAD_BEGIN
 	#ifndef SHT_AXISYM
 V	#ifndef HAVE_LIBFFTW3_OMP
 V	if (shtns->fftc_mode > 0) {
@@ -415,16 +479,14 @@ V		#pragma omp barrier
 V	}
 V	#endif
 	#endif
-QX	GEN3(_an1,NWAY,SUFFIX)(shtns, BrF, Qlm, llim, imlim);
-VX	GEN3(_an2,NWAY,SUFFIX)(shtns, BtF, BpF, Slm, Tlm, llim, imlim);
-3	GEN3(_an3,NWAY,SUFFIX)(shtns, BrF, BtF, BpF, Qlm, Slm, Tlm, llim, imlim);
+QX	GEN3(_an1,NWAY,SUFFIX)(shtns, BrF, Qlm, llim, imlim, &im_next, red);
+VX	GEN3(_an2,NWAY,SUFFIX)(shtns, BtF, BpF, Slm, Tlm, llim, imlim, &im_next, red);
+3	GEN3(_an3,NWAY,SUFFIX)(shtns, BrF, BtF, BpF, Qlm, Slm, Tlm, llim, imlim, &im_next, red);
+	STATS_THREAD_END
   }
 
-  #ifndef SHT_AXISYM
-  	if (shtns->fftc_mode > 0) {		// free memory
-Q	    VFREE(BrF);
-VX	    VFREE(BtF);	// this frees also BpF.
-	}
-  #endif
 
+QX	STATS_END(SHT_TYP_SAN)
+VX	STATS_END(SHT_TYP_VAN)
+3	STATS_END(SHT_TYP_3AN)
   }
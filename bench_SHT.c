@@ -0,0 +1,407 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/// \file bench_SHT.c This program benchmarks the spherical harmonic transforms over a matrix of sizes and options,
+/// and writes the results (timings, GFlop/s, bandwidth, accuracy, algorithm) as CSV or JSON.
+/// It can also compare two CSV result files and flag the regressions beyond the measured noise.
+/// \c make \c bench_SHT to compile, and then run.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <complex.h>
+#include <math.h>
+#include <time.h>
+
+#include <shtns.h>
+
+#define MAX_LIST 32			// maximum number of values for each swept parameter.
+#define MAX_TRIALS 101
+
+/// transforms that can be benchmarked, each one timed as a synthesis and an analysis.
+enum bench_kind { BENCH_SCAL, BENCH_VECT, BENCH_QST, BENCH_LTR, BENCH_NKIND };
+const char* kind_name[BENCH_NKIND] = { "scal", "vect", "qst", "ltr" };
+const int kind_nf[BENCH_NKIND] = { 1, 2, 3, 1 };		// number of scalar fields
+
+const char* grid_name[] = { "gauss", "reg", "fly", "predict", "quick", "poles" };
+const enum shtns_type grid_flag[] = { sht_gauss, sht_reg_fast, sht_gauss_fly, sht_predict, sht_quick_init, sht_reg_poles };
+const char* layout_name[] = { "native", "oop", "transpose" };
+const int layout_flag[] = { SHT_NATIVE_LAYOUT, SHT_THETA_CONTIGUOUS, SHT_PHI_CONTIGUOUS };
+
+/// one line of results.
+struct bench_res {
+	int lmax, mmax, mres, nlat, nphi, nth;
+	char grid[16], layout[16], transform[16], alg[16];
+	long nloop;
+	int trials;
+	double t_med, t_q1, t_q3;		// seconds per call
+	double gflops, gbps, error, t_init;
+};
+
+double wall_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1.e-9*ts.tv_nsec;
+}
+
+void runerr(const char * error_text)
+{
+	fprintf(stderr, "%s\n",error_text);
+	exit(1);
+}
+
+/// parse a comma separated list of integers. Returns the number of values.
+int parse_int_list(const char* s, int* v)
+{
+	int n = 0;
+	while ((n < MAX_LIST) && (*s)) {
+		v[n++] = strtol(s, (char**) &s, 10);
+		if (*s == ',') s++;
+		else break;
+	}
+	return n;
+}
+
+/// parse a comma separated list of names among the nn names[]. Returns the number of values.
+int parse_name_list(const char* s, const char** names, int nn, int* v)
+{
+	int n = 0;
+	while ((n < MAX_LIST) && (*s)) {
+		int len = strcspn(s, ",");
+		int k;
+		for (k=0; k<nn; k++)
+			if ((strlen(names[k]) == len) && (strncmp(s, names[k], len) == 0)) break;
+		if (k == nn) {
+			fprintf(stderr, "unknown value '%.*s'\n", len, s);		exit(1);
+		}
+		v[n++] = k;
+		s += len;
+		if (*s == ',') s++;
+	}
+	return n;
+}
+
+/// sorts the n values of t and returns the median, with the quartiles in q1 and q3.
+double median(double* t, int n, double* q1, double* q3)
+{
+	for (int i=1; i<n; i++) {		// insertion sort
+		double x = t[i];
+		int j = i-1;
+		while ((j >= 0) && (t[j] > x)) {  t[j+1] = t[j];  j--;  }
+		t[j+1] = x;
+	}
+	*q1 = t[n/4];		*q3 = t[(3*n)/4];
+	return (n & 1) ? t[n/2] : 0.5*(t[n/2-1] + t[n/2]);
+}
+
+/// nominal number of floating point operations of a transform of nf scalar fields, truncated at ltr (the same formula is used across versions):
+/// Legendre recurrence (3 flops) and accumulation of even/odd, real/imaginary parts (4 flops per field), for each (l,m) and latitude pair,
+/// plus 2.5*nphi*log2(nphi) flops for the real fft of each latitude and field.
+double nominal_flops(shtns_cfg shtns, int nf, int ltr)
+{
+	int mmax = shtns->mmax;
+	if (mmax*shtns->mres > ltr) mmax = ltr / shtns->mres;
+	double nlm = nlm_calc(ltr, mmax, shtns->mres);
+	double f = nlm * shtns->nlat_2 * (3 + 4*nf);
+	if (shtns->nphi > 1) f += nf * 2.5 * shtns->nphi * log2(shtns->nphi) * shtns->nlat;
+	return f;
+}
+
+/// minimal amount of memory read or written by a transform of nf scalar fields (spectral and spatial arrays).
+double nominal_bytes(shtns_cfg shtns, int nf, int ltr)
+{
+	int mmax = shtns->mmax;
+	if (mmax*shtns->mres > ltr) mmax = ltr / shtns->mres;
+	return nf * ( nlm_calc(ltr, mmax, shtns->mres) * sizeof(cplx) + (double) shtns->nlat * shtns->nphi * sizeof(double) );
+}
+
+/* arrays shared by all transforms */
+cplx *Slm, *Tlm, *Qlm, *Slm0, *Tlm0, *Qlm0;
+double *Sh, *Th, *Qh;
+
+/// performs nloop transforms of kind k (analysis if ana=1, synthesis otherwise).
+void do_transform(shtns_cfg shtns, int k, int ana, long nloop)
+{
+	const int ltr = shtns->lmax/2;
+	for (long i=0; i<nloop; i++) {
+		switch(k) {
+			case BENCH_SCAL :	if (ana) spat_to_SH(shtns, Sh, Slm);		else SH_to_spat(shtns, Slm0, Sh);	break;
+			case BENCH_VECT :	if (ana) spat_to_SHsphtor(shtns, Sh, Th, Slm, Tlm);		else SHsphtor_to_spat(shtns, Slm0, Tlm0, Sh, Th);	break;
+			case BENCH_QST :	if (ana) spat_to_SHqst(shtns, Qh, Sh, Th, Qlm, Slm, Tlm);		else SHqst_to_spat(shtns, Qlm0, Slm0, Tlm0, Qh, Sh, Th);	break;
+			case BENCH_LTR :	if (ana) spat_to_SH_l(shtns, Sh, Slm, ltr);		else SH_to_spat_l(shtns, Slm0, Sh, ltr);	break;
+		}
+	}
+}
+
+/// max error of a back-and-forth transform of kind k (same measure as SHT_error() during initialization), from random coefficients.
+double roundtrip_error(shtns_cfg shtns, int k)
+{
+	const int ltr = (k == BENCH_LTR) ? shtns->lmax/2 : shtns->lmax;
+	const int nf = kind_nf[k];
+	cplx* in[3] = { Slm0, Tlm0, Qlm0 };
+	cplx* out[3] = { Slm, Tlm, Qlm };
+	const double r = 1.0 / (RAND_MAX/2);
+	srand(42);		// reproducible
+	for (int f=0; f<nf; f++) {
+		for (int i=0; i<shtns->nlm; i++) {
+			in[f][i] = 0.0;
+			if (shtns->li[i] > ltr) continue;
+			in[f][i] = r*(rand() - RAND_MAX/2);
+			if ((shtns->mi[i] > 0) && (2*shtns->mi[i] != shtns->nphi))		// m=0 and m=nphi/2 are real
+				in[f][i] += I*r*(rand() - RAND_MAX/2);
+		}
+		if (k==BENCH_VECT || (k==BENCH_QST && f<2))	in[f][0] = 0.0;		// l=0 has no spheroidal/toroidal part
+	}
+	do_transform(shtns, k, 0, 1);
+	do_transform(shtns, k, 1, 1);
+	double err = 0.0;
+	for (int f=0; f<nf; f++)
+		for (int i=0; i<shtns->nlm; i++) {
+			if (shtns->li[i] > ltr) continue;
+			double e = cabs(out[f][i] - in[f][i]);
+			if (!(e <= err)) err = e;		// also catches NaN
+		}
+	return err;
+}
+
+/// times transforms of kind k: warmup, then repeated trials of nloop calls (nloop set so that a trial lasts at least mintime).
+void time_transform(shtns_cfg shtns, int k, int ana, int warmup, int trials, double mintime, struct bench_res* r)
+{
+	double t[MAX_TRIALS];
+	long nloop = 1;
+	double t0 = wall_time();
+	do_transform(shtns, k, ana, 1);
+	double t1 = wall_time() - t0;
+	if (t1 < mintime)	nloop = mintime / (t1 + 1e-9) + 1;
+	for (int i=0; i<warmup; i++)	do_transform(shtns, k, ana, nloop);
+	for (int i=0; i<trials; i++) {
+		t0 = wall_time();
+		do_transform(shtns, k, ana, nloop);
+		t[i] = (wall_time() - t0) / nloop;
+	}
+	r->nloop = nloop;		r->trials = trials;
+	r->t_med = median(t, trials, &r->t_q1, &r->t_q3);
+	const int ltr = (k == BENCH_LTR) ? shtns->lmax/2 : shtns->lmax;
+	r->gflops = nominal_flops(shtns, kind_nf[k], ltr) * 1e-9 / r->t_med;
+	r->gbps = nominal_bytes(shtns, kind_nf[k], ltr) * 1e-9 / r->t_med;
+	// stats type: syn/ana for scal and ltr, vector and 3D vector.
+	const int typ = ((k == BENCH_VECT) ? shtns_stats_SHsphtor_to_spat : ((k == BENCH_QST) ? shtns_stats_SHqst_to_spat : shtns_stats_SH_to_spat)) + ana;
+	strncpy(r->alg, shtns_get_algorithm(shtns, typ, (k == BENCH_LTR)), sizeof(r->alg)-1);
+	snprintf(r->transform, sizeof(r->transform), "%s_%s", kind_name[k], (ana) ? "ana" : "syn");
+}
+
+const char* csv_header = "lmax,mmax,mres,nlat,nphi,grid,layout,nth,transform,alg,nloop,trials,t_median,t_q1,t_q3,gflops,gbps,error,t_init";
+
+void write_csv(FILE* f, struct bench_res* r)
+{
+	fprintf(f, "%d,%d,%d,%d,%d,%s,%s,%d,%s,%s,%ld,%d,%.6e,%.6e,%.6e,%.4f,%.4f,%.3e,%.4f\n",
+		r->lmax, r->mmax, r->mres, r->nlat, r->nphi, r->grid, r->layout, r->nth, r->transform, r->alg,
+		r->nloop, r->trials, r->t_med, r->t_q1, r->t_q3, r->gflops, r->gbps, r->error, r->t_init);
+}
+
+void write_json(FILE* f, struct bench_res* r, int first)
+{
+	fprintf(f, "%s  {\"lmax\":%d, \"mmax\":%d, \"mres\":%d, \"nlat\":%d, \"nphi\":%d, \"grid\":\"%s\", \"layout\":\"%s\", \"nth\":%d, "
+		"\"transform\":\"%s\", \"alg\":\"%s\", \"nloop\":%ld, \"trials\":%d, \"t_median\":%.6e, \"t_q1\":%.6e, \"t_q3\":%.6e, "
+		"\"gflops\":%.4f, \"gbps\":%.4f, \"error\":%.3e, \"t_init\":%.4f}", (first) ? "" : ",\n",
+		r->lmax, r->mmax, r->mres, r->nlat, r->nphi, r->grid, r->layout, r->nth, r->transform, r->alg,
+		r->nloop, r->trials, r->t_med, r->t_q1, r->t_q3, r->gflops, r->gbps, r->error, r->t_init);
+}
+
+/* COMPARISON OF RESULT FILES */
+
+/// reads the results from a CSV file written by bench_SHT. Returns the number of results (allocated in *res).
+int read_csv(const char* fname, struct bench_res** res)
+{
+	char line[1024];
+	int n = 0, nmax = 64;
+	FILE* f = fopen(fname, "r");
+	if (f == NULL) {
+		fprintf(stderr, "cannot open '%s'\n", fname);		exit(1);
+	}
+	*res = (struct bench_res*) malloc(nmax * sizeof(struct bench_res));
+	while (fgets(line, sizeof(line), f)) {
+		struct bench_res* r = *res + n;
+		if ((line[0] < '0') || (line[0] > '9')) continue;		// skip header and comments
+		int nr = sscanf(line, "%d,%d,%d,%d,%d,%15[^,],%15[^,],%d,%15[^,],%15[^,],%ld,%d,%lf,%lf,%lf,%lf,%lf,%lf,%lf",
+			&r->lmax, &r->mmax, &r->mres, &r->nlat, &r->nphi, r->grid, r->layout, &r->nth, r->transform, r->alg,
+			&r->nloop, &r->trials, &r->t_med, &r->t_q1, &r->t_q3, &r->gflops, &r->gbps, &r->error, &r->t_init);
+		if (nr != 19) continue;
+		if (++n == nmax) {
+			nmax *= 2;
+			*res = (struct bench_res*) realloc(*res, nmax * sizeof(struct bench_res));
+		}
+	}
+	fclose(f);
+	return n;
+}
+
+/// compares the results of two CSV files. A regression (or improvement) is reported when the median time changes by more than tol
+/// AND the interquartile ranges do not overlap. Returns the number of regressions.
+int compare(const char* fold, const char* fnew, double tol)
+{
+	struct bench_res *a, *b;
+	int na = read_csv(fold, &a);
+	int nb = read_csv(fnew, &b);
+	int nreg = 0, nimp = 0, ncmp = 0;
+
+	printf("# comparing %s (%d results) with %s (%d results), tolerance %g%%\n", fold, na, fnew, nb, tol*100);
+	printf("%5s %5s %4s %-7s %-9s %3s %-9s %8s %8s  %11s %11s %7s\n", "lmax","mmax","mres","grid","layout","nth","transform","alg_old","alg_new","t_old","t_new","ratio");
+	for (int j=0; j<nb; j++) {
+		struct bench_res* q = b + j;
+		for (int i=0; i<na; i++) {
+			struct bench_res* p = a + i;
+			if ((p->lmax != q->lmax) || (p->mmax != q->mmax) || (p->mres != q->mres) || (p->nth != q->nth)
+				|| strcmp(p->grid, q->grid) || strcmp(p->layout, q->layout) || strcmp(p->transform, q->transform)) continue;
+			double ratio = q->t_med / p->t_med;
+			const char* flag = "";
+			if ((ratio > 1.0+tol) && (q->t_q1 > p->t_q3)) {  flag = "  REGRESSION";  nreg++;  }
+			else if ((ratio < 1.0-tol) && (q->t_q3 < p->t_q1)) {  flag = "  improved";  nimp++;  }
+			if ((q->error > 10*p->error) && (q->error > 1e-10)) {  flag = "  ACCURACY REGRESSION";  nreg++;  }
+			printf("%5d %5d %4d %-7s %-9s %3d %-9s %8s %8s  %11.4e %11.4e %7.3f%s\n", q->lmax, q->mmax, q->mres, q->grid, q->layout, q->nth,
+				q->transform, p->alg, q->alg, p->t_med, q->t_med, ratio, flag);
+			ncmp++;
+			break;
+		}
+	}
+	printf("# %d results compared: %d regressions, %d improvements\n", ncmp, nreg, nimp);
+	free(a);	free(b);
+	return nreg;
+}
+
+void usage()
+{
+	printf("\nUsage: bench_SHT [options]\n");
+	printf("       bench_SHT -compare old.csv new.csv [-tol=<t>]\n");
+	printf("** available options (lists are comma separated) :\n");
+	printf(" -lmax=<list> : maximum degrees to sweep (default 127,255,511)\n");
+	printf(" -mres=<list> : azimutal periodicities to sweep (default 1)\n");
+	printf(" -grid=<list> : grids and initialization among gauss,reg,fly,predict,quick,poles (default gauss)\n");
+	printf(" -layout=<list> : data layouts among native,oop,transpose (default native)\n");
+	printf(" -nth=<list> : numbers of threads (default 0 = all available)\n");
+	printf(" -transforms=<list> : transforms among scal,vect,qst,ltr (default scal,vect,qst,ltr)\n");
+	printf(" -warmup=<n> : number of warmup trials (default 2)\n");
+	printf(" -trials=<n> : number of timed trials (default 7)\n");
+	printf(" -mintime=<s> : minimum duration of a trial in seconds (default 0.02)\n");
+	printf(" -csv=<file> : write the results to a CSV file (default: stdout)\n");
+	printf(" -json=<file> : write the results to a JSON file\n");
+	printf(" -compare old.csv new.csv : compare two result files, and flag regressions beyond noise (exit code 1 if any)\n");
+	printf(" -tol=<t> : relative change of median time to be reported by -compare (default 0.05)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	int lmax[MAX_LIST] = {127, 255, 511};		int n_lmax = 3;
+	int mres[MAX_LIST] = {1};		int n_mres = 1;
+	int grid[MAX_LIST] = {0};		int n_grid = 1;
+	int layout[MAX_LIST] = {0};		int n_layout = 1;
+	int nth[MAX_LIST] = {0};		int n_nth = 1;
+	int kind[MAX_LIST] = {BENCH_SCAL, BENCH_VECT, BENCH_QST, BENCH_LTR};		int n_kind = BENCH_NKIND;
+	int warmup = 2,  trials = 7;
+	double mintime = 0.02,  tol = 0.05;
+	const char* fcsv = NULL;
+	const char* fjson = NULL;
+	FILE *fc = stdout,  *fj = NULL;
+	int nres = 0;
+
+	for (int i=1; i<argc; i++) {		// parse command line
+		char* a = argv[i];
+		char* v = strchr(a, '=');
+		if (v) v++;
+		if (strcmp(a, "-compare") == 0) {
+			if (i+2 >= argc) {  usage();  exit(1);  }
+			for (int j=i+3; j<argc; j++)	if (strncmp(argv[j], "-tol=", 5) == 0) tol = atof(argv[j]+5);
+			exit( compare(argv[i+1], argv[i+2], tol) > 0 );
+		}
+		else if (strncmp(a, "-lmax=", 6) == 0)	n_lmax = parse_int_list(v, lmax);
+		else if (strncmp(a, "-mres=", 6) == 0)	n_mres = parse_int_list(v, mres);
+		else if (strncmp(a, "-nth=", 5) == 0)	n_nth = parse_int_list(v, nth);
+		else if (strncmp(a, "-grid=", 6) == 0)	n_grid = parse_name_list(v, grid_name, sizeof(grid_flag)/sizeof(grid_flag[0]), grid);
+		else if (strncmp(a, "-layout=", 8) == 0)	n_layout = parse_name_list(v, layout_name, 3, layout);
+		else if (strncmp(a, "-transforms=", 12) == 0)	n_kind = parse_name_list(v, kind_name, BENCH_NKIND, kind);
+		else if (strncmp(a, "-warmup=", 8) == 0)	warmup = atoi(v);
+		else if (strncmp(a, "-trials=", 8) == 0)	trials = atoi(v);
+		else if (strncmp(a, "-mintime=", 9) == 0)	mintime = atof(v);
+		else if (strncmp(a, "-csv=", 5) == 0)	fcsv = v;
+		else if (strncmp(a, "-json=", 6) == 0)	fjson = v;
+		else if (strncmp(a, "-tol=", 5) == 0)	tol = atof(v);
+		else {  usage();  exit(1);  }
+	}
+	if (trials < 1) trials = 1;
+	if (trials > MAX_TRIALS) trials = MAX_TRIALS;
+
+	if (fcsv) {
+		fc = fopen(fcsv, "w");
+		if (fc == NULL) runerr("cannot open csv file");
+	}
+	if (fjson) {
+		fj = fopen(fjson, "w");
+		if (fj == NULL) runerr("cannot open json file");
+		fprintf(fj, "[\n");
+	}
+	fprintf(fc, "%s\n", csv_header);
+
+	for (int il=0; il<n_lmax; il++)
+	for (int ir=0; ir<n_mres; ir++)
+	for (int ig=0; ig<n_grid; ig++)
+	for (int iy=0; iy<n_layout; iy++)
+	for (int it=0; it<n_nth; it++) {
+		int lm = lmax[il];		int mr = mres[ir];
+		int need_vect = 0;
+		for (int k=0; k<n_kind; k++) if ((kind[k] == BENCH_VECT) || (kind[k] == BENCH_QST)) need_vect = 1;
+		int nlat = 0,  nphi = 0;
+		int flags = grid_flag[grid[ig]] | layout_flag[layout[iy]];
+		if (!need_vect) flags |= SHT_SCALAR_ONLY;
+
+		int nt = shtns_use_threads(nth[it]);
+		double t0 = wall_time();
+		shtns_cfg shtns = shtns_create(lm, lm/mr, mr, sht_orthonormal);
+		shtns_set_grid_auto(shtns, flags, 1.e-8, 0, &nlat, &nphi);
+		double t_init = wall_time() - t0;
+
+		long nspat = shtns->nspat;
+		Sh = shtns_malloc(nspat * sizeof(double));		Slm = shtns_malloc(shtns->nlm * sizeof(cplx));		Slm0 = shtns_malloc(shtns->nlm * sizeof(cplx));
+		Th = shtns_malloc(nspat * sizeof(double));		Tlm = shtns_malloc(shtns->nlm * sizeof(cplx));		Tlm0 = shtns_malloc(shtns->nlm * sizeof(cplx));
+		Qh = shtns_malloc(nspat * sizeof(double));		Qlm = shtns_malloc(shtns->nlm * sizeof(cplx));		Qlm0 = shtns_malloc(shtns->nlm * sizeof(cplx));
+		if ((Sh==0) || (Th==0) || (Qh==0) || (Slm0==0) || (Tlm0==0) || (Qlm0==0)) runerr("not enough memory");
+
+		for (int k=0; k<n_kind; k++) {
+			struct bench_res r;
+			r.lmax = lm;	r.mmax = shtns->mmax;	r.mres = mr;	r.nlat = shtns->nlat;	r.nphi = shtns->nphi;	r.nth = nt;
+			strcpy(r.grid, grid_name[grid[ig]]);		strcpy(r.layout, layout_name[layout[iy]]);
+			r.t_init = t_init;		r.alg[sizeof(r.alg)-1] = 0;
+			r.error = roundtrip_error(shtns, kind[k]);		// also initializes the input data.
+			for (int ana=0; ana<2; ana++) {
+				time_transform(shtns, kind[k], ana, warmup, trials, mintime, &r);
+				write_csv(fc, &r);		fflush(fc);
+				if (fj) write_json(fj, &r, nres==0);
+				nres++;
+			}
+		}
+		shtns_free(Sh);		shtns_free(Slm);	shtns_free(Slm0);
+		shtns_free(Th);		shtns_free(Tlm);	shtns_free(Tlm0);
+		shtns_free(Qh);		shtns_free(Qlm);	shtns_free(Qlm0);
+		shtns_destroy(shtns);
+	}
+
+	if (fj) {
+		fprintf(fj, "\n]\n");		fclose(fj);
+	}
+	if (fc != stdout) fclose(fc);
+	return 0;
+}
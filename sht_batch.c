@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ * 
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ * 
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ * 
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ * 
+ */
+
+
+/// \file sht_batch.c batched transforms: one Legendre recurrence applied to several fields at once.
+
+#include "sht_private.h"
+
+#define MTR MMAX
+#define SHT_VAR_LTR
+
+#define GEN(name,sfx) GLUE2(name,sfx)
+#define GEN3(name,nw,sfx) GLUE3(name,nw,sfx)
+
+// number of pairs of degrees l for which the ylm are stored before being applied to all fields (should fit in L1 cache).
+#define BATCH_LBLK 16
+
+#undef SUFFIX
+#define SUFFIX _l
+
+	#define NWAY 2
+	#include "SHT/spat_to_SH_batch.c"
+	#include "SHT/SH_to_spat_batch.c"
+	#include "SHT/spat_to_SHst_batch.c"
+	#include "SHT/SHst_to_spat_batch.c"
+	#undef NWAY
+
+
+void* fbatch[SHT_NTYP] = { SH_to_spat_batch2_l, spat_to_SH_batch2_l, SHsphtor_to_spat_batch2_l, spat_to_SHsphtor_batch2_l,
+		NULL, NULL, NULL, NULL };
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_cfgdb.c
+ * \brief Persistent store of the tuned algorithm choices (included by sht_init.c).
+ *
+ * The store is a binary file made of a header followed by fixed-size records, one per
+ * configuration key (sizes, grid, threads, requested flags, version, SIMD and cpu model).
+ * A record holds the index of the chosen algorithm for each transform variant and type, the
+ * tuned distribution of the work among threads (m scheduling and multi-shell mode), and the choice of the complex and fused transforms.
+ * - readers load the whole file at once, and need no lock: the file is only ever replaced atomically (rename).
+ * - writers are serialized by an fcntl() lock on "<path>.lock", merge their record with the current
+ *   content, write everything to a temporary file and rename it over the store. The fftw wisdom is
+ *   saved next to it ("<path>.fftw") in the same way.
+ * The store can be preloaded in memory (\ref shtns_cfg_preload), so that subsequent lookups do not touch the file system.
+ * The store does not use cfg_lock, except briefly for the fftw wisdom: cfgdb_mutex protects its path and preloaded copy,
+ * and the writers of this process are serialized by cfgdb_writer (fcntl locks belong to the process, not to the thread),
+ * so that waiting for another process does not block the creation of configs.
+ * The path is "shtns_cfg.db" in the current directory, unless changed by the SHTNS_CFG_PATH environment
+ * variable or by \ref shtns_cfg_path.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define CFGDB_MAGIC "SHTnsDB3"
+#define CFGDB_DEFAULT_PATH "shtns_cfg.db"
+#define CFGDB_NONE 255		// no algorithm for this transform
+
+struct cfgdb_key {
+	int lmax, mmax, mres, nphi, nlat, grid, nthreads, req_flags, nlorder;
+	char version[16];
+	char simd[16];
+	char cpu[64];
+};
+
+struct cfgdb_rec {
+	struct cfgdb_key key;
+	unsigned char alg[SHT_NVAR][SHT_NTYP];
+	short omp_msched, omp_shells;		// see shtns_info
+	unsigned cplx_fast, fused_sep;		// see shtns_info
+};
+
+struct cfgdb_header {
+	char magic[8];
+	int rec_size;		// sizeof(struct cfgdb_rec), also detects incompatible builds.
+	int nrec;
+};
+
+static char* cfgdb_path = NULL;				// user-defined path (NULL = default)
+static struct cfgdb_rec* cfgdb_mem = NULL;	// preloaded records (NULL = not preloaded)
+static int cfgdb_nmem = 0;
+static unsigned cfgdb_gen = 0;		// incremented when the path changes.
+static pthread_mutex_t cfgdb_mutex = PTHREAD_MUTEX_INITIALIZER;		// protects the 4 variables above (never held while waiting).
+static pthread_mutex_t cfgdb_writer = PTHREAD_MUTEX_INITIALIZER;		// one writer per process (taken before the fcntl lock).
+
+/// \internal returns a copy of the path of the config store (to be freed), and its generation in *gen if not NULL.
+static char* cfgdb_get_path(unsigned* gen)
+{
+	pthread_mutex_lock(&cfgdb_mutex);
+	const char* p = cfgdb_path;
+	if (p == NULL) {
+		p = getenv("SHTNS_CFG_PATH");
+		if ((p == NULL) || (p[0] == 0)) p = CFGDB_DEFAULT_PATH;
+	}
+	char* path = strdup(p);
+	if (gen) *gen = cfgdb_gen;
+	pthread_mutex_unlock(&cfgdb_mutex);
+	if (path == NULL) shtns_runerr("not enough memory.");
+	return path;
+}
+
+/// \internal returns a name identifying the processor model ("unknown" if not available).
+static const char* cfgdb_cpu_model()
+{
+	static char model[64] = "";
+	if (model[0] == 0) {
+		strcpy(model, "unknown");
+		FILE* f = fopen("/proc/cpuinfo", "r");
+		if (f) {
+			char line[256];
+			while (fgets(line, sizeof(line), f)) {
+				if (strncmp(line, "model name", 10) == 0) {
+					char* s = strchr(line, ':');
+					if (s) {
+						s++;	while (*s == ' ') s++;
+						s[strcspn(s, "\n")] = 0;
+						strncpy(model, s, sizeof(model)-1);
+					}
+					break;
+				}
+			}
+			fclose(f);
+		}
+	}
+	return model;
+}
+
+/// \internal fills the key identifying the given config.
+static void cfgdb_make_key(shtns_cfg shtns, int req_flags, struct cfgdb_key* key)
+{
+	memset(key, 0, sizeof(struct cfgdb_key));		// also clears padding, so that keys can be compared with memcmp.
+	key->lmax = shtns->lmax;		key->mmax = shtns->mmax;		key->mres = shtns->mres;
+	key->nphi = shtns->nphi;		key->nlat = shtns->nlat;		key->grid = shtns->grid;
+	key->nthreads = shtns->nthreads;		key->req_flags = req_flags;		key->nlorder = shtns->nlorder;
+	strncpy(key->version, PACKAGE_VERSION, sizeof(key->version)-1);
+	strncpy(key->simd, _SIMD_NAME_, sizeof(key->simd)-1);
+	memcpy(key->cpu, cfgdb_cpu_model(), sizeof(key->cpu)-1);		// cpu model is a zero-padded char[64].
+}
+
+/// \internal reads all records of a store in memory (returns the number of records, or -1 if no valid store).
+static int cfgdb_read(const char* path, struct cfgdb_rec** recs)
+{
+	struct cfgdb_header h;
+	int n = -1;
+	*recs = NULL;
+	FILE* f = fopen(path, "rb");
+	if (f == NULL) return -1;
+	if ((fread(&h, sizeof(h), 1, f) == 1) && (memcmp(h.magic, CFGDB_MAGIC, 8) == 0)
+		&& (h.rec_size == sizeof(struct cfgdb_rec)) && (h.nrec >= 0)) {
+		*recs = (struct cfgdb_rec*) malloc(sizeof(struct cfgdb_rec) * (h.nrec+1));		// +1 : room for a new record.
+		if ((*recs) && (fread(*recs, sizeof(struct cfgdb_rec), h.nrec, f) == h.nrec)) n = h.nrec;
+	}
+	fclose(f);
+	if ((n < 0) && (*recs)) {	free(*recs);	*recs = NULL;	}
+	return n;
+}
+
+/// \internal returns the record matching key, or NULL.
+static struct cfgdb_rec* cfgdb_find(struct cfgdb_rec* recs, int n, const struct cfgdb_key* key)
+{
+	for (int i=0; i<n; i++)
+		if (memcmp(&recs[i].key, key, sizeof(struct cfgdb_key)) == 0) return recs + i;
+	return NULL;
+}
+
+/// \internal write to a temporary file, then atomically replace path with it.
+static int cfgdb_write_atomic(const char* path, const struct cfgdb_rec* recs, int n)
+{
+	char tmp[strlen(path) + 32];
+	struct cfgdb_header h;
+	int ok;
+
+	sprintf(tmp, "%s.tmp%ld", path, (long) getpid());
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL) return -1;
+	memcpy(h.magic, CFGDB_MAGIC, 8);
+	h.rec_size = sizeof(struct cfgdb_rec);		h.nrec = n;
+	ok = (fwrite(&h, sizeof(h), 1, f) == 1) && (fwrite(recs, sizeof(struct cfgdb_rec), n, f) == n);
+	ok &= (fflush(f) == 0) && (fsync(fileno(f)) == 0);
+	ok &= (fclose(f) == 0);
+	if ((ok) && (rename(tmp, path) == 0)) return 0;
+	unlink(tmp);
+	return -1;
+}
+
+/// \internal take (F_WRLCK) the writer lock associated to path. Returns a file descriptor, to be passed to cfgdb_unlock, or -1.
+static int cfgdb_lock(const char* path)
+{
+	char lck[strlen(path) + 8];
+	struct flock fl;
+
+	sprintf(lck, "%s.lock", path);
+	int fd = open(lck, O_RDWR | O_CREAT, 0666);
+	if (fd < 0) return -1;
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = F_WRLCK;	fl.l_whence = SEEK_SET;		// lock the whole file
+	while (fcntl(fd, F_SETLKW, &fl) == -1) {
+		if (errno != EINTR) {	close(fd);	return -1;	}
+	}
+	return fd;
+}
+
+static void cfgdb_unlock(int fd)
+{
+	close(fd);		// releases the lock.
+}
+
+/// \internal loads the fftw wisdom saved along the store at path, if any.
+static void cfgdb_import_wisdom_path(const char* path)
+{
+	char wis[strlen(path) + 8];
+	sprintf(wis, "%s.fftw", path);
+	cfg_lock();		// fftw is not thread-safe.
+	fftw_import_wisdom_from_filename(wis);
+	cfg_unlock();
+}
+
+/// \internal loads the fftw wisdom saved along the store, unless already done by \ref shtns_cfg_preload.
+static void cfgdb_import_wisdom()
+{
+	pthread_mutex_lock(&cfgdb_mutex);
+	const int preloaded = (cfgdb_mem != NULL);
+	pthread_mutex_unlock(&cfgdb_mutex);
+	if (preloaded) return;
+	char* path = cfgdb_get_path(NULL);
+	cfgdb_import_wisdom_path(path);
+	free(path);
+}
+
+/// \internal saves config to the store for later restart.
+int config_save(shtns_cfg shtns, int req_flags)
+{
+	struct cfgdb_rec rec, *recs, *r;
+	int n, err = 0;
+
+	if (shtns->ct == NULL) return -1;		// no grid set
+
+	memset(&rec, 0, sizeof(rec));		// no uninitialized padding written to the file.
+	cfgdb_make_key(shtns, req_flags, &rec.key);
+	rec.omp_msched = shtns->omp_msched;		rec.omp_shells = shtns->omp_shells;
+	rec.cplx_fast = shtns->cplx_fast;		rec.fused_sep = shtns->fused_sep;
+	for (int iv=0; iv<SHT_NVAR; iv++) {
+		for (int it=0; it<SHT_NTYP; it++) {
+			rec.alg[iv][it] = CFGDB_NONE;
+			for (int ia=0; ia<SHT_NALG; ia++)
+				if ((shtns->ftable[iv][it]) && (sht_func[iv][ia][it] == shtns->ftable[iv][it])) {
+					rec.alg[iv][it] = ia;		break;
+				}
+		}
+	}
+
+	unsigned gen;
+	char* path = cfgdb_get_path(&gen);
+	pthread_mutex_lock(&cfgdb_writer);		// single writer (other threads)...
+	int fd = cfgdb_lock(path);		// ...and other processes.
+	if (fd < 0) err -= 8;
+
+	if (shtns->nphi > 1) {
+		char wis[strlen(path) + 8];
+		char tmp[strlen(path) + 32];
+		sprintf(wis, "%s.fftw", path);
+		sprintf(tmp, "%s.fftw.tmp%ld", path, (long) getpid());
+		cfg_lock();		// fftw is not thread-safe.
+		fftw_import_wisdom_from_filename(wis);		// merge with wisdom saved by others.
+		int ok = fftw_export_wisdom_to_filename(tmp);
+		cfg_unlock();
+		if ((ok) && (rename(tmp, wis) == 0)) {}
+		else {	unlink(tmp);	err -= 2;	}
+	}
+
+	n = cfgdb_read(path, &recs);
+	if (n < 0) {	n = 0;	recs = (struct cfgdb_rec*) malloc(sizeof(struct cfgdb_rec));	}
+	r = cfgdb_find(recs, n, &rec.key);
+	if (r == NULL) r = recs + (n++);
+	*r = rec;
+	if (cfgdb_write_atomic(path, recs, n) < 0) err -= 4;
+	if (fd >= 0) cfgdb_unlock(fd);
+	pthread_mutex_unlock(&cfgdb_writer);
+	free(path);
+
+	pthread_mutex_lock(&cfgdb_mutex);
+	if ((cfgdb_mem) && (gen == cfgdb_gen)) {		// keep the preloaded store up to date (unless the path has changed meanwhile).
+		free(cfgdb_mem);
+		cfgdb_mem = recs;	cfgdb_nmem = n;
+		recs = NULL;
+	}
+	pthread_mutex_unlock(&cfgdb_mutex);
+	if (recs) free(recs);
+
+	#if SHT_VERBOSE > 0
+		if (err < 0) fprintf(stderr,"! Warning ! SHTns could not save config\n");
+	#endif
+	return err;
+}
+
+/// \internal try to load config from the store (or its preloaded copy). Returns 1 if found, 0 if not found, <0 if no store.
+int config_load(shtns_cfg shtns, int req_flags)
+{
+	struct cfgdb_key key;
+	struct cfgdb_rec *recs, *r;
+	int n, found = 0;
+
+	if (shtns->ct == NULL) return -1;		// no grid set
+
+	if ((req_flags & 255) == sht_quick_init) req_flags += sht_gauss - sht_quick_init;		// quick_init uses gauss.
+	cfgdb_make_key(shtns, req_flags, &key);
+
+	pthread_mutex_lock(&cfgdb_mutex);
+	if (cfgdb_mem) {		// copy the record, the preloaded store may be replaced meanwhile.
+		r = cfgdb_find(cfgdb_mem, cfgdb_nmem, &key);
+		recs = (r) ? (struct cfgdb_rec*) malloc(sizeof(struct cfgdb_rec)) : NULL;
+		n = (recs != NULL);
+		if (recs) *recs = *r;
+		pthread_mutex_unlock(&cfgdb_mutex);
+	} else {
+		pthread_mutex_unlock(&cfgdb_mutex);
+		char* path = cfgdb_get_path(NULL);
+		n = cfgdb_read(path, &recs);
+		free(path);
+		if (n < 0) {
+			#if SHT_VERBOSE > 0
+				if (verbose) fprintf(stderr,"! Warning ! SHTns could not load config\n");
+			#endif
+			return -2;		// no valid store
+		}
+	}
+	r = cfgdb_find(recs, n, &key);
+	if (r) {
+		void* ft2[SHT_NVAR][SHT_NTYP];
+		for (int iv=0; iv<SHT_NVAR; iv++)
+			for (int it=0; it<SHT_NTYP; it++)
+				ft2[iv][it] = (r->alg[iv][it] < SHT_NALG) ? sht_func[iv][r->alg[iv][it]][it] : NULL;
+		#if SHT_VERBOSE > 0
+			if (verbose > 0) printf("        + using saved config\n");
+		#endif
+		#if SHT_VERBOSE > 1
+			if (verbose > 1) {
+				fprint_ftable(stdout, ft2);
+				printf("\n");
+			}
+		#endif
+		for (int iv=0; iv<SHT_NVAR; iv++)
+			for (int it=0; it<SHT_NTYP; it++)
+				if (ft2[iv][it]) shtns->ftable[iv][it] = ft2[iv][it];		// accept only non-null pointer
+		if ((r->omp_msched >= 0) && (r->omp_msched < MSCHED_N)) shtns->omp_msched = r->omp_msched;
+		if ((shtns->omp_msched == MSCHED_BALANCED) && (shtns->omp_mlist == NULL)) shtns->omp_msched = MSCHED_CYCLIC;
+		shtns->omp_shells = (r->omp_shells != 0);
+		shtns->cplx_fast = r->cplx_fast;		shtns->fused_sep = r->fused_sep;
+		found = 1;
+	}
+	if (recs) free(recs);
+	return found;
+}
+
+/* PUBLIC FUNCTIONS */
+
+/// Sets the path of the store used to save and load tuned configs (with the \ref SHT_LOAD_SAVE_CFG flag).
+/// NULL restores the default, which is given by the SHTNS_CFG_PATH environment variable, or "shtns_cfg.db" in the current directory.
+/// The fftw wisdom is saved to the same path with ".fftw" appended. Drops any preloaded store.
+void shtns_cfg_path(const char* path)
+{
+	pthread_mutex_lock(&cfgdb_mutex);
+	if (cfgdb_path) free(cfgdb_path);
+	cfgdb_path = (path) ? strdup(path) : NULL;
+	if (cfgdb_mem) free(cfgdb_mem);
+	cfgdb_mem = NULL;		cfgdb_nmem = 0;
+	cfgdb_gen++;
+	pthread_mutex_unlock(&cfgdb_mutex);
+}
+
+/// Loads the whole config store (and the fftw wisdom) in memory, so that subsequent initializations do not read the files.
+/// Returns the number of configs loaded, or -1 if no valid store was found.
+int shtns_cfg_preload()
+{
+	struct cfgdb_rec* recs;
+	unsigned gen;
+	char* path = cfgdb_get_path(&gen);
+	int n = cfgdb_read(path, &recs);
+	if (n >= 0) {
+		cfgdb_import_wisdom_path(path);
+		pthread_mutex_lock(&cfgdb_mutex);
+		if (gen == cfgdb_gen) {		// the path was not changed meanwhile.
+			if (cfgdb_mem) free(cfgdb_mem);
+			cfgdb_mem = recs;		cfgdb_nmem = n;
+			recs = NULL;
+		}
+		pthread_mutex_unlock(&cfgdb_mutex);
+		if (recs) free(recs);
+	}
+	free(path);
+	return n;
+}
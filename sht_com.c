@@ -126,6 +126,78 @@ void SHsph_to_spat_ml(shtns_cfg shtns, int im, cplx *Slm, cplx *Vt, cplx *Vp, in
 }
 
 
+/* legendre transforms between spectral and fourier space for a list of orders (no fft).
+   The orders are distributed among threads, each transform then uses a single thread
+   (the threaded SHT_M kernels detect that they run in a parallel region). */
+
+void SH_to_fourier(shtns_cfg shtns, int nm, const int *im_list, cplx *Qlm, cplx *Vr, int ltr) {
+	pf2ml f = (pf2ml) shtns->ftable[SHT_M][SHT_TYP_SSY];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		f(shtns, im, Qlm + LiM(shtns, im*MRES, im), Vr + i*NLAT, ltr);
+	}
+}
+
+void fourier_to_SH(shtns_cfg shtns, int nm, const int *im_list, cplx *Vr, cplx *Qlm, int ltr) {
+	pf2ml f = (pf2ml) shtns->ftable[SHT_M][SHT_TYP_SAN];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		f(shtns, im, Vr + i*NLAT, Qlm + LiM(shtns, im*MRES, im), ltr);
+	}
+}
+
+/* former names of the scalar transforms above, kept for compatibility. */
+
+void SH_to_spat_ml_batch(shtns_cfg shtns, int nm, const int *im_list, cplx *Qlm, cplx *Vr, int ltr) {
+	SH_to_fourier(shtns, nm, im_list, Qlm, Vr, ltr);
+}
+
+void spat_to_SH_ml_batch(shtns_cfg shtns, int nm, const int *im_list, cplx *Vr, cplx *Qlm, int ltr) {
+	fourier_to_SH(shtns, nm, im_list, Vr, Qlm, ltr);
+}
+
+void SHsphtor_to_fourier(shtns_cfg shtns, int nm, const int *im_list, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, int ltr) {
+	pf4ml f = (pf4ml) shtns->ftable[SHT_M][SHT_TYP_VSY];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		const long lm = LiM(shtns, im*MRES, im);
+		f(shtns, im, Slm + lm, Tlm + lm, Vt + i*NLAT, Vp + i*NLAT, ltr);
+	}
+}
+
+void fourier_to_SHsphtor(shtns_cfg shtns, int nm, const int *im_list, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, int ltr) {
+	pf4ml f = (pf4ml) shtns->ftable[SHT_M][SHT_TYP_VAN];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		const long lm = LiM(shtns, im*MRES, im);
+		f(shtns, im, Vt + i*NLAT, Vp + i*NLAT, Slm + lm, Tlm + lm, ltr);
+	}
+}
+
+void SHqst_to_fourier(shtns_cfg shtns, int nm, const int *im_list, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, int ltr) {
+	pf6ml f = (pf6ml) shtns->ftable[SHT_M][SHT_TYP_3SY];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		const long lm = LiM(shtns, im*MRES, im);
+		f(shtns, im, Qlm + lm, Slm + lm, Tlm + lm, Vr + i*NLAT, Vt + i*NLAT, Vp + i*NLAT, ltr);
+	}
+}
+
+void fourier_to_SHqst(shtns_cfg shtns, int nm, const int *im_list, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, int ltr) {
+	pf6ml f = (pf6ml) shtns->ftable[SHT_M][SHT_TYP_3AN];
+	#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (int i=0; i<nm; i++) {
+		const int im = im_list[i];
+		const long lm = LiM(shtns, im*MRES, im);
+		f(shtns, im, Vr + i*NLAT, Vt + i*NLAT, Vp + i*NLAT, Qlm + lm, Slm + lm, Tlm + lm, ltr);
+	}
+}
+
 /* successive scalar + vector for 3D transform (can be faster than simultaneous transform) */
 static
 void SHqst_to_spat_2(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, double *Vr, double *Vt, double *Vp) {
@@ -166,6 +238,103 @@ void spat_to_SHqst_2ml(shtns_cfg shtns, int im, cplx *Vr, cplx *Vt, cplx *Vp, cp
 }
 
 
+/* batched transforms (several independent fields sharing the Legendre recurrence) */
+
+extern void* fbatch[SHT_NTYP];
+
+/// returns 1 if the batched algorithm can be used for the given transform type, 0 otherwise (then use the single-field transforms).
+static int batch_supported(shtns_cfg shtns, int typ)
+{
+	if ((shtns->nphi == 1) || (shtns->nlat_2 < 2*VSIZE2)) return 0;		// axisymmetric or too few latitudes for NWAY=2.
+	if ((typ & 1) && (shtns->wg == NULL)) return 0;		// no on-the-fly analysis for regular grids.
+	return 1;
+}
+
+void SH_to_spat_batch(shtns_cfg shtns, int nfields, cplx **Qlm, double **Vr) {
+	if (batch_supported(shtns, SHT_TYP_SSY)) {
+		((pf2ml)fbatch[SHT_TYP_SSY])(shtns, nfields, Qlm, Vr, shtns->lmax);
+	} else for (int f=0; f<nfields; f++) SH_to_spat(shtns, Qlm[f], Vr[f]);
+}
+
+void spat_to_SH_batch(shtns_cfg shtns, int nfields, double **Vr, cplx **Qlm) {
+	if (batch_supported(shtns, SHT_TYP_SAN)) {
+		((pf2ml)fbatch[SHT_TYP_SAN])(shtns, nfields, Vr, Qlm, shtns->lmax);
+	} else for (int f=0; f<nfields; f++) spat_to_SH(shtns, Vr[f], Qlm[f]);
+}
+
+void SHsphtor_to_spat_batch(shtns_cfg shtns, int nfields, cplx **Slm, cplx **Tlm, double **Vt, double **Vp) {
+	if (batch_supported(shtns, SHT_TYP_VSY)) {
+		((pf4ml)fbatch[SHT_TYP_VSY])(shtns, nfields, Slm, Tlm, Vt, Vp, shtns->lmax);
+	} else for (int f=0; f<nfields; f++) SHsphtor_to_spat(shtns, Slm[f], Tlm[f], Vt[f], Vp[f]);
+}
+
+void spat_to_SHsphtor_batch(shtns_cfg shtns, int nfields, double **Vt, double **Vp, cplx **Slm, cplx **Tlm) {
+	if (batch_supported(shtns, SHT_TYP_VAN)) {
+		((pf4ml)fbatch[SHT_TYP_VAN])(shtns, nfields, Vt, Vp, Slm, Tlm, shtns->lmax);
+	} else for (int f=0; f<nfields; f++) spat_to_SHsphtor(shtns, Vt[f], Vp[f], Slm[f], Tlm[f]);
+}
+
+
+/* multi-shell transforms (independent fields stored with a constant stride, e.g. the radial levels of a spherical shell) */
+
+/// returns 1 if the nr shells should be distributed among threads (each one using the single-thread transform fseq[typ]),
+/// 0 if they are transformed one after the other (each one using all threads).
+static int shells_par(shtns_cfg shtns, int nr, int typ)
+{
+  #ifdef _OPENMP
+	return (shtns->omp_shells) && (shtns->nthreads > 1) && (nr > 1) && (shtns->fseq[typ] != NULL);
+  #else
+	return 0;
+  #endif
+}
+
+void SH_to_spat_shells(shtns_cfg shtns, int nr, cplx *Qlm, long lm_stride, double *Vr, long spat_stride) {
+	if (shells_par(shtns, nr, SHT_TYP_SSY)) {
+		pf2l f = (pf2l) shtns->fseq[SHT_TYP_SSY];
+		#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads)
+		for (int ir=0; ir<nr; ir++)	f(shtns, Qlm + ir*lm_stride, Vr + ir*spat_stride, shtns->lmax);
+	} else for (int ir=0; ir<nr; ir++) SH_to_spat(shtns, Qlm + ir*lm_stride, Vr + ir*spat_stride);
+}
+
+void spat_to_SH_shells(shtns_cfg shtns, int nr, double *Vr, long spat_stride, cplx *Qlm, long lm_stride) {
+	if (shells_par(shtns, nr, SHT_TYP_SAN)) {
+		pf2l f = (pf2l) shtns->fseq[SHT_TYP_SAN];
+		#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads)
+		for (int ir=0; ir<nr; ir++)	f(shtns, Vr + ir*spat_stride, Qlm + ir*lm_stride, shtns->lmax);
+	} else for (int ir=0; ir<nr; ir++) spat_to_SH(shtns, Vr + ir*spat_stride, Qlm + ir*lm_stride);
+}
+
+void SHqst_to_spat_shells(shtns_cfg shtns, int nr, cplx *Qlm, cplx *Slm, cplx *Tlm, long lm_stride,
+							double *Vr, double *Vt, double *Vp, long spat_stride) {
+	if (shells_par(shtns, nr, SHT_TYP_3SY)) {
+		pf6l f = (pf6l) shtns->fseq[SHT_TYP_3SY];
+		#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads)
+		for (int ir=0; ir<nr; ir++) {
+			const long i = ir*lm_stride;		const long j = ir*spat_stride;
+			f(shtns, Qlm+i, Slm+i, Tlm+i, Vr+j, Vt+j, Vp+j, shtns->lmax);
+		}
+	} else for (int ir=0; ir<nr; ir++) {
+		const long i = ir*lm_stride;		const long j = ir*spat_stride;
+		SHqst_to_spat(shtns, Qlm+i, Slm+i, Tlm+i, Vr+j, Vt+j, Vp+j);
+	}
+}
+
+void spat_to_SHqst_shells(shtns_cfg shtns, int nr, double *Vr, double *Vt, double *Vp, long spat_stride,
+							cplx *Qlm, cplx *Slm, cplx *Tlm, long lm_stride) {
+	if (shells_par(shtns, nr, SHT_TYP_3AN)) {
+		pf6l f = (pf6l) shtns->fseq[SHT_TYP_3AN];
+		#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads)
+		for (int ir=0; ir<nr; ir++) {
+			const long i = ir*lm_stride;		const long j = ir*spat_stride;
+			f(shtns, Vr+j, Vt+j, Vp+j, Qlm+i, Slm+i, Tlm+i, shtns->lmax);
+		}
+	} else for (int ir=0; ir<nr; ir++) {
+		const long i = ir*lm_stride;		const long j = ir*spat_stride;
+		spat_to_SHqst(shtns, Vr+j, Vt+j, Vp+j, Qlm+i, Slm+i, Tlm+i);
+	}
+}
+
+
 #if defined(SHT_F77_API)
 
 /*  Fortran 77 api  */
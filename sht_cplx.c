@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ * 
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ * 
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ * 
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ * 
+ */
+
+/// \file sht_cplx.c native transforms of complex-valued fields: one Legendre recurrence shared by the orders m and -m, and one complex fft.
+
+#include <string.h>
+#include "sht_private.h"
+
+#define MTR MMAX
+#define SHT_VAR_LTR
+
+#define GEN(name,sfx) GLUE2(name,sfx)
+#define GEN3(name,nw,sfx) GLUE3(name,nw,sfx)
+
+#undef SUFFIX
+#define SUFFIX _l
+
+	#define NWAY 1
+	#include "SHT/spat_to_SHst_cplx.c"
+	#include "SHT/SHst_to_spat_cplx.c"
+	#undef NWAY
+	#define NWAY 2
+	#include "SHT/spat_to_SH_cplx.c"
+	#include "SHT/SH_to_spat_cplx.c"
+	#include "SHT/spat_to_SHst_cplx.c"
+	#include "SHT/SHst_to_spat_cplx.c"
+	#undef NWAY
+	#define NWAY 3
+	#include "SHT/spat_to_SH_cplx.c"
+	#include "SHT/SH_to_spat_cplx.c"
+	#include "SHT/spat_to_SHst_cplx.c"
+	#include "SHT/SHst_to_spat_cplx.c"
+	#undef NWAY
+	#define NWAY 4
+	#include "SHT/spat_to_SH_cplx.c"
+	#include "SHT/SH_to_spat_cplx.c"
+	#undef NWAY
+	#define NWAY 6
+	#include "SHT/spat_to_SH_cplx.c"
+	#include "SHT/SH_to_spat_cplx.c"
+	#undef NWAY
+	#define NWAY 8
+	#include "SHT/spat_to_SH_cplx.c"
+	#include "SHT/SH_to_spat_cplx.c"
+	#undef NWAY
+
+/// same layout as ffly (sht_fly.c), so that the block size tuned for the real transforms can be reused.
+void* fcplx[6][SHT_NTYP] = {
+	{ NULL, NULL, SHsphtor_to_spat_cplx1_l, spat_cplx_to_SHsphtor1_l,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_cplx2_l, spat_cplx_to_SH2_l, SHsphtor_to_spat_cplx2_l, spat_cplx_to_SHsphtor2_l,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_cplx3_l, spat_cplx_to_SH3_l, SHsphtor_to_spat_cplx3_l, spat_cplx_to_SHsphtor3_l,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_cplx4_l, spat_cplx_to_SH4_l, NULL, NULL,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_cplx6_l, spat_cplx_to_SH6_l, NULL, NULL,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_cplx8_l, spat_cplx_to_SH8_l, NULL, NULL,
+		NULL, NULL, NULL, NULL }
+};
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_float.c
+ * \brief Single precision (float) transforms.
+ * The Legendre recurrence and the summations over l are done in double precision, one order m at a time, by the
+ * fixed-m kernels (the same as \ref SH_to_fourier). The spectral coefficients of one order and its Fourier coefficients
+ * are converted on the fly to (or from) small per-thread double buffers that stay in cache, so that the arrays of the size
+ * of the grid (the spatial fields, and the Fourier coefficients on which the fft works) are only read or written as float.
+ * The fft is performed in single precision (if fftw3f is available).
+ */
+
+static void float_to_double(const float* f, double* d, size_t n)
+{
+	for (size_t i=0; i<n; i++) d[i] = f[i];
+}
+
+static void double_to_float(const double* d, float* f, size_t n)
+{
+	for (size_t i=0; i<n; i++) f[i] = d[i];
+}
+
+#ifdef SHT_FLOAT_FFT
+/* Layout of the float Fourier coefficients F (one array of nlat*nphi/2 complex floats per field, or nlat*(nphi/2+1) for odd nlat):
+ * for even nlat, the latitudes are taken by pairs (it=2j and 2j+1) as the real and imaginary parts of nlat/2 complex sequences,
+ * whose complex fft gives the coefficients m and -m (nphi-m) of both latitudes. This is the layout used by the complex ffts of the
+ * on-the-fly kernels (faster than real ffts). The element (m,j) is at F[m*nlat/2 + j], except for the analysis with phi-contiguous
+ * data, where it is at F[j*nphi + m] (split dft without transpose). For odd nlat, real ffts are used, with F[m*nlat + it].
+ * With latitudes contiguous and even nlat, F is the spatial array itself and the ffts are done in place (much faster),
+ * so that the analysis overwrites its input, as the double precision one.
+ */
+
+/// \internal true if the float ffts are done in place, in the spatial arrays.
+static int float_fft_inplace(shtns_cfg shtns)
+{
+	return !(NLAT & 1) && !(shtns->layout & SHT_PHI_CONTIGUOUS);
+}
+
+/// \internal plan the single precision ffts for the layout of F described above.
+static void plan_float_fft(shtns_cfg shtns)
+{
+	fftwf_plan fft, ifft;
+	int nfft = NPHI;
+	const unsigned plan_mode = (shtns->fftw_plan_mode & FFTW_ESTIMATE) ? FFTW_ESTIMATE : FFTW_MEASURE;		// planned on first use: avoid lengthy searches.
+
+	float* F = (float*) VMALLOC(NLAT*(NPHI+2)*sizeof(float));		// dummy arrays for planning.
+	float* S = (float*) VMALLOC(shtns->nspat*sizeof(float));		// large enough for nlat*nphi/2 complex floats.
+	#ifdef OMP_FFTWF
+		fftwf_plan_with_nthreads(shtns->nthreads);
+	#endif
+
+	if (NLAT & 1) {		// real ffts
+		int ncplx = NPHI/2 +1;
+		int theta_inc=1,  phi_inc=NLAT;
+		if (shtns->layout & SHT_PHI_CONTIGUOUS)	{	phi_inc=1;  theta_inc=NPHI;	}
+		fft = fftwf_plan_many_dft_r2c(1, &nfft, NLAT, S, &nfft, phi_inc, theta_inc, (fftwf_complex*) F, &ncplx, NLAT, 1, plan_mode);
+		ifft = fftwf_plan_many_dft_c2r(1, &nfft, NLAT, (fftwf_complex*) F, &ncplx, NLAT, 1, S, &nfft, phi_inc, theta_inc, plan_mode);
+	} else if (shtns->layout & SHT_PHI_CONTIGUOUS) {		// split dft (same as planFFT)
+		fftwf_iodim dim, many;
+		dim.n = NPHI;    	dim.is = 1;			dim.os = 2;
+		many.n = NLAT/2;	many.is = 2*NPHI;	many.os = 2*NPHI;
+		fft = fftwf_plan_guru_split_dft(1, &dim, 1, &many, S+NPHI, S, F+1, F, plan_mode);
+		dim.n = NPHI;    	dim.os = 1;			dim.is = NLAT;
+		many.n = NLAT/2;	many.os = 2*NPHI;	many.is = 2;
+		ifft = fftwf_plan_guru_split_dft(1, &dim, 1, &many, F+1, F, S+NPHI, S, plan_mode);
+	} else {		// in-place (the same transform, with m>0 and m<0 exchanged; two plans so that each can be destroyed).
+		fft = fftwf_plan_many_dft(1, &nfft, NLAT/2, (fftwf_complex*) S, &nfft, NLAT/2, 1, (fftwf_complex*) S, &nfft, NLAT/2, 1, FFTW_BACKWARD, plan_mode);
+		ifft = fftwf_plan_many_dft(1, &nfft, NLAT/2, (fftwf_complex*) S, &nfft, NLAT/2, 1, (fftwf_complex*) S, &nfft, NLAT/2, 1, FFTW_BACKWARD, plan_mode);
+	}
+	VFREE(S);		VFREE(F);
+	if ((fft == NULL) || (ifft == NULL)) shtns_runerr("[FFTW] float fft planning failed !");
+	shtns->fftf = fft;
+	__atomic_store_n(&shtns->ifftf, ifft, __ATOMIC_RELEASE);		// set last, marks the plans as ready (see float_fft_ready).
+}
+
+/// \internal make sure the float ffts have been planned (only once, even if called concurrently by several threads).
+static void float_fft_ready(shtns_cfg shtns)
+{
+	if ((NPHI > 1) && (__atomic_load_n(&shtns->ifftf, __ATOMIC_ACQUIRE) == NULL)) {
+		cfg_lock();
+		if (shtns->ifftf == NULL) plan_float_fft(shtns);
+		cfg_unlock();
+	}
+}
+
+/// \internal number of complex floats of F for one field.
+static long float_fourier_size(shtns_cfg shtns)
+{
+	return (NLAT & 1) ? NLAT*(NPHI/2+1) : (NLAT/2)*NPHI;
+}
+
+/// \internal stores the Fourier coefficients Vm of order im (nlat complex doubles, as given by the fixed-m synthesis) in F,
+/// or zeros if Vm is NULL.
+static void float_fourier_store(shtns_cfg shtns, int im, const cplx* Vm, cplxf* F)
+{
+	if (NLAT & 1) {
+		cplxf* Fm = F + im*NLAT;
+		for (int it=0; it<NLAT; it++)	Fm[it] = (Vm) ? Vm[it] : 0;
+		return;
+	}
+	const int nt2 = NLAT/2;
+	cplxf* Fp = F + im*nt2;		// m
+	cplxf* Fn = F + (NPHI-im)*nt2;		// -m
+	if (Vm == NULL) {
+		memset(Fp, 0, nt2*sizeof(cplxf));
+		if (im > 0) memset(Fn, 0, nt2*sizeof(cplxf));
+	} else if (im == 0) {
+		for (int j=0; j<nt2; j++)	Fp[j] = creal(Vm[2*j]) + I*creal(Vm[2*j+1]);
+	} else {
+		for (int j=0; j<nt2; j++) {
+			const cplx a = Vm[2*j];		const cplx b = Vm[2*j+1];
+			Fp[j] = a + I*b;		Fn[j] = conj(a) + I*conj(b);
+		}
+	}
+}
+
+/// \internal loads the Fourier coefficients of order im from F (as computed by the float fft of the analysis) to Vm,
+/// normalized for the fixed-m analysis.
+static void float_fourier_load(shtns_cfg shtns, int im, const cplxf* F, cplx* Vm)
+{
+	const double nphi_1 = 1.0/NPHI;		// the fft is not normalized.
+	if (NLAT & 1) {
+		const cplxf* Fm = F + im*NLAT;
+		for (int it=0; it<NLAT; it++)	Vm[it] = Fm[it] * nphi_1;
+		return;
+	}
+	const int nt2 = NLAT/2;
+	long ms = nt2,  js = 1;		// strides of m and j.
+	if (shtns->layout & SHT_PHI_CONTIGUOUS)	{	ms = 1;  js = NPHI;	}
+	const cplxf* Fp = F + im*ms;
+	const cplxf* Fn = F + ((NPHI-im) % NPHI)*ms;
+	for (int j=0; j<nt2; j++) {		// the backward fft gives conj(V_m) for m, and V_m for -m.
+		const cplx a = conj(Fp[j*js]);		const cplx b = Fn[j*js];
+		Vm[2*j] = (0.5*nphi_1) * (b + a);
+		Vm[2*j+1] = (-0.5*I*nphi_1) * (b - a);
+	}
+}
+
+/// \internal synthesis of nf fields (1: scalar, 2: spheroidal/toroidal, 3: qst) with transform type typ.
+static void float_synth(shtns_cfg shtns, int typ, int nf, cplxf** Xlm, float** V)
+{
+	const long nfr = float_fourier_size(shtns);
+	void* fm = shtns->ftable[SHT_M][typ];
+	cplxf* F[3] = { NULL, NULL, NULL };		// float Fourier coefficients of each field.
+
+	float_fft_ready(shtns);
+	if (NPHI > 1) {
+		cplxf* buf = (float_fft_inplace(shtns)) ? NULL : (cplxf*) shtns_scratch(SCRATCH_FLOAT, nf*nfr*sizeof(cplxf));
+		for (int f=0; f<nf; f++)	F[f] = (buf) ? buf + f*nfr : (cplxf*) V[f];
+	}
+	#pragma omp parallel num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	{
+		cplx *Ql[3], *Vm[3];		// spectral and Fourier coefficients of one order, for each field.
+		const long nl = (LMAX+2 + 7) & ~7L;		// keep the buffers vector-aligned (required by the kernels).
+		const long nt = (NLAT + 7) & ~7L;
+		cplx* buf = (cplx*) shtns_scratch(SCRATCH_FLOAT_M, nf*(nl + nt)*sizeof(cplx));
+		for (int f=0; f<nf; f++) {
+			Vm[f] = buf + f*nt;
+			Ql[f] = buf + nf*nt + f*nl;
+		}
+		#pragma omp for schedule(dynamic)
+		for (int im=0; im <= NPHI/2; im++) {
+			if (im > MMAX) {		// padding for high m's.
+				for (int f=0; f<nf; f++)	float_fourier_store(shtns, im, NULL, F[f]);
+				continue;
+			}
+			const long lm = LiM(shtns, im*MRES, im);
+			for (int f=0; f<nf; f++)	float_to_double((float*) (Xlm[f] + lm), (double*) Ql[f], 2*(LMAX+1 - im*MRES));
+			switch(typ) {
+				case SHT_TYP_SSY :	((pf2ml)fm)(shtns, im, Ql[0], Vm[0], LMAX);	break;
+				case SHT_TYP_VSY :	((pf4ml)fm)(shtns, im, Ql[0], Ql[1], Vm[0], Vm[1], LMAX);	break;
+				case SHT_TYP_3SY :	((pf6ml)fm)(shtns, im, Ql[0], Ql[1], Ql[2], Vm[0], Vm[1], Vm[2], LMAX);	break;
+			}
+			for (int f=0; f<nf; f++) {
+				if (F[f])	float_fourier_store(shtns, im, Vm[f], F[f]);
+				else	for (int it=0; it<NLAT; it++) V[f][it] = creal(Vm[f][it]);		// axisymmetric: no fft.
+			}
+		}
+	}
+	for (int f=0; (f<nf) && (F[f]); f++) {
+		float* Ff = (float*) F[f];
+		if (NLAT & 1)	fftwf_execute_dft_c2r(shtns->ifftf, (fftwf_complex*) Ff, V[f]);
+		else if (shtns->layout & SHT_PHI_CONTIGUOUS)	fftwf_execute_split_dft(shtns->ifftf, Ff+1, Ff, V[f]+NPHI, V[f]);
+		else	fftwf_execute_dft(shtns->ifftf, (fftwf_complex*) Ff, (fftwf_complex*) V[f]);
+	}
+}
+
+/// \internal analysis of nf fields (1: scalar, 2: spheroidal/toroidal, 3: qst) with transform type typ.
+static void float_anal(shtns_cfg shtns, int typ, int nf, float** V, cplxf** Xlm)
+{
+	const long nfr = float_fourier_size(shtns);
+	void* fm = shtns->ftable[SHT_M][typ];
+	cplxf* F[3] = { NULL, NULL, NULL };		// float Fourier coefficients of each field.
+
+	float_fft_ready(shtns);
+	if (NPHI > 1) {
+		cplxf* buf = (float_fft_inplace(shtns)) ? NULL : (cplxf*) shtns_scratch(SCRATCH_FLOAT, nf*nfr*sizeof(cplxf));
+		for (int f=0; f<nf; f++)	F[f] = (buf) ? buf + f*nfr : (cplxf*) V[f];
+	}
+	for (int f=0; (f<nf) && (F[f]); f++) {
+		float* Ff = (float*) F[f];
+		if (NLAT & 1)	fftwf_execute_dft_r2c(shtns->fftf, V[f], (fftwf_complex*) Ff);
+		else if (shtns->layout & SHT_PHI_CONTIGUOUS)	fftwf_execute_split_dft(shtns->fftf, V[f]+NPHI, V[f], Ff+1, Ff);
+		else	fftwf_execute_dft(shtns->fftf, (fftwf_complex*) V[f], (fftwf_complex*) Ff);
+	}
+	#pragma omp parallel num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	{
+		cplx *Ql[3], *Vm[3];		// spectral and Fourier coefficients of one order, for each field.
+		const long nl = (LMAX+2 + 7) & ~7L;		// keep the buffers vector-aligned (required by the kernels).
+		const long nt = (NLAT + 7) & ~7L;
+		cplx* buf = (cplx*) shtns_scratch(SCRATCH_FLOAT_M, nf*(nl + nt)*sizeof(cplx));
+		for (int f=0; f<nf; f++) {
+			Vm[f] = buf + f*nt;
+			Ql[f] = buf + nf*nt + f*nl;
+		}
+		#pragma omp for schedule(dynamic)
+		for (int im=0; im <= MMAX; im++) {
+			for (int f=0; f<nf; f++) {
+				if (F[f])	float_fourier_load(shtns, im, F[f], Vm[f]);
+				else	for (int it=0; it<NLAT; it++) Vm[f][it] = V[f][it];		// axisymmetric: no fft.
+			}
+			switch(typ) {
+				case SHT_TYP_SAN :	((pf2ml)fm)(shtns, im, Vm[0], Ql[0], LMAX);	break;
+				case SHT_TYP_VAN :	((pf4ml)fm)(shtns, im, Vm[0], Vm[1], Ql[0], Ql[1], LMAX);	break;
+				case SHT_TYP_3AN :	((pf6ml)fm)(shtns, im, Vm[0], Vm[1], Vm[2], Ql[0], Ql[1], Ql[2], LMAX);	break;
+			}
+			const long lm = LiM(shtns, im*MRES, im);
+			for (int f=0; f<nf; f++)	double_to_float((double*) Ql[f], (float*) (Xlm[f] + lm), 2*(LMAX+1 - im*MRES));
+		}
+	}
+}
+
+#else
+/* without fftw3f, the double precision transforms are used on converted copies of the data. */
+
+/// \internal synthesis of nf fields (1: scalar, 2: spheroidal/toroidal, 3: qst) with transform type typ.
+static void float_synth(shtns_cfg shtns, int typ, int nf, cplxf** Xlm, float** V)
+{
+	const size_t nlm2 = (2*NLM + 15) & ~((size_t) 15);		// doubles per spectral field.
+	const size_t ns = (shtns->nspat + 15) & ~((size_t) 15);
+	cplx* Q[3];
+	double* B[3];
+
+	double* buf = (double*) shtns_scratch(SCRATCH_FLOAT, nf*(nlm2 + ns)*sizeof(double));
+	for (int f=0; f<nf; f++) {
+		Q[f] = (cplx*) (buf + f*nlm2);
+		B[f] = buf + nf*nlm2 + f*ns;
+		float_to_double((float*) Xlm[f], (double*) Q[f], 2*NLM);
+	}
+	switch(typ) {
+		case SHT_TYP_SSY :	((pf2l)shtns->ftable[SHT_STD][typ])(shtns, Q[0], B[0], LMAX);	break;
+		case SHT_TYP_VSY :	((pf4l)shtns->ftable[SHT_STD][typ])(shtns, Q[0], Q[1], B[0], B[1], LMAX);	break;
+		case SHT_TYP_3SY :	((pf6l)shtns->ftable[SHT_STD][typ])(shtns, Q[0], Q[1], Q[2], B[0], B[1], B[2], LMAX);	break;
+	}
+	for (int f=0; f<nf; f++)	double_to_float(B[f], V[f], shtns->nspat);
+}
+
+/// \internal analysis of nf fields (1: scalar, 2: spheroidal/toroidal, 3: qst) with transform type typ.
+static void float_anal(shtns_cfg shtns, int typ, int nf, float** V, cplxf** Xlm)
+{
+	const size_t nlm2 = (2*NLM + 15) & ~((size_t) 15);		// doubles per spectral field.
+	const size_t ns = (shtns->nspat + 15) & ~((size_t) 15);
+	cplx* Q[3];
+	double* B[3];
+
+	double* buf = (double*) shtns_scratch(SCRATCH_FLOAT, nf*(nlm2 + ns)*sizeof(double));
+	for (int f=0; f<nf; f++) {
+		Q[f] = (cplx*) (buf + f*nlm2);
+		B[f] = buf + nf*nlm2 + f*ns;
+		float_to_double(V[f], B[f], shtns->nspat);
+	}
+	switch(typ) {
+		case SHT_TYP_SAN :	((pf2l)shtns->ftable[SHT_STD][typ])(shtns, B[0], Q[0], LMAX);	break;
+		case SHT_TYP_VAN :	((pf4l)shtns->ftable[SHT_STD][typ])(shtns, B[0], B[1], Q[0], Q[1], LMAX);	break;
+		case SHT_TYP_3AN :	((pf6l)shtns->ftable[SHT_STD][typ])(shtns, B[0], B[1], B[2], Q[0], Q[1], Q[2], LMAX);	break;
+	}
+	for (int f=0; f<nf; f++)	double_to_float((double*) Q[f], (float*) Xlm[f], 2*NLM);
+}
+#endif
+
+/* single precision transforms */
+
+void SH_to_spatf(shtns_cfg shtns, cplxf *Qlm, float *Vr) {
+	float_synth(shtns, SHT_TYP_SSY, 1, &Qlm, &Vr);
+}
+
+void spat_to_SHf(shtns_cfg shtns, float *Vr, cplxf *Qlm) {
+	float_anal(shtns, SHT_TYP_SAN, 1, &Vr, &Qlm);
+}
+
+void SHsphtor_to_spatf(shtns_cfg shtns, cplxf *Slm, cplxf *Tlm, float *Vt, float *Vp) {
+	cplxf* Xlm[2] = { Slm, Tlm };
+	float* V[2] = { Vt, Vp };
+	float_synth(shtns, SHT_TYP_VSY, 2, Xlm, V);
+}
+
+void spat_to_SHsphtorf(shtns_cfg shtns, float *Vt, float *Vp, cplxf *Slm, cplxf *Tlm) {
+	cplxf* Xlm[2] = { Slm, Tlm };
+	float* V[2] = { Vt, Vp };
+	float_anal(shtns, SHT_TYP_VAN, 2, V, Xlm);
+}
+
+void SHqst_to_spatf(shtns_cfg shtns, cplxf *Qlm, cplxf *Slm, cplxf *Tlm, float *Vr, float *Vt, float *Vp) {
+	cplxf* Xlm[3] = { Qlm, Slm, Tlm };
+	float* V[3] = { Vr, Vt, Vp };
+	float_synth(shtns, SHT_TYP_3SY, 3, Xlm, V);
+}
+
+void spat_to_SHqstf(shtns_cfg shtns, float *Vr, float *Vt, float *Vp, cplxf *Qlm, cplxf *Slm, cplxf *Tlm) {
+	cplxf* Xlm[3] = { Qlm, Slm, Tlm };
+	float* V[3] = { Vr, Vt, Vp };
+	float_anal(shtns, SHT_TYP_3AN, 3, V, Xlm);
+}
@@ -204,3 +204,21 @@ void* ffly_m[6][SHT_NTYP] = {
 	{ SH_m_to_spat_fly8_l, spat_to_SH_m_fly8_l, NULL, NULL,
 		NULL, NULL, NULL, NULL }
 };
+
+#ifdef _OPENMP
+void* fomp_m[6][SHT_NTYP] = {
+	{ NULL, NULL, SHsphtor_m_to_spat_omp1_l, spat_to_SHsphtor_m_omp1_l,
+		SHsph_m_to_spat_omp1_l, SHtor_m_to_spat_omp1_l, SHqst_m_to_spat_omp1_l, spat_to_SHqst_m_omp1_l },
+	{ SH_m_to_spat_omp2_l, spat_to_SH_m_omp2_l, SHsphtor_m_to_spat_omp2_l, spat_to_SHsphtor_m_omp2_l,
+		SHsph_m_to_spat_omp2_l, SHtor_m_to_spat_omp2_l, SHqst_m_to_spat_omp2_l, spat_to_SHqst_m_omp2_l },
+	{ SH_m_to_spat_omp3_l, spat_to_SH_m_omp3_l, SHsphtor_m_to_spat_omp3_l, spat_to_SHsphtor_m_omp3_l,
+		SHsph_m_to_spat_omp3_l, SHtor_m_to_spat_omp3_l, SHqst_m_to_spat_omp3_l, spat_to_SHqst_m_omp3_l },
+	{ SH_m_to_spat_omp4_l, spat_to_SH_m_omp4_l, NULL, NULL,
+		SHsph_m_to_spat_omp4_l, SHtor_m_to_spat_omp4_l, NULL, NULL },
+	{ SH_m_to_spat_omp6_l, spat_to_SH_m_omp6_l, NULL, NULL,
+		NULL, NULL, NULL, NULL },
+	{ SH_m_to_spat_omp8_l, spat_to_SH_m_omp8_l, NULL, NULL,
+		NULL, NULL, NULL, NULL }
+};
+#endif
+
@@ -50,13 +50,9 @@ void SH_Zrotate(shtns_cfg shtns, cplx *Qlm, double alpha, cplx *Rlm)
 
 //@}
 
-/// \internal initialize pseudo-spectral rotations
+/// \internal initialize pseudo-spectral rotations (the fft is planned on first use, see rot_fft_ready).
 static void SH_rotK90_init(shtns_cfg shtns)
 {
-	cplx *q;
-	double *q0;
-	int nfft, nrembed, ncembed;
-	
 //	if ((shtns->mres != 1) || (shtns->mmax != shtns->lmax)) runerr("Arbitrary rotations require lmax=mmax and mres=1");
 
 #define NWAY 4
@@ -74,20 +70,36 @@ static void SH_rotK90_init(shtns_cfg shtns)
 		shtns->ct_rot[k] = cost;
 		shtns->st_rot[k] = sint;
 	}
+	shtns->npts_rot = ntheta;		// save ntheta, and mark as initialized.
+}
 
-	// plan FFT
-	size_t sze = sizeof(double)*(2*ntheta+2)*lmax;
-	q0 = VMALLOC(sze);		// alloc.
-	#ifdef OMP_FFTW
-		int k = (lmax < 63) ? 1 : shtns->nthreads;
-		fftw_plan_with_nthreads(k);
-	#endif
-	q = (cplx*) q0;		// in-place FFT
-	nfft = 2*ntheta;	nrembed = nfft+2;		ncembed = nrembed/2;
-	shtns->fft_rot = fftw_plan_many_dft_r2c(1, &nfft, lmax, q0, &nrembed, lmax, 1, q, &ncembed, lmax, 1, FFTW_MEASURE);
+/// \internal plan the fft of the rotations (only once, even if called concurrently by several threads).
+static void rot_fft_ready(shtns_cfg shtns)
+{
+	cplx *q;
+	double *q0;
+	int nfft, nrembed, ncembed;
 
-	VFREE(q0);
-	shtns->npts_rot = ntheta;		// save ntheta, and mark as initialized.
+	if (__atomic_load_n(&shtns->fft_rot, __ATOMIC_ACQUIRE) != NULL) return;
+	const int lmax = shtns->lmax;
+	const int ntheta = shtns->npts_rot;
+	const unsigned plan_mode = (shtns->fftw_plan_mode & FFTW_ESTIMATE) ? FFTW_ESTIMATE : FFTW_MEASURE;		// planned on first use: avoid lengthy searches.
+	size_t sze = sizeof(double)*(2*ntheta+2)*lmax;
+	cfg_lock();		// fftw planning is not thread-safe.
+	if (shtns->fft_rot == NULL) {
+		q0 = VMALLOC(sze);		// alloc.
+		q = (cplx*) q0;		// in-place FFT
+		nfft = 2*ntheta;	nrembed = nfft+2;		ncembed = nrembed/2;
+		#ifdef OMP_FFTW
+			int k = (lmax < 63) ? 1 : shtns->nthreads;
+			fftw_plan_with_nthreads(k);
+		#endif
+		fftw_plan fft = fftw_plan_many_dft_r2c(1, &nfft, lmax, q0, &nrembed, lmax, 1, q, &ncembed, lmax, 1, plan_mode);
+		VFREE(q0);
+		if (fft == NULL) shtns_runerr("[FFTW] rotation fft planning failed !");
+		__atomic_store_n(&shtns->fft_rot, fft, __ATOMIC_RELEASE);
+	}
+	cfg_unlock();
 }
 
 /** \internal rotation kernel used by SH_Yrotate90(), SH_Xrotate90() and SH_rotate().
@@ -100,13 +112,15 @@ static void SH_rotK90_init(shtns_cfg shtns)
 static void SH_rotK90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm, double dphi0, double dphi1)
 {
 //	if (shtns->npts_rot == 0)	SH_rotK90_init(shtns);
+	rot_fft_ready(shtns);
 
 //	ticks tik0, tik1, tik2, tik3;
 
 	const int lmax = shtns->lmax;
 	const int ntheta = shtns->npts_rot;
 	size_t sze = sizeof(double)*(2*ntheta+2)*lmax;
-	double* const q0 = VMALLOC(sze);		// alloc.
+	const size_t sze_a = ((sze + sizeof(rnd)-1)/sizeof(rnd))*sizeof(rnd);		// qve must be aligned.
+	double* const q0 = shtns_scratch(SCRATCH_ROT, sze_a + sizeof(rnd)*NWAY*4*lmax);		// alloc (also holds qve below).
 
 	// rotate around Z by dphi0,  and also pre-multiply imaginary parts by m
 	if (Rlm != Qlm) {		// copy m=0 which does not change.
@@ -127,7 +141,7 @@ static void SH_rotK90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm, double dphi0, doubl
 
 //	tik0 = getticks();
 
-		rnd* const qve = (rnd*) VMALLOC( sizeof(rnd)*NWAY*4*lmax );	// vector buffer
+		rnd* const qve = (rnd*) (((char*)q0) + sze_a);	// vector buffer
 		rnd* const qvo = qve + NWAY*2*lmax;		// for odd m
 		double* const ct = shtns->ct_rot;
 		double* const st = shtns->st_rot;
@@ -286,7 +300,6 @@ static void SH_rotK90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm, double dphi0, doubl
 			}
 			k += NWAY;
 		} while (k<nk);
-	VFREE(qve);
 #undef NWAY
 
 //	tik1 = getticks();
@@ -325,7 +338,6 @@ static void SH_rotK90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm, double dphi0, doubl
 			lm++;
 		}
 	}
-	VFREE(q0);
 
 //	tik3 = getticks();
 //	printf("    tick ratio : %.3f  %.3f  %.3f\n", elapsed(tik1,tik0)/elapsed(tik3,tik0), elapsed(tik2,tik1)/elapsed(tik3,tik0), elapsed(tik3,tik2)/elapsed(tik3,tik0));
@@ -651,10 +663,75 @@ void SHqst_to_point(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, double cos
 	(does not require a previous call to shtns_set_grid)
 */
 
+// per-thread cache of the Legendre functions at the last latitude and of the fftw plan, for SH_to_lat and SHqst_to_lat.
+// The config is identified by its serial number, as a new config may be allocated at the address of a destroyed one.
+static __thread struct {
+	unsigned long serial;	// serial number of the config used to compute ylm (0 if ylm is not valid).
+	unsigned nlm;
+	int ltr, mtr;
+	double ct;				// cos(theta) of the latitude.
+	double* ylm;			// Legendre functions (nlm values) followed by their derivatives (nlm values).
+	unsigned nlm_alloc;		// number of ylm allocated.
+	fftw_plan ifft;			// fftw plan for nphi points.
+	int nphi;
+} lat_cache = { 0, 0, 0, 0, 2.0, NULL, 0, NULL, 0 };
+
+/// \internal free the Legendre functions and the fftw plan kept by the calling thread (see \ref shtns_release_scratch).
+static void lat_cache_release()
+{
+	if (lat_cache.ylm) free(lat_cache.ylm);
+	lat_cache.ylm = NULL;		lat_cache.nlm_alloc = 0;		lat_cache.serial = 0;
+	if (lat_cache.ifft) {
+		cfg_lock();		// fftw planning is not thread-safe.
+		fftw_destroy_plan(lat_cache.ifft);
+		cfg_unlock();
+	}
+	lat_cache.ifft = NULL;		lat_cache.nphi = 0;
+}
+
+/// \internal returns the Legendre functions of the given config at cos(theta) = cost, followed by their derivatives.
+/// They are kept by the calling thread for subsequent calls at the same latitude.
+static double* lat_legendre(shtns_cfg shtns, double cost, double st_lat, int ltr, int mtr)
+{
+	if ((lat_cache.serial != shtns->serial) || (lat_cache.nlm != NLM) || (lat_cache.ct != cost) || (lat_cache.ltr != ltr) || (lat_cache.mtr != mtr)) {
+		if (lat_cache.nlm_alloc < NLM) {		// alloc memory for Legendre functions ?
+			if (lat_cache.ylm) free(lat_cache.ylm);
+			lat_cache.ylm = (double *) malloc(sizeof(double)* 2*NLM);
+			if (lat_cache.ylm == NULL) shtns_runerr("not enough memory.");
+			lat_cache.nlm_alloc = NLM;
+		}
+		double* const ylm_lat = lat_cache.ylm;
+		double* const dylm_lat = ylm_lat + NLM;
+		for (int m=0,j=0; m<=mtr; ++m) {
+			legendre_sphPlm_deriv_array(shtns, ltr, m, cost, st_lat, &ylm_lat[j], &dylm_lat[j]);
+			j += LMAX -m*MRES +1;
+		}
+		lat_cache.serial = shtns->serial;	lat_cache.nlm = NLM;
+		lat_cache.ct = cost;		lat_cache.ltr = ltr;		lat_cache.mtr = mtr;
+	}
+	return lat_cache.ylm;
+}
+
+/// \internal returns the c2r fftw plan of size nphi, kept by the calling thread for subsequent calls.
+static fftw_plan lat_plan(int nphi, cplx* vrc, double* vr)
+{
+	if (nphi != lat_cache.nphi) {		// compute FFTW plan ?
+		cfg_lock();		// fftw planning is not thread-safe.
+		if (lat_cache.ifft) fftw_destroy_plan(lat_cache.ifft);
+		#ifdef OMP_FFTW
+			fftw_plan_with_nthreads(1);
+		#endif
+		lat_cache.ifft = fftw_plan_dft_c2r_1d(nphi, vrc, vr, FFTW_ESTIMATE | FFTW_UNALIGNED);		// vr is not always aligned the same way.
+		cfg_unlock();
+		lat_cache.nphi = nphi;
+	}
+	return lat_cache.ifft;
+}
+
 /// synthesis at a given latitude, on nphi equispaced longitude points.
 /// vr, vt, and vp arrays must have nphi doubles allocated.
-/// It does not require a previous call to shtns_set_grid, but it is NOT thread-safe, 
-/// unless called with a different shtns_cfg
+/// It does not require a previous call to shtns_set_grid. It is thread-safe (each thread keeps its own
+/// Legendre functions for the last latitude).
 /// \ingroup local
 void SHqst_to_lat(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, double cost,
 					double *vr, double *vt, double *vp, int nphi, int ltr, int mtr)
@@ -670,34 +747,15 @@ void SHqst_to_lat(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, double cost,
 	if (mtr*MRES > ltr) mtr=ltr/MRES;
 	if (mtr*2*MRES >= nphi) mtr = (nphi-1)/(2*MRES);
 
-	ylm_lat = shtns->ylm_lat;
-	if (ylm_lat == NULL) {		// alloc memory for Legendre functions ?
-		ylm_lat = (double *) malloc(sizeof(double)* 2*NLM);
-		shtns->ylm_lat = ylm_lat;
-	}
-	dylm_lat = ylm_lat + NLM;
-
 	st_lat = sqrt((1.-cost)*(1.+cost));	// sin(theta)
-	if (cost != shtns->ct_lat) {		// compute Legendre functions ?
-		shtns->ct_lat = cost;
-		for (int m=0,j=0; m<=mtr; ++m) {
-			legendre_sphPlm_deriv_array(shtns, ltr, m, cost, st_lat, &ylm_lat[j], &dylm_lat[j]);
-			j += LMAX -m*MRES +1;
-		}
-	}
+	ylm_lat = lat_legendre(shtns, cost, st_lat, ltr, mtr);
+	dylm_lat = ylm_lat + NLM;
 
-	vrc = (cplx*) fftw_malloc(sizeof(double) * 3*(nphi+2));
+	vrc = (cplx*) shtns_scratch(SCRATCH_FFT, sizeof(double) * 3*(nphi+2));
 	vtc = vrc + (nphi/2+1);
 	vpc = vtc + (nphi/2+1);
 
-	if (nphi != shtns->nphi_lat) {		// compute FFTW plan ?
-		if (shtns->ifft_lat) fftw_destroy_plan(shtns->ifft_lat);
-		#ifdef OMP_FFTW
-			fftw_plan_with_nthreads(1);
-		#endif
-		shtns->ifft_lat = fftw_plan_dft_c2r_1d(nphi, vrc, vr, FFTW_ESTIMATE);
-		shtns->nphi_lat = nphi;
-	}
+	const fftw_plan ifft_lat = lat_plan(nphi, vrc, vr);
 
 	for (int m = 0; m<nphi/2+1; ++m) {	// init with zeros
 		vrc[m] = 0.0;	vtc[m] = 0.0;	vpc[m] = 0.0;
@@ -728,16 +786,15 @@ void SHqst_to_lat(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, double cost,
 		vtc[m] = I*m*vtp + vst;	// Vt = I.m/sint *T  + dS/dt
 		vpc[m] = I*m*vsp - vtt;	// Vp = I.m/sint *S  - dT/dt
 	}
-	fftw_execute_dft_c2r(shtns->ifft_lat,vrc,vr);
-	fftw_execute_dft_c2r(shtns->ifft_lat,vtc,vt);
-	fftw_execute_dft_c2r(shtns->ifft_lat,vpc,vp);
-	fftw_free(vrc);
+	fftw_execute_dft_c2r(ifft_lat,vrc,vr);
+	fftw_execute_dft_c2r(ifft_lat,vtc,vt);
+	fftw_execute_dft_c2r(ifft_lat,vpc,vp);
 }
 
 /// synthesis at a given latitude, on nphi equispaced longitude points.
 /// vr arrays must have nphi doubles allocated.
-/// It does not require a previous call to shtns_set_grid, but it is NOT thread-safe,
-/// unless called with a different shtns_cfg
+/// It does not require a previous call to shtns_set_grid. It is thread-safe (each thread keeps its own
+/// Legendre functions for the last latitude).
 /// \ingroup local
 void SH_to_lat(shtns_cfg shtns, cplx *Qlm, double cost,
 					double *vr, int nphi, int ltr, int mtr)
@@ -745,7 +802,6 @@ void SH_to_lat(shtns_cfg shtns, cplx *Qlm, double cost,
 	cplx vrr;
 	cplx *vrc;
 	double* ylm_lat;
-	double* dylm_lat;
 	double st_lat;
 
 	if (ltr > LMAX) ltr=LMAX;
@@ -753,32 +809,12 @@ void SH_to_lat(shtns_cfg shtns, cplx *Qlm, double cost,
 	if (mtr*MRES > ltr) mtr=ltr/MRES;
 	if (mtr*2*MRES >= nphi) mtr = (nphi-1)/(2*MRES);
 
-	ylm_lat = shtns->ylm_lat;
-	if (ylm_lat == NULL) {
-		ylm_lat = (double *) malloc(sizeof(double)* 2*NLM);
-		shtns->ylm_lat = ylm_lat;
-	}
-	dylm_lat = ylm_lat + NLM;
-
 	st_lat = sqrt((1.-cost)*(1.+cost));	// sin(theta)
-	if (cost != shtns->ct_lat) {
-		shtns->ct_lat = cost;
-		for (int m=0,j=0; m<=mtr; ++m) {
-			legendre_sphPlm_deriv_array(shtns, ltr, m, cost, st_lat, &ylm_lat[j], &dylm_lat[j]);
-			j += LMAX -m*MRES +1;
-		}
-	}
+	ylm_lat = lat_legendre(shtns, cost, st_lat, ltr, mtr);
 
-	vrc = (cplx*) fftw_malloc(sizeof(double) * (nphi+2));
+	vrc = (cplx*) shtns_scratch(SCRATCH_FFT, sizeof(double) * (nphi+2));
 
-	if (nphi != shtns->nphi_lat) {
-		if (shtns->ifft_lat) fftw_destroy_plan(shtns->ifft_lat);
-		#ifdef OMP_FFTW
-			fftw_plan_with_nthreads(1);
-		#endif
-		shtns->ifft_lat = fftw_plan_dft_c2r_1d(nphi, vrc, vr, FFTW_ESTIMATE);
-		shtns->nphi_lat = nphi;
-	}
+	const fftw_plan ifft_lat = lat_plan(nphi, vrc, vr);
 
 	for (int m = 0; m<nphi/2+1; ++m) {	// init with zeros
 		vrc[m] = 0.0;
@@ -799,8 +835,7 @@ void SH_to_lat(shtns_cfg shtns, cplx *Qlm, double cost,
 		j+=(LMAX-ltr);
 		vrc[m] = vrr*st_lat;
 	}
-	fftw_execute_dft_c2r(shtns->ifft_lat,vrc,vr);
-	fftw_free(vrc);
+	fftw_execute_dft_c2r(ifft_lat,vrc,vr);
 }
 
 
@@ -970,20 +1005,55 @@ static void SH_cplx_to_2real(shtns_cfg shtns, cplx* Zlm, cplx* Rlm, cplx* Ilm)
 	}
 }
 
-/// complex scalar transform.
-/// in: complex spatial field z.
-/// out: alm[LM(shtns,l,m)] is the SH coefficients of order l and degree m (with -l <= m <= l)
-/// for a total of nlm_cplx_calc(lmax,mmax,mres) coefficients.
-void spat_cplx_to_SH(shtns_cfg shtns, cplx *z, cplx *alm)
+extern void* fcplx[6][SHT_NTYP];
+extern void* ffly[6][SHT_NTYP];
+#ifdef _OPENMP
+extern void* fomp[6][SHT_NTYP];
+#endif
+
+/// \internal plans the complex ffts used by the native transforms of complex fields (sht_cplx.c).
+/// The Fourier coefficients are theta-contiguous (order m in column m, order -m in column nphi-m).
+static void plan_cplx_fft(shtns_cfg shtns)
+{
+	int nfft = NPHI;
+	const long nspat = ((long) NLAT) * NPHI;
+	const unsigned plan_mode = shtns->fftw_plan_mode;		// same planner effort as the ffts of the real transforms.
+	int phi_inc = NLAT;		int theta_inc = 1;
+	if (shtns->layout & SHT_PHI_CONTIGUOUS) {	phi_inc = 1;	theta_inc = NPHI;	}
+
+	cplx* F = (cplx*) VMALLOC(2*nspat * sizeof(cplx));		// dummy arrays for planning.
+	cplx* z = F + nspat;
+	#ifdef OMP_FFTW
+		fftw_plan_with_nthreads(shtns->nthreads);
+	#endif
+	// in-place, unless the spatial data is phi-contiguous (the analysis copies the input to leave it unchanged).
+	fftw_plan ifft = fftw_plan_many_dft(1, &nfft, NLAT, F, &nfft, NLAT, 1, (phi_inc == 1) ? z : F, &nfft, phi_inc, theta_inc, FFTW_BACKWARD, plan_mode);
+	fftw_plan fft = fftw_plan_many_dft(1, &nfft, NLAT, (phi_inc == 1) ? z : F, &nfft, phi_inc, theta_inc, F, &nfft, NLAT, 1, FFTW_FORWARD, plan_mode);
+	VFREE(F);
+	if ((ifft == NULL) || (fft == NULL)) shtns_runerr("[FFTW] complex fft planning failed !");
+	shtns->ifft_cplx = ifft;
+	__atomic_store_n(&shtns->fft_cplx, fft, __ATOMIC_RELEASE);		// set last, marks the plans as ready (see cplx_fft_ready).
+}
+
+/// \internal make sure the complex ffts have been planned (only once, even if called concurrently by several threads).
+static void cplx_fft_ready(shtns_cfg shtns)
+{
+	if ((shtns->fftc_mode >= 0) && (__atomic_load_n(&shtns->fft_cplx, __ATOMIC_ACQUIRE) == NULL)) {
+		cfg_lock();
+		if (shtns->fft_cplx == NULL) plan_cplx_fft(shtns);
+		cfg_unlock();
+	}
+}
+
+/// \internal complex scalar analysis performed by two real transforms (fallback of \ref spat_cplx_to_SH).
+static void spat_cplx_to_SH_2real(shtns_cfg shtns, cplx *z, cplx *alm)
 {
 	long int nspat = shtns->nspat;
 	double *re, *im;
 	cplx *rlm, *ilm;
 
-	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
-
 	// alloc temporary fields
-	re = (double*) VMALLOC( 2*(nspat + NLM*2)*sizeof(double) );
+	re = (double*) shtns_scratch(SCRATCH_CPLX, 2*(nspat + NLM*2)*sizeof(double) );
 	im = re + nspat;
 	rlm = (cplx*) (re + 2*nspat);
 	ilm = rlm + NLM;
@@ -1000,23 +1070,17 @@ void spat_cplx_to_SH(shtns_cfg shtns, cplx *z, cplx *alm)
 	// combine into complex coefficients
 	SH_2real_to_cplx(shtns, rlm, ilm, alm);
 
-	VFREE(re);
 }
 
-/// complex scalar transform.
-/// in: alm[LM_cplx(shtns,l,m)] is the SH coefficients of order l and degree m (with -l <= m <= l)
-/// for a total of nlm_cplx_calc(lmax,mmax,mres) coefficients.
-/// out: complex spatial field z.
-void SH_to_spat_cplx(shtns_cfg shtns, cplx *alm, cplx *z)
+/// \internal complex scalar synthesis performed by two real transforms (fallback of \ref SH_to_spat_cplx).
+static void SH_to_spat_cplx_2real(shtns_cfg shtns, cplx *alm, cplx *z)
 {
 	long int nspat = shtns->nspat;
 	double *re, *im;
 	cplx *rlm, *ilm;
 
-	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
-
 	// alloc temporary fields
-	re = (double*) VMALLOC( 2*(nspat + NLM*2)*sizeof(double) );
+	re = (double*) shtns_scratch(SCRATCH_CPLX, 2*(nspat + NLM*2)*sizeof(double) );
 	im = re + nspat;
 	rlm = (cplx*) (re + 2*nspat);
 	ilm = rlm + NLM;
@@ -1032,23 +1096,17 @@ void SH_to_spat_cplx(shtns_cfg shtns, cplx *alm, cplx *z)
 	for (int k=0; k<nspat; k++)
 		z[k] = re[k] + I*im[k];
 
-	VFREE(re);
 }
 
-
-/// complex vector transform (2D).
-/// in: slm, tlm are the spheroidal/toroidal SH coefficients of order l and degree m (with -l <= m <= l)
-/// out: zt, zp are respectively the theta and phi components of the complex spatial vector field.
-void SHsphtor_to_spat_cplx(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt, cplx *zp)
+/// \internal complex vector synthesis performed by two real transforms (fallback of \ref SHsphtor_to_spat_cplx).
+static void SHsphtor_to_spat_cplx_2real(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt, cplx *zp)
 {
 	long int nspat = shtns->nspat;
 	double *zt_r, *zt_i, *zp_r, *zp_i;
 	cplx *slm_r, *slm_i, *tlm_r, *tlm_i;
 
-	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
-
 	// alloc temporary fields
-	zt_r = (double*) VMALLOC( 4*(nspat + NLM*2)*sizeof(double) );
+	zt_r = (double*) shtns_scratch(SCRATCH_CPLX, 4*(nspat + NLM*2)*sizeof(double) );
 	zp_r = zt_r + nspat;
 	zt_i = zt_r + 2*nspat;
 	zp_i = zt_r + 3*nspat;
@@ -1071,24 +1129,17 @@ void SHsphtor_to_spat_cplx(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt, cplx
 	for (int k=0; k<nspat; k++)
 		zp[k] = zp_r[k] + I*zp_i[k];
 
-	VFREE(zt_r);
 }
 
-
-/// complex vector transform (2D).
-/// zt,zp: theta,phi components of the complex spatial vector field.
-/// out: slm[LM_cplx(l,m)] and tlm[LM_cplx(l,m)] are the SH coefficients of order l and degree m (with -l <= m <= l)
-/// for a total of shtns->nlm_cplx = nlm_cplx_calc(lmax, mmax, mres) coefficients.
-void spat_cplx_to_SHsphtor(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm, cplx *tlm)
+/// \internal complex vector analysis performed by two real transforms (fallback of \ref spat_cplx_to_SHsphtor).
+static void spat_cplx_to_SHsphtor_2real(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm, cplx *tlm)
 {
 	long int nspat = shtns->nspat;
 	double *zt_r, *zt_i, *zp_r, *zp_i;
 	cplx *slm_r, *slm_i, *tlm_r, *tlm_i;
 
-	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
-
 	// alloc temporary fields
-	zt_r = (double*) VMALLOC( 4*(nspat + NLM*2)*sizeof(double) );
+	zt_r = (double*) shtns_scratch(SCRATCH_CPLX, 4*(nspat + NLM*2)*sizeof(double) );
 	zp_r = zt_r + nspat;
 	zt_i = zt_r + 2*nspat;
 	zp_i = zt_r + 3*nspat;
@@ -1113,7 +1164,175 @@ void spat_cplx_to_SHsphtor(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm, cplx
 	SH_2real_to_cplx(shtns, slm_r, slm_i, slm);
 	SH_2real_to_cplx(shtns, tlm_r, tlm_i, tlm);
 
-	VFREE(zt_r);
+}
+
+/// \internal returns 1 if the native complex transform of type typ (SHT_TYP_SSY, SHT_TYP_SAN, ...) can be used with this config.
+static int cplx_native_ok(shtns_cfg shtns, int typ)
+{
+  #ifdef SHTNS4MAGIC
+	return 0;
+  #else
+	if ((NLAT_2 < 2*VSIZE2) || (NLAT & 1)) return 0;		// the kernels work on blocks of 2*VSIZE2 latitudes in each hemisphere.
+	if ((NPHI > 1) && (2*MMAX >= NPHI)) return 0;		// orders m and -m must be stored in different columns.
+	if ((typ & 1) && (shtns->wg == NULL)) return 0;		// no on-the-fly analysis on regular grids.
+	return 1;
+  #endif
+}
+
+/// \internal returns the native complex transform of type typ (SHT_TYP_SSY, SHT_TYP_SAN, ...).
+/// The kernel processes latitudes by blocks of the same size as the on-the-fly algorithm chosen for the real transform of the same type.
+static void* cplx_kernel(shtns_cfg shtns, int typ)
+{
+	void* f = shtns->ftable[SHT_STD][typ];
+	int j = 1;		// NWAY=2 by default (precomputed matrices).
+	for (int i=0; i<6; i++) {
+		if ((f == ffly[i][typ])
+		#ifdef _OPENMP
+			|| (f == fomp[i][typ])
+		#endif
+		) {		j = i;	break;	}
+	}
+	if (fcplx[j][typ] == NULL) j = 1;
+	return fcplx[j][typ];
+}
+
+/// \internal measures the time of the complex transform of type typ, either native or by two real transforms (first call discarded).
+static double cplx_time(shtns_cfg shtns, int typ, int native, cplx* z, cplx* alm, int nloop)
+{
+	const long nspat = shtns->nspat;
+	const long nlm = shtns->nlm_cplx;
+	void* f = cplx_kernel(shtns, typ);
+	ticks tik0 = getticks();
+	for (int i=0; i<=nloop; i++) {
+		if (i==1) tik0 = getticks();
+		switch(typ) {
+			case SHT_TYP_SSY :
+				if (native) ((pf2l)f)(shtns, alm, z, LMAX);		else SH_to_spat_cplx_2real(shtns, alm, z);
+				break;
+			case SHT_TYP_SAN :
+				if (native) ((pf2l)f)(shtns, z, alm, LMAX);		else spat_cplx_to_SH_2real(shtns, z, alm);
+				break;
+			case SHT_TYP_VSY :
+				if (native) ((pf5l)f)(shtns, alm, alm+nlm, z, z+nspat, NULL, LMAX);		else SHsphtor_to_spat_cplx_2real(shtns, alm, alm+nlm, z, z+nspat);
+				break;
+			default :
+				if (native) ((pf5l)f)(shtns, z, z+nspat, alm, alm+nlm, NULL, LMAX);		else spat_cplx_to_SHsphtor_2real(shtns, z, z+nspat, alm, alm+nlm);
+		}
+	}
+	return elapsed(getticks(), tik0) / nloop;
+}
+
+/// \internal with \ref SHT_CPLX_NATIVE, chooses between the native kernel and two real transforms for each type of complex transform,
+/// by timing both (medians of interleaved trials): the native kernel is kept unless two real transforms are significantly faster.
+/// Called by shtns_set_grid_auto() after the tuning of the real transforms (without holding cfg_lock), with the same number of threads
+/// (the native kernels are parallel over m, like the real ones). If it is not called (quick init or predicted config), the native kernels are used.
+/// Without SHT_CPLX_NATIVE, two real transforms are always used: the native kernels are not faster in general,
+/// because the complex fft of the whole grid is often slower than two real ffts.
+static void choose_cplx(shtns_cfg shtns)
+{
+	const long nspat = shtns->nspat;
+	const long nlm = shtns->nlm_cplx;
+	const int nloop = (nlm > 400000) ? 1 : 3;
+	unsigned sel = 0;
+	cplx* z = NULL;
+	cplx* alm = NULL;
+
+	for (int typ = SHT_TYP_SSY; typ <= SHT_TYP_VAN; typ++) {
+		if ((typ >= SHT_TYP_VSY) && (shtns->mx_stdt == NULL)) break;		// no vector transforms (SHT_SCALAR_ONLY).
+		if (!cplx_native_ok(shtns, typ)) continue;
+		if (z == NULL) {
+			cplx_fft_ready(shtns);
+			z = (cplx*) VMALLOC( (2*nspat + 2*nlm) * sizeof(cplx) );
+			alm = z + 2*nspat;
+			memset(z, 0, (2*nspat + 2*nlm) * sizeof(cplx));
+		}
+		double tn[SHT_TRIALS_MIN], tr[SHT_TRIALS_MIN], lo, hi, lo2, hi2;
+		for (int i=0; i<SHT_TRIALS_MIN; i++) {		// interleaved trials, in alternating order.
+			if (i & 1) {	tr[i] = cplx_time(shtns, typ, 0, z, alm, nloop);	tn[i] = cplx_time(shtns, typ, 1, z, alm, nloop);	}
+			else {			tn[i] = cplx_time(shtns, typ, 1, z, alm, nloop);	tr[i] = cplx_time(shtns, typ, 0, z, alm, nloop);	}
+		}
+		trial_stats(tn, SHT_TRIALS_MIN, &lo, &hi);		// also sorts the trials.
+		trial_stats(tr, SHT_TRIALS_MIN, &lo2, &hi2);
+		if (hi2 >= lo) sel |= 1U << typ;		// native unless significantly slower.
+		#if SHT_VERBOSE > 1
+		if (verbose>1) printf("  complex %s : native %.3g, two real %.3g\n", (typ & 1) ? "analysis" : "synthesis", tn[SHT_TRIALS_MIN/2], tr[SHT_TRIALS_MIN/2]);
+		#endif
+	}
+	if (z) VFREE(z);
+	shtns->cplx_fast = sel;
+}
+
+/// \internal returns the native complex transform of type typ (SHT_TYP_SSY, SHT_TYP_SAN, ...) and makes sure its fft is planned,
+/// or NULL if it cannot be used, is not enabled by \ref SHT_CPLX_NATIVE, or was timed slower than two real transforms (the complex transforms then fall back to two real transforms).
+/// The spatial fields a and b must be aligned as returned by \ref shtns_malloc (for the vector stores and the fft planned with aligned arrays).
+static void* cplx_native(shtns_cfg shtns, int typ, const void* a, const void* b)
+{
+	if (!cplx_native_ok(shtns, typ)) return NULL;
+	if ((((size_t) a) | ((size_t) b)) & (MIN_ALIGNMENT-1)) return NULL;		// not allocated with shtns_malloc.
+	if ((shtns->cplx_fast & (1U << typ)) == 0) return NULL;		// not enabled, or two real transforms are faster.
+	cplx_fft_ready(shtns);
+	return cplx_kernel(shtns, typ);
+}
+
+/// complex scalar transform.
+/// in: complex spatial field z.
+/// out: alm[LM(shtns,l,m)] is the SH coefficients of order l and degree m (with -l <= m <= l)
+/// for a total of nlm_cplx_calc(lmax,mmax,mres) coefficients.
+void spat_cplx_to_SH(shtns_cfg shtns, cplx *z, cplx *alm)
+{
+	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_SAN, z, z);
+	if (f) {
+		((pf2l)f)(shtns, z, alm, LMAX);
+		return;
+	}
+	spat_cplx_to_SH_2real(shtns, z, alm);
+}
+
+/// complex scalar transform.
+/// in: alm[LM_cplx(shtns,l,m)] is the SH coefficients of order l and degree m (with -l <= m <= l)
+/// for a total of nlm_cplx_calc(lmax,mmax,mres) coefficients.
+/// out: complex spatial field z.
+void SH_to_spat_cplx(shtns_cfg shtns, cplx *alm, cplx *z)
+{
+	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_SSY, z, z);
+	if (f) {
+		((pf2l)f)(shtns, alm, z, LMAX);
+		return;
+	}
+	SH_to_spat_cplx_2real(shtns, alm, z);
+}
+
+
+/// complex vector transform (2D).
+/// in: slm, tlm are the spheroidal/toroidal SH coefficients of order l and degree m (with -l <= m <= l)
+/// out: zt, zp are respectively the theta and phi components of the complex spatial vector field.
+void SHsphtor_to_spat_cplx(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt, cplx *zp)
+{
+	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_VSY, zt, zp);
+	if (f) {
+		((pf5l)f)(shtns, slm, tlm, zt, zp, NULL, LMAX);
+		return;
+	}
+	SHsphtor_to_spat_cplx_2real(shtns, slm, tlm, zt, zp);
+}
+
+
+/// complex vector transform (2D).
+/// zt,zp: theta,phi components of the complex spatial vector field.
+/// out: slm[LM_cplx(l,m)] and tlm[LM_cplx(l,m)] are the SH coefficients of order l and degree m (with -l <= m <= l)
+/// for a total of shtns->nlm_cplx = nlm_cplx_calc(lmax, mmax, mres) coefficients.
+void spat_cplx_to_SHsphtor(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm, cplx *tlm)
+{
+	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_VAN, zt, zp);
+	if (f) {
+		((pf5l)f)(shtns, zt, zp, slm, tlm, NULL, LMAX);
+		return;
+	}
+	spat_cplx_to_SHsphtor_2real(shtns, zt, zp, slm, tlm);
 }
 
 /// same as \ref SHsphtor_to_spat_cplx but multiply by sin(theta) after the transform.
@@ -1124,9 +1343,14 @@ void SHsphtor_to_spat_cplx_xsint(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt
 	cplx *slm_r, *slm_i, *tlm_r, *tlm_i;
 
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_VSY, zt, zp);
+	if (f) {
+		((pf5l)f)(shtns, slm, tlm, zt, zp, shtns->st, LMAX);		// multiply by sin(theta) in the kernel.
+		return;
+	}
 
 	// alloc temporary fields
-	zt_r = (double*) VMALLOC( 4*(nspat + NLM*2)*sizeof(double) );
+	zt_r = (double*) shtns_scratch(SCRATCH_CPLX, 4*(nspat + NLM*2)*sizeof(double) );
 	zp_r = zt_r + nspat;
 	zt_i = zt_r + 2*nspat;
 	zp_i = zt_r + 3*nspat;
@@ -1147,7 +1371,6 @@ void SHsphtor_to_spat_cplx_xsint(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt
 	spat_xsint_2real_to_cplx(shtns, zt_r, zt_i, zt);
 	spat_xsint_2real_to_cplx(shtns, zp_r, zp_i, zp);
 
-	VFREE(zt_r);
 }
 
 
@@ -1155,14 +1378,18 @@ void SHsphtor_to_spat_cplx_xsint(shtns_cfg shtns, cplx *slm, cplx *tlm, cplx *zt
 void spat_cplx_xsint_to_SHsphtor(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm, cplx *tlm)
 {
 	long int nspat = shtns->nspat;
-	const double* st_1 = shtns->st_1;
 	double *zt_r, *zt_i, *zp_r, *zp_i;
 	cplx *slm_r, *slm_i, *tlm_r, *tlm_i;
 
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
+	void* f = cplx_native(shtns, SHT_TYP_VAN, zt, zp);
+	if (f) {
+		((pf5l)f)(shtns, zt, zp, slm, tlm, shtns->st_1, LMAX);		// divide by sin(theta) in the kernel.
+		return;
+	}
 
 	// alloc temporary fields
-	zt_r = (double*) VMALLOC( 4*(nspat + NLM*2)*sizeof(double) );
+	zt_r = (double*) shtns_scratch(SCRATCH_CPLX, 4*(nspat + NLM*2)*sizeof(double) );
 	zp_r = zt_r + nspat;
 	zt_i = zt_r + 2*nspat;
 	zp_i = zt_r + 3*nspat;
@@ -1183,13 +1410,13 @@ void spat_cplx_xsint_to_SHsphtor(shtns_cfg shtns, cplx *zt, cplx *zp, cplx *slm,
 	SH_2real_to_cplx(shtns, slm_r, slm_i, slm);
 	SH_2real_to_cplx(shtns, tlm_r, tlm_i, tlm);
 
-	VFREE(zt_r);
 }
 
 
 /// complex vector transform (3D).
 /// in: zr,zt,zp are the r,theta,phi components of the complex spatial vector field.
 /// out: {qlm,slm,tlm}[LM_cplx(l,m)] are the SH coefficients of order l and degree m (with -l <= m <= l)
+/// The scalar and vector parts use their own native kernels when enabled (see \ref SHT_CPLX_NATIVE).
 void spat_cplx_to_SHqst(shtns_cfg shtns, cplx *zr, cplx *zt, cplx *zp, cplx *qlm, cplx *slm, cplx *tlm)
 {
 	spat_cplx_to_SH(shtns, zr, qlm);
@@ -1199,6 +1426,7 @@ void spat_cplx_to_SHqst(shtns_cfg shtns, cplx *zr, cplx *zt, cplx *zp, cplx *qlm
 /// complex vector transform (3D).
 /// in: {qlm,slm,tlm}[LM_cplx(l,m)] are the SH coefficients of order l and degree m (with -l <= m <= l)
 /// out: zr,zt,zp: r,theta,phi components of the complex spatial vector field.
+/// The scalar and vector parts use their own native kernels when enabled (see \ref SHT_CPLX_NATIVE).
 void SHqst_to_spat_cplx(shtns_cfg shtns, cplx *qlm, cplx *slm, cplx *tlm, cplx *zr, cplx *zt, cplx *zp)
 {
 	SH_to_spat_cplx(shtns, qlm, zr);
@@ -1212,7 +1440,7 @@ void SH_cplx_Xrotate90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm)
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
 
 	// alloc temporary fields
-	cplx* rlm = (cplx*) VMALLOC( NLM*2*sizeof(cplx) );
+	cplx* rlm = (cplx*) shtns_scratch(SCRATCH_CPLX, NLM*2*sizeof(cplx) );
 	cplx* ilm = rlm + NLM;
 
 	// extract complex coefficients corresponding to real and imag
@@ -1225,7 +1453,6 @@ void SH_cplx_Xrotate90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm)
 	// combine back into complex coefficients
 	SH_2real_to_cplx(shtns, rlm, ilm, Rlm);
 
-	VFREE(rlm);
 }
 
 void SH_cplx_Yrotate90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm)
@@ -1233,7 +1460,7 @@ void SH_cplx_Yrotate90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm)
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
 
 	// alloc temporary fields
-	cplx* rlm = (cplx*) VMALLOC( NLM*2*sizeof(cplx) );
+	cplx* rlm = (cplx*) shtns_scratch(SCRATCH_CPLX, NLM*2*sizeof(cplx) );
 	cplx* ilm = rlm + NLM;
 
 	// extract complex coefficients corresponding to real and imag
@@ -1246,7 +1473,6 @@ void SH_cplx_Yrotate90(shtns_cfg shtns, cplx *Qlm, cplx *Rlm)
 	// combine back into complex coefficients
 	SH_2real_to_cplx(shtns, rlm, ilm, Rlm);
 
-	VFREE(rlm);
 }
 
 /// complex scalar rotation around Y
@@ -1257,7 +1483,7 @@ void SH_cplx_Yrotate(shtns_cfg shtns, cplx *Qlm, double alpha, cplx *Rlm)
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
 
 	// alloc temporary fields
-	cplx* rlm = (cplx*) VMALLOC( NLM*2*sizeof(cplx) );
+	cplx* rlm = (cplx*) shtns_scratch(SCRATCH_CPLX, NLM*2*sizeof(cplx) );
 	cplx* ilm = rlm + NLM;
 
 	// extract complex coefficients corresponding to real and imag
@@ -1270,7 +1496,6 @@ void SH_cplx_Yrotate(shtns_cfg shtns, cplx *Qlm, double alpha, cplx *Rlm)
 	// combine back into complex coefficients
 	SH_2real_to_cplx(shtns, rlm, ilm, Rlm);
 
-	VFREE(rlm);
 }
 
 /// complex scalar rotation around Z
@@ -1281,7 +1506,7 @@ void SH_cplx_Zrotate(shtns_cfg shtns, cplx *Qlm, double alpha, cplx *Rlm)
 	if (MRES != 1) shtns_runerr("complex SH requires mres=1.");
 
 	// alloc temporary fields
-	cplx* rlm = (cplx*) VMALLOC( NLM*2*sizeof(cplx) );
+	cplx* rlm = (cplx*) shtns_scratch(SCRATCH_CPLX, NLM*2*sizeof(cplx) );
 	cplx* ilm = rlm + NLM;
 
 	// extract complex coefficients corresponding to real and imag
@@ -1294,7 +1519,6 @@ void SH_cplx_Zrotate(shtns_cfg shtns, cplx *Qlm, double alpha, cplx *Rlm)
 	// combine back into complex coefficients
 	SH_2real_to_cplx(shtns, rlm, ilm, Rlm);
 
-	VFREE(rlm);
 }
 
 /*
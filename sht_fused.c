@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_fused.c
+ * \brief Fused synthesis, pointwise operation and analysis (for non-linear terms).
+ * The grid is processed by blocks of latitudes: a band of rings in the northern hemisphere and its mirror image in the southern one.
+ * The input fields are synthesized on a block by the batched kernels, handed to a user function while they are still in cache,
+ * and the analysis of the result is accumulated right away into the output spectra. The full spatial fields are never stored.
+ * The blocks are distributed among the threads: each one accumulates its own partial spectra, which are summed once at the end.
+ * Separate transforms on the whole grid are used instead only for small grids where they were timed faster (see choose_fused).
+ */
+
+/// \internal returns the number of latitude pairs in each block of the fused transforms, except the last one which has *nbl pairs.
+/// The blocks are as large as allowed by SHT_FUSED_BLOCK_BYTES, but there is at least one block per thread.
+/// Returns 0 if the grid cannot be split into blocks.
+static int fused_blocks(shtns_cfg shtns, int* nbl)
+{
+  #ifndef SHTNS4MAGIC
+	const int nw = 2*VSIZE2;		// number of rings processed at once by the batch kernels (NWAY=2).
+	if ((NPHI > 1) && ((NLAT & 1) == 0) && (NLAT_2 >= nw) && (shtns->wg != NULL)) {
+		int nb = SHT_FUSED_BLOCK_BYTES / (2*NPHI*sizeof(double));
+		if (nb > NLAT_2 / shtns->nthreads) nb = NLAT_2 / shtns->nthreads;
+		nb -= nb % nw;		// the kernels must not overflow a block, except the last one.
+		if (nb < nw) nb = nw;
+		if (nb > NLAT_2) nb = NLAT_2;
+		*nbl = NLAT_2 - (NLAT_2/nb - 1)*nb;		// the last block has between nb and 2*nb-1 pairs.
+		return nb;
+	}
+  #endif
+	return 0;
+}
+
+/// \internal plan the in-place complex ffts of the blocks (same as fftc for theta-contiguous data),
+/// and without SIMD the out-of-place complex-to-real ffts used by the synthesis. Index 0 is for regular blocks, 1 for the last one.
+static void plan_fused_fft(shtns_cfg shtns, int nb, int nbl)
+{
+	fftw_plan fft[2], ifft[2];
+	const int nr[2] = { 2*nb, 2*nbl };		// number of rings in each kind of block.
+	int nfft = NPHI;
+	const unsigned plan_mode = (shtns->fftw_plan_mode & FFTW_ESTIMATE) ? FFTW_ESTIMATE : FFTW_MEASURE;		// planned on first use: avoid lengthy searches.
+
+	double* S = (double*) VMALLOC((NPHI + 2*(NPHI/2+1)) * nr[1] * sizeof(double));		// dummy arrays for planning.
+	#ifdef OMP_FFTW
+		fftw_plan_with_nthreads(1);		// each block is transformed by a single thread.
+	#endif
+	for (int i=0; i<2; i++) {
+		const int n = nr[i];
+		fft[i] = fftw_plan_many_dft(1, &nfft, n/2, (cplx*) S, &nfft, n/2, 1, (cplx*) S, &nfft, n/2, 1, FFTW_BACKWARD, plan_mode);
+		if (fft[i] == NULL) shtns_runerr("[FFTW] block fft planning failed !");
+		ifft[i] = NULL;
+	  #if _GCC_VEC_ == 0
+		int ncplx = NPHI/2 +1;
+		cplx* F = (cplx*) (S + NPHI*nr[1]);
+		ifft[i] = fftw_plan_many_dft_c2r(1, &nfft, n, F, &ncplx, n, 1, S, &nfft, n, 1, plan_mode);
+		if (ifft[i] == NULL) shtns_runerr("[FFTW] block ifft planning failed !");
+	  #endif
+	}
+	VFREE(S);
+	shtns->ifft_blk[0] = ifft[0];		shtns->ifft_blk[1] = ifft[1];
+	shtns->fft_blk[0] = fft[0];
+	__atomic_store_n(&shtns->fft_blk[1], fft[1], __ATOMIC_RELEASE);		// set last, marks the plans as ready (see fused_fft_ready).
+}
+
+/// \internal make sure the block ffts have been planned (only once, even if called concurrently by several threads).
+static void fused_fft_ready(shtns_cfg shtns, int nb, int nbl)
+{
+	if (__atomic_load_n(&shtns->fft_blk[1], __ATOMIC_ACQUIRE) == NULL) {
+		cfg_lock();
+		if (shtns->fft_blk[1] == NULL) plan_fused_fft(shtns, nb, nbl);
+		cfg_unlock();
+	}
+}
+
+/// \internal sets up cfg for transforms restricted to the rings [k0, k0+nb) and [NLAT-k0-nb, NLAT-k0), stored as a
+/// theta-contiguous grid of 2*nb rings (north band followed by the south band), with the fft left to the caller.
+/// tm (size MMAX+1) receives the polar optimization of the block.
+static void fused_block_cfg(shtns_cfg shtns, struct shtns_info* cfg, unsigned short* tm, int k0, int nb)
+{
+	*cfg = *shtns;
+	cfg->nthreads = 1;		// the blocks are distributed among the threads.
+	cfg->nlat = 2*nb;		cfg->nlat_2 = nb;		cfg->nspat = NPHI*2*nb;
+	cfg->ct = shtns->ct + k0;		cfg->st = shtns->st + k0;		cfg->wg = shtns->wg + k0;
+	if (shtns->st_1) cfg->st_1 = shtns->st_1 + k0;
+	cfg->fftc_mode = -1;		cfg->ncplx_fft = -1;
+	cfg->k_stride_a = 1;		cfg->m_stride_a = 2*nb;
+	const int nw = 2*VSIZE2;		// the kernels compute batches of nw rings, which must not cross the end of the block (except for the last one).
+	for (int im=0; im<=MMAX; im++) {
+		int t = shtns->tm[im] - k0;
+		if (t < 0) t = 0;
+		if (t >= nb) t = nb;		// block entirely in the polar region: nothing to compute for this m.
+		else t -= t % nw;
+		tm[im] = t;
+	}
+	cfg->tm = tm;
+}
+
+/// \internal transpose the n1 x n2 matrix in into out.
+static void fused_transpose(const double* in, double* out, int n1, int n2)
+{
+	for (long i=0; i<n1; i++)
+		for (long j=0; j<n2; j++)	out[j*n1 + i] = in[i*n2 + j];
+}
+
+/// \internal fused transform done on the whole grid at once with the regular transforms, when it cannot be split into blocks.
+static void fused_whole_grid(shtns_cfg shtns, int nqi, cplx **Qi, int nvi, cplx **Si, cplx **Ti,
+		shtns_spat_op op, void* data, int nqo, cplx **Qo, int nvo, cplx **So, cplx **To)
+{
+	const int nin = nqi + 2*nvi;
+	const int nout = nqo + 2*nvo;
+	const size_t nsp = (shtns->nspat + 7) & ~((size_t) 7);
+	const int transpose = (NPHI > 1) && (shtns->layout & SHT_PHI_CONTIGUOUS);		// the user function expects theta-contiguous data.
+	double* V[nin+nout+1];
+
+	double* buf = (double*) shtns_scratch(SCRATCH_FUSED, (nin+nout+transpose)*nsp*sizeof(double) + NLAT*sizeof(int));
+	double* const tmp = buf + (nin+nout)*nsp;
+	int* const lat = (int*) (buf + (nin+nout+transpose)*nsp);
+	for (int f=0; f<nin+nout; f++)	V[f] = buf + f*nsp;
+	for (int j=0; j<NLAT; j++)	lat[j] = j;
+
+	for (int f=0; f<nqi; f++)	SH_to_spat(shtns, Qi[f], V[f]);
+	for (int v=0; v<nvi; v++)	SHsphtor_to_spat(shtns, Si[v], Ti[v], V[nqi+2*v], V[nqi+2*v+1]);
+	if (transpose) for (int f=0; f<nin; f++) {
+		fused_transpose(V[f], tmp, NLAT, NPHI);
+		memcpy(V[f], tmp, NLAT*NPHI*sizeof(double));
+	}
+	op(data, NLAT, lat, V, V+nin);
+	if (transpose) for (int f=nin; f<nin+nout; f++) {
+		fused_transpose(V[f], tmp, NPHI, NLAT);
+		memcpy(V[f], tmp, NLAT*NPHI*sizeof(double));
+	}
+	for (int f=0; f<nqo; f++)	spat_to_SH(shtns, V[nin+f], Qo[f]);
+	for (int v=0; v<nvo; v++)	spat_to_SHsphtor(shtns, V[nin+nqo+2*v], V[nin+nqo+2*v+1], So[v], To[v]);
+}
+
+/// \internal fused transform by blocks of latitudes, with nb pairs of latitudes per block, and nbl for the last one (see \ref fused_blocks).
+/// Each thread processes a contiguous range of blocks and accumulates its own partial output spectra (directly into the output
+/// spectra for the first thread), which are summed once by all threads at the end.
+static void fused_by_blocks(shtns_cfg shtns, int nb, int nbl, int nqi, cplx **Qi, int nvi, cplx **Si, cplx **Ti,
+		shtns_spat_op op, void* data, int nqo, cplx **Qo, int nvo, cplx **So, cplx **To)
+{
+	fused_fft_ready(shtns, nb, nbl);
+
+	const int nin = nqi + 2*nvi;
+	const int nout = nqo + 2*nvo;
+	const int nblk = (NLAT_2 - nbl)/nb + 1;
+	const int nth = (shtns->nthreads < nblk) ? shtns->nthreads : nblk;
+	const size_t nsp = ((size_t) NPHI*2*nbl + 7) & ~((size_t) 7);		// doubles per field on a block.
+  #if _GCC_VEC_
+	const size_t nfr = 0;		// the kernels write the Fourier coefficients in place.
+  #else
+	const size_t nfr = ((size_t) 2*(NPHI/2+1)*2*nbl + 7) & ~((size_t) 7);		// doubles per field for the Fourier coefficients on a block.
+  #endif
+	const size_t nlm2 = (2*NLM + 7) & ~((size_t) 7);		// doubles per spectral field.
+	cplx* Y[nout+1];		// output spectra.
+	for (int f=0; f<nqo; f++)	Y[f] = Qo[f];
+	for (int v=0; v<nvo; v++) {		Y[nqo+2*v] = So[v];		Y[nqo+2*v+1] = To[v];		}
+	// partial output spectra of the other threads.
+	double* const part = (nth > 1) ? (double*) shtns_scratch(SCRATCH_FUSED, (nth-1)*nout*nlm2*sizeof(double)) : NULL;
+	int nt = 1;		// number of threads actually running.
+
+  #pragma omp parallel num_threads(nth)
+  {
+	int ith = 0;
+	#ifdef _OPENMP
+	ith = omp_get_thread_num();
+	#pragma omp single
+	nt = omp_get_num_threads();
+	#endif
+	double *Vin[nin+1], *Bin[nin+1], *Vout[nout+1];
+	double *Bt[nvi+1], *Bp[nvi+1], *Vt[nvo+1], *Vp[nvo+1];
+	cplx *P[nout+1], *Xq[nqo+1], *Xs[nvo+1], *Xt[nvo+1];		// partial spectra of this thread, and spectra of one block.
+	cplx *Pq[nqo+1], *Ps[nvo+1], *Pt[nvo+1];
+
+	double* buf = (double*) shtns_scratch(SCRATCH_FUSED_BLK, ((nin+nout)*nsp + nin*nfr + nout*nlm2)*sizeof(double)
+				+ 2*nbl*sizeof(int) + (MMAX+1)*sizeof(unsigned short));
+	for (int f=0; f<nin; f++) {
+		Vin[f] = buf + f*nsp;
+		Bin[f] = (nfr) ? buf + (nin+nout)*nsp + f*nfr : Vin[f];
+	}
+	for (int f=0; f<nout; f++) {
+		Vout[f] = buf + (nin+f)*nsp;
+		P[f] = (ith == 0) ? Y[f] : (cplx*) (part + ((ith-1)*nout + f)*nlm2);
+	}
+	for (int v=0; v<nvi; v++) {		Bt[v] = Bin[nqi+2*v];		Bp[v] = Bin[nqi+2*v+1];		}
+	for (int v=0; v<nvo; v++) {		Vt[v] = Vout[nqo+2*v];		Vp[v] = Vout[nqo+2*v+1];	}
+	cplx* const X = (cplx*) (buf + (nin+nout)*nsp + nin*nfr);
+	for (int f=0; f<nqo; f++) {		Xq[f] = X + f*(nlm2/2);		Pq[f] = P[f];		}
+	for (int v=0; v<nvo; v++) {
+		Xs[v] = X + (nqo+2*v)*(nlm2/2);		Xt[v] = X + (nqo+2*v+1)*(nlm2/2);
+		Ps[v] = P[nqo+2*v];		Pt[v] = P[nqo+2*v+1];
+	}
+	int* const lat = (int*) (buf + (nin+nout)*nsp + nin*nfr + nout*nlm2);
+	unsigned short* const tm = (unsigned short*) (lat + 2*nbl);
+
+	const int ib0 = (ith*nblk)/nt;		// first block of this thread.
+	const int ib1 = ((ith+1)*nblk)/nt;
+	for (int ib=ib0; ib<ib1; ib++) {
+		struct shtns_info cfg;
+		const int last = (ib == nblk-1);
+		const int k0 = ib*nb;
+		const int n = (last) ? nbl : nb;
+		fused_block_cfg(shtns, &cfg, tm, k0, n);
+		for (int j=0; j<n; j++) {	lat[j] = k0+j;		lat[2*n-1-j] = NLAT-1-k0-j;		}
+
+		// synthesis of all input fields on the block
+		if (nqi > 0)	((pf2ml)fbatch[SHT_TYP_SSY])(&cfg, nqi, Qi, Bin, LMAX);
+		if (nvi > 0)	((pf4ml)fbatch[SHT_TYP_VSY])(&cfg, nvi, Si, Ti, Bt, Bp, LMAX);
+		for (int f=0; f<nin; f++) {
+		  #if _GCC_VEC_
+			fftw_execute_dft(shtns->fft_blk[last], (cplx*) Vin[f], (cplx*) Vin[f]);
+		  #else
+			fftw_execute_dft_c2r(shtns->ifft_blk[last], (cplx*) Bin[f], Vin[f]);
+		  #endif
+		}
+
+		op(data, 2*n, lat, Vin, Vout);
+
+		// analysis of the output fields, accumulated over the blocks of this thread
+		for (int f=0; f<nout; f++)	fftw_execute_dft(shtns->fft_blk[last], (cplx*) Vout[f], (cplx*) Vout[f]);
+		if (nqo > 0)	((pf2ml)fbatch[SHT_TYP_SAN])(&cfg, nqo, Vout, (ib==ib0) ? Pq : Xq, LMAX);
+		if (nvo > 0)	((pf4ml)fbatch[SHT_TYP_VAN])(&cfg, nvo, Vt, Vp, (ib==ib0) ? Ps : Xs, (ib==ib0) ? Pt : Xt, LMAX);
+		if (ib > ib0) {
+			for (int f=0; f<nout; f++)
+				for (long lm=0; lm<NLM; lm++)	P[f][lm] += X[f*(nlm2/2) + lm];
+		}
+	}
+	if (nt > 1) {		// sum the partial spectra of all threads, once they are all complete.
+		#pragma omp barrier
+		#pragma omp for schedule(static)
+		for (long lm=0; lm<NLM; lm++) {
+			for (int f=0; f<nout; f++) {
+				cplx s = Y[f][lm];
+				for (int t=1; t<nt; t++)	s += ((cplx*) (part + ((t-1)*nout + f)*nlm2))[lm];
+				Y[f][lm] = s;
+			}
+		}
+	}
+  }
+}
+
+/// Synthesize nqi scalar fields Qi and nvi vector fields (Si,Ti), apply the user function op to them block by block,
+/// and analyse the nqo scalar and nvo vector fields it returns into Qo and (So,To). See \ref shtns_spat_op.
+void SH_to_spat_op_to_SH(shtns_cfg shtns, int nqi, cplx **Qi, int nvi, cplx **Si, cplx **Ti,
+		shtns_spat_op op, void* data, int nqo, cplx **Qo, int nvo, cplx **So, cplx **To)
+{
+	int nbl;
+	const int nb = fused_blocks(shtns, &nbl);
+	const unsigned vec = (nvi + nvo > 0);
+	if ((nb == 0) || (shtns->fused_sep & (1U << vec))) {		// cannot split the grid, or separate transforms are faster.
+		fused_whole_grid(shtns, nqi, Qi, nvi, Si, Ti, op, data, nqo, Qo, nvo, So, To);
+		return;
+	}
+	fused_by_blocks(shtns, nb, nbl, nqi, Qi, nvi, Si, Ti, op, data, nqo, Qo, nvo, So, To);
+}
+
+/// \internal user function copying the fields, used to time the fused transforms. data[0] is the number of fields, data[1] is nphi.
+static void fused_copy(void* data, int nlat_blk, const int *lat, double **Vin, double **Vout)
+{
+	const long* d = (const long*) data;
+	for (int f=0; f<d[0]; f++)	memcpy(Vout[f], Vin[f], nlat_blk*d[1]*sizeof(double));
+}
+
+/// \internal measures the time of a fused transform of one scalar field (and one vector field if vec=1),
+/// either by blocks or by separate transforms (first call discarded). Q holds 6 spectra (3 inputs and 3 outputs).
+static double fused_time(shtns_cfg shtns, int vec, int blocks, cplx** Q, int nloop)
+{
+	long d[2] = { 1+2*vec, NPHI };
+	int nbl;
+	const int nb = fused_blocks(shtns, &nbl);
+	ticks tik0 = getticks();
+	for (int i=0; i<=nloop; i++) {
+		if (i==1) tik0 = getticks();
+		if (blocks)	fused_by_blocks(shtns, nb, nbl, 1, Q, vec, Q+1, Q+2, fused_copy, d, 1, Q+3, vec, Q+4, Q+5);
+		else	fused_whole_grid(shtns, 1, Q, vec, Q+1, Q+2, fused_copy, d, 1, Q+3, vec, Q+4, Q+5);
+	}
+	return elapsed(getticks(), tik0) / nloop;
+}
+
+/// \internal chooses between the fused transforms by blocks and separate transforms on the whole grid, for scalar fields only (bit 0
+/// of fused_sep) and with vector fields (bit 1), by timing both (medians of interleaved trials) with one field of each kind.
+/// Called by shtns_set_grid_auto() after the tuning of the regular transforms (without holding cfg_lock), with the same number of threads.
+/// The blocks are kept unless separate transforms are significantly faster, and always for large grids (see SHT_FUSED_GRID_BYTES).
+/// If it is not called (quick init or predicted config), the blocks are used.
+static void choose_fused(shtns_cfg shtns)
+{
+	int nbl;
+	unsigned sel = 0;
+	if ((fused_blocks(shtns, &nbl) > 0) && (shtns->nspat*sizeof(double) <= SHT_FUSED_GRID_BYTES)) {
+		const int nloop = (NLM > 400000) ? 1 : 3;
+		const long nlm = (NLM + 3) & ~3L;
+		cplx* Q[6];
+		Q[0] = (cplx*) VMALLOC(6*nlm*sizeof(cplx));
+		memset(Q[0], 0, 6*nlm*sizeof(cplx));
+		for (int i=1; i<6; i++)	Q[i] = Q[0] + i*nlm;
+		for (int vec=0; vec<=1; vec++) {
+			if ((vec) && (shtns->mx_stdt == NULL)) break;		// no vector transforms (SHT_SCALAR_ONLY).
+			double tb[SHT_TRIALS_MIN], ts[SHT_TRIALS_MIN], lo, hi, lo2, hi2;
+			for (int i=0; i<SHT_TRIALS_MIN; i++) {		// interleaved trials, in alternating order.
+				if (i & 1) {	ts[i] = fused_time(shtns, vec, 0, Q, nloop);	tb[i] = fused_time(shtns, vec, 1, Q, nloop);	}
+				else {			tb[i] = fused_time(shtns, vec, 1, Q, nloop);	ts[i] = fused_time(shtns, vec, 0, Q, nloop);	}
+			}
+			trial_stats(tb, SHT_TRIALS_MIN, &lo, &hi);		// also sorts the trials.
+			trial_stats(ts, SHT_TRIALS_MIN, &lo2, &hi2);
+			if (hi2 < lo) sel |= 1U << vec;		// separate transforms only if significantly faster.
+			#if SHT_VERBOSE > 1
+			if (verbose>1) printf("  fused %s : blocks %.3g, separate %.3g\n", (vec) ? "scalar and vector" : "scalar", tb[SHT_TRIALS_MIN/2], ts[SHT_TRIALS_MIN/2]);
+			#endif
+		}
+		VFREE(Q[0]);
+	}
+	shtns->fused_sep = sel;
+}
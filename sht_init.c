@@ -27,6 +27,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 // global variables definitions
 #include "sht_private.h"
 
@@ -40,10 +43,18 @@ shtns_cfg sht_data = NULL;
   #if HAVE_LIBFFTW3_OMP
 	#define OMP_FFTW
   #endif
+  #if HAVE_LIBFFTW3F_OMP
+	#define OMP_FFTWF
+  #endif
 #else
   #define omp_threads 1
 #endif
 
+// the float transforms use single precision ffts if available, with the Fourier layout of the fixed-m kernels.
+#if defined(HAVE_LIBFFTW3F) && !defined(SHTNS_MEM) && !defined(HAVE_LIBCUFFT)
+	#define SHT_FLOAT_FFT
+#endif
+
 #ifdef HAVE_LIBCUFFT
 	int cuda_gpu_id = 0;	// by default, use gpu device 0
 #endif
@@ -53,6 +64,43 @@ void shtns_verbose(int v) {
 	verbose = v;
 }
 
+static double tuning_budget = SHT_TIME_LIMIT;		// time budget for timing the algorithms of each transform type (seconds).
+
+void shtns_tuning_budget(double seconds) {
+	tuning_budget = (seconds > 0.0) ? seconds : SHT_TIME_LIMIT;
+}
+
+// lock protecting sht_data, sht_func and fftw planning against concurrent creation or destruction of configs.
+static pthread_mutex_t cfg_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread int cfg_lock_depth = 0;		// allows nested locking by the same thread.
+
+/// \internal acquire the global configuration lock (can be nested).
+static void cfg_lock()
+{
+	if (cfg_lock_depth++ == 0)	pthread_mutex_lock(&cfg_mutex);
+}
+
+/// \internal release the global configuration lock.
+static void cfg_unlock()
+{
+	if (--cfg_lock_depth == 0)	pthread_mutex_unlock(&cfg_mutex);
+}
+
+static unsigned long cfg_serial = 0;		// number of configs created so far.
+
+/// \internal give a config a unique serial number, which also marks its arrays as complete and shareable (cfg_lock must be held).
+static void cfg_ready(shtns_cfg shtns)
+{
+	shtns->serial = ++cfg_serial;
+}
+
+/// \internal add a new config to the list of configs (cfg_lock must be held). Its arrays are not shared before \ref cfg_ready is called.
+static void cfg_track(shtns_cfg shtns)
+{
+	shtns->next = sht_data;		// reference of previous setup (may be NULL).
+	sht_data = shtns;			// keep track of new setup.
+}
+
 
 /// \internal Abort program with error message.
 static void shtns_runerr(const char * error_text)
@@ -142,11 +190,19 @@ static int fft_int(int n, int fmax)
 	return n;
 }
 
+static double trial_stats(double* t, int n, double* lo, double* hi);		// used by choose_cplx and choose_fused, defined with the tuning below.
+
 /*	SHT FUNCTIONS  */
 #include "sht_func.c"
 
+#include "sht_points.c"
+
 #include "sht_com.c"
 
+#include "sht_float.c"
+
+#include "sht_fused.c"
+
 /*
 	INTERNAL INITIALIZATION FUNCTIONS
 */
@@ -174,13 +230,16 @@ extern void* ffly_m[6][SHT_NTYP];
 extern void* ffly_m0[6][SHT_NTYP];
 #ifdef _OPENMP
 extern void* fomp[6][SHT_NTYP];
+extern void* fomp_m0[6][SHT_NTYP];
+extern void* fomp_m[6][SHT_NTYP];
 #endif
 #ifdef HAVE_LIBCUFFT
 extern void* fgpu[4][SHT_NTYP];
 #endif
 
-// big array holding all sht functions, variants and algorithms
-void* sht_func[SHT_NVAR][SHT_NALG][SHT_NTYP];
+// big array holding all sht functions, variants and algorithms. Its content depends on the grid (see fill_sht_func),
+// so each thread has its own: configs can be initialized concurrently without holding cfg_lock.
+static __thread void* sht_func[SHT_NVAR][SHT_NALG][SHT_NTYP];
 
 /// \internal use on-the-fly alogorithm (guess without measuring)
 static void set_sht_fly(shtns_cfg shtns, int typ_start)
@@ -190,6 +249,7 @@ static void set_sht_fly(shtns_cfg shtns, int typ_start)
 	for (int it=typ_start; it<SHT_NTYP; it++) {
 		for (int v=0; v<SHT_NVAR; v++)
 			shtns->ftable[v][it] = sht_func[v][algo][it];
+		shtns->fseq[it] = sht_func[SHT_STD][SHT_FLY2][it];
 	}
 }
 
@@ -211,13 +271,14 @@ static void set_sht_mem(shtns_cfg shtns) {
 		for (int v=0; v<SHT_NVAR; v++)
 			shtns->ftable[v][it] = sht_func[v][SHT_MEM][it];
 		shtns->ftable[SHT_M][it] = sht_func[SHT_M][SHT_FLY2][it];		// there is no "mem" algo for SHT_M
+		shtns->fseq[it] = sht_func[SHT_STD][SHT_MEM][it];
 	}
 }
 #endif
 
-/// \internal copy all algos to sht_func array (should be called by set_grid before choosing variants).
+/// \internal copy all algos available for the grid of shtns to the sht_func array of the calling thread.
 /// if nphi is 1, axisymmetric algorithms are used.
-static void init_sht_array_func(shtns_cfg shtns)
+static void fill_sht_func(shtns_cfg shtns)
 {
 	int it, j;
 	int alg_lim = SHT_FLY8;
@@ -249,6 +310,11 @@ static void init_sht_array_func(shtns_cfg shtns)
 			memcpy(sht_func[SHT_STD][SHT_FLY1 + j], &ffly_m0[j], sizeof(void*)*SHT_NTYP);
 			memcpy(sht_func[SHT_LTR][SHT_FLY1 + j], &ffly_m0[j], sizeof(void*)*SHT_NTYP);
 			memcpy(sht_func[SHT_M][SHT_FLY1 + j], &ffly_m[j], sizeof(void*)*SHT_NTYP);
+		  #ifdef _OPENMP
+			memcpy(sht_func[SHT_STD][SHT_OMP1 + j], &fomp_m0[j], sizeof(void*)*SHT_NTYP);		// latitudes split among threads
+			memcpy(sht_func[SHT_LTR][SHT_OMP1 + j], &fomp_m0[j], sizeof(void*)*SHT_NTYP);
+			memcpy(sht_func[SHT_M][SHT_OMP1 + j], &fomp_m[j], sizeof(void*)*SHT_NTYP);
+		  #endif
 		}
 	  #ifdef SHTNS_MEM
 		memcpy(sht_func[SHT_STD][SHT_MEM], &fmem_m0, sizeof(void*)*SHT_NTYP);
@@ -262,7 +328,7 @@ static void init_sht_array_func(shtns_cfg shtns)
 		  #ifdef _OPENMP
 			memcpy(sht_func[SHT_STD][SHT_OMP1 + j], &fomp[j], sizeof(void*)*SHT_NTYP);
 			memcpy(sht_func[SHT_LTR][SHT_OMP1 + j], &fomp[j], sizeof(void*)*SHT_NTYP);
-			memcpy(sht_func[SHT_M][SHT_OMP1 + j], &ffly_m[j], sizeof(void*)*SHT_NTYP);		// no omp algo for SHT_M, use fly instead
+			memcpy(sht_func[SHT_M][SHT_OMP1 + j], &fomp_m[j], sizeof(void*)*SHT_NTYP);		// latitudes split among threads
 		  #endif
 		}
 	  #ifdef SHTNS_MEM
@@ -276,7 +342,12 @@ static void init_sht_array_func(shtns_cfg shtns)
 		}
 	  #endif
 	}
+}
 
+/// \internal copy all algos to sht_func array and set the default ones (should be called by set_grid before choosing variants).
+static void init_sht_array_func(shtns_cfg shtns)
+{
+	fill_sht_func(shtns);
 	#ifdef SHTNS_MEM
 	set_sht_mem(shtns);		// default transform is MEM
 	#else
@@ -315,6 +386,12 @@ static int ref_count(shtns_cfg shtns, void* pp)
 	return nref;		// will be >= 1 (as shtns is included in search)
 }
 
+/// \internal returns 1 if p points into the read-only file mapping of shtns (see \ref shtns_load), which must not be freed.
+static int cfg_mapped(shtns_cfg shtns, void* p)
+{
+	return (shtns->map_base != NULL) && ((char*)p >= (char*)shtns->map_base) && ((char*)p < (char*)shtns->map_base + shtns->map_size);
+}
+
 /// \internal check if the memory location *pp is referenced by another sht config before freeing it.
 /// returns the number of other references, or -1 on error. If >=1, the memory location could not be freed.
 /// If the return value is 0, the ressource has been freed.
@@ -324,12 +401,42 @@ static int free_unused(shtns_cfg shtns, void* pp)
 	if (n <= 0) return n;		// nothing to free.
 	if (n == 1) {				// no other reference found...
 		void** ap = (void**) pp;
-		free(*ap);		// ...so we can free it...
+		if (!cfg_mapped(shtns, *ap))	free(*ap);		// ...so we can free it...
 		*ap = NULL;		// ...and mark as unaloccated.
 	}
 	return (n-1);
 }
 
+/// \internal returns the size in bytes of the data of a precomputed matrix (without its array of pointers):
+/// k=0 for ylm, 1 for dylm, 2 for zlm and 3 for dzlm. With m0_only, the size of ylm or zlm reduced to m=0.
+static size_t mem_matrix_size(shtns_cfg shtns, int k, int m0_only)
+{
+	long int lstride;
+	size_t size = 0;
+
+	switch(k) {
+		case 0 :		/* ylm */
+			if (m0_only) return (LMAX+2)*NLAT_2*sizeof(double);
+			lstride = (LMAX+1);		lstride += (lstride&1);		// even stride.
+			size = sizeof(double) * ((NLM-(LMAX+1)+lstride)*NLAT_2);
+			if (MMAX == 0) size += 3*sizeof(double);			// some overflow needed.
+			break;
+		case 1 :		/* dylm */
+			lstride = LMAX;		lstride += (lstride&1);		// even stride.
+			size = sizeof(struct DtDp) * ((NLM-(LMAX+1) +lstride/2)*NLAT_2);
+			if (MMAX == 0) size += 2*sizeof(double);	// some overflow needed.
+			break;
+		case 2 :		/* zlm */
+			if (m0_only) return ((LMAX+1)*NLAT_2 +3)*sizeof(double);
+			size = sizeof(double) * (NLM*NLAT_2 + (NLAT_2 & 1));
+			if (MMAX == 0) size += 2*(NLAT_2 & 1)*((LMAX+1) & 1) * sizeof(double);
+			break;
+		case 3 :		/* dzlm */
+			size = sizeof(struct DtDp)* (NLM-1)*NLAT_2;		// remove l=0
+	}
+	return size;
+}
+
 #ifdef SHTNS_MEM
 /// \internal Free matrices if on-the-fly has been selected.
 static void free_unused_matrices(shtns_cfg shtns)
@@ -369,7 +476,8 @@ static void free_unused_matrices(shtns_cfg shtns)
 	} else if (shtns->mmax > 0) {	// scalar may be reduced to m=0
 		if ((count[SHT_TYP_SAN] == 0) && (ref_count(shtns, &shtns->zlm) == 1)) {
 			PRINT_VERB("keeping scalar analysis matrix up to m=0\n");
-			shtns->zlm = realloc(shtns->zlm, ((LMAX+1)*NLAT_2 +3)*sizeof(double) + marray_size );
+			shtns->zlm = realloc(shtns->zlm, mem_matrix_size(shtns, 2, 1) + marray_size );
+			for (int im=1; im<=MMAX; im++)	shtns->zlm[im] = NULL;		// m>0 is gone.
 		}
 	}
 	if (count[SHT_TYP_3SY] == 0) {		// synthesis may be freed.
@@ -384,7 +492,8 @@ static void free_unused_matrices(shtns_cfg shtns)
 	} else if (shtns->mmax > 0) {	// scalar may be reduced to m=0
 		if ((count[SHT_TYP_SSY] == 0) && (ref_count(shtns, &shtns->ylm) == 1)) {
 			PRINT_VERB("keeping scalar synthesis matrix up to m=0\n");
-			shtns->ylm = realloc(shtns->ylm, (LMAX+2)*NLAT_2*sizeof(double) + marray_size );
+			shtns->ylm = realloc(shtns->ylm, mem_matrix_size(shtns, 0, 1) + marray_size );
+			for (int im=1; im<=MMAX; im++)	shtns->ylm[im] = NULL;		// m>0 is gone.
 		}
 	}
 }
@@ -394,7 +503,7 @@ static void free_unused_matrices(shtns_cfg shtns)
 static void alloc_SHTarrays(shtns_cfg shtns, int on_the_fly, int vect, int analys)
 {
 	long int im, l0;
-	long int size, marray_size, lstride;
+	long int marray_size, lstride;
 
 	im = (VSIZE2 > 2) ? VSIZE2 : 2;
 	l0 = ((NLAT+im-1)/im)*im;		// align on vector
@@ -409,34 +518,27 @@ static void alloc_SHTarrays(shtns_cfg shtns, int on_the_fly, int vect, int analy
 
 		/* ylm */
 		lstride = (LMAX+1);		lstride += (lstride&1);		// even stride.
-		size = sizeof(double) * ((NLM-(LMAX+1)+lstride)*NLAT_2);
-		if (MMAX == 0) size += 3*sizeof(double);			// some overflow needed.
-		shtns->ylm = (double **) malloc( marray_size + size );
+		shtns->ylm = (double **) malloc( marray_size + mem_matrix_size(shtns, 0, 0) );
 		shtns->ylm[0] = (double *) PTR_ALIGN( shtns->ylm + (MMAX+1) );
 		if (MMAX>0) shtns->ylm[1] = shtns->ylm[0] + NLAT_2*lstride;
 		for (im=1; im<MMAX; im++) shtns->ylm[im+1] = shtns->ylm[im] + NLAT_2*(LMAX+1-im*MRES);
 		/* dylm */		
 		if (vect) {
 			lstride = LMAX;		lstride += (lstride&1);		// even stride.
-			size = sizeof(struct DtDp) * ((NLM-(LMAX+1) +lstride/2)*NLAT_2);
-			if (MMAX == 0) size += 2*sizeof(double);	// some overflow needed.
-			shtns->dylm = (struct DtDp **) malloc( marray_size + size );
+			shtns->dylm = (struct DtDp **) malloc( marray_size + mem_matrix_size(shtns, 1, 0) );
 			shtns->dylm[0] = (struct DtDp *) PTR_ALIGN( shtns->dylm + (MMAX+1) );
 			if (MMAX>0) shtns->dylm[1] = shtns->dylm[0] + (lstride/2)*NLAT_2;		// phi-derivative is zero for m=0
 			for (im=1; im<MMAX; im++) shtns->dylm[im+1] = shtns->dylm[im] + NLAT_2*(LMAX+1-im*MRES);
 		}
 		if (analys) {
 			/* zlm */
-			size = sizeof(double) * (NLM*NLAT_2 + (NLAT_2 & 1));
-			if (MMAX == 0) size += 2*(NLAT_2 & 1)*((LMAX+1) & 1) * sizeof(double);
-			shtns->zlm = (double **) malloc( marray_size + size );
+			shtns->zlm = (double **) malloc( marray_size + mem_matrix_size(shtns, 2, 0) );
 			shtns->zlm[0] = (double *) PTR_ALIGN( shtns->zlm + (MMAX+1) );
 			if (MMAX>0) shtns->zlm[1] = shtns->zlm[0] + NLAT_2*(LMAX+1) + (NLAT_2&1);
 			for (im=1; im<MMAX; im++) shtns->zlm[im+1] = shtns->zlm[im] + NLAT_2*(LMAX+1-im*MRES);
 			/* dzlm */
 			if (vect) {
-				size = sizeof(struct DtDp)* (NLM-1)*NLAT_2;		// remove l=0
-				shtns->dzlm = (struct DtDp **) malloc( marray_size + size );
+				shtns->dzlm = (struct DtDp **) malloc( marray_size + mem_matrix_size(shtns, 3, 0) );
 				shtns->dzlm[0] = (struct DtDp *) PTR_ALIGN( shtns->dzlm + (MMAX+1) );
 				if (MMAX>0) shtns->dzlm[1] = shtns->dzlm[0] + NLAT_2*(LMAX);
 				for (im=1; im<MMAX; im++) shtns->dzlm[im+1] = shtns->dzlm[im] + NLAT_2*(LMAX+1-im*MRES);
@@ -457,12 +559,25 @@ static void free_SHTarrays(shtns_cfg shtns)
 	free_unused(shtns, &shtns->zlm);
 	free_unused(shtns, &shtns->dzlm);
 
-	if (ref_count(shtns, &shtns->ct) == 1)	VFREE(shtns->ct);
+	if ((ref_count(shtns, &shtns->ct) == 1) && (!cfg_mapped(shtns, shtns->ct)))	VFREE(shtns->ct);
 	shtns->ct = NULL;		shtns->st = NULL;
 
 	if (ref_count(shtns, &shtns->fft) == 1)  fftw_destroy_plan(shtns->fft);
 	if (ref_count(shtns, &shtns->ifft) == 1) fftw_destroy_plan(shtns->ifft);
 	shtns->fft = NULL;		shtns->ifft = NULL;		shtns->ncplx_fft = -1;	// no fft
+  #ifdef SHT_FLOAT_FFT
+	if (ref_count(shtns, &shtns->fftf) == 1)  fftwf_destroy_plan(shtns->fftf);
+	if (ref_count(shtns, &shtns->ifftf) == 1) fftwf_destroy_plan(shtns->ifftf);
+  #endif
+	shtns->fftf = NULL;		shtns->ifftf = NULL;
+	for (int i=0; i<2; i++) {
+		if (ref_count(shtns, &shtns->fft_blk[i]) == 1)  fftw_destroy_plan(shtns->fft_blk[i]);
+		if (ref_count(shtns, &shtns->ifft_blk[i]) == 1) fftw_destroy_plan(shtns->ifft_blk[i]);
+		shtns->fft_blk[i] = NULL;		shtns->ifft_blk[i] = NULL;
+	}
+	if (ref_count(shtns, &shtns->fft_cplx) == 1)  fftw_destroy_plan(shtns->fft_cplx);
+	if (ref_count(shtns, &shtns->ifft_cplx) == 1) fftw_destroy_plan(shtns->ifft_cplx);
+	shtns->fft_cplx = NULL;		shtns->ifft_cplx = NULL;		shtns->cplx_fast = 0;		shtns->fused_sep = 0;
 }
 
 #ifndef HAVE_FFTW_COST
@@ -659,30 +774,94 @@ static void planFFT(shtns_cfg shtns, int layout, int on_the_fly)
 }
 
 
+#ifdef _OPENMP
+/// \internal Distribute the orders im>0 among threads for the openmp transforms (used by MSCHED_BALANCED).
+/// The work for order m is estimated as (lmax+1-m)*(nlat_2-tm[im]), and each order is given to the least loaded thread,
+/// starting with the most expensive ones (low m). Thread 0 also handles m=0.
+static void omp_mpartition(shtns_cfg shtns)
+{
+	const int nth = shtns->nthreads;
+	double load[nth];
+	unsigned short owner[MMAX+1];
+
+	free_unused(shtns, &shtns->omp_mlist);
+	if (nth <= 1) return;
+	unsigned short* ml = (unsigned short*) malloc( sizeof(unsigned short) * (MMAX + nth+1) );
+	if (ml == NULL) {	shtns->omp_msched = MSCHED_CYCLIC;	return;  }
+
+	for (int t=0; t<nth; t++) load[t] = 0.0;
+	for (int im=0; im<=MMAX; im++) {		// work decreases with im.
+		int t = 0;
+		double w = (double) (LMAX+1 - im*MRES) * (NLAT_2 - shtns->tm[im]);
+		if (im == 0) w *= 0.5;		// m=0 is real.
+		else for (int i=1; i<nth; i++)	if (load[i] < load[t]) t = i;
+		load[t] += w;		owner[im] = t;
+	}
+	unsigned short* ofs = ml + MMAX;
+	int n = 0;
+	for (int t=0; t<nth; t++) {
+		ofs[t] = n;
+		for (int im=1; im<=MMAX; im++)	if (owner[im] == t) ml[n++] = im;		// increasing im for each thread.
+	}
+	ofs[nth] = n;
+	shtns->omp_mlist = ml;
+  #if SHT_VERBOSE > 1
+	if (verbose>1) {
+		double lmx = 0.0, lsum = 0.0;
+		for (int t=0; t<nth; t++) {	lsum += load[t];	if (load[t] > lmx) lmx = load[t];  }
+		printf("          balanced m partition: max/mean thread load = %.3f\n", lmx*nth/lsum);
+	}
+  #endif
+}
+#endif
+
+/// \internal Returns the largest absolute value of the Legendre functions of order im at latitude it (for polar optimization).
+static double polar_max_ylm(shtns_cfg shtns, int im, int it, double* y)
+{
+	const int m = im*MRES;
+	double v = 0.0;
+	legendre_sphPlm_array(shtns, LMAX, im, shtns->ct[it], y);
+	for (int l=0; l<=LMAX-m; l++) {
+		double ya = fabs(y[l]);
+		if ( v < ya )	v = ya;
+	}
+	return v;
+}
+
 /// \internal Sets the value tm[im] used for polar optimiation on-the-fly.
+/// The orders are processed in chunks distributed among threads: the first order of a chunk finds its threshold
+/// by bisection, the following ones by a linear search starting from the previous order (tm[im] is monotonic).
 static void PolarOptimize(shtns_cfg shtns, double eps)
 {
-	int im, m, l, it;
-	double v;
-	double y[LMAX+1];
+	const int mchunk = 32;
+	int im;
 
 	for (im=0;im<=MMAX;im++)	shtns->tm[im] = 0;
 
 	if (eps > 0.0) {
-		for (im=1;im<=MMAX;im++) {
-			m = im*MRES;
-			it = shtns->tm[im-1] -1;	// tm[im] is monotonic.
-			do {
-				it++;
-				legendre_sphPlm_array(shtns, LMAX, im, shtns->ct[it], y+m);
-				v = 0.0;
-				for (l=m; l<=LMAX; l++) {
-					double ya = fabs(y[l]);
-					if ( v < ya )	v = ya;
-				}
-			} while (v < eps);
-			shtns->tm[im] = it;
+		#pragma omp parallel for schedule(dynamic) num_threads(shtns->nthreads) if((shtns->nthreads > 1) && (MMAX > mchunk))
+		for (int i0=1; i0<=MMAX; i0+=mchunk) {
+			double y[LMAX+1];
+			int it0 = 0;
+			int it1 = NLAT_2-1;
+			while (it0 < it1) {		// bisection for the first order of the chunk.
+				int it = (it0+it1) >> 1;
+				if (polar_max_ylm(shtns, i0, it, y) < eps)	it0 = it+1;
+				else	it1 = it;
+			}
+			shtns->tm[i0] = it0;
+			int i1 = i0 + mchunk;
+			if (i1 > MMAX+1) i1 = MMAX+1;
+			for (int im=i0+1; im<i1; im++) {
+				int it = shtns->tm[im-1] -1;
+				do {
+					it++;
+				} while (polar_max_ylm(shtns, im, it, y) < eps);
+				shtns->tm[im] = it;
+			}
 		}
+		for (im=1;im<=MMAX;im++)	// enforce monotonicity across chunks.
+			if (shtns->tm[im] < shtns->tm[im-1])	shtns->tm[im] = shtns->tm[im-1];
 	#if SHT_VERBOSE > 0
 		if (verbose) printf("        + polar optimization threshold = %.1e\n",eps);
 	#endif
@@ -1088,47 +1267,148 @@ static double get_time(shtns_cfg shtns, int nloop, int npar, char* name, void *f
 		t = elapsed(tik1, tik0)/(nloop-1);		// discard first iteration.
 	}
 	#if SHT_VERBOSE > 1
-	if (verbose>1) {  printf("  t(%s) = %.3g",name,t);	fflush(stdout);  }
+	if ((verbose>1) && (name)) {  printf("  t(%s) = %.3g",name,t);	fflush(stdout);  }
 	#endif
 	return t;
 }
 
 
-/// \internal choose fastest between on-the-fly and gauss algorithms.
-/// *nlp is the number of loops. If zero, it is set to a good value.
-/// on_the_fly : 1 = skip all memory algorithm. 0 = include memory and on-the-fly. -1 = test only DCT.
-/// returns time without dct / best time with dct (or 0 if no dct available).
-static void choose_best_sht(shtns_cfg shtns, int* nlp, int vector)
+/// \internal wall-clock time in seconds.
+static double wall_time()
 {
-	cplx *Qlm=0, *Slm=0, *Tlm=0;
-	double *Qh=0, *Sh=0, *Th=0;
-	int m, i, i0, minc, nloop, alg_end;
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + 1.e-9*ts.tv_nsec;
+}
+
+/// \internal sorts the n timings t[] and returns their median. lo and hi are set to the lower and upper quartiles,
+/// widened to at least 1% of the median (3% with less than 3 trials) to account for the timer resolution.
+static double trial_stats(double* t, int n, double* lo, double* hi)
+{
+	for (int i=1; i<n; i++) {		// insertion sort
+		double x = t[i];
+		int j = i;
+		while ((j > 0) && (t[j-1] > x)) {	t[j] = t[j-1];	j--;  }
+		t[j] = x;
+	}
+	double med = (n & 1) ? t[n/2] : 0.5*(t[n/2-1] + t[n/2]);
+	double w = (n < 3) ? 0.03 : 0.01;
+	*lo = t[n/4];		*hi = t[(3*n-1)/4];
+	if (*lo > med*(1.-w)) *lo = med*(1.-w);
+	if (*hi < med*(1.+w)) *hi = med*(1.+w);
+	return med;
+}
+
+/// \internal preference class of an algorithm, used only to break statistical ties:
+/// on-the-fly first (less memory), then memory-based, then the ones using all threads (or the gpu).
+static int alg_class(int i)
+{
+	if ((i >= SHT_FLY1) && (i <= SHT_FLY8)) return 0;
+	if (i == SHT_MEM) return 1;
+	return 2;
+}
+
+/// \internal buffers used to time the transforms.
+struct tune_buf {
+	cplx *Slm, *Tlm, *Qlm;
+	double *Sh, *Th, *Qh;
+};
+
+/// \internal times the nc algorithms alg[] for transform type ityp of variant iv, truncated at l.
+/// Each trial calls nloop times each algorithm, and the order of the candidates is rotated and reversed between trials to cancel drifts (cpu frequency, load).
+/// Trials stop when the fastest (median) is significantly faster than all the others (its upper quartile below their lower quartiles),
+/// or when the time budget (in seconds) is exhausted, but no less than SHT_TRIALS_MIN trials are done (unless that would take more than 3 times the budget).
+/// Among the algorithms not significantly slower than the fastest, the one with lowest \ref alg_class is chosen.
+/// Returns the index in alg[] of the chosen algorithm, and tmed[] receives the median times. *iseq is set to the fastest single-thread algorithm (or -1).
+static int time_candidates(shtns_cfg shtns, struct tune_buf* b, int iv, int ityp, int l, int nc, const int* alg, int nloop, double budget, double* tmed, int* iseq)
+{
+	double tr[SHT_NALG][SHT_TRIALS_MAX];
+	double lo[SHT_NALG], hi[SHT_NALG], ts[SHT_TRIALS_MAX];
+	int n = 0,  best = 0,  decided = 0;
+
+	const double wt0 = wall_time();
+	do {
+		for (int k=0; k<nc; k++) {
+			int c = (k + n/2) % nc;		// rotate the order ...
+			if (n & 1) c = nc-1-c;		// ... and reverse it every other trial.
+			void *pf = sht_func[iv][alg[c]][ityp];
+			#ifdef SHTNS_STATS
+			const ticks t0 = getticks();
+			#endif
+			if (ityp&1) {	// analysis
+				tr[c][n] = get_time(shtns, nloop, sht_npar[ityp], NULL, pf, b->Sh, b->Th, b->Qh, b->Slm, b->Tlm, b->Qlm, l);
+			} else {
+				tr[c][n] = get_time(shtns, nloop, sht_npar[ityp], NULL, pf, b->Slm, b->Tlm, b->Qlm, b->Sh, b->Th, b->Qh, l);
+			}
+			#ifdef SHTNS_STATS
+			if (sht_trace_on) trace_event(sht_name[alg[c]], TRACE_TUNE, ityp, t0, getticks());
+			#endif
+		}
+		n++;
+		for (int c=0; c<nc; c++) {
+			for (int k=0; k<n; k++) ts[k] = tr[c][k];
+			tmed[c] = trial_stats(ts, n, lo+c, hi+c);
+			if (tmed[c] < tmed[best]) best = c;
+		}
+		decided = 1;
+		for (int c=0; c<nc; c++)
+			if ((c != best) && (lo[c] <= hi[best])) decided = 0;
+		double wt = wall_time() - wt0;
+		if ((n >= SHT_TRIALS_MIN) && (decided || (wt > budget))) break;
+		if (wt*(n+1) > 3*budget*n) break;		// one more trial would exceed the budget too much.
+	} while (n < SHT_TRIALS_MAX);
+
+	int ic = best;
+	*iseq = -1;
+	for (int c=0; c<nc; c++) {
+		if ((alg[c] != SHT_SV) && (alg[c] < SHT_GPU1) && ((*iseq < 0) || (tmed[c] < tmed[*iseq]))) *iseq = c;
+		if (lo[c] > hi[best]) continue;		// significantly slower.
+		int dc = alg_class(alg[c]) - alg_class(alg[ic]);
+		if ((dc < 0) || ((dc == 0) && (tmed[c] < tmed[ic]))) ic = c;
+	}
+	#if SHT_VERBOSE > 1
+	if (verbose>1) {
+		for (int c=0; c<nc; c++)	printf("  t(%s) = %.3g",sht_name[alg[c]], tmed[c]);
+		printf(" => %s [%d trials%s]\n", sht_name[alg[ic]], n, (decided) ? "" : ", not significant");
+	}
+	#endif
+	return ic;
+}
+
+/// \internal choose fastest between on-the-fly and gauss algorithms, for each transform type (see \ref time_candidates).
+/// The SHT_LTR variant is timed separately at a representative truncation (lmax/2), while the SHT_M variant follows the SHT_STD choice.
+/// *nlp is the number of calls in each trial. If zero, it is set to a good value for the scalar synthesis.
+/// The time budget for each transform type is set by \ref shtns_tuning_budget.
+/// cand : if not NULL, only the (at most 2) algorithms cand[ityp][0..1] are timed for each type (-1 = none), and the thread scheduling is not timed.
+static void choose_best_sht(shtns_cfg shtns, int* nlp, int vector, const short cand[SHT_NTYP][2])
+{
+	struct tune_buf b = {0, 0, 0, 0, 0, 0};
+	int i, nloop, alg_end;
 	int typ_lim = SHT_NTYP;		// time every type.
-	double t0, t, tt, r;
-	double tdct, tnodct;
-	clock_t tcpu;
+	double t, t1;
 	int on_the_fly_only = (shtns->ylm == NULL);		// only on-the-fly.
 	int otf_analys = (shtns->wg != NULL);			// on-the-fly analysis supported.
+	const double budget = tuning_budget;
 
 	if (NLAT < VSIZE2*4) return;			// on-the-fly not possible for NLAT_2 < 2*NWAY (overflow).
 
 	size_t nspat = sizeof(double) * NSPAT_ALLOC(shtns);
 	size_t nspec = sizeof(cplx)* NLM;
 	if (nspec>nspat) nspat=nspec;
-	Sh = (double *) VMALLOC(nspat);		Slm = (cplx *) VMALLOC(nspec);
-	if ((Sh==0) || (Slm==0)) shtns_runerr("not enough memory.");
+	b.Sh = (double *) VMALLOC(nspat);		b.Slm = (cplx *) VMALLOC(nspec);
+	if ((b.Sh==0) || (b.Slm==0)) shtns_runerr("not enough memory.");
 	if (vector) {
-		Th = (double *) VMALLOC(nspat);				Qh = (double *) VMALLOC(nspat);
-		Tlm = (cplx *) VMALLOC(nspec);	Qlm = (cplx *) VMALLOC(nspec);
-		if ( (Th==0) || (Qh==0) || (Tlm==0) || (Qlm==0) ) vector = 0;
+		b.Th = (double *) VMALLOC(nspat);				b.Qh = (double *) VMALLOC(nspat);
+		b.Tlm = (cplx *) VMALLOC(nspec);	b.Qlm = (cplx *) VMALLOC(nspec);
+		if ( (b.Th==0) || (b.Qh==0) || (b.Tlm==0) || (b.Qlm==0) ) vector = 0;
 	}
 
 	for (i=0;i<NLM;i++) {
 		int l = shtns->li[i];
-		Slm[i] = shtns->l_2[l] + 0.5*I*shtns->l_2[l];
+		b.Slm[i] = shtns->l_2[l] + 0.5*I*shtns->l_2[l];
 		if (vector) {
-			Tlm[i] = 0.5*shtns->l_2[l] + I*shtns->l_2[l];
-			Qlm[i] = 3*shtns->l_2[l] + 2*I*shtns->l_2[l];
+			b.Tlm[i] = 0.5*shtns->l_2[l] + I*shtns->l_2[l];
+			b.Qlm[i] = 3*shtns->l_2[l] + 2*I*shtns->l_2[l];
 		}
 	}
 
@@ -1138,91 +1418,369 @@ static void choose_best_sht(shtns_cfg shtns, int* nlp, int vector)
 	}
 	#endif
 
+	// wall-clock time of one scalar synthesis (median of 3, after warm-up).
+	{
+		double tw[3], lo, hi;
+		void* pf = sht_func[SHT_STD][SHT_FLY2][SHT_TYP_SSY];
+		(*(pf2l)pf)(shtns, b.Slm, b.Sh, LMAX);
+		for (int k=0; k<3; k++) {
+			tw[k] = wall_time();
+			(*(pf2l)pf)(shtns, b.Slm, b.Sh, LMAX);
+			tw[k] = wall_time() - tw[k];
+		}
+		t1 = trial_stats(tw, 3, &lo, &hi);
+	}
 	if (*nlp <= 0) {
-		// find good nloop by requiring less than 3% difference between 2 consecutive timings.
-		m=0;	nloop = 1;                     // number of loops to get timings.
-		r = 0.0;	tt = 1.0;
-		do {
-			if ((r > 0.03)||(tt<0.1)) {
-				m = 0;		nloop *= 3;
-			} else 	m++;
-			tcpu = clock();
-			t0 = get_time(shtns, nloop, 2, "", sht_func[SHT_STD][SHT_FLY2][SHT_TYP_SSY], Slm, Tlm, Qlm, Sh, Th, Qh, LMAX);
-			tcpu = clock() - tcpu;		tt = 1.e-6 * tcpu;
-			if (tt >= SHT_TIME_LIMIT) break;			// we should not exceed 1 second
-			t = get_time(shtns, nloop, 2, "", sht_func[SHT_STD][SHT_FLY2][SHT_TYP_SSY], Slm, Tlm, Qlm, Sh, Th, Qh, LMAX);
-			r = fabs(2.0*(t-t0)/(t+t0));
-			#if SHT_VERBOSE > 1
-				if (verbose>1) printf(", nloop=%d, r=%g, m=%d (real time = %g s)\n",nloop,r,m,tt);
-				if (tt >= 0.01) break;		// faster timing in debug mode.
-			#endif
-			PRINT_DOT
-		} while((nloop<10000)&&(m < 3));
+		// each trial should last about budget/(SHT_TRIALS_MAX*n_algos), for 16 algorithms.
+		t = budget / (SHT_TRIALS_MAX * 16);
+		nloop = (t1 > 0.0) ? (int) (t / t1) : 1000;
+		if (nloop < 1) nloop = 1;
+		if (nloop > 1000) nloop = 1000;
 		*nlp = nloop;
 	} else {
 		nloop = *nlp;
 	}
 	#if SHT_VERBOSE > 1
-		if (verbose>1) printf(" => nloop=%d (takes %g s)\n",nloop, tt);
+		if (verbose>1) printf(" => nloop=%d (one synthesis takes %g s)\n",nloop, t1);
 	#endif
+  #ifdef _OPENMP
+	if ((shtns->nthreads > 1) && (sht_func[SHT_STD][SHT_OMP2][SHT_TYP_SSY]) && (cand == NULL)) {		// choose how to distribute m among threads.
+		static char* msched_name[MSCHED_N] = { "cyclic", "balanced", "dynamic" };
+		int ms0 = MSCHED_CYCLIC;
+		double t0 = 1e100;
+		for (int ms=0; ms<MSCHED_N; ms++) {
+			if ((ms == MSCHED_BALANCED) && (shtns->omp_mlist == NULL)) continue;
+			shtns->omp_msched = ms;
+			t = get_time(shtns, nloop+1, 2, msched_name[ms], sht_func[SHT_STD][SHT_OMP2][SHT_TYP_SSY], b.Slm, b.Tlm, b.Qlm, b.Sh, b.Th, b.Qh, LMAX);
+			if (otf_analys) t += get_time(shtns, nloop+1, 2, msched_name[ms], sht_func[SHT_STD][SHT_OMP2][SHT_TYP_SAN], b.Sh, b.Th, b.Qh, b.Slm, b.Tlm, b.Qlm, LMAX);
+			if (t < t0) {	ms0 = ms;	t0 = t;  }
+		}
+		shtns->omp_msched = ms0;
+		#if SHT_VERBOSE > 1
+			if (verbose>1) printf(" => m scheduling: %s\n", msched_name[ms0]);
+		#endif
+	}
+  #endif
 	if (vector == 0)	typ_lim = SHT_TYP_VSY;		// time only scalar transforms.
-//	if (tt > 3.0)		typ_lim = SHT_TYP_VSY;		// time only scalar transforms.
-//	if (tt > 10.0)	goto done;		// timing this will be too slow...
 
 	int ityp = 0;	do {
-		if (ityp == 2) nloop = (nloop+1)/2;		// scalar ar done.
-		t0 = 1e100;
-		i0 = SHT_MEM;
-		if (on_the_fly_only) i0 = SHT_SV;		// only on-the-fly (SV is then also on-the-fly)
+		int alg[SHT_NALG], nc = 0;
+		double tmed[SHT_NALG];
+		int nl = nloop;
+		if (ityp >= SHT_TYP_VSY) nl = (nloop+1)/2;		// vector transforms are about twice as expensive.
+		i = (on_the_fly_only) ? SHT_SV : SHT_MEM;		// only on-the-fly (SV is then also on-the-fly)
 		alg_end = SHT_NALG;
 		if (shtns->nthreads <= 1) alg_end = SHT_OMP1;		// no OpenMP with 1 thread.
 		if ((ityp&1) && (otf_analys == 0)) alg_end = SHT_FLY1;		// no on-the-fly analysis for regular grid.
-		for (i=i0, m=0;	i<alg_end; i++) {
-			if (sht_func[0][i][ityp] != NULL) m++;		// count number of algos
+		for (; i<alg_end; i++) {
+			if ((cand) && (i != cand[ityp][0]) && (i != cand[ityp][1])) continue;		// not a candidate.
+			if (sht_func[SHT_STD][i][ityp] != NULL) alg[nc++] = i;		// list the algorithms
 		}
-		if (m >= 2) {		// don't time if there is only 1 algo !
+		if (nc >= 2) {		// don't time if there is only 1 algo !
+			int iseq;
 			#if SHT_VERBOSE > 1
 			if (verbose>1) {  printf("finding best %s ...",sht_type[ityp]);	fflush(stdout);  }
 			#endif
-			i = i0-1;		i0 = -1;
-			while (++i < alg_end) {
-				void *pf = sht_func[0][i][ityp];
-				if (pf != NULL) {
-					if (ityp&1) {	// analysis
-						t = get_time(shtns, nloop, sht_npar[ityp], sht_name[i], pf, Sh, Th, Qh, Slm, Tlm, Qlm, LMAX);
-					} else {
-						t = get_time(shtns, nloop, sht_npar[ityp], sht_name[i], pf, Slm, Tlm, Qlm, Sh, Th, Qh, LMAX);
-					}
-					if (i < SHT_FLY1) t *= 1.03;	// 3% penality for memory based transforms.
-				#ifdef _OPENMP
-					if ((shtns->nthreads > 1) && ((i >= SHT_OMP1)||(i == SHT_SV))) t *= 1.3;	// 30% penality for openmp transforms.
-				#endif
-					if (t < t0) {	i0 = i;		t0 = t;		PRINT_VERB("*");	}
+			int ic = time_candidates(shtns, &b, SHT_STD, ityp, LMAX, nc, alg, nl, budget, tmed, &iseq);
+			for (int iv=0; iv<SHT_NVAR; iv++) {
+				if (iv == SHT_LTR) continue;		// timed below
+				if (sht_func[iv][alg[ic]][ityp]) shtns->ftable[iv][ityp] = sht_func[iv][alg[ic]][ityp];
+				if (ityp == 4) {		// only one timing for both gradients variants.
+					if (sht_func[iv][alg[ic]][ityp+1]) shtns->ftable[iv][ityp+1] = sht_func[iv][alg[ic]][ityp+1];
 				}
 			}
-			if (i0 >= 0) {
-				for (int iv=0; iv<SHT_NVAR; iv++) {
-					if (sht_func[iv][i0][ityp]) shtns->ftable[iv][ityp] = sht_func[iv][i0][ityp];
-					if (ityp == 4) {		// only one timing for both gradients variants.
-						if (sht_func[iv][i0][ityp+1]) shtns->ftable[iv][ityp+1] = sht_func[iv][i0][ityp+1];
-					}
-				}
-				PRINT_DOT
+			if (iseq >= 0) {
+				shtns->fseq[ityp] = sht_func[SHT_STD][alg[iseq]][ityp];
+				if (ityp == 4) shtns->fseq[ityp+1] = sht_func[SHT_STD][alg[iseq]][ityp+1];
+			}
+			// truncated transforms: time the ltr variants at l=lmax/2, where the best choice may differ.
+			int ltr = LMAX/2;
+			for (i=0, nc=0; i<alg_end; i++) {
+				if ((cand) && (i != cand[ityp][0]) && (i != cand[ityp][1])) continue;
+				if ((i < SHT_SV) && (on_the_fly_only)) continue;
+				if (sht_func[SHT_LTR][i][ityp] != NULL) alg[nc++] = i;
+			}
+			if ((nc >= 2) && (ltr >= 8)) {
 				#if SHT_VERBOSE > 1
-					if (verbose>1) printf(" => %s\n",sht_name[i0]);
+				if (verbose>1) {  printf("finding best %s at l=%d ...",sht_type[ityp], ltr);	fflush(stdout);  }
 				#endif
+				ic = time_candidates(shtns, &b, SHT_LTR, ityp, ltr, nc, alg, nl, budget/2, tmed, &iseq);
+			} else ic = -1;
+			for (int k=0; k<=(ityp == 4); k++) {
+				void* f = (ic >= 0) ? sht_func[SHT_LTR][alg[ic]][ityp+k] : NULL;
+				if (f == NULL) {		// fall back to the SHT_STD choice.
+					for (i=0; i<SHT_NALG; i++)
+						if ((sht_func[SHT_STD][i][ityp+k]) && (sht_func[SHT_STD][i][ityp+k] == shtns->ftable[SHT_STD][ityp+k]))  f = sht_func[SHT_LTR][i][ityp+k];
+				}
+				if (f) shtns->ftable[SHT_LTR][ityp+k] = f;
 			}
+			PRINT_DOT
 		}
 		if (ityp == 4) ityp++;		// skip second gradient
 	} while(++ityp < typ_lim);
 
-done:
+  #ifdef _OPENMP
+	if ((shtns->nthreads > 1) && (cand == NULL)) {		// multi-shell transforms: distribute the shells among threads, or use all threads for each shell ?
+		const int nsh = shtns->nthreads;
+		const long nsp = ((nspat / sizeof(double)) + 7) & ~7L;		// keep each shell aligned on 64 bytes.
+		double* Vs = (double *) VMALLOC(nsp * nsh * sizeof(double));
+		cplx* Qs = (cplx *) VMALLOC(nspec * nsh);
+		if ((Vs) && (Qs)) {
+			double tsh[2];
+			for (int k=0; k<nsh; k++)	memcpy(Qs + k*NLM, b.Slm, nspec);
+			for (int p=0; p<2; p++) {
+				ticks tik0, tik1;
+				shtns->omp_shells = p;
+				SH_to_spat_shells(shtns, nsh, Qs, NLM, Vs, nsp);		// warm-up
+				tik0 = getticks();
+				for (i=0; i<nloop; i++) {
+					SH_to_spat_shells(shtns, nsh, Qs, NLM, Vs, nsp);
+					if (otf_analys) spat_to_SH_shells(shtns, nsh, Vs, nsp, Qs, NLM);
+				}
+				tik1 = getticks();
+				tsh[p] = elapsed(tik1, tik0);
+			}
+			shtns->omp_shells = (tsh[1] < tsh[0]);
+			#if SHT_VERBOSE > 1
+				if (verbose>1) printf(" => shells: %s\n", (shtns->omp_shells) ? "distributed among threads" : "one after the other");
+			#endif
+		}
+		if (Qs) VFREE(Qs);
+		if (Vs) VFREE(Vs);
+	}
+  #endif
+
 	#if SHT_VERBOSE > 0
 		if (verbose) printf("\n");
 	#endif
-	if (Qlm) VFREE(Qlm);		if (Tlm) VFREE(Tlm);
-	if (Qh)  VFREE(Qh);			if (Th)  VFREE(Th);
-	if (Slm) VFREE(Slm);	 	if (Sh)  VFREE(Sh);
+	if (b.Qlm) VFREE(b.Qlm);		if (b.Tlm) VFREE(b.Tlm);
+	if (b.Qh)  VFREE(b.Qh);			if (b.Th)  VFREE(b.Th);
+	if (b.Slm) VFREE(b.Slm);	 	if (b.Sh)  VFREE(b.Sh);
+}
+
+#include "sht_roofline.c"
+
+/// \internal size in bytes of the level 1 data cache (level=1) or of the level 2 cache (level=2), with a sensible default.
+static long cache_size(int level)
+{
+	long sz = 0;
+  #ifdef _SC_LEVEL1_DCACHE_SIZE
+	sz = sysconf((level == 1) ? _SC_LEVEL1_DCACHE_SIZE : _SC_LEVEL2_CACHE_SIZE);
+  #endif
+	if (sz <= 0) sz = (level == 1) ? 32*1024 : 1024*1024;
+	return sz;
+}
+
+/// \internal analytic cost model of the on-the-fly transforms (in vector flops).
+/// The inner loop over l processes nway blocks of VSIZE2 latitudes: each block costs the recurrence and the accumulations,
+/// while the recurrence coefficients and spectral data are loaded once for all the blocks. The blocks that do not fit
+/// in the registers are spilled to memory, and the coefficients come from a slower cache level when they don't fit in L1.
+// live vector registers per block, vector flops per block and per l, broadcasts per l (for syn, ana, vsy, van, gsp, gto, v3s, v3a).
+static const char reg_way[SHT_NTYP] = {7, 7, 11, 11, 9, 9, 15, 15};
+static const char flop_l[SHT_NTYP] = {5, 5, 9, 9, 7, 7, 11, 11};
+static const char load_l[SHT_NTYP] = {4, 4, 6, 6, 4, 4, 8, 8};
+static const char nfield[SHT_NTYP] = {1, 1, 2, 2, 1, 1, 3, 3};
+// flops of the recurrence per block and per l (not done by the algorithm using precomputed matrices), and number of matrices read.
+static const char flop_rec = 3;
+static const char nmat[SHT_NTYP] = {1, 1, 2, 2, 2, 2, 3, 3};
+static const char nway_alg[6] = {1, 2, 3, 4, 6, 8};		// nway of algorithms SHT_FLY1 ... SHT_FLY8
+// The following are rough orders of magnitude: the model only needs to rank the algorithms, and the two best
+// candidates can still be timed (SHT_PREDICT_CHECK).
+// cost of a load relative to L1, when the streamed data only fits in L2, or not even in L2 (ratio of typical x86 latencies).
+#define FLY_LOAD_L2 3
+#define FLY_LOAD_MEM 8
+// openmp transforms: the work of nth threads is unbalanced by about 10%, and each fork/join costs about 2e4 vector flops per thread.
+#define OMP_IMBALANCE 1.1
+#define OMP_FORK_COST 2.e4
+
+/// \internal predicted cost of the openmp version of an algorithm of single-thread cost c.
+static inline double omp_cost(double c, int nth)
+{
+	return c * (OMP_IMBALANCE/nth) + OMP_FORK_COST*nth;
+}
+
+/// \internal number of blocks of VSIZE2 latitudes for order im (before the polar optimization is done, all latitudes are included).
+static inline int fly_nk(shtns_cfg shtns, int im)
+{
+	const int k0 = (shtns->ct) ? shtns->tm[im] : 0;
+	return (NLAT_2 - k0 + VSIZE2-1) / VSIZE2;
+}
+
+static double fly_cost(shtns_cfg shtns, int nway, int ityp)
+{
+	const int nregs = (VSIZE2 >= 8) ? 32 : 16;		// number of SIMD registers (AVX-512 has 32).
+	double spill, load, c;
+
+	// data streamed for each group of blocks: recurrence coefficients and spectral coefficients (for m=0, the largest).
+	size_t wset = (size_t) (LMAX+2) * 16 * (1 + nfield[ityp]);
+	load = load_l[ityp];
+	if (wset > (size_t) cache_size(2))	load *= FLY_LOAD_MEM;
+	else if (wset > (size_t) cache_size(1))	load *= FLY_LOAD_L2;
+	spill = reg_way[ityp]*nway + 4 - nregs;		// 4 registers for constants and recurrence coefficients.
+	if (spill < 0) spill = 0;
+	c = 0.0;
+	for (int im=0; im<=MMAX; im++) {
+		const int m = im*MRES;
+		const int nk = fly_nk(shtns, im);		// blocks of latitudes for this m.
+		const int ngrp = (nk + nway-1) / nway;		// the last group is padded.
+		const double cplx_m = (m==0) ? 1.0 : 2.0;		// real and imaginary parts for m>0.
+		c += (double) ngrp * (LMAX+1-m) * (cplx_m*(flop_l[ityp]*nway + 2*spill) + load);
+	}
+	return c;
+}
+
+/// \internal index of the algorithm used by variant iv and transform type ityp, or -1 if none.
+static int ftable_alg(shtns_cfg shtns, int iv, int ityp)
+{
+	void* f = shtns->ftable[iv][ityp];
+	if (f == NULL) return -1;
+	for (int ia=0; ia<SHT_NALG; ia++)
+		if (sht_func[iv][ia][ityp] == f) return ia;
+	return -1;
+}
+
+/// \internal roofline model of algorithm alg (SHT_MEM or on-the-fly) for transform type ityp: the floating point operations
+/// and the bytes read or written in memory (spectral and spatial fields, and precomputed matrices). Returns 0 if there is no model.
+static int roofline_model(shtns_cfg shtns, int alg, int ityp, double* flops, double* bytes)
+{
+	static const char nspat[SHT_NTYP] = { 1,1, 2,2, 2,2, 3,3 };
+	int flop;
+	if (alg == SHT_MEM)	flop = flop_l[ityp] - flop_rec;
+	else if (((alg >= SHT_FLY1) && (alg <= SHT_FLY8)) || ((alg >= SHT_OMP1) && (alg <= SHT_OMP8)))	flop = flop_l[ityp];
+	else return 0;
+	double f = 0.0,  b = 0.0;
+	for (int im=0; im<=MMAX; im++) {
+		const int m = im*MRES;
+		const double nlat_l = (double) fly_nk(shtns, im) * VSIZE2 * (LMAX+1-m);		// number of (l,theta) pairs (north-south symmetric).
+		f += nlat_l * flop * ((m==0) ? 1 : 2);
+		if (alg == SHT_MEM) b += nlat_l * nmat[ityp] * sizeof(double);
+	}
+	*flops = f;
+	*bytes = b + nfield[ityp] * (double) NLM * sizeof(cplx) + nspat[ityp] * (double) NLAT * NPHI * sizeof(double);
+	return 1;
+}
+
+/// \internal cost of the algorithm using precomputed matrices, in the same units as \ref fly_cost (vector flops).
+/// It is computed like fly_cost with one block per group without recurrence, but the matrices are read from memory:
+/// the time to read them is converted to vector flops using the calibration of the machine (see \ref shtns_calibrate).
+static double mem_cost(shtns_cfg shtns, int ityp)
+{
+	double c = 0.0,  mat = 0.0;
+	for (int im=0; im<=MMAX; im++) {
+		const int m = im*MRES;
+		const double nk = fly_nk(shtns, im);
+		const double cplx_m = (m==0) ? 1.0 : 2.0;
+		c += nk * (LMAX+1-m) * (cplx_m*(flop_l[ityp] - flop_rec) + load_l[ityp] + nmat[ityp]);
+		mat += nk * VSIZE2 * (LMAX+1-m) * nmat[ityp] * sizeof(double);
+	}
+	const double c_bw = mat * sht_machine.flops / (sht_machine.bw1 * VSIZE2);		// vector flops that could be done while reading the matrices.
+	return (c_bw > c) ? c_bw : c;
+}
+
+#ifdef SHTNS_MEM
+/// \internal best predicted on-the-fly cost of transform type ityp, possibly with threads (in vector flops).
+/// Called before the function table is set, assuming all on-the-fly algorithms are available.
+static double fly_best_cost(shtns_cfg shtns, int ityp)
+{
+	double c0 = 1e100;
+	for (int j=0; j<6; j++) {
+		double c = fly_cost(shtns, nway_alg[j], ityp);
+		if (c < c0) c0 = c;
+	}
+  #ifdef _OPENMP
+	const int nth = shtns->nthreads;
+	if ((nth > 1) && (omp_cost(c0, nth) < c0))	c0 = omp_cost(c0, nth);
+  #endif
+	return c0;
+}
+
+/// \internal with the \ref sht_predict initialization: returns 1 if the precomputed matrices are predicted to be faster than
+/// the on-the-fly algorithms, according to the bandwidth and flop rate of the machine (see \ref shtns_calibrate).
+static int predict_mem(shtns_cfg shtns)
+{
+	roofline_calibrate(shtns->nthreads, 0);
+	if (sht_machine.nth == 0) return 0;
+	const double c_mem = mem_cost(shtns, SHT_TYP_SSY);
+	const double c_fly = fly_best_cost(shtns, SHT_TYP_SSY);
+	#if SHT_VERBOSE > 1
+		if (verbose>1) printf("        + predicted cost of scalar synthesis: mem=%.3g, fly=%.3g\n", c_mem, c_fly);
+	#endif
+	return (c_mem < c_fly);
+}
+#endif
+
+/// \internal predict the best on-the-fly algorithm for each transform type using \ref fly_cost, without any timing.
+/// If the precomputed matrices are available, the algorithm using them is also a candidate (see \ref mem_cost).
+/// With check=1, the two best candidates are timed to choose between them.
+static void predict_best_sht(shtns_cfg shtns, int vector, int check)
+{
+	short cand[SHT_NTYP][2];
+	double cost[SHT_NTYP];
+	const int typ_lim = (vector) ? SHT_NTYP : SHT_TYP_VSY;
+
+	#if SHT_VERBOSE > 0
+	if (verbose) printf("        + predicting best algorithm (L1=%ldk, L2=%ldk)\n", cache_size(1)/1024, cache_size(2)/1024);
+	#endif
+	for (int ityp=0; ityp<SHT_NTYP; ityp++) {
+		double c0 = 1e100,  c1 = 1e100;
+		int i0 = -1,  i1 = -1;
+		cand[ityp][0] = -1;		cand[ityp][1] = -1;		cost[ityp] = 0.0;
+		if (ityp >= typ_lim) continue;
+		for (int j=0; j<6; j++) {
+			const int i = SHT_FLY1 + j;
+			if (sht_func[SHT_STD][i][ityp] == NULL) continue;
+			double c = fly_cost(shtns, nway_alg[j], ityp);
+			if (c < c0) {	c1 = c0;	i1 = i0;	c0 = c;		i0 = i;	}
+			else if (c < c1) {	c1 = c;		i1 = i;  }
+		}
+		if ((shtns->ylm) && (sht_func[SHT_STD][SHT_MEM][ityp]) && (sht_machine.nth > 0)) {		// precomputed matrices available.
+			double c = mem_cost(shtns, ityp);
+			if (c < c0) {	c1 = c0;	i1 = i0;	c0 = c;		i0 = SHT_MEM;	}
+			else if (c < c1) {	c1 = c;		i1 = SHT_MEM;  }
+		}
+		if (i0 < 0) continue;
+		shtns->fseq[ityp] = sht_func[SHT_STD][i0][ityp];		// best single-thread algorithm.
+	  #ifdef _OPENMP
+		const int nth = shtns->nthreads;
+		if ((nth > 1) && (i0 >= SHT_FLY1) && (sht_func[SHT_STD][i0 - SHT_FLY1 + SHT_OMP1][ityp])) {
+			const double c_omp = omp_cost(c0, nth);
+			if (c_omp < c0) {
+				i1 = i0;	c1 = c0;		// single-thread is second best.
+				i0 += SHT_OMP1 - SHT_FLY1;		c0 = c_omp;
+			} else if (c_omp < c1) {
+				i1 = i0 + SHT_OMP1 - SHT_FLY1;		c1 = c_omp;
+			}
+		}
+	  #endif
+		if (ityp >= SHT_TYP_3SY) {		// qst transforms can also be done as a scalar and a vector transform.
+			const double c_sv = cost[ityp-SHT_TYP_3SY] + cost[ityp-SHT_TYP_3SY+2];
+			if (sht_func[SHT_STD][SHT_SV][ityp] && (c_sv < c0)) {
+				i1 = i0;	c1 = c0;
+				i0 = SHT_SV;		c0 = c_sv;
+			}
+		}
+		cost[ityp] = c0;
+		cand[ityp][0] = i0;		cand[ityp][1] = i1;
+		for (int iv=0; iv<SHT_NVAR; iv++)
+			if (sht_func[iv][i0][ityp]) shtns->ftable[iv][ityp] = sht_func[iv][i0][ityp];
+		#if SHT_VERBOSE > 1
+			if (verbose>1) printf("  %s: predicted %s (%.3g), then %s (%.3g)\n", sht_type[ityp], sht_name[i0], c0, (i1>=0) ? sht_name[i1] : "none", c1);
+		#endif
+	}
+	// gradients use the same algorithm as the scalar synthesis.
+	for (int iv=0; iv<SHT_NVAR; iv++) {
+		if (cand[4][0] >= 0) {
+			if (sht_func[iv][cand[4][0]][5]) shtns->ftable[iv][5] = sht_func[iv][cand[4][0]][5];
+		}
+	}
+	if (cand[4][0] >= 0)	shtns->fseq[5] = sht_func[SHT_STD][cand[4][0]][5];
+
+	if (check) {		// validate the prediction: time only the two best candidates.
+		int nloop = 1.e7 / (cost[SHT_TYP_SSY] + 1.0);		// about 10ms per timing, assuming 1 vector flop per ns.
+		if (nloop < 3) nloop = 3;
+		if (nloop > 100) nloop = 100;
+		choose_best_sht(shtns, &nloop, vector, (const short (*)[2]) cand);
+	}
 }
 
 
@@ -1250,6 +1808,37 @@ void fprint_ftable(FILE* fp, void* ftable[SHT_NVAR][SHT_NTYP])
 	}
 }
 
+/// Returns the name of the algorithm selected for the transforms of given type (see \ref shtns_stats_type),
+/// for the full transforms (ltr=0) or the truncated ones (ltr=1, functions with suffix _l).
+/// Returns "none" if no algorithm is available, or if the grid is not set.
+const char* shtns_get_algorithm(shtns_cfg shtns, int type, int ltr)
+{
+	if ((type < 0) || (type >= SHT_NTYP) || (shtns->ct == NULL)) return "none";
+	fill_sht_func(shtns);		// this thread may not have initialized shtns.
+	const int ia = ftable_alg(shtns, (ltr) ? SHT_LTR : SHT_STD, type);
+	return (ia >= 0) ? sht_name[ia] : "none";
+}
+
+/// \internal print the roofline placement of the algorithms used by each transform type, if the machine has been calibrated.
+static void print_roofline(shtns_cfg shtns)
+{
+	if (sht_machine.nth == 0) return;
+	printf("Roofline : %.1f GB/s (1 thread), %.1f GB/s (%d threads), %.1f GFlop/s per thread\n",
+			sht_machine.bw1*1e-9, sht_machine.bw*1e-9, sht_machine.nth, sht_machine.flops*1e-9);
+	for (int it=0; it<SHT_NTYP; it++) {
+		double f, b;
+		const int ia = ftable_alg(shtns, SHT_STD, it);
+		if ((ia < 0) || (roofline_model(shtns, ia, it, &f, &b) == 0)) continue;
+		const int nth = ((ia >= SHT_OMP1) && (ia <= SHT_OMP8)) ? shtns->nthreads : 1;
+		const double peak = sht_machine.flops * nth;
+		const double bw = (nth > 1) ? sht_machine.bw : sht_machine.bw1;
+		const double ai = f / b;		// arithmetic intensity
+		const double att = (ai*bw < peak) ? ai*bw : peak;
+		printf("  %s %5s : %6.2f flop/byte, %s-bound, attainable %6.1f GFlop/s, %.3g ms\n", sht_type[it], sht_name[ia],
+				ai, (ai*bw < peak) ? "memory" : "compute", att*1e-9, f/att*1e3);
+	}
+}
+
 void shtns_print_cfg(shtns_cfg shtns)
 {
 	printf("Lmax=%d, Mmax*Mres=%d, Mres=%d, Nlm=%d  [%d threads, ",LMAX, MMAX*MRES, MRES, NLM, shtns->nthreads);
@@ -1267,102 +1856,19 @@ void shtns_print_cfg(shtns_cfg shtns)
 		default : printf("Unknown grid");
 	}
 	printf(" : Nlat=%d, Nphi=%d\n", NLAT, NPHI);
+	fill_sht_func(shtns);		// this thread may not have initialized shtns.
 	printf("      ");
 	for (int it=0; it<SHT_NTYP; it++)
 		printf("%5s ",sht_type[it]);
 	fprint_ftable(stdout, shtns->ftable);
 	printf("\n");
+	print_roofline(shtns);
 }
 
 
-/// \internal saves config to a file for later restart.
-int config_save(shtns_cfg shtns, int req_flags)
-{
-	int err = 0;
-	
-	if (shtns->ct == NULL) return -1;		// no grid set
-
-	if (shtns->nphi > 1) {
-		FILE* f = fopen("shtns_cfg_fftw","w");
-		if (f != NULL) {
-			fftw_export_wisdom_to_file(f);
-			fclose(f);
-		} else err -= 2;
-	}
-
-	FILE *fcfg = fopen("shtns_cfg","a");
-	if (fcfg != NULL) {
-		fprintf(fcfg, "%s %s %d %d %d %d %d %d %d %d %d %d",PACKAGE_VERSION, _SIMD_NAME_, shtns->lmax, shtns->mmax, shtns->mres, shtns->nphi, shtns->nlat, shtns->grid, shtns->nthreads, req_flags, shtns->nlorder, -1);
-		fprint_ftable(fcfg, shtns->ftable);
-		fprintf(fcfg,"\n");
-		fclose(fcfg);
-	} else err -= 4;
-
-	#if SHT_VERBOSE > 0
-		if (err < 0) fprintf(stderr,"! Warning ! SHTns could not save config\n");
-	#endif
-	return err;
-}
-
-/// \internal try to load config from a file 
-int config_load(shtns_cfg shtns, int req_flags)
-{
-	void* ft2[SHT_NVAR][SHT_NTYP];		// pointers to transform functions.
-	int lmax2, mmax2, mres2, nphi2, nlat2, grid2, nthreads2, req_flags2, nlorder2, mtr_dct2;
-	int found = 0;
-	char version[32], simd[8], alg[8];
-
-	if (shtns->ct == NULL) return -1;		// no grid set
-
-	if ((req_flags & 255) == sht_quick_init) req_flags += sht_gauss - sht_quick_init;		// quick_init uses gauss.
-
-	FILE *fcfg = fopen("shtns_cfg","r");
-	if (fcfg != NULL) {
-		int i=0;
-		while(1) {
-			fscanf(fcfg, "%30s %7s %d %d %d %d %d %d %d %d %d %d",version, simd, &lmax2, &mmax2, &mres2, &nphi2, &nlat2, &grid2, &nthreads2, &req_flags2, &nlorder2, &mtr_dct2);
-			for (int iv=0; iv<SHT_NVAR; iv++) {
-				fscanf(fcfg, "%7s", alg);
-				for (int it=0; it<SHT_NTYP; it++) {
-					fscanf(fcfg, "%7s", alg),
-					ft2[iv][it] = 0;
-					for (int ia=0; ia<SHT_NALG; ia++) {
-						if (strcmp(alg, sht_name[ia]) == 0) {
-							ft2[iv][it] = sht_func[iv][ia][it];
-							break;
-						}
-					}
-				}
-			}
-			if (feof(fcfg)) break;
-			if ((shtns->lmax == lmax2) && (shtns->mmax == mmax2) && (shtns->mres == mres2) && (shtns->nthreads == nthreads2) &&
-			  (shtns->nphi == nphi2) && (shtns->nlat == nlat2) && (shtns->grid == grid2) &&  (req_flags == req_flags2) &&
-			  (shtns->nlorder == nlorder2) && (strcmp(simd, _SIMD_NAME_)==0)) {
-			#if SHT_VERBOSE > 0
-				if (verbose > 0) printf("        + using saved config\n");
-			#endif
-			#if SHT_VERBOSE > 1
-				if (verbose > 1) {
-					fprint_ftable(stdout, ft2);
-					printf("\n");
-				}
-			#endif
-				for (int iv=0; iv<SHT_NVAR; iv++)
-				for (int it=0; it<SHT_NTYP; it++)
-					if (ft2[iv][it]) shtns->ftable[iv][it] = ft2[iv][it];		// accept only non-null pointer
-				found = 1;
-				break;
-			}
-		}
-		fclose(fcfg);
-		return found;
-	} else {
-		#if SHT_VERBOSE > 0
-			if (verbose) fprintf(stderr,"! Warning ! SHTns could not load config\n");
-		#endif
-		return -2;		// file not found
-	}
-}
+#include "sht_cfgdb.c"
+#include "sht_perf.c"
+#include "sht_stats.c"
 
 /// \internal returns 1 if val cannot fit in dest (unsigned)
 #define IS_TOO_LARGE(val, dest) (sizeof(dest) >= sizeof(val)) ? 0 : ( ( val >= (1<<(8*sizeof(dest))) ) ? 1 : 0 )
@@ -1413,10 +1919,14 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 		shtns->tm = (unsigned short*) (shtns->lmidx + (mmax+1));		// and tm just after.
 		shtns->ct = NULL;	shtns->st = NULL;
 		shtns->nphi = 0;	shtns->nlat = 0;	shtns->nlat_2 = 0;		shtns->nspat = 0;	// public data
-		shtns->ylm_lat = NULL;	shtns->ct_lat = 2.0;	shtns->ifft_lat = NULL;		shtns->nphi_lat = 0;	// _to_lat data
+		shtns->serial = 0;		// not ready to be shared.
+		shtns->fftw_plan_mode = FFTW_MEASURE;		// until a grid is set (the ffts of the rotations may be planned before).
 		#ifdef HAVE_LIBCUFFT
 		shtns->d_alm = NULL;		// this marks the gpu as disabled.
 		#endif
+		#ifdef SHTNS_STATS
+		stats_alloc(shtns);
+		#endif
 	}
 
 	// copy sizes.
@@ -1430,7 +1940,9 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 	shtns->nlm = nlm_calc(lmax, mmax, mres);
 	shtns->nlm_cplx = 2*shtns->nlm - (lmax+1);	// = nlm_cplx_calc(lmax, mmax, mres);
 	shtns->nthreads = omp_threads;
-	if (omp_threads > mmax+1) shtns->nthreads = mmax+1;	// limit the number of threads to mmax+1
+	if ((omp_threads > mmax+1) && (mmax > 0)) shtns->nthreads = mmax+1;	// limit the number of threads to mmax+1 (axisymmetric transforms split the latitudes instead)
+	shtns->omp_msched = MSCHED_BALANCED;
+	shtns->omp_shells = 1;
 	#if SHT_VERBOSE > 0
 	if (verbose) {
 		shtns_print_version();
@@ -1438,9 +1950,13 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 	}
 	#endif
 
+	cfg_lock();
 	s2 = sht_data;		// check if some data can be shared ...
 	while(s2 != NULL) {
-		if ((s2->mmax >= mmax) && (s2->mres == mres)) {
+		if (s2->serial == 0) {		// config still being initialized by another thread: its arrays may be incomplete.
+			s2 = s2->next;		continue;
+		}
+		if ((s2->mmax >= mmax) && (s2->mres == mres) && (s2->map_base == NULL)) {		// do not share arrays that will be unmapped with a loaded config.
 			if (s2->lmax == lmax) {		// we can reuse the l-related arrays (li + copy lmidx)
 				shtns->li = s2->li;		shtns->mi = s2->mi;
 				for (im=0; im<=mmax; im++)	shtns->lmidx[im] = s2->lmidx[im];
@@ -1451,12 +1967,14 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 				}
 			}
 		}
-		if (s2->lmax >= lmax) {		// we can reuse l_2
+		if ((s2->lmax >= lmax) && (s2->map_base == NULL)) {		// we can reuse l_2
 			shtns->l_2 = s2->l_2;
 			l_2_ok = 1;
 		}
 		s2 = s2->next;
 	}
+	cfg_track(shtns);		// now referenced by this config, the shared arrays will not be freed by a concurrent shtns_destroy().
+	cfg_unlock();
 	if (larrays_ok == 0) {
 		// alloc spectral arrays
 		shtns->li = (unsigned short *) malloc( 2*NLM*sizeof(unsigned short) );	// NLM defined at runtime.
@@ -1471,9 +1989,16 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 		}
 		if (lm != NLM) shtns_runerr("unexpected error");
 	}
+	#if SHT_VERBOSE > 1
+	double tw[3];		// wall-clock time of the initialization stages.
+	tw[0] = wall_time();
+	#endif
 	if (legendre_ok == 0) {	// this quickly precomputes some values for the legendre recursion.
 		legendre_precomp(shtns, SHT_NORM, with_cs_phase, mpos_renorm);
 	}
+	#if SHT_VERBOSE > 1
+	tw[1] = wall_time();
+	#endif
 	if (l_2_ok == 0) {
 		shtns->l_2 = (double *) malloc( (LMAX+1)*sizeof(double) );
 		shtns->l_2[0] = 0.0;	// undefined for l=0 => replace with 0.
@@ -1498,10 +2023,15 @@ shtns_cfg shtns_create(int lmax, int mmax, int mres, enum shtns_norm norm)
 
 // initialize rotations along arbitrary axes (if applicable).
 	if ((lmax == mmax) && (mres == 1))	SH_rotK90_init(shtns);
+	#if SHT_VERBOSE > 1
+	tw[2] = wall_time();
+	if (verbose>1) printf("        + init time : legendre %.3g s, rotations %.3g s\n", tw[1]-tw[0], tw[2]-tw[1]);
+	#endif
 
-// save a pointer to this setup and return.
-	shtns->next = sht_data;		// reference of previous setup (may be NULL).
-	sht_data = shtns;			// keep track of new setup.
+// mark this setup as complete and return.
+	cfg_lock();
+	cfg_ready(shtns);
+	cfg_unlock();
 	return(shtns);
 }
 
@@ -1512,8 +2042,12 @@ shtns_cfg shtns_create_with_grid(shtns_cfg base, int mmax, int nofft)
 
 	if (mmax > base->mmax) return (NULL);		// fail if mmax larger than source config.
 
+	cfg_lock();
 	shtns = malloc( SIZEOF_SHTNS_INFO(mmax) );
 	memcpy(shtns, base, SIZEOF_SHTNS_INFO(mmax) );		// copy all
+	#ifdef SHTNS_STATS
+	stats_alloc(shtns);		// own statistics.
+	#endif
 	shtns->lmidx = (int*) shtns+1;		// lmidx is stored at the end of the struct...
 	shtns->tm = (unsigned short*) (shtns->lmidx + (mmax+1));		// ...and tm just after.
 
@@ -1535,24 +2069,29 @@ shtns_cfg shtns_create_with_grid(shtns_cfg base, int mmax, int nofft)
 	}
 
 // save a pointer to this setup and return.
-	shtns->next = sht_data;		// reference of previous setup (may be NULL).
-	sht_data = shtns;			// keep track of new setup.
+	cfg_track(shtns);
+	cfg_ready(shtns);
+	cfg_unlock();
 	return(shtns);
 }
 
 /// release all resources allocated by a grid.
 void shtns_unset_grid(shtns_cfg shtns)
 {
-	if (ref_count(shtns, &shtns->wg) == 1)	VFREE(shtns->wg);
+	cfg_lock();
+	if ((ref_count(shtns, &shtns->wg) == 1) && (!cfg_mapped(shtns, shtns->wg)))	VFREE(shtns->wg);
 	shtns->wg = NULL;
+	free_unused(shtns, &shtns->omp_mlist);
 	free_SHTarrays(shtns);
 	shtns->nlat = 0;	shtns->nlat_2 = 0;
 	shtns->nphi = 0;	shtns->nspat = 0;
+	cfg_unlock();
 }
 
 /// release all resources allocated by a given shtns_cfg.
 void shtns_destroy(shtns_cfg shtns)
 {
+	cfg_lock();
 	#ifdef HAVE_LIBCUFFT
 	if (shtns->d_alm) cushtns_release_gpu(shtns);
 	#endif
@@ -1565,6 +2104,8 @@ void shtns_destroy(shtns_cfg shtns)
 	if (shtns->fft_rot)  fftw_destroy_plan(shtns->fft_rot);
 
 	shtns_unset_grid(shtns);
+	if ((shtns->map_base) && (ref_count(shtns, &shtns->map_base) == 1))
+		munmap(shtns->map_base, shtns->map_size);		// last config using this saved config.
 
 	if (sht_data == shtns) {
 		sht_data = shtns->next;		// forget shtns
@@ -1578,17 +2119,30 @@ void shtns_destroy(shtns_cfg shtns)
 			s2 = s2->next;
 		}
 	}
+	#ifdef SHTNS_STATS
+	free(shtns->stats);
+	#endif
 	free(shtns);
+	cfg_unlock();
 }
 
 /// clear all allocated memory (hopefully) and go back to 0 state.
 void shtns_reset()
 {
+	cfg_lock();
 	while (sht_data != NULL) {
 		shtns_destroy(sht_data);
 	}
+	cfg_unlock();
+	shtns_release_scratch();
+  #ifdef _OPENMP
+	#pragma omp parallel
+	shtns_release_scratch();		// also the scratch memory kept by the (persistent) openmp worker threads.
+  #endif
 }
 
+#include "sht_save.c"
+
 #ifndef HAVE_LIBCUFFT
 // allocation for vector-aligned data. If gpu is enabled, these are replace by pinned memory allocation.
 void* shtns_malloc(size_t size) {
@@ -1600,6 +2154,60 @@ void shtns_free(void* p) {
 }
 #endif
 
+// scratch memory used by the transforms, kept by each thread from one call to the next (no allocation in steady state).
+static __thread void* scratch_ptr[SCRATCH_N] = { NULL };
+static __thread size_t scratch_size[SCRATCH_N] = { 0 };
+static pthread_key_t scratch_key;		// only used for its destructor, freeing the scratch memory of exiting threads.
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void scratch_thread_exit(void* p)
+{
+	shtns_release_scratch();
+}
+
+static void scratch_key_create()
+{
+	pthread_key_create(&scratch_key, scratch_thread_exit);
+}
+
+/// \internal returns a vector-aligned buffer of at least size bytes, owned by the calling thread.
+/// The same buffer is returned for a given slot until a larger size is requested, so that nested
+/// functions needing scratch memory at the same time must use different slots (see \ref sht_scratch).
+void* shtns_scratch(int slot, size_t size)
+{
+	if (size > scratch_size[slot]) {
+		#ifdef SHTNS_STATS
+		const ticks t0 = getticks();
+		#endif
+		if (scratch_ptr[slot]) VFREE(scratch_ptr[slot]);
+		else {		// first allocation by this thread: register the destructor called when it exits.
+			pthread_once(&scratch_key_once, scratch_key_create);
+			pthread_setspecific(scratch_key, scratch_ptr);
+		}
+		scratch_ptr[slot] = VMALLOC(size);
+		scratch_size[slot] = size;
+		if (scratch_ptr[slot] == NULL) {
+			scratch_size[slot] = 0;
+			shtns_runerr("not enough memory.");
+		}
+		#ifdef SHTNS_STATS
+		const ticks t1 = getticks();
+		stats_tls.alloc += elapsed(t1, t0);
+		if (sht_trace_on) trace_event("shtns_scratch", TRACE_ALLOC, slot, t0, t1);
+		#endif
+	}
+	return scratch_ptr[slot];
+}
+
+void shtns_release_scratch()
+{
+	for (int i=0; i<SCRATCH_N; i++) {
+		if (scratch_ptr[i]) VFREE(scratch_ptr[i]);
+		scratch_ptr[i] = NULL;		scratch_size[i] = 0;
+	}
+	lat_cache_release();
+}
+
 
 static int choose_nlat(int n)
 {
@@ -1637,10 +2245,13 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 	int n_gauss = 0;
 	int on_the_fly = 0;
 	int quick_init = 0;
+	int predict = 0;
 	int vector = !(flags & SHT_SCALAR_ONLY);
 	int latdir = (flags & SHT_SOUTH_POLE_FIRST) ? -1 : 1;		// choose latitudinal direction (change sign of ct)
 	int cfg_loaded = 0;
 	int analys = 1;
+	int shm_fd = -1;		// shared memory segment to be written (SHT_SHARED_MEMORY).
+	char shm_name[32];
 	const int req_flags = flags;		// requested flags.
 
 	#if HAVE_LIBCUFFT
@@ -1655,7 +2266,9 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 			if (*nlat % VSIZE2) shtns_runerr("Nlat must be a multiple of 8 for the MIC\n");
 		#endif
 	#endif
+	cfg_lock();		// only held for the config list (arrays shared with other configs), the fftw planner, and the shared memory segments.
 	shtns_unset_grid(shtns);		// release grid if previously allocated.
+	cfg_unlock();
 	if (nl_order <= 0) nl_order = SHT_DEFAULT_NL_ORDER;
 /*	shtns.lshift = 0;
 	if (nl_order == 0) nl_order = SHT_DEFAULT_NL_ORDER;
@@ -1671,6 +2284,7 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 		case sht_reg_fast:	quick_init = 1;
 		case sht_reg_dct:	flags = sht_reg_fast; on_the_fly = 1;  break;
 		case sht_gauss_fly :  flags = sht_gauss;  on_the_fly = 1;  break;
+		case sht_predict :  flags = sht_gauss;  on_the_fly = 1;  predict = 1;  break;		// no timing, except fftw planning and optional check.
 		case sht_quick_init : flags = sht_gauss;  quick_init = 1;  break;
 		case sht_reg_poles : on_the_fly = 1;  quick_init = 1;	break;		// WARNING: quick_init mandatory here, as reg_poles needs NWAY>1 to work (quick_init sets NWAY=2)
 		default : break;
@@ -1705,6 +2319,7 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 			*nlat = m;
 		} else *nlat = n_gauss;
 	}
+	if ((*nphi > 1) && (shtns->nthreads > MMAX+1)) shtns->nthreads = MMAX+1;		// only m=0 : no work for other threads.
 
 	mem = sht_mem_size(shtns->lmax, shtns->mmax, shtns->mres, *nlat);
 	t=mem;	if (analys) t*=2;		if (vector) t*=3;
@@ -1720,7 +2335,7 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 		shtns->fftw_plan_mode = FFTW_EXHAUSTIVE;		// defines the default FFTW planner mode.
 	// fftw_set_timelimit(60.0);		// do not search plans for more than 1 minute (does it work well ???)
 		if (*nphi > 512) shtns->fftw_plan_mode = FFTW_PATIENT;
-		if (*nphi > 1024) shtns->fftw_plan_mode = FFTW_MEASURE;
+		if ((*nphi > 1024) || (predict)) shtns->fftw_plan_mode = FFTW_MEASURE;		// FFTW_ESTIMATE plans can be twice slower.
 	} else {
 		shtns->fftw_plan_mode = FFTW_ESTIMATE;
 		if ((mem < 1.0) && (SHT_VERBOSE < 2)) shtns->nthreads = 1;		// disable threads for small transforms (in quickinit mode).
@@ -1743,25 +2358,39 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 	// copy to global variables.
 	shtns->nphi = *nphi;
 	shtns->nlat_2 = (*nlat+1)/2;	shtns->nlat = *nlat;
-
-	if (layout & SHT_LOAD_SAVE_CFG)	{
-		FILE* f = fopen("shtns_cfg_fftw","r");
-		if (f) {
-			fftw_import_wisdom_from_file(f);		// load fftw wisdom.
-			fclose(f);
-		}
+	if ((layout & SHT_SHARED_MEMORY) && (shtns->map_base == NULL)) {
+		shm_segment_name(shtns, req_flags, eps, shm_name);
+		cfg_lock();
+		const int attached = shm_attach(shtns, shm_name, &shm_fd);
+		cfg_unlock();
+		if (attached > 0) return(shtns->nspat);		// already initialized by another process.
 	}
+	#ifdef SHTNS_MEM
+	cfg_lock();		// the machine may be calibrated concurrently.
+	if ((predict) && (t <= SHTNS_MAX_MEMORY) && (predict_mem(shtns)))	on_the_fly = 0;		// the machine favors precomputed matrices.
+	cfg_unlock();
+	#endif
+
+	double tw[6];		// wall-clock time of the initialization stages.
+	tw[0] = wall_time();
+	if (layout & SHT_LOAD_SAVE_CFG)	cfgdb_import_wisdom();		// load fftw wisdom (unless preloaded).
+	cfg_lock();		// fftw planning is not thread-safe.
 	planFFT(shtns, layout, on_the_fly);		// initialize fftw
+	cfg_unlock();
+	tw[1] = wall_time();
 	init_sht_array_func(shtns);		// array of SHT functions is now set.
+	if (layout & SHT_CPLX_NATIVE) shtns->cplx_fast = ~0U;		// native complex kernels (experimental), possibly restricted by choose_cplx.
 
 	alloc_SHTarrays(shtns, on_the_fly, vector, analys);		// allocate dynamic arrays
 	shtns->grid = GRID_NONE;
 	switch(flags) {
 		case sht_gauss : 	 shtns->grid = GRID_GAUSS;	break;
 		case sht_reg_poles : shtns->grid = GRID_POLES;	break;
-		case sht_reg_fast :  shtns->grid = GRID_REGULAR;
+		case sht_reg_fast :  shtns->grid = GRID_REGULAR;	break;
+		default : break;
 	}
 	grid_weights(shtns, latdir);
+	tw[2] = wall_time();
 	#ifdef SHTNS_MEM
 	if ((on_the_fly == 0) && (flags == sht_gauss)) {
 		init_SH_gauss(shtns);			// precompute matrices
@@ -1780,11 +2409,14 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 		PolarOptimize(shtns, eps);
 		set_sht_fly(shtns, 0);		// switch function pointers to "on-the-fly" functions.
 	}
+	tw[3] = wall_time();
 
   #ifdef HAVE_LIBCUFFT
 	int gpu_ok = -1;
 	if (layout & SHT_ALLOW_GPU) {
+		cfg_lock();
 		gpu_ok = cushtns_init_gpu(shtns);		// try to initialize cuda gpu
+		cfg_unlock();
 		#if SHT_VERBOSE > 0
 		if ((verbose)&&(gpu_ok>=0)) printf("        + GPU #%d successfully initialized.\n", gpu_ok);
 		#endif
@@ -1797,16 +2429,31 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 	}
   #endif
 
+  #ifdef _OPENMP
+	omp_mpartition(shtns);		// distribute m among threads (needs tm[]).
+  #endif
 	if ((layout & SHT_LOAD_SAVE_CFG) && (!cfg_loaded)) cfg_loaded = (config_load(shtns, req_flags) > 0);
+	tw[4] = tw[3];		tw[5] = tw[3];
 	if (quick_init == 0) {
-		if (!cfg_loaded) {
-			choose_best_sht(shtns, &nloop, vector);
-			if (layout & SHT_LOAD_SAVE_CFG) config_save(shtns, req_flags);
+		if (!cfg_loaded) {		// the tuning only uses this config: other threads may create or destroy theirs meanwhile.
+			if (predict) predict_best_sht(shtns, vector, (layout & SHT_PREDICT_CHECK) != 0);
+			else {
+				choose_best_sht(shtns, &nloop, vector, NULL);
+				if ((MRES == 1) && (layout & SHT_CPLX_NATIVE)) choose_cplx(shtns);		// native complex transforms, or two real transforms.
+				choose_fused(shtns);		// fused transforms by blocks, or separate transforms.
+			}
+			if (layout & SHT_LOAD_SAVE_CFG) config_save(shtns, req_flags);		// without cfg_lock: may wait for other processes.
 		}
 		#ifdef SHTNS_MEM
-		if (on_the_fly == 0) free_unused_matrices(shtns);
+		if (on_the_fly == 0) {
+			cfg_lock();		// the matrices may be shared with other configs.
+			free_unused_matrices(shtns);
+			cfg_unlock();
+		}
 		#endif
+		tw[4] = wall_time();
 		t = SHT_error(shtns, vector);		// compute SHT accuracy.
+		tw[5] = wall_time();
   #if SHT_VERBOSE > 0
 		if (verbose) printf("        + SHT accuracy = %.3g\n",t);
   #endif
@@ -1821,10 +2468,14 @@ int shtns_set_grid_auto(shtns_cfg shtns, enum shtns_type flags, double eps, int
 //	set_sht_fly(shtns, SHT_TYP_VAN);
 //	set_sht_gpu(shtns, 0);
 
+	if (shm_fd >= 0) shm_publish(shtns, shm_fd, shm_name);		// other processes can now use the arrays.
+
   #if SHT_VERBOSE > 1
 	if ((omp_threads > 1)&&(verbose>1)) printf(" nthreads = %d\n",shtns->nthreads);
   #endif
   #if SHT_VERBOSE > 0
+	if (verbose) printf("        + init time : fft %.3g s, grid %.3g s, matrices %.3g s, tuning %.3g s, accuracy %.3g s\n",
+			tw[1]-tw[0], tw[2]-tw[1], tw[3]-tw[2], tw[4]-tw[3], tw[5]-tw[4]);
 	if (verbose) printf("        => " PACKAGE_NAME " is ready.\n");
   #endif
 	return(shtns->nspat);	// returns the number of doubles to be allocated for a spatial field.
@@ -1879,6 +2530,9 @@ int shtns_use_threads(int num_threads)
 #endif
 #ifdef OMP_FFTW
 	fftw_init_threads();		// enable threads for FFTW.
+#endif
+#ifdef OMP_FFTWF
+	fftwf_init_threads();
 #endif
 	return omp_threads;
 }
@@ -1941,6 +2595,12 @@ void shtns_use_threads_(int *num_threads)
 	shtns_use_threads(*num_threads);
 }
 
+/// Set the time budget (in seconds) for timing the algorithms of each transform type
+void shtns_tuning_budget_(double *seconds)
+{
+	shtns_tuning_budget(*seconds);
+}
+
 void shtns_use_gpu_(int *device_id)
 {
 	shtns_use_gpu(*device_id);
@@ -2105,6 +2765,19 @@ void shtns_qst_to_point_(double *vr, double *vt, double *vp,
 {
 	SHqst_to_point(sht_data, Qlm, Slm, Tlm, *cost, *phi, vr, vt, vp);
 }
+
+/// Evaluate at the \b n points (cost[i], phi[i]) a scalar SH representation. \see SH_to_points
+void shtns_sh_to_points_(double *spat, cplx *Qlm, int *n, double *cost, double *phi)
+{
+	SH_to_points(sht_data, Qlm, *n, cost, phi, spat);
+}
+
+/// \see SHqst_to_points for argument description
+void shtns_qst_to_points_(double *vr, double *vt, double *vp,
+		cplx *Qlm, cplx *Slm, cplx *Tlm, int *n, double *cost, double *phi)
+{
+	SHqst_to_points(sht_data, Qlm, Slm, Tlm, *n, cost, phi, vr, vt, vp);
+}
 //@}
 
 void shtns_sh_zrotate_(cplx* Qlm, double* alpha, cplx* Rlm)
@@ -660,10 +660,11 @@ static double legendre_Pl(const int l, double x)
 
 
 /// \internal Generates the abscissa and weights for a Gauss-Legendre quadrature.
-/// Newton method from initial Guess to find the zeros of the Legendre Polynome
+/// Newton method from initial Guess to find the zeros of the Legendre Polynome.
+/// Each iteration evaluates the Legendre polynomial by recurrence: the cost is O(n^2).
 /// \param x = abscissa, \param w = weights, \param n points.
 /// \note Reference:  Numerical Recipes, Cornell press.
-static void gauss_nodes(real *x, real *w, const int n)
+static void gauss_nodes_newton(real *x, real *w, const int n)
 {
 	long int i,l,m, k;
 	real z, z1, p1, p2, p3, pp;
@@ -695,11 +696,94 @@ static void gauss_nodes(real *x, real *w, const int n)
 		w[n-i] = w[i-1];
 	}
 	if (n&1) x[n/2] = 0.0;		// exactly zero.
+}
+
+/// \internal returns the k-th positive zero of the Bessel function J0, and the square of J1 at that zero in *j1sq.
+/// Newton iterations on J0, starting from the McMahon expansion.
+static double bessel_j0_zero(int k, double *j1sq)
+{
+	double z = M_PI*(k-0.25);
+	const double r = 1.0/z;
+	z += r*(0.125 + r*r*(-0.807291666666666666666666666667e-1 + r*r*0.246028645833333333333333333333));	// McMahon
+	for (int it=0; it<8; it++) {
+		double dz = j0(z)/j1(z);		// J0' = -J1
+		z += dz;
+		if (fabs(dz) < 1e-16*z) break;
+	}
+	const double t = j1(z);
+	*j1sq = t*t;
+	return z;
+}
+
+/// \internal Generates the abscissa and weights for a Gauss-Legendre quadrature, without iterations on the Legendre polynomial.
+/// Each node is obtained independently from an asymptotic expansion in terms of the zeros of the Bessel function J0,
+/// which is accurate to double precision for n > 100 : the cost is O(n), and the nodes are computed in parallel.
+/// \param x = abscissa, \param w = weights, \param n points.
+/// \note Reference: I. Bogaert (2014) "Iteration-free computation of Gauss-Legendre quadrature nodes and weights", SIAM J. Sci. Comput. 36(3), A1008-A1026.
+static void gauss_nodes_asymptotic(real *x, real *w, const int n)
+{
+	const double wn = 1.0/(n+0.5);
+	const long int m = (n+1)/2;
+
+	#pragma omp parallel for schedule(static) if(n > 4096)
+	for (long int k=1; k<=m; k++) {
+		double b;
+		const double nu = bessel_j0_zero(k, &b);
+		double theta = wn*nu;
+		const double t2 = theta*theta;
+
+		// Chebyshev interpolants of the expansion terms, for the nodes...
+		double sf1 = (((((-1.29052996274280508473467968379e-12*t2 +2.40724685864330121825976175184e-10)*t2 -3.13148654635992041468855740012e-8)*t2 +0.275573168962061235623801563453e-5)*t2 -0.148809523713909147898955880165e-3)*t2 +0.416666666665193394525296923981e-2)*t2 -0.416666666666662959639712457549e-1;
+		double sf2 = (((((+2.20639421781871003734786884322e-9*t2 -7.53036771373769326811030753538e-8)*t2 +0.161969259453836261731700382098e-5)*t2 -0.253300326008232025914059965302e-4)*t2 +0.282116886057560434805998583817e-3)*t2 -0.209022248387852902722635654229e-2)*t2 +0.815972221772932265640401128517e-2;
+		double sf3 = (((((-2.97058225375526229899781956673e-8*t2 +5.55845330223796209655886325712e-7)*t2 -0.567797841356833081642185432056e-5)*t2 +0.418498100329504574443885193835e-4)*t2 -0.251395293283965914823026348764e-3)*t2 +0.128654198542845137196151147483e-2)*t2 -0.416012165620204364833694266818e-2;
+		// ... and for the weights.
+		double wsf1 = ((((((((-2.20902861044616638398573427475e-14*t2 +2.30365726860377376873232578871e-12)*t2 -1.75257700735423807659851042318e-10)*t2 +1.03756066927916795821098009353e-8)*t2 -4.63968647553221331251529631098e-7)*t2 +0.149644593625028648361395938176e-4)*t2 -0.326278659594412170300449074873e-3)*t2 +0.436507936507598105249726413120e-2)*t2 -0.305555555555553028279487898503e-1)*t2 +0.833333333333333302184063103900e-1;
+		double wsf2 = (((((((+3.63117412152654783455929483029e-12*t2 +7.67643545069893130779501844323e-11)*t2 -7.12912857233642220650643150625e-9)*t2 +2.11483880685947151466370130277e-7)*t2 -0.381817918680045468483009307090e-5)*t2 +0.465969530694968391417927388162e-4)*t2 -0.407297185611335764191683161117e-3)*t2 +0.268959435694729660779984493795e-2)*t2 -0.111111111111214923138249347172e-1;
+		double wsf3 = (((((((+2.01826791256703301806643264922e-9*t2 -4.38647122520206649251063212545e-8)*t2 +5.08898347288671653137451093208e-7)*t2 -0.397933316519135275712977531366e-5)*t2 +0.200559326396458326778521795392e-4)*t2 -0.422888059282921161626339411388e-4)*t2 -0.105646050254076140548678457002e-3)*t2 -0.947969308958577323145923317955e-4)*t2 +0.656966489926484797412985260842e-2;
+
+		const double nu_sin = nu/sin(theta);
+		const double winvsinc = wn*wn*nu_sin;
+		const double wis2 = winvsinc*winvsinc;
+		theta = wn*(nu + theta*winvsinc*(sf1 + wis2*(sf2 + wis2*sf3)));
+		const double deno = b*nu_sin*(1.0 + wis2*(wsf1 + wis2*(wsf2 + wis2*wsf3)));
+		x[k-1] = cos(theta);		x[n-k] = -x[k-1];
+		w[k-1] = (2.0*wn)/deno;		w[n-k] = w[k-1];
+	}
+	if (n&1) x[n/2] = 0.0;		// exactly zero.
+}
+
+/// \internal Generates the abscissa and weights for a Gauss-Legendre quadrature.
+/// Uses Newton iterations for small n, and the O(n) asymptotic expansion for n > SHT_GAUSS_NEWTON_MAX.
+/// \param x = abscissa, \param w = weights, \param n points.
+static void gauss_nodes(real *x, real *w, const int n)
+{
+	long int i,m;
+
+	m = (n+1)/2;
+	if (n <= SHT_GAUSS_NEWTON_MAX) {
+		gauss_nodes_newton(x, w, n);
+	} else {
+		gauss_nodes_asymptotic(x, w, n);
+	#if SHT_VERBOSE > 1
+		if (verbose>1) {		// self-check against the Newton method (slow).
+			real *xn = (real*) malloc(2*n * sizeof(real));
+			real *wn = xn + n;
+			gauss_nodes_newton(xn, wn, n);
+			double ex = 0.0;	double ew = 0.0;
+			for (i=0; i<m; i++) {
+				double e = fabs((double) (x[i] - xn[i]));		if (e > ex) ex = e;
+				e = fabs((double) (w[i]/wn[i] - 1.0));		if (e > ew) ew = e;
+			}
+			printf("          Gauss nodes (asymptotic) : max difference with Newton method = %g (nodes), %g (relative, weights)\n", ex, ew);
+			free(xn);
+		}
+	#endif
+	}
 
 #if SHT_VERBOSE > 1
 // test integral to compute :
 	if (verbose) {
-		z = 0;
+		real z = 0;
 		for (i=0;i<m;++i) {
 			z += w[i]*x[i]*x[i];
 		}
@@ -739,13 +823,17 @@ static void fejer1_nodes(real *x, real *w, const int n)
 		v1[k] = (cos(t) + I*sin(t)) * 2.0/(1.0 - 4.0*k*k);
 	}
 
+	cfg_lock();		// fftw planning is not thread-safe.
 	ifft = fftw_plan_dft_c2r_1d(n, v1, wf, FFTW_ESTIMATE);
+	cfg_unlock();
 	fftw_execute_dft_c2r(ifft,v1,wf);
 
 	for (int k=0; k<n; k++)
 		w[k] = wf[k]/n;
 
+	cfg_lock();
 	fftw_destroy_plan(ifft);
+	cfg_unlock();
 	free(wf);
 }
 
@@ -765,14 +853,18 @@ static void clenshaw_curtis_nodes(real *x, real *w, const int n)
 		v1[k] = 2.0/(1.0 - 4.0*k*k);
 	}
 
+	cfg_lock();		// fftw planning is not thread-safe.
 	ifft = fftw_plan_dft_c2r_1d(n-1, v1, wf, FFTW_ESTIMATE);
+	cfg_unlock();
 	fftw_execute_dft_c2r(ifft,v1,wf);
 
 	wf[0] *= 0.5;
 	for (int k=0; k<n-1; k++)  w[k] = wf[k]/(n-1);
 	w[n-1] = w[0];
 
+	cfg_lock();
 	fftw_destroy_plan(ifft);
+	cfg_unlock();
 	free(wf);
 }
 
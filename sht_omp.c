@@ -23,6 +23,27 @@
 #define GEN(name,sfx) GLUE2(name,sfx)
 #define GEN3(name,nw,sfx) GLUE3(name,nw,sfx)
 
+/// \internal returns the next order index im>0 to be processed by the calling thread, or a value >= imlim when there is none left.
+/// it is the number of previous calls by this thread, im_next is a counter shared by all threads (used by MSCHED_DYNAMIC only).
+static inline unsigned omp_next_im(shtns_cfg shtns, unsigned it, unsigned* im_next, unsigned imlim)
+{
+	const unsigned ith = omp_get_thread_num();
+	const unsigned nth = omp_get_num_threads();
+	unsigned im;
+
+	if (shtns->omp_msched == MSCHED_DYNAMIC) {		// first come, first served (largest work first).
+		#pragma omp atomic capture
+		im = (*im_next)++;
+	} else if ((shtns->omp_msched == MSCHED_BALANCED) && (shtns->omp_mlist) && (nth == shtns->nthreads)) {
+		const unsigned short* ofs = shtns->omp_mlist + MMAX;
+		im = imlim;
+		if (it < (unsigned) (ofs[ith+1] - ofs[ith]))  im = shtns->omp_mlist[ofs[ith] + it];
+	} else {		// round-robin, thread 0 has already done m=0.
+		im = ith + (it + (ith==0))*nth;
+	}
+	return im;
+}
+
 // genaral case
 #undef SUFFIX
 #define SUFFIX _l
@@ -91,6 +112,76 @@
 #undef SHT_3COMP
 
 
+// axisymmetric
+#define SHT_AXISYM
+#undef SUFFIX
+#define SUFFIX _m0l
+
+	#define NWAY 1
+	#include "SHT/spat_to_SHst_omp.c"
+	#include "SHT/SHst_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 2
+	#include "SHT/spat_to_SH_omp.c"
+	#include "SHT/SH_to_spat_omp.c"
+	#include "SHT/spat_to_SHst_omp.c"
+	#include "SHT/SHst_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 3
+	#include "SHT/spat_to_SH_omp.c"
+	#include "SHT/SH_to_spat_omp.c"
+	#include "SHT/spat_to_SHst_omp.c"
+	#include "SHT/SHst_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 4
+	#include "SHT/spat_to_SH_omp.c"
+	#include "SHT/SH_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 6
+	#include "SHT/spat_to_SH_omp.c"
+	#include "SHT/SH_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 8
+	#include "SHT/spat_to_SH_omp.c"
+	#include "SHT/SH_to_spat_omp.c"
+	#undef NWAY
+
+#define SHT_GRAD
+	#define NWAY 1
+	#include "SHT/SHs_to_spat_omp.c"
+	#include "SHT/SHt_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 2
+	#include "SHT/SHs_to_spat_omp.c"
+	#include "SHT/SHt_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 3
+	#include "SHT/SHs_to_spat_omp.c"
+	#include "SHT/SHt_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 4
+	#include "SHT/SHs_to_spat_omp.c"
+	#include "SHT/SHt_to_spat_omp.c"
+	#undef NWAY
+#undef SHT_GRAD
+
+#define SHT_3COMP
+	#define NWAY 1
+	#include "SHT/spat_to_SHqst_omp.c"
+	#include "SHT/SHqst_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 2
+	#include "SHT/spat_to_SHqst_omp.c"
+	#include "SHT/SHqst_to_spat_omp.c"
+	#undef NWAY
+	#define NWAY 3
+	#include "SHT/spat_to_SHqst_omp.c"
+	#include "SHT/SHqst_to_spat_omp.c"
+	#undef NWAY
+#undef SHT_3COMP
+#undef SHT_AXISYM
+
+
 void* fomp[6][SHT_NTYP] = {
 	{ NULL, NULL, SHsphtor_to_spat_omp1_l, spat_to_SHsphtor_omp1_l,
 		SHsph_to_spat_omp1_l, SHtor_to_spat_omp1_l, SHqst_to_spat_omp1_l, spat_to_SHqst_omp1_l },
@@ -105,3 +196,18 @@ void* fomp[6][SHT_NTYP] = {
 	{ SH_to_spat_omp8_l, spat_to_SH_omp8_l, NULL, NULL,
 		NULL, NULL, NULL, NULL }
 };
+
+void* fomp_m0[6][SHT_NTYP] = {
+	{ NULL, NULL, SHsphtor_to_spat_omp1_m0l, spat_to_SHsphtor_omp1_m0l,
+		SHsph_to_spat_omp1_m0l, SHtor_to_spat_omp1_m0l, SHqst_to_spat_omp1_m0l, spat_to_SHqst_omp1_m0l },
+	{ SH_to_spat_omp2_m0l, spat_to_SH_omp2_m0l, SHsphtor_to_spat_omp2_m0l, spat_to_SHsphtor_omp2_m0l,
+		SHsph_to_spat_omp2_m0l, SHtor_to_spat_omp2_m0l, SHqst_to_spat_omp2_m0l, spat_to_SHqst_omp2_m0l },
+	{ SH_to_spat_omp3_m0l, spat_to_SH_omp3_m0l, SHsphtor_to_spat_omp3_m0l, spat_to_SHsphtor_omp3_m0l,
+		SHsph_to_spat_omp3_m0l, SHtor_to_spat_omp3_m0l, SHqst_to_spat_omp3_m0l, spat_to_SHqst_omp3_m0l },
+	{ SH_to_spat_omp4_m0l, spat_to_SH_omp4_m0l, NULL, NULL,
+		SHsph_to_spat_omp4_m0l, SHtor_to_spat_omp4_m0l, NULL, NULL },
+	{ SH_to_spat_omp6_m0l, spat_to_SH_omp6_m0l, NULL, NULL,
+		NULL, NULL, NULL, NULL },
+	{ SH_to_spat_omp8_m0l, spat_to_SH_omp8_m0l, NULL, NULL,
+		NULL, NULL, NULL, NULL }
+};
@@ -0,0 +1,230 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_perf.c
+ * \brief Hardware performance counters of the transforms (included by sht_init.c).
+ *
+ * When compiled with ./configure --enable-stats on Linux, \ref shtns_perf_enable starts reading the counters
+ * of the perf_event interface around every transform, and in each thread of their parallel regions.
+ * Every thread opens its own counters on first use (counting only itself, in user space), and closes them when
+ * the counters are disabled or when it exits.
+ * The cache misses and cycles use the generic events of the kernel; the L2 misses and floating point operations
+ * use raw events of recent Intel (Broadwell and later big cores) and AMD (zen) processors, and are not available elsewhere.
+ * Counters that cannot be opened (no hardware support, virtual machine, or /proc/sys/kernel/perf_event_paranoid too high)
+ * are simply not reported.
+ */
+
+#ifdef SHTNS_STATS
+
+int sht_perf_on = 0;		///< 1 if the transforms read the hardware counters.
+
+#ifdef SHTNS_PERF
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#define PERF_MAXEV 12
+
+/// an event of the kernel, accumulated with a weight into one of the counters of enum shtns_perf_counter.
+struct perf_ev {
+	unsigned type;
+	unsigned long long config;
+	double w;
+	short cnt;
+};
+
+static struct perf_ev perf_ev[PERF_MAXEV];
+static int perf_nev = -1;			///< number of events (-1 if not yet set up).
+static unsigned perf_mask = 0;		///< counters available in the thread that called shtns_perf_enable().
+
+static __thread int perf_fd[PERF_MAXEV];
+static __thread int perf_tls_open = 0;
+static pthread_key_t perf_key;		// only used for its destructor, closing the counters of exiting threads.
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+
+#define PERF_CACHE_READ_MISS(cache)  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+#if defined(__x86_64__) || defined(__i386__)
+/// \internal returns 1 if the Intel family 6 processor model has the FP_ARITH_INST_RETIRED events (0xC7),
+/// that is the big cores from Broadwell on. Haswell and older, and the Atom cores, do not have them.
+static int perf_intel_fp_arith(int model)
+{
+	static const unsigned char models[] = {
+		0x3D, 0x47, 0x4F, 0x56,		// Broadwell
+		0x4E, 0x5E, 0x55, 0x8E, 0x9E, 0xA5, 0xA6,		// Skylake, Kaby Lake, Coffee Lake, Comet Lake, Cascade Lake
+		0x66, 0x6A, 0x6C, 0x7D, 0x7E, 0xA7, 0x8C, 0x8D,		// Cannon Lake, Ice Lake, Rocket Lake, Tiger Lake
+		0x8F, 0xCF, 0xAD, 0xAE,		// Sapphire Rapids, Emerald Rapids, Granite Rapids
+		0x97, 0x9A, 0xB7, 0xBA, 0xBF, 0xAA, 0xAC, 0xC5, 0xC6, 0xBD		// Alder Lake, Raptor Lake, Meteor Lake, Arrow Lake, Lunar Lake
+	};
+	for (int i=0; i<(int) sizeof(models); i++)
+		if (models[i] == model) return 1;
+	return 0;
+}
+#endif
+
+static void perf_add_ev(int cnt, unsigned type, unsigned long long config, double w)
+{
+	if (perf_nev >= PERF_MAXEV) return;
+	struct perf_ev* e = perf_ev + perf_nev++;
+	e->cnt = cnt;		e->type = type;		e->config = config;		e->w = w;
+}
+
+/// \internal list of the events to read, depending on the cpu.
+static void perf_setup()
+{
+	perf_nev = 0;
+	perf_add_ev(shtns_perf_cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, 1.0);
+	perf_add_ev(shtns_perf_instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, 1.0);
+	perf_add_ev(shtns_perf_l1d_misses, PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), 1.0);
+	perf_add_ev(shtns_perf_llc_misses, PERF_TYPE_HW_CACHE, PERF_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL), 1.0);
+  #if defined(__x86_64__) || defined(__i386__)
+	unsigned a, b, c, d;
+	if (__get_cpuid(0, &a, &b, &c, &d)) {
+		char vendor[13];
+		memcpy(vendor, &b, 4);		memcpy(vendor+4, &d, 4);		memcpy(vendor+8, &c, 4);		vendor[12] = 0;
+		__get_cpuid(1, &a, &b, &c, &d);
+		int family = (a >> 8) & 0xF;
+		int model = (a >> 4) & 0xF;
+		if ((family == 6) || (family == 0xF)) model += ((a >> 16) & 0xF) << 4;
+		if (family == 0xF) family += (a >> 20) & 0xFF;
+		if ((strcmp(vendor, "GenuineIntel") == 0) && (family == 6) && (perf_intel_fp_arith(model))) {
+			perf_add_ev(shtns_perf_l2_misses, PERF_TYPE_RAW, 0x3F24, 1.0);		// L2_RQSTS.MISS
+			perf_add_ev(shtns_perf_fp_ops, PERF_TYPE_RAW, 0x01C7, 1.0);		// FP_ARITH_INST_RETIRED.SCALAR_DOUBLE
+			perf_add_ev(shtns_perf_fp_ops, PERF_TYPE_RAW, 0x04C7, 2.0);		// FP_ARITH_INST_RETIRED.128B_PACKED_DOUBLE
+			perf_add_ev(shtns_perf_fp_ops, PERF_TYPE_RAW, 0x10C7, 4.0);		// FP_ARITH_INST_RETIRED.256B_PACKED_DOUBLE
+			perf_add_ev(shtns_perf_fp_ops, PERF_TYPE_RAW, 0x40C7, 8.0);		// FP_ARITH_INST_RETIRED.512B_PACKED_DOUBLE
+		} else if ((strcmp(vendor, "AuthenticAMD") == 0) && (family >= 0x17)) {		// zen
+			perf_add_ev(shtns_perf_l2_misses, PERF_TYPE_RAW, 0x0864, 1.0);		// L2_CACHE_REQ_STAT.LS_RD_BLK_C
+			perf_add_ev(shtns_perf_fp_ops, PERF_TYPE_RAW, 0xFF03, 1.0);		// RETIRED_SSE_AVX_FLOPS.ALL
+		}
+	}
+  #endif
+}
+
+/// \internal closes the counters of the calling thread (they are opened again by the next \ref perf_read).
+static void perf_close()
+{
+	if (!perf_tls_open) return;
+	for (int i=0; i<perf_nev; i++) {
+		if (perf_fd[i] >= 0) close(perf_fd[i]);
+		perf_fd[i] = -1;
+	}
+	perf_tls_open = 0;
+}
+
+static void perf_thread_exit(void* p)
+{
+	perf_close();
+}
+
+static void perf_key_create()
+{
+	pthread_key_create(&perf_key, perf_thread_exit);
+}
+
+/// \internal opens the counters of the calling thread. Returns the set of available counters.
+static unsigned perf_open()
+{
+	struct perf_event_attr attr;
+	unsigned mask = 0;
+	for (int i=0; i<perf_nev; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = perf_ev[i].type;		attr.config = perf_ev[i].config;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;		// to scale multiplexed counters.
+		attr.exclude_kernel = 1;		attr.exclude_hv = 1;
+		perf_fd[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);		// calling thread, any cpu.
+		if (perf_fd[i] >= 0) mask |= 1U << perf_ev[i].cnt;
+	}
+	perf_tls_open = 1;
+	pthread_once(&perf_key_once, perf_key_create);
+	pthread_setspecific(perf_key, perf_fd);		// non-NULL value: the destructor is called when the thread exits.
+	return mask;
+}
+
+/// \internal reads the counters of the calling thread into v[shtns_perf_ncounters], opening them on first use.
+void perf_read(double* v)
+{
+	unsigned long long x[3];		// value, time enabled, time running.
+	if (!perf_tls_open) perf_open();
+	for (int k=0; k<shtns_perf_ncounters; k++)	v[k] = 0.0;
+	for (int i=0; i<perf_nev; i++) {
+		if (perf_fd[i] < 0) continue;
+		if (read(perf_fd[i], x, sizeof(x)) != sizeof(x)) continue;
+		double c = x[0];
+		if ((x[2] > 0) && (x[2] < x[1])) c *= (double) x[1] / x[2];
+		v[perf_ev[i].cnt] += perf_ev[i].w * c;
+	}
+}
+
+#else
+
+void perf_read(double* v)
+{
+	for (int k=0; k<shtns_perf_ncounters; k++)	v[k] = 0.0;
+}
+
+#endif
+
+/// \internal nominal peak of double precision operations per cycle and core: two fma units on vectors of VSIZE2 doubles.
+#define PERF_PEAK_FLOPS_PER_CYCLE (2*2*VSIZE2)
+
+/// \internal fills the hardware counters and derived metrics of st from the statistics r.
+static void perf_get_stats(const struct stats_rec* r, struct shtns_stats* st)
+{
+	st->perf_calls = r->perf_calls;
+	if (r->perf_calls == 0) return;
+  #ifdef SHTNS_PERF
+	st->perf_mask = perf_mask;
+  #endif
+	for (int k=0; k<shtns_perf_ncounters; k++)	st->counter[k] = r->perf[k];
+	const double* c = r->perf;
+	if (c[shtns_perf_cycles] > 0) {
+		st->ipc = c[shtns_perf_instructions] / c[shtns_perf_cycles];
+		st->peak_fraction = c[shtns_perf_fp_ops] / (c[shtns_perf_cycles] * PERF_PEAK_FLOPS_PER_CYCLE);
+	}
+	st->mem_bytes = c[shtns_perf_llc_misses] * 64;
+	if (st->mem_bytes > 0) st->flops_per_byte = c[shtns_perf_fp_ops] / st->mem_bytes;
+}
+
+#endif
+
+/// Start (on=1) or stop (on=0) measuring the transforms with the hardware performance counters.
+/// The counters are then reported by \ref shtns_get_stats, summed over all threads.
+/// Returns the set of counters available in the calling thread (bit k is set for counter k of \ref shtns_perf_counter),
+/// or 0 if they are not available (SHTns compiled without ./configure --enable-stats, not running on Linux,
+/// or no permission to read the counters: see /proc/sys/kernel/perf_event_paranoid).
+unsigned shtns_perf_enable(int on)
+{
+  #if defined(SHTNS_STATS) && defined(SHTNS_PERF)
+	if (perf_nev < 0) perf_setup();
+	if (!on) {
+		sht_perf_on = 0;
+		perf_close();
+		#pragma omp parallel
+		perf_close();		// also the counters opened by the threads of the parallel regions.
+		return perf_mask;
+	}
+	if (!perf_tls_open) perf_mask = perf_open();
+	sht_perf_on = (perf_mask) ? 1 : 0;
+	return perf_mask;
+  #else
+	return 0;
+  #endif
+}
@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_points.c
+ * \brief Evaluation of SH representations at many scattered points.
+ * The points are sorted by |cos(theta)|, so that points sharing a latitude (or its mirror image with respect to the equator)
+ * share the same Legendre functions. VSIZE2 distinct latitudes are processed at once (one per SIMD lane): for every m,
+ * the sums over l of the Legendre functions times the coefficients are accumulated, split into their equatorially
+ * symmetric and anti-symmetric parts. The sum over m is then done for each point, with e^{im.phi} computed by recurrence.
+ */
+
+/// \internal a point, identified by its index, and the absolute value of its cos(theta).
+struct pts_key {
+	double ac;
+	long int i;
+};
+
+static int pts_key_cmp(const void* a, const void* b)
+{
+	const struct pts_key* ka = (const struct pts_key*) a;
+	const struct pts_key* kb = (const struct pts_key*) b;
+	if (ka->ac != kb->ac) return (ka->ac < kb->ac) ? -1 : 1;
+	return (ka->i > kb->i) - (ka->i < kb->i);
+}
+
+/// \internal maximum of log(sin(t0)^mmax / sin(t)^mmax) for latitudes t evaluated together with t0 (see \ref vsint_pow_n_ext).
+/// A factor 1e-20 keeps the other lanes far from underflow, even when the first one is rescaled down to about 1/SHT_SCALE_FACTOR^2.
+#define PTS_LOG_RANGE 46.0
+
+/// \internal sorts the n points by increasing |cos(theta)| and groups them by distinct latitudes.
+/// On return, idx[] holds the point indices, and the points of the k-th latitude are idx[lat0[k]] to idx[lat0[k+1]-1].
+/// lat0 must have room for n+1 values. Returns the number of distinct latitudes.
+static long int points_group(long int n, const double* cost, long int* idx, long int* lat0)
+{
+	struct pts_key* key = (struct pts_key*) malloc(sizeof(struct pts_key) * n);
+	if (key == NULL) shtns_runerr("not enough memory.");
+	for (long int i=0; i<n; i++) {
+		key[i].ac = fabs(cost[i]);		key[i].i = i;
+	}
+	qsort(key, n, sizeof(struct pts_key), pts_key_cmp);
+	long int nlat = 0;
+	for (long int i=0; i<n; i++) {
+		if ((i==0) || (key[i].ac != key[i-1].ac)) lat0[nlat++] = i;
+		idx[i] = key[i].i;
+	}
+	lat0[nlat] = n;
+	free(key);
+	return nlat;
+}
+
+/// \internal returns sin(t)^n for each lane, from s2 = sin(t)^2 and s = sin(t), with an extended exponent nval<=0 shared by all lanes.
+/// The result is the returned vector times SHT_SCALE_FACTOR^(nval). The exponent is chosen for the first lane, which must
+/// hold the largest sin(t). The other lanes would underflow if their sin(t)^n were much smaller, although their Legendre functions
+/// may become significant at higher degrees: points_eval only puts together latitudes whose sin(t)^n are within PTS_LOG_RANGE.
+static rnd vsint_pow_n_ext(rnd s2, rnd s, int n, int* nval)
+{
+	rnd val = (n&1) ? s : vall(1.0);
+	int ns2 = 0;
+	int nv = 0;
+
+	while (n >>= 1) {
+		if (n&1) {
+			if (vlo(val) < 1.0/SHT_SCALE_FACTOR) {
+				nv--;		val *= vall(SHT_SCALE_FACTOR);
+			}
+			val *= s2;		nv += ns2;
+		}
+		s2 *= s2;		ns2 += ns2;
+		if (vlo(s2) < 1.0/SHT_SCALE_FACTOR) {
+			ns2--;		s2 *= vall(SHT_SCALE_FACTOR);
+		}
+	}
+	while ((nv < 0) && (vlo(val) > 1.0/SHT_SCALE_FACTOR)) {		// try to minimize |nv|
+		++nv;	val *= vall(1.0/SHT_SCALE_FACTOR);
+	}
+	*nval = nv;
+	return val;
+}
+
+// accumulates y*c into the real and imaginary parts a[0] and a[1].
+#define PTS_ACC(a, y, c)	{ (a)[0] += (y) * vall(creal(c));		(a)[1] += (y) * vall(cimag(c)); }
+
+/// \internal For the VSIZE2 latitudes x = |cos(theta)|, s2 = sin(theta)^2 and s = sin(theta), and for all m, computes the sums over l of the Legendre functions times Q.
+/// acc[4*im] and acc[4*im+1] receive the real and imaginary parts of the sum over l-m even, acc[4*im+2] and acc[4*im+3] the one over l-m odd.
+static void points_leg(shtns_cfg shtns, cplx* Q, rnd x, rnd s2, rnd s, rnd* acc)
+{
+	for (int im=0; im<=MMAX; im++) {
+		const int m = im*MRES;
+		const double* al = alm_im(shtns, im);
+		const cplx* Ql = Q + LiM(shtns, 0, im);		// virtual pointer for l=0 and im
+		rnd ae[2] = { vall(0.0), vall(0.0) };
+		rnd ao[2] = { vall(0.0), vall(0.0) };
+		int ny = 0;
+		long int l = m;
+		rnd y0 = vall(al[0]);
+		if (m>0) y0 *= vsint_pow_n_ext(s2, s, m, &ny);
+		if (ny==0) PTS_ACC(ae, y0, Ql[l]);
+		if (l < LMAX) {
+			rnd y1 = vall(al[1]) * (x*y0);
+			if (ny==0) PTS_ACC(ao, y1, Ql[l+1]);
+			l+=2;	al+=2;
+			while ((ny < 0) && (l < LMAX)) {		// values are negligible => discard.
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				y1 = vall(al[3])*(x*y0) + vall(al[2])*y1;
+				l+=2;	al+=4;
+				if (fabs(vlo(y0)) > 1.0/SHT_SCALE_FACTOR) {		// rescale when value is significant
+					++ny;	y0 *= vall(1.0/SHT_SCALE_FACTOR);	y1 *= vall(1.0/SHT_SCALE_FACTOR);
+				}
+			}
+			while (l < LMAX) {
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				PTS_ACC(ae, y0, Ql[l]);
+				y1 = vall(al[3])*(x*y0) + vall(al[2])*y1;
+				PTS_ACC(ao, y1, Ql[l+1]);
+				l+=2;	al+=4;
+			}
+			if ((l == LMAX) && (ny == 0)) {
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				PTS_ACC(ae, y0, Ql[l]);
+			}
+		}
+		acc[4*im] = ae[0];		acc[4*im+1] = ae[1];
+		acc[4*im+2] = ao[0];	acc[4*im+3] = ao[1];
+	}
+}
+
+/// \internal Same as \ref points_leg, but for the sums needed by vector fields: for all m, the sums over l are stored in acc[4*(nc*im+k)],
+/// for k=0: Q.Y ; k=1: S.dY/dt ; k=2: S.Y ; and if T is not NULL k=3: T.dY/dt ; k=4: T.Y, with nc=3 or 5 the number of sums.
+/// As for \ref legendre_sphPlm_deriv_array, Y is divided by sin(theta) for m>0.
+static void points_leg_deriv(shtns_cfg shtns, cplx* Q, cplx* S, cplx* T, rnd x, rnd s2, rnd s, rnd* acc)
+{
+	const int nc = (T) ? 5 : 3;
+	for (int im=0; im<=MMAX; im++) {
+		const int m = im*MRES;
+		const double* al = alm_im(shtns, im);
+		const long int lm0 = LiM(shtns, 0, im);
+		const cplx* Ql = Q + lm0;		const cplx* Sl = S + lm0;		const cplx* Tl = (T) ? T + lm0 : NULL;
+		rnd a[20];		// even parts in a[4*k], a[4*k+1], odd parts in a[4*k+2], a[4*k+3].
+		for (int k=0; k<4*nc; k++) a[k] = vall(0.0);
+		int ny = 0;
+		long int l = m;
+		rnd st = s;
+		rnd y0 = vall(al[0]);
+		rnd dy0 = vall(0.0);
+		if (m>0) {
+			y0 *= vsint_pow_n_ext(s2, s, m-1, &ny);
+			dy0 = vall(m)*(x*y0);
+			st = s2;		// st = sin(theta)^2 is used in the recurrence for m>0
+		}
+		#define PTS_ACC_DERIV(p, y, dy, l)	{	\
+			PTS_ACC(a+(p), y, Ql[l]);	PTS_ACC(a+4+(p), dy, Sl[l]);	PTS_ACC(a+8+(p), y, Sl[l]);	\
+			if (Tl) { PTS_ACC(a+12+(p), dy, Tl[l]);	PTS_ACC(a+16+(p), y, Tl[l]); }	}
+		if (ny==0) PTS_ACC_DERIV(0, y0, dy0, l);
+		if (l < LMAX) {
+			rnd y1 = vall(al[1]) * (x*y0);
+			rnd dy1 = vall(al[1]) * (x*dy0 - st*y0);
+			if (ny==0) PTS_ACC_DERIV(2, y1, dy1, l+1);
+			l+=2;	al+=2;
+			while ((ny < 0) && (l < LMAX)) {		// values are negligible => discard.
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				dy0 = vall(al[1])*(x*dy1 - y1*st) + vall(al[0])*dy0;
+				y1 = vall(al[3])*(x*y0) + vall(al[2])*y1;
+				dy1 = vall(al[3])*(x*dy0 - y0*st) + vall(al[2])*dy1;
+				l+=2;	al+=4;
+				if (fabs(vlo(y0)) > 1.0/SHT_SCALE_FACTOR) {		// rescale when value is significant
+					++ny;	y0 *= vall(1.0/SHT_SCALE_FACTOR);	dy0 *= vall(1.0/SHT_SCALE_FACTOR);
+							y1 *= vall(1.0/SHT_SCALE_FACTOR);	dy1 *= vall(1.0/SHT_SCALE_FACTOR);
+				}
+			}
+			while (l < LMAX) {
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				dy0 = vall(al[1])*(x*dy1 - y1*st) + vall(al[0])*dy0;
+				PTS_ACC_DERIV(0, y0, dy0, l);
+				y1 = vall(al[3])*(x*y0) + vall(al[2])*y1;
+				dy1 = vall(al[3])*(x*dy0 - y0*st) + vall(al[2])*dy1;
+				PTS_ACC_DERIV(2, y1, dy1, l+1);
+				l+=2;	al+=4;
+			}
+			if ((l == LMAX) && (ny == 0)) {
+				y0 = vall(al[1])*(x*y1) + vall(al[0])*y0;
+				dy0 = vall(al[1])*(x*dy1 - y1*st) + vall(al[0])*dy0;
+				PTS_ACC_DERIV(0, y0, dy0, l);
+			}
+		}
+		#undef PTS_ACC_DERIV
+		for (int k=0; k<4*nc; k++) acc[4*nc*im + k] = a[k];
+	}
+}
+
+#undef PTS_ACC
+
+/// \internal evaluates the scalar field Q (if S==NULL) or the vector field Q,S,T (T may be NULL) at the n points (cost[i], phi[i]).
+/// The points are grouped by latitude, and the latitudes are processed by blocks of up to VSIZE2 (see \ref PTS_LOG_RANGE), distributed among the threads.
+static void points_eval(shtns_cfg shtns, cplx* Q, cplx* S, cplx* T, long int n, const double* cost, const double* phi,
+					double* vr, double* vt, double* vp)
+{
+	if (n <= 0) return;
+	long int* idx = (long int*) malloc(sizeof(long int) * (3*n+2));
+	if (idx == NULL) shtns_runerr("not enough memory.");
+	long int* lat0 = idx + n;
+	const long int nlat = points_group(n, cost, idx, lat0);
+	long int* blk0 = lat0 + nlat+1;		// first latitude of each block.
+	long int nblk = 0;
+	for (long int k=0; k<nlat; nblk++) {		// blocks of up to VSIZE2 latitudes, with sin(theta)^mmax within PTS_LOG_RANGE.
+		const double x0 = fabs(cost[idx[lat0[k]]]);
+		const double ls0 = 0.5*log((1.-x0)*(1.+x0));
+		blk0[nblk] = k++;
+		while ((k < nlat) && (k - blk0[nblk] < VSIZE2)) {
+			const double x = fabs(cost[idx[lat0[k]]]);
+			if (MMAX*MRES*(ls0 - 0.5*log((1.-x)*(1.+x))) > PTS_LOG_RANGE) break;		// also true at the poles for mmax>0.
+			k++;
+		}
+	}
+	blk0[nblk] = nlat;
+	const int nc = (S == NULL) ? 1 : ((T) ? 5 : 3);		// number of sums per m.
+
+	#pragma omp parallel num_threads(shtns->nthreads) if((shtns->nthreads > 1) && (nblk > 1))
+	{
+		rnd* acc = (rnd*) VMALLOC(sizeof(rnd) * 4*nc*(MMAX+1));
+		if (acc == NULL) shtns_runerr("not enough memory.");
+		const double* const a0 = (const double*) acc;
+
+		#pragma omp for schedule(dynamic)
+		for (long int b=0; b<nblk; b++) {
+			const long int k0 = blk0[b];
+			const long int nk = blk0[b+1] - k0;
+			double xl[VSIZE2] SSE;
+			double s2l[VSIZE2] SSE;
+			double sl[VSIZE2] SSE;
+			for (int j=0; j<VSIZE2; j++) {		// lane 0 gets the largest sin(theta).
+				const long int k = k0 + ((j < nk) ? j : nk-1);		// pad with the last latitude of the block.
+				const double x = fabs(cost[idx[lat0[k]]]);
+				xl[j] = x;		s2l[j] = (1.-x)*(1.+x);		sl[j] = sqrt(s2l[j]);
+			}
+			const rnd x = vread(xl, 0);
+			const rnd s2 = vread(s2l, 0);
+			const rnd s = vread(sl, 0);
+			if (S == NULL) {
+				points_leg(shtns, Q, x, s2, s, acc);
+			} else points_leg_deriv(shtns, Q, S, T, x, s2, s, acc);
+
+			for (int j=0; j<nk; j++) {
+				const long int k = k0 + j;
+				const double sint = sl[j];
+				for (long int p=lat0[k]; p<lat0[k+1]; p++) {
+					const long int i = idx[p];
+					const double sgn = (cost[i] < 0.0) ? -1.0 : 1.0;	// southern hemisphere: odd parts change sign.
+					const double ph = phi[i];
+					const double cp = cos(MRES*ph);		const double sp = sin(MRES*ph);
+					double er = 1.0;		double ei = 0.0;		// e^{im.phi}
+					const double* a = a0 + j;
+					if (S == NULL) {
+						double vr0 = a[0] + sgn*a[2*VSIZE2];
+						double vrm = 0.0;
+						for (int im=1; im<=MMAX; im++) {
+							const double t = er*cp - ei*sp;		ei = er*sp + ei*cp;		er = t;
+							if ((im & 127) == 0) {	er = cos(im*MRES*ph);	ei = sin(im*MRES*ph);	}	// limit the accumulation of round-off errors.
+							a += 4*VSIZE2;
+							vrm += (a[0] + sgn*a[2*VSIZE2])*er - (a[VSIZE2] + sgn*a[3*VSIZE2])*ei;
+						}
+						vr[i] = vr0 + 2.*vrm;
+					} else {
+						#define PTS_RE(k) (a[(4*(k))*VSIZE2] + sgn*a[(4*(k)+2)*VSIZE2])		// real part of the sum k, for Y
+						#define PTS_IM(k) (a[(4*(k)+1)*VSIZE2] + sgn*a[(4*(k)+3)*VSIZE2])	// imaginary part of the sum k, for Y
+						#define PTS_DRE(k) (sgn*a[(4*(k))*VSIZE2] + a[(4*(k)+2)*VSIZE2])	// real part of the sum k, for dY/dt
+						#define PTS_DIM(k) (sgn*a[(4*(k)+1)*VSIZE2] + a[(4*(k)+3)*VSIZE2])	// imaginary part of the sum k, for dY/dt
+						const double vr0 = PTS_RE(0);
+						const double vt0 = PTS_DRE(1);
+						const double vp0 = (T) ? -PTS_DRE(3) : 0.0;
+						double vrm = 0.0;		double vtm = 0.0;		double vpm = 0.0;
+						for (int im=1; im<=MMAX; im++) {
+							const double m = im*MRES;
+							const double t = er*cp - ei*sp;		ei = er*sp + ei*cp;		er = t;
+							if ((im & 127) == 0) {	er = cos(m*ph);	ei = sin(m*ph);	}	// limit the accumulation of round-off errors.
+							a += 4*nc*VSIZE2;
+							vrm += PTS_RE(0)*er - PTS_IM(0)*ei;
+							vtm += PTS_DRE(1)*er - PTS_DIM(1)*ei;			// + dS/dt
+							vpm -= m*(PTS_RE(2)*ei + PTS_IM(2)*er);			// + I.m/sint *S
+							if (T) {
+								vtm -= m*(PTS_RE(4)*ei + PTS_IM(4)*er);		// + I.m/sint *T
+								vpm -= PTS_DRE(3)*er - PTS_DIM(3)*ei;		// - dT/dt
+							}
+						}
+						#undef PTS_RE
+						#undef PTS_IM
+						#undef PTS_DRE
+						#undef PTS_DIM
+						vr[i] = vr0 + 2.*vrm*sint;
+						vt[i] = vt0 + 2.*vtm;
+						vp[i] = vp0 + 2.*vpm;
+					}
+				}
+			}
+		}
+		VFREE(acc);
+	}
+	free(idx);
+}
+
+/*
+	FAST SYNTHESIS AT SCATTERED POINTS, AND ITS ADJOINT
+	The field is synthesized by SH_to_spat on an oversampled regular grid, and interpolated to the points with a compact
+	(Lagrange) kernel of pt x pp grid points. The grid is extended beyond the poles: f(-theta, phi) = f(theta, phi+pi).
+	The adjoint spreads the values on the grid with the same weights, and uses the analysis as the transpose of the synthesis.
+*/
+
+static int choose_nlat(int n);
+
+/// a planned synthesis at given points, see \ref shtns_points_plan_create
+struct shtns_points_plan_s {
+	shtns_cfg shtns;		///< the config of the spectral data.
+	shtns_cfg grid;			///< config with an oversampled regular grid (equispaced latitudes, without poles), phi varying fastest.
+	double *spat;			///< spatial field on the oversampled grid.
+	long int n;				///< number of points.
+	int pt, pp;				///< number of grid points of the interpolation kernel, in theta and in phi.
+	int phalf;				///< longitude shift corresponding to phi+pi, in grid points.
+	long int *idx;			///< index of the points, sorted by position on the grid.
+	int *jt, *jp;			///< first latitude (of the grid extended beyond the poles) and first longitude of each kernel.
+	double *wt, *wp;		///< interpolation weights in theta (n*pt) and in phi (n*pp).
+};
+
+/// \internal log of the error bound of the Lagrange interpolation with p equispaced nodes, for a trigonometric polynomial
+/// of maximum frequency k sampled with step h (kh = k*h), relative to its maximum value.
+/// The bound (kh)^p / p! . max|prod(x-x_i)|/h^p uses the Bernstein inequality for the p-th derivative.
+static double lagrange_log_err(double kh, int p)
+{
+	double e = p*log(kh);
+	for (int i=1; i<=p; i++) e -= log(i);		// 1/p!
+	for (int i=0; i<p/2; i++) e += 2.*log(i+0.5);		// max of the node polynomial, in the central interval
+	if (p&1) e += log((p/2)+0.5);
+	return e;
+}
+
+/// \internal smallest number of nodes (at least 2, at most 40) to interpolate with relative accuracy eps.
+static int lagrange_order(double kh, double eps)
+{
+	if (kh == 0.0) return 1;		// constant.
+	int p = 2;
+	while ((p < 40) && (lagrange_log_err(kh, p) > log(eps))) p++;
+	return p;
+}
+
+/// \internal Lagrange interpolation weights w[k] of the p nodes 0..p-1, at position t.
+static void lagrange_weights(int p, double t, double* w)
+{
+	for (int k=0; k<p; k++) {
+		double c = 1.0;
+		for (int i=0; i<p; i++) {
+			if (i != k) c *= (t-i)/(k-i);
+		}
+		w[k] = c;
+	}
+}
+
+/// \internal first node j0 of a kernel of p nodes around the grid coordinate u, and the position of u relative to j0.
+static int kernel_start(double u, int p, double* t)
+{
+	int j0 = (int) floor(u + 0.5*(p&1)) - (p-1)/2;
+	*t = u - j0;
+	return j0;
+}
+
+static int points_slot_cmp(const void* a, const void* b)
+{
+	const int* ka = (const int*) a;		const int* kb = (const int*) b;
+	if (ka[0] != kb[0]) return ka[0] - kb[0];
+	return ka[1] - kb[1];
+}
+
+/** Plan the synthesis at the \b n points defined by \b cost[i] = cos(theta) and \b phi[i], with relative accuracy \b eps
+ * (with respect to the maximum value of the field). The grid oversampling and the size of the interpolation kernel are
+ * chosen to minimize the cost for the given accuracy, and the interpolation weights are precomputed.
+ * See \ref SH_to_points_fast and \ref SH_to_points_adjoint. Release with \ref shtns_points_plan_destroy.
+ * Returns NULL if the grid could not be set. */
+shtns_points_plan shtns_points_plan_create(shtns_cfg shtns, long int n, const double *cost, const double *phi, double eps)
+{
+	int nlat = 0, nphi = 1;
+	int pt = 1, pp = 1;
+	double cmin = 0.0;
+
+	if (eps < 1e-14) eps = 1e-14;
+	if (eps > 0.1) eps = 0.1;
+	for (int sig=2; sig<=8; sig++) {		// oversampling factor: fewer kernel points, but more expensive grid synthesis.
+		int nl = choose_nlat(sig*(LMAX+1));
+		int np = (MMAX > 0) ? fft_int(2*sig*(MMAX+1), 7) : 1;
+		int a = lagrange_order(M_PI*LMAX/nl, 0.5*eps);
+		int b = (MMAX > 0) ? lagrange_order(2.*M_PI*MMAX/np, 0.5*eps) : 1;
+		if (a > nl) a = nl;
+		while (b > np) np = fft_int(np+2, 7);
+		const int ok = (lagrange_log_err(M_PI*LMAX/nl, a) <= log(0.5*eps)) && ((MMAX == 0) || (lagrange_log_err(2.*M_PI*MMAX/np, b) <= log(0.5*eps)));
+		if ((!ok) && ((nlat > 0) || (sig < 8))) continue;		// the kernel (at most 40 points) cannot reach the accuracy.
+		double c = (double) NLM * nl * 2.0  +  2.5*nl*np*log2(np+1)  +  (double) n * (a*b*2 + 2*(a+b)*a);
+		if ((nlat == 0) || (c < cmin)) {
+			cmin = c;		nlat = nl;		nphi = np;		pt = a;		pp = b;
+		}
+	}
+
+	shtns_points_plan p = (shtns_points_plan) malloc(sizeof(struct shtns_points_plan_s));
+	if (p == NULL) return NULL;
+	p->shtns = shtns;		p->n = n;		p->pt = pt;		p->pp = pp;
+	const int verbose0 = verbose;
+	verbose = 0;		// the internal grid is not reported.
+	p->grid = shtns_create(LMAX, MMAX, MRES, shtns->norm);
+	int ok = (p->grid != NULL) && (shtns_set_grid(p->grid, sht_reg_fast | SHT_PHI_CONTIGUOUS | SHT_SCALAR_ONLY, 0.0, nlat, nphi) > 0);		// no polar optimization: the analysis must be the exact transpose.
+	verbose = verbose0;
+	if (!ok) {
+		if (p->grid) shtns_destroy(p->grid);
+		free(p);	return NULL;
+	}
+	p->phalf = ((nphi*MRES) & 1) ? 0 : ((nphi*MRES)/2) % nphi;		// nphi is odd only for mmax=0
+	p->spat = (double*) VMALLOC(sizeof(double) * NSPAT_ALLOC(p->grid));
+	p->idx = (long int*) malloc(sizeof(long int) * n);
+	p->jt = (int*) malloc(sizeof(int) * 2*n);
+	p->wt = (double*) malloc(sizeof(double) * n*(pt+pp));
+	if ((p->spat == NULL) || (p->idx == NULL) || (p->jt == NULL) || (p->wt == NULL)) shtns_runerr("not enough memory.");
+	p->jp = p->jt + n;		p->wp = p->wt + n*pt;
+
+	// sort the points by kernel position, for locality of the grid accesses.
+	const double ht = M_PI/nlat;		// latitude spacing, the grid latitudes being at (j+0.5)*ht
+	const double hp = 2.*M_PI/(MRES*nphi);		// longitude spacing.
+	const double period = 2.*M_PI/MRES;
+	{
+		struct { int k[2]; long int i; } *ks = malloc(sizeof(*ks) * n);
+		if (ks == NULL) shtns_runerr("not enough memory.");
+		for (long int i=0; i<n; i++) {
+			double t;
+			ks[i].k[0] = kernel_start(acos(cost[i])/ht - 0.5, pt, &t);
+			ks[i].k[1] = (int) floor((phi[i] - floor(phi[i]/period)*period)/hp);
+			ks[i].i = i;
+		}
+		qsort(ks, n, sizeof(*ks), points_slot_cmp);
+		for (long int i=0; i<n; i++) p->idx[i] = ks[i].i;
+		free(ks);
+	}
+	for (long int s=0; s<n; s++) {
+		const long int i = p->idx[s];
+		double t;
+		p->jt[s] = kernel_start(acos(cost[i])/ht - 0.5, pt, &t);
+		lagrange_weights(pt, t, p->wt + s*pt);
+		double ph = phi[i] - floor(phi[i]/period)*period;		// 0 <= ph < 2pi/mres
+		int j0 = kernel_start(ph/hp, pp, &t);
+		lagrange_weights(pp, t, p->wp + s*pp);
+		j0 %= nphi;		if (j0 < 0) j0 += nphi;
+		p->jp[s] = j0;
+	}
+	#if SHT_VERBOSE > 1
+	if (verbose>1) printf("        points plan: %ld points, grid %d x %d, kernel %d x %d\n", n, nlat, nphi, pt, pp);
+	#endif
+	return p;
+}
+
+/// Release the resources of a plan created by \ref shtns_points_plan_create.
+void shtns_points_plan_destroy(shtns_points_plan p)
+{
+	if (p == NULL) return;
+	shtns_destroy(p->grid);
+	VFREE(p->spat);
+	free(p->wt);		free(p->jt);		free(p->idx);
+	free(p);
+}
+
+/// \internal grid latitude j of the extended grid: maps latitudes beyond the poles back on the grid, and returns the longitude shift.
+static inline int points_lat(shtns_points_plan p, int* j)
+{
+	const int nlat = p->grid->nlat;
+	if (*j < 0) {	*j = -1 - *j;		return p->phalf;	}
+	if (*j >= nlat) {	*j = 2*nlat-1 - *j;		return p->phalf;	}
+	return 0;
+}
+
+/// Evaluate the scalar SH representation \b Qlm at the points of plan \b p, storing the values in \b vr[i] (same ordering as the points given to \ref shtns_points_plan_create).
+/// \b Qlm is not modified.
+void SH_to_points_fast(shtns_points_plan p, cplx *Qlm, double *vr)
+{
+	const shtns_cfg shtns = p->grid;
+	const int pt = p->pt;		const int pp = p->pp;
+
+	SH_to_spat(shtns, Qlm, p->spat);
+	#pragma omp parallel for schedule(static) num_threads(shtns->nthreads) if(shtns->nthreads > 1)
+	for (long int s=0; s<p->n; s++) {
+		const double* wt = p->wt + s*pt;		const double* wp = p->wp + s*pp;
+		double v = 0.0;
+		for (int k=0; k<pt; k++) {
+			int j = p->jt[s] + k;
+			int ip = p->jp[s] + points_lat(p, &j);
+			if (ip >= NPHI) ip -= NPHI;
+			const double* row = p->spat + (long int) j*NPHI;
+			double vk = 0.0;
+			for (int q=0; q<pp; q++) {
+				vk += wp[q] * row[ip];
+				if (++ip == NPHI) ip = 0;
+			}
+			v += wt[k] * vk;
+		}
+		vr[p->idx[s]] = v;
+	}
+}
+
+/// Adjoint of \ref SH_to_points_fast: computes Qlm such that sum_lm Re(conj(Qlm).Xlm) = sum_i vr[i].x[i], for any Xlm synthesized as x[i] at the points.
+/// This is the transpose used in least-squares fits of data given at the points (it is not an inverse).
+void SH_to_points_adjoint(shtns_points_plan p, const double *vr, cplx *Qlm)
+{
+	const shtns_cfg shtns = p->grid;
+	const int pt = p->pt;		const int pp = p->pp;
+	double* const f = p->spat;
+
+	memset(f, 0, sizeof(double) * NLAT*NPHI);
+	for (long int s=0; s<p->n; s++) {		// spread the values on the grid (sequential, as kernels overlap).
+		const double* wt = p->wt + s*pt;		const double* wp = p->wp + s*pp;
+		const double v = vr[p->idx[s]];
+		for (int k=0; k<pt; k++) {
+			int j = p->jt[s] + k;
+			int ip = p->jp[s] + points_lat(p, &j);
+			if (ip >= NPHI) ip -= NPHI;
+			double* row = f + (long int) j*NPHI;
+			const double vk = wt[k] * v;
+			for (int q=0; q<pp; q++) {
+				row[ip] += wp[q] * vk;
+				if (++ip == NPHI) ip = 0;
+			}
+		}
+	}
+	// the analysis computes wg[j] * sum_j Ylm(j) * sum_k f[j,k] exp(-i.m.phi_k), with some normalization factors:
+	for (int j=0; j<NLAT; j++) {
+		const double w = 1.0 / shtns->wg[(j < NLAT_2) ? j : NLAT-1-j];
+		for (int k=0; k<NPHI; k++) f[(long int) j*NPHI + k] *= w;
+	}
+	spat_to_SH(shtns, f, Qlm);
+	for (int im=0; im<=MMAX; im++) {		// undo the normalization factors of the analysis, and double m>0 (real fields).
+		double c = (im == 0) ? 1.0 : 2.0;
+		if ((im > 0) && (shtns->norm & SHT_REAL_NORM)) c *= 0.5;
+		for (int l=im*MRES; l<=LMAX; l++) {
+			double cl = c;
+			if (SHT_NORM == sht_schmidt) cl /= (2*l+1);
+			Qlm[LiM(shtns, l, im)] *= cl;
+		}
+	}
+}
+
+/** \addtogroup local
+*/
+//@{
+
+/// Evaluate scalar SH representation \b Qlm at the \b n physical points defined by \b cost[i] = cos(theta) and \b phi[i], storing the values in \b vr[i].
+/// Much faster than repeated calls to \ref SH_to_point, especially when many points share the same latitude.
+void SH_to_points(shtns_cfg shtns, cplx *Qlm, long int n, const double *cost, const double *phi, double *vr)
+{
+	points_eval(shtns, Qlm, NULL, NULL, n, cost, phi, vr, NULL, NULL);
+}
+
+/// Evaluate the gradient of a scalar field at the \b n points (\b cost[i], \b phi[i]), like \ref SH_to_grad_point does for one point.
+void SH_to_grad_points(shtns_cfg shtns, cplx *DrSlm, cplx *Slm, long int n, const double *cost, const double *phi,
+					   double *gr, double *gt, double *gp)
+{
+	points_eval(shtns, DrSlm, Slm, NULL, n, cost, phi, gr, gt, gp);
+}
+
+/// Evaluate vector SH representation \b Qlm, \b Slm, \b Tlm at the \b n points (\b cost[i], \b phi[i]), like \ref SHqst_to_point does for one point.
+void SHqst_to_points(shtns_cfg shtns, cplx *Qlm, cplx *Slm, cplx *Tlm, long int n, const double *cost, const double *phi,
+					   double *vr, double *vt, double *vp)
+{
+	points_eval(shtns, Qlm, Slm, Tlm, n, cost, phi, vr, vt, vp);
+}
+//@}
@@ -81,9 +81,21 @@ int cushtns_use_gpu(int);
 /// minimum NLAT to consider the use of DCT acceleration.
 #define SHT_MIN_NLAT_DCT 64
 
-/// time-limit for timing individual transforms (in seconds)
+/// default time budget for timing the algorithms of one transform type (in seconds), see \ref shtns_tuning_budget.
 #define SHT_TIME_LIMIT 0.2
 
+/// minimum and maximum number of timing trials of each algorithm (the median is used).
+#define SHT_TRIALS_MIN 3
+#define SHT_TRIALS_MAX 15
+
+/// target size (in bytes) of one spatial field restricted to a block of latitudes, for the fused transforms (\ref SH_to_spat_op_to_SH).
+/// Smaller blocks stay in cache, but each block costs a pass over the spectra (and an accumulation of the output spectra).
+#define SHT_FUSED_BLOCK_BYTES (2*1024*1024)
+
+/// size (in bytes) of a spatial field above which the fused transforms always work by blocks (the full grids are never stored),
+/// even if separate transforms would be faster.
+#define SHT_FUSED_GRID_BYTES (8*1024*1024)
+
 /* END COMPILE-TIME SETTINGS */
 
 // sht variants (std, ltr)
@@ -95,10 +107,87 @@ enum sht_types { SHT_TYP_SSY, SHT_TYP_SAN, SHT_TYP_VSY, SHT_TYP_VAN,
 // sht grids
 enum sht_grids { GRID_NONE, GRID_GAUSS, GRID_REGULAR, GRID_POLES };
 
+// slots for scratch memory (see shtns_scratch), one for each level of nested functions needing it.
+enum sht_scratch { SCRATCH_FFT, SCRATCH_BATCH, SCRATCH_ROT, SCRATCH_CPLX, SCRATCH_FLOAT, SCRATCH_FLOAT_M, SCRATCH_FUSED, SCRATCH_FUSED_BLK, SCRATCH_N };
+void* shtns_scratch(int slot, size_t size);
+
+#ifdef SHTNS_STATS
+// per-stage timing statistics (see shtns_get_stats) and trace (see shtns_trace_start) of the transforms, recorded in cpu ticks.
+#include "fftw3/cycle.h"
+#ifndef HAVE_TICK_COUNTER
+  #error "--enable-stats requires a cycle counter (see fftw3/cycle.h)"
+#endif
+enum stats_stage { STATS_TOTAL, STATS_LEGENDRE, STATS_FFT, STATS_ALLOC, STATS_NSTAGE };
+struct stats_rec {
+	unsigned long calls;
+	double t[STATS_NSTAGE][3];		// sum, min and max of each stage.
+	double bytes;
+	unsigned long perf_calls;		// number of calls measured with the hardware counters.
+	double perf[shtns_perf_ncounters];	// hardware counters summed over threads and calls.
+	double busy[SHTNS_STATS_MAX_THREADS];
+	int nthreads;
+};
+/// time spent by the calling thread in the fft and in allocations (never reset, the transforms use differences).
+struct stats_tls { double fft, alloc; };
+extern __thread struct stats_tls stats_tls;
+/// state of a transform call, shared by the threads of its parallel region.
+struct stats_call { ticks t0; double fft0, alloc0, fft_other; int nth, perf;
+	double busy[SHTNS_STATS_MAX_THREADS];
+	double perf0[shtns_perf_ncounters], perf_other[shtns_perf_ncounters];
+};
+void stats_begin(struct stats_call* c);
+void stats_end(shtns_cfg shtns, int typ, long llim, struct stats_call* c);
+void stats_thread_end(shtns_cfg shtns, struct stats_call* c, ticks t0, double fft0, const double* perf0);
+
+/// hardware performance counters of the calling thread (see shtns_perf_enable), read only if sht_perf_on.
+#ifdef HAVE_LINUX_PERF_EVENT_H
+  #define SHTNS_PERF
+#endif
+extern int sht_perf_on;
+void perf_read(double* v);
+
+/// to be placed at the beginning and end of the transform functions, and of their parallel regions.
+#define STATS_BEGIN		struct stats_call _stats_c;  stats_begin(&_stats_c);
+#define STATS_END(typ)	stats_end(shtns, typ, llim, &_stats_c);
+#define STATS_THREAD_BEGIN	double _stats_perf0[shtns_perf_ncounters];  if (_stats_c.perf) perf_read(_stats_perf0); \
+	const ticks _stats_t0 = getticks();  const double _stats_fft0 = stats_tls.fft;
+#define STATS_THREAD_END	stats_thread_end(shtns, &_stats_c, _stats_t0, _stats_fft0, _stats_perf0);
+
+/// trace of the transforms (see shtns_trace_start): events recorded in a ring buffer of each thread.
+enum trace_cat { TRACE_CALL, TRACE_REGION, TRACE_M, TRACE_FFT, TRACE_ALLOC, TRACE_TUNE };
+extern int sht_trace_on;
+void trace_event(const char* name, int cat, int arg, ticks t0, ticks t1);
+/// to be placed around the work on each order m by a thread.
+#define TRACE_M_BEGIN	const ticks _trace_t0 = (sht_trace_on) ? getticks() : 0;
+#define TRACE_M_END(m)	if (sht_trace_on) trace_event("m", TRACE_M, m, _trace_t0, getticks());
+
+/// accumulate the time spent in the fft (or allocation) by the calling thread.
+#define STATS_TIME_NAMED(acc, cat, name, call) do { const ticks _stats_tf = getticks();  call;  const ticks _stats_tf1 = getticks(); \
+	stats_tls.acc += elapsed(_stats_tf1, _stats_tf);  if (sht_trace_on) trace_event(name, cat, -1, _stats_tf, _stats_tf1); } while(0)
+#define STATS_TIME(acc, call)		STATS_TIME_NAMED(acc, TRACE_ALLOC, #acc, call)
+#define fftw_execute_dft(...)		STATS_TIME_NAMED(fft, TRACE_FFT, "fftw_execute_dft", fftw_execute_dft(__VA_ARGS__))
+#define fftw_execute_split_dft(...)	STATS_TIME_NAMED(fft, TRACE_FFT, "fftw_execute_split_dft", fftw_execute_split_dft(__VA_ARGS__))
+#define fftw_execute_dft_c2r(...)	STATS_TIME_NAMED(fft, TRACE_FFT, "fftw_execute_dft_c2r", fftw_execute_dft_c2r(__VA_ARGS__))
+#define fftw_execute_dft_r2c(...)	STATS_TIME_NAMED(fft, TRACE_FFT, "fftw_execute_dft_r2c", fftw_execute_dft_r2c(__VA_ARGS__))
+#define fftw_execute_r2r(...)		STATS_TIME_NAMED(fft, TRACE_FFT, "fftw_execute_r2r", fftw_execute_r2r(__VA_ARGS__))
+#else
+#define STATS_BEGIN
+#define STATS_END(typ)
+#define STATS_THREAD_BEGIN
+#define STATS_THREAD_END
+#define STATS_TIME(acc, call) call
+#define TRACE_M_BEGIN
+#define TRACE_M_END(m)
+#endif
+
+// distribution of the orders m among threads in the openmp transforms.
+enum sht_msched { MSCHED_CYCLIC, MSCHED_BALANCED, MSCHED_DYNAMIC, MSCHED_N };
+
 // pointer to various function types
 typedef void (*pf2l)(shtns_cfg, void*, void*, long int);
 typedef void (*pf3l)(shtns_cfg, void*, void*, void*, long int);
 typedef void (*pf4l)(shtns_cfg, void*, void*, void*, void*, long int);
+typedef void (*pf5l)(shtns_cfg, void*, void*, void*, void*, void*, long int);
 typedef void (*pf6l)(shtns_cfg, void*, void*, void*, void*, void*, void*, long int);
 typedef void (*pf2ml)(shtns_cfg, int, void*, void*, long int);
 typedef void (*pf3ml)(shtns_cfg, int, void*, void*, void*, long int);
@@ -125,14 +214,22 @@ struct shtns_info {		// MUST start with "int nlm;"
 
 	short fftc_mode;			///< how to perform the complex fft : -1 = no fft; 0 = interleaved/native; 1 = split/transpose.
 	unsigned short nthreads;	///< number of threads (openmp).
+	short omp_msched;			///< distribution of m among threads for openmp transforms (enum \ref sht_msched).
+	short omp_shells;			///< 1 if the multi-shell transforms distribute the shells among threads, 0 if each shell uses all threads.
 	unsigned short *tm;			///< start theta value for SH (polar optimization : near the poles the legendre polynomials go to zero for high m's)
 	int k_stride_a;				///< stride in theta direction
 	int m_stride_a;				///< stride in phi direction (m)
 	double *wg;					///< Gauss weights for Gauss-Legendre quadrature.
 	double *st_1;				///< 1/sin(theta);
+	unsigned short *omp_mlist;	///< im>0 sorted by thread for MSCHED_BALANCED (size mmax), followed by the start of each thread in this list (size nthreads+1).
 
 	fftw_plan ifft, fft;		// plans for FFTW.
 	fftw_plan ifftc, fftc;
+	fftwf_plan ifftf, fftf;		// single precision plans for the float transforms (created on first use).
+	fftw_plan fft_blk[2], ifft_blk[2];		// ffts of the latitude blocks of fused transforms, regular and last block (created on first use).
+	fftw_plan ifft_cplx, fft_cplx;		// ffts of the native transforms of complex fields (created on first use).
+	unsigned cplx_fast;		// bit (1<<typ) set when the native complex transform of type typ is used (see SHT_CPLX_NATIVE and choose_cplx).
+	unsigned fused_sep;		// bit 0 (scalar fields only) and bit 1 (with vector fields) set when separate transforms were timed faster than the fused ones (see choose_fused).
 
 	/* Legendre function generation arrays */
 	double *alm;	// coefficient list for Legendre function recurrence (size 2*NLM)
@@ -143,6 +240,7 @@ struct shtns_info {		// MUST start with "int nlm;"
 	double *mx_van;		// sparse matrix for  sin(theta).d/dtheta + 2*cos(theta),  couples l-1 and l+1
 
 	void* ftable[SHT_NVAR][SHT_NTYP];		// pointers to transform functions.
+	void* fseq[SHT_NTYP];		// fastest single-thread transform functions (used by the multi-shell transforms).
 
 	/* MEM matrices */
 	double **ylm;		// matrix for inverse transform (synthesis)
@@ -158,11 +256,9 @@ struct shtns_info {		// MUST start with "int nlm;"
 	double* ct_rot;			// cos(theta) array
 	double* st_rot;			// sin(theta) array
 
-	/* _to_lat stuff */
-	double* ylm_lat;
-	double ct_lat;
-	fftw_plan ifft_lat;		///< fftw plan for SHqst_to_lat
-	int nphi_lat;			///< nphi of previous SHqst_to_lat
+	/* saved config (see shtns_load) */
+	void* map_base;			// read-only file mapping holding the precomputed arrays, or NULL.
+	size_t map_size;		// size of the mapping.
 
 	#ifdef HAVE_LIBCUFFT
 	/* cuda stuff */
@@ -187,6 +283,10 @@ struct shtns_info {		// MUST start with "int nlm;"
 	unsigned fftw_plan_mode;
 	unsigned layout;		// requested data layout
 	double Y00_1, Y10_ct, Y11_st;
+	unsigned long serial;	// unique number of this config (never reused, unlike its address), see \ref cfg_ready.
+	#ifdef SHTNS_STATS
+	struct stats_rec* stats;	// timing statistics, for each transform type (see shtns_get_stats).
+	#endif
 	shtns_cfg next;		// pointer to next sht_setup or NULL (records a chained list of SHT setup).
 	// the end should be aligned on the size of int, to allow the storage of small arrays.
 };
@@ -207,6 +307,30 @@ struct shtns_info {		// MUST start with "int nlm;"
 // SHT_NORM without CS_PHASE
 #define SHT_NORM (shtns->norm & 0x0FF)
 
+#ifdef _OPENMP
+/// \internal splits the latitude blocks kt <= k < nk among nth threads, returns in [k0,k1) the range of thread ith.
+/// The blocks below kt (polar optimization, nothing to compute) are given to thread 0.
+/// Ranges are made of groups of 2*nw blocks, so that no thread writes into the range of another.
+static inline void omp_krange(long int nk, long int kt, int nw, unsigned ith, unsigned nth, long int* k0, long int* k1)
+{
+	kt &= ~1L;		// groups start on an even block.
+	const long int ng = (nk - kt + 2*nw-1) / (2*nw);		// number of groups
+	*k0 = (ith == 0) ? 0 : kt + ((ng*ith)/nth) * (2*nw);
+	long int k = kt + ((ng*(ith+1))/nth) * (2*nw);
+	*k1 = (k < nk) ? k : nk;
+}
+
+/// \internal number of threads to use when splitting the latitude blocks kt <= k < nk (1 if already in a parallel region).
+static inline int omp_m_threads(shtns_cfg shtns, long int nk, long int kt, int nw)
+{
+	if (omp_in_parallel()) return 1;
+	kt &= ~1L;
+	const long int ng = (nk - kt + 2*nw-1) / (2*nw);
+	if (ng < 1) return 1;
+	return (shtns->nthreads < ng) ? shtns->nthreads : ng;
+}
+#endif
+
 #ifndef M_PI
 # define M_PI 3.1415926535897932384626433832795
 #endif
@@ -221,6 +345,8 @@ struct shtns_info {		// MUST start with "int nlm;"
 // scale factor for extended range numbers (used in on-the-fly transforms to compute recurrence)
 #define SHT_SCALE_FACTOR 2.9073548971824275622e+135
 //#define SHT_SCALE_FACTOR 2.0370359763344860863e+90
+// Gauss nodes are computed by Newton iterations (O(n^2)) up to this size, and by an O(n) asymptotic expansion above.
+#define SHT_GAUSS_NEWTON_MAX 100
 
 
 #if _GCC_VEC_ == 0
@@ -452,10 +578,10 @@ struct shtns_info {		// MUST start with "int nlm;"
 			((s4d*)mem)[(idx)*4+3] = _mm512_extractf64x4_pd(bb, 1);	\
 			rr = (rnd)_mm512_permutex_pd(er-od, 0x8D);	ii = (rnd)_mm512_permutex_pd(ei-oi, 0x8D);	\
 			aa = (rnd)_mm512_unpacklo_pd(rr, ii);	bb = (rnd)_mm512_unpackhi_pd(rr, ii);	\
-			((s4d*)mem)[NLAT-1-(idx)*4] = _mm512_castpd512_pd256(aa);	\
-			((s4d*)mem)[NLAT-2-(idx)*4] = _mm512_castpd512_pd256(bb);	\
-			((s4d*)mem)[NLAT-3-(idx)*4] = _mm512_extractf64x4_pd(aa, 1);	\
-			((s4d*)mem)[NLAT-4-(idx)*4] = _mm512_extractf64x4_pd(bb, 1);	}
+			((s4d*)mem)[NLAT_2-1-(idx)*4] = _mm512_castpd512_pd256(aa);	\
+			((s4d*)mem)[NLAT_2-2-(idx)*4] = _mm512_castpd512_pd256(bb);	\
+			((s4d*)mem)[NLAT_2-3-(idx)*4] = _mm512_extractf64x4_pd(aa, 1);	\
+			((s4d*)mem)[NLAT_2-4-(idx)*4] = _mm512_extractf64x4_pd(bb, 1);	}
 	#elif defined __AVX__
 		#define MIN_ALIGNMENT 32
 		#define VSIZE2 4
@@ -694,27 +820,29 @@ struct DtDp {		// theta and phi derivatives stored together.
 
 // compute symmetric and antisymmetric parts, and reorganize data.
 #ifndef SHTNS4MAGIC
-  #define SYM_ASYM_M0_V(F, er, od) { \
-	long int k=0; do { \
+  #define SYM_ASYM_M0_V_K(F, er, od, k0, k1) { \
+	long int k=k0; while(k < k1) { \
 		double an = F[k*k_inc];				double bn = F[k*k_inc +1]; \
 		double bs = F[(NLAT-2-k)*k_inc];	double as = F[(NLAT-2-k)*k_inc +1]; \
 		er[k] = an+as;			od[k] = an-as; \
 		er[k+1] = bn+bs;		od[k+1] = bn-bs; \
 		k+=2; \
-	} while(k < nk*VSIZE2); }
-  #define SYM_ASYM_M0_Q(F, er, od, acc0) { \
+	} }
+  #define SYM_ASYM_M0_Q_K(F, er, od, acc0, k0, k1) { \
 	double r0a = 0.0;	double r0b = 0.0; \
-	long int k=0; do { \
+	long int k=k0; while(k < k1) { \
 		double an = F[k*k_inc];				double bn = F[k*k_inc +1]; \
 		double bs = F[(NLAT-2-k)*k_inc];	double as = F[(NLAT-2-k)*k_inc +1]; \
 		er[k] = an+as;			od[k] = an-as; \
 		er[k+1] = bn+bs;		od[k+1] = bn-bs; \
 		r0a += (an+as)*wg[k];	r0b += (bn+bs)*wg[k+1]; \
 		k+=2; \
-	} while(k < nk*VSIZE2); 	acc0 = r0a+r0b; }
+	} 	acc0 = r0a+r0b; }
+  #define SYM_ASYM_M0_V(F, er, od) SYM_ASYM_M0_V_K(F, er, od, 0, nk*VSIZE2)
+  #define SYM_ASYM_M0_Q(F, er, od, acc0) SYM_ASYM_M0_Q_K(F, er, od, acc0, 0, nk*VSIZE2)
   #define SYM_ASYM_Q(F, er, od, ei, oi, k0v) { \
 	long int k = ((k0v*VSIZE2)>>1)*2; \
-	do { \
+	while (k<nk*VSIZE2) { \
 		double an, bn, ani, bni, bs, as, bsi, asi, t; \
 		ani = F[im*m_inc + k*k_inc];		bni = F[im*m_inc + k*k_inc +1]; \
 		an  = F[(NPHI-im)*m_inc + k*k_inc];	bn = F[(NPHI-im)*m_inc + k*k_inc +1]; \
@@ -725,10 +853,10 @@ struct DtDp {		// theta and phi derivatives stored together.
 		er[k] = an+as;		ei[k] = ani+asi;		er[k+1] = bn+bs;		ei[k+1] = bni+bsi; \
 		od[k] = an-as;		oi[k] = ani-asi;		od[k+1] = bn-bs;		oi[k+1] = bni-bsi; \
 		k+=2; \
-		} while (k<nk*VSIZE2); }
+		} }
   #define SYM_ASYM_Q3(F, er, od, ei, oi, k0v) { \
 	long int k = ((k0v*VSIZE2)>>1)*2; \
-	do { \
+	while (k<nk*VSIZE2) { \
 		double an, bn, ani, bni, bs, as, bsi, asi, t; \
 		double sina = st[k];	double sinb = st[k+1]; \
 		ani = F[im*m_inc + k*k_inc];		bni = F[im*m_inc + k*k_inc +1]; \
@@ -740,24 +868,26 @@ struct DtDp {		// theta and phi derivatives stored together.
 		er[k] = (an+as)*sina;	ei[k] = (ani+asi)*sina;		er[k+1] = (bn+bs)*sinb;		ei[k+1] = (bni+bsi)*sinb; \
 		od[k] = (an-as)*sina;	oi[k] = (ani-asi)*sina;		od[k+1] = (bn-bs)*sinb;		oi[k+1] = (bni-bsi)*sinb; \
 		k+=2; \
-		} while (k<nk*VSIZE2); }
+		} }
   #define SYM_ASYM_V SYM_ASYM_Q
 #else /* SHTNS4MAGIC */
-  #define SYM_ASYM_M0_V(F, er, od) { \
-	long int k=0; do { \
+  #define SYM_ASYM_M0_V_K(F, er, od, k0, k1) { \
+	long int k=k0; while(k < k1) { \
 		double st_1 = 1.0/st[k]; \
 		double an = F[2*k*k_inc];		double as = F[2*k*k_inc +1]; \
 		er[k] = (an+as)*st_1;			od[k] = (an-as)*st_1; \
 		k+=1; \
-	} while(k < nk*VSIZE2); }
-  #define SYM_ASYM_M0_Q(F, er, od, acc0) { \
+	} }
+  #define SYM_ASYM_M0_Q_K(F, er, od, acc0, k0, k1) { \
 	acc0 = 0.0; \
-	long int k=0; do { \
+	long int k=k0; while(k < k1) { \
 		double an = F[2*k*k_inc];	double as = F[2*k*k_inc +1]; \
 		er[k] = (an+as);			od[k] = (an-as); \
 		acc0 += (an+as)*wg[k]; \
 		k+=1; \
-	} while(k < nk*VSIZE2); }
+	} }
+  #define SYM_ASYM_M0_V(F, er, od) SYM_ASYM_M0_V_K(F, er, od, 0, nk*VSIZE2)
+  #define SYM_ASYM_M0_Q(F, er, od, acc0) SYM_ASYM_M0_Q_K(F, er, od, acc0, 0, nk*VSIZE2)
   #define SYM_ASYM_Q(F, er, od, ei, oi, k0v) { \
 	k = ((k0v*VSIZE2)>>1)*2; \
 	do { \
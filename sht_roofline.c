@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_roofline.c
+ * \brief Calibration of the memory bandwidth and peak floating point rate of the machine (included by sht_init.c).
+ *
+ * The sustained bandwidth is measured with a STREAM triad on arrays much larger than the caches, with one thread
+ * and with all threads. The peak rate is measured for one thread with independent chains of multiply-adds on vectors
+ * of VSIZE2 doubles. The result is measured once per process and kept, and can be imposed with the environment
+ * variable SHTNS_ROOFLINE="<GB/s for one thread>,<GB/s for all threads>,<GFlop/s per thread>".
+ * It feeds the cost model of \ref sht_predict (precomputed matrices or on-the-fly), and the roofline printed by \ref shtns_print_cfg.
+ */
+
+/// \internal measured characteristics of the machine (see \ref shtns_calibrate).
+static struct {
+	double bw1, bw;		///< sustained memory bandwidth (bytes/s) of one thread, and of nth threads.
+	double flops;		///< peak floating point rate of one thread (flop/s).
+	int nth;			///< number of threads used to measure bw (0 if not calibrated).
+} sht_machine = { 0.0, 0.0, 0.0, 0 };
+
+#define ROOFLINE_N (4L<<20)		// number of doubles of each array of the triad (32Mb each, much larger than the caches).
+#define ROOFLINE_NFMA (1L<<22)	// number of iterations of the peak rate measure.
+
+// values unknown to the compiler, so that the peak rate measure is not optimized away.
+static volatile double roofline_sink;
+static volatile double roofline_x = 1.0 - 1.e-9;
+static volatile double roofline_y = 1.e-9;
+
+/// \internal best bandwidth (bytes/s) of a few STREAM triads with nth threads (24 bytes per element, write-allocate not counted).
+static double roofline_triad(double* a, const double* b, const double* c, long n, int nth)
+{
+	double tbest = 1e100;
+	for (int r=0; r<4; r++) {
+		const double t0 = wall_time();
+		#pragma omp parallel for num_threads(nth) schedule(static)
+		for (long i=0; i<n; i++)	a[i] = b[i] + 3.0*c[i];
+		const double t = wall_time() - t0;
+		if (t < tbest) tbest = t;
+	}
+	return 3.0*n*sizeof(double) / tbest;
+}
+
+/// \internal best floating point rate of one thread (flop/s), with 12 independent chains of multiply-add to hide the latency.
+static double roofline_peak()
+{
+	const rnd x = vall(roofline_x);
+	const rnd y = vall(roofline_y);
+	double tbest = 1e100;
+	double s = 0.0;
+	for (int r=0; r<3; r++) {
+		rnd a0 = vall(roofline_y);		rnd a1 = a0;	rnd a2 = a0;	rnd a3 = a0;	rnd a4 = a0;	rnd a5 = a0;
+		rnd a6 = a0;	rnd a7 = a0;	rnd a8 = a0;	rnd a9 = a0;	rnd a10 = a0;	rnd a11 = a0;
+		const double t0 = wall_time();
+		for (long i=0; i<ROOFLINE_NFMA; i++) {
+			a0 = a0*x + y;		a1 = a1*x + y;		a2 = a2*x + y;		a3 = a3*x + y;
+			a4 = a4*x + y;		a5 = a5*x + y;		a6 = a6*x + y;		a7 = a7*x + y;
+			a8 = a8*x + y;		a9 = a9*x + y;		a10 = a10*x + y;	a11 = a11*x + y;
+		}
+		const double t = wall_time() - t0;
+		if (t < tbest) tbest = t;
+		s += reduce_add(((a0+a1)+(a2+a3)) + ((a4+a5)+(a6+a7)) + ((a8+a9)+(a10+a11)));
+	}
+	roofline_sink = s;
+	return (2.0*12*VSIZE2) * ROOFLINE_NFMA / tbest;
+}
+
+/// \internal measures the machine with nth threads, unless already done (or imposed by SHTNS_ROOFLINE).
+static void roofline_calibrate(int nth, int force)
+{
+	if ((sht_machine.nth == nth) && (!force)) return;
+	const char* env = getenv("SHTNS_ROOFLINE");
+	if (env) {
+		double bw1, bw, gf;
+		if (sscanf(env, "%lf,%lf,%lf", &bw1, &bw, &gf) == 3) {
+			sht_machine.bw1 = bw1*1.e9;		sht_machine.bw = bw*1.e9;		sht_machine.flops = gf*1.e9;
+			sht_machine.nth = nth;
+			return;
+		}
+	}
+	double* a = (double*) VMALLOC(3*ROOFLINE_N * sizeof(double));
+	if (a == NULL) return;		// not calibrated.
+	double* b = a + ROOFLINE_N;		double* c = b + ROOFLINE_N;
+	#pragma omp parallel for num_threads(nth) schedule(static)
+	for (long i=0; i<ROOFLINE_N; i++) {		// first touch by the threads that will use the memory.
+		a[i] = 0.0;		b[i] = 1.0;		c[i] = 2.0;
+	}
+	sht_machine.bw1 = roofline_triad(a, b, c, ROOFLINE_N, 1);
+	sht_machine.bw = (nth > 1) ? roofline_triad(a, b, c, ROOFLINE_N, nth) : sht_machine.bw1;
+	VFREE(a);
+	sht_machine.flops = roofline_peak();
+	sht_machine.nth = nth;
+	#if SHT_VERBOSE > 1
+		if (verbose>1) printf("        + roofline: %.1f GB/s (1 thread), %.1f GB/s (%d threads), %.1f GFlop/s per thread\n",
+			sht_machine.bw1*1e-9, sht_machine.bw*1e-9, nth, sht_machine.flops*1e-9);
+	#endif
+}
+
+/** \addtogroup init
+*/
+//@{
+
+/// Measures the sustained memory bandwidth and peak floating point rate of the machine (about 0.2 seconds), with the number of
+/// threads set by \ref shtns_use_threads. The measure is done only once per process (unless force=1), and is used by the
+/// \ref sht_predict initialization to choose between precomputed matrices and on-the-fly algorithms, and by \ref shtns_print_cfg.
+/// It can be imposed by the environment variable SHTNS_ROOFLINE="<GB/s for one thread>,<GB/s for all threads>,<GFlop/s per thread>".
+/// \param[out] bw if not NULL, the bandwidth of all threads (bytes/s).
+/// \param[out] flops if not NULL, the peak floating point rate of all threads (flop/s).
+/// \returns the machine balance (flop per byte of memory traffic) for all threads, or 0 if the measure failed.
+double shtns_calibrate(int force, double* bw, double* flops)
+{
+	cfg_lock();
+	roofline_calibrate(omp_threads, force);
+	cfg_unlock();
+	if (bw) *bw = sht_machine.bw;
+	if (flops) *flops = sht_machine.flops * sht_machine.nth;
+	return (sht_machine.nth > 0) ? sht_machine.flops * sht_machine.nth / sht_machine.bw : 0.0;
+}
+
+//@}
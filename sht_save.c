@@ -0,0 +1,637 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_save.c
+ * \brief Binary image of a fully initialized config, for instant startup (included by sht_init.c).
+ *
+ * The file is made of a header followed by the arrays computed during initialization: Legendre recurrence
+ * coefficients, grid and quadrature weights, matrices of the vector transforms and, with the mem algorithm,
+ * the precomputed matrices ylm, dylm, zlm and dzlm. Each array starts on a page boundary and has its own checksum.
+ * The header records the version, the SIMD extension and the build options, which must match on load,
+ * as well as the algorithm chosen for each transform and the fftw wisdom.
+ * \ref shtns_load maps the file read-only, so that processes loading the same file share the same physical pages.
+ * Only the fftw plans, the rotation setup and the distribution of m among threads are rebuilt.
+ *
+ * With \ref SHT_SHARED_MEMORY, the same image is written to a POSIX shared memory segment named after the requested
+ * parameters: the first process to request a config initializes it and writes the segment (holding a lock meanwhile),
+ * the other processes of the node wait for the lock and then map the segment instead of computing their own arrays.
+ */
+
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define SAVE_MAGIC "SHTnsIM3"
+#define SAVE_ALG_NONE 255		// no algorithm for this transform
+
+enum save_sec { SAVE_LMIDX, SAVE_TM, SAVE_LI, SAVE_ALM, SAVE_BLM, SAVE_L2, SAVE_CT, SAVE_WG, SAVE_MX_STDT, SAVE_MX_VAN,
+	SAVE_YLM, SAVE_DYLM, SAVE_ZLM, SAVE_DZLM, SAVE_MAT_OFS, SAVE_WISDOM, SAVE_NSEC };
+
+struct save_sec_rec {
+	uint64_t ofs, size;		// offset and size in bytes (ofs=0 for a missing array).
+	uint64_t sum;			// checksum of the array.
+};
+
+struct save_header {
+	char magic[8];
+	int hdr_size;		// sizeof(struct save_header), also detects incompatible builds.
+	int features;		// build options, see save_features().
+	char version[16];
+	char simd[16];
+	unsigned nlm, nlm_cplx;
+	int lmax, mmax, mres, nphi, nlat, nlat_2;
+	int nthreads, omp_msched, omp_shells;
+	int nlorder, grid, norm, layout;
+	unsigned fftw_plan_mode;
+	unsigned cplx_fast;		// native complex transforms in use (see choose_cplx).
+	unsigned fused_sep;		// separate transforms timed faster than the fused transforms (see choose_fused).
+	int ct_stride;		// st = ct + ct_stride, st_1 = st + ct_stride.
+	int fft_real;		// 1 if the real ffts (used by the mem algorithm) were planned.
+	int ncplx_fft;
+	double Y00_1, Y10_ct, Y11_st;
+	unsigned char alg[SHT_NVAR][SHT_NTYP];		// chosen algorithm for each transform.
+	unsigned char alg_seq[SHT_NTYP];			// single-thread algorithm used by multi-shell transforms.
+	struct save_sec_rec sec[SAVE_NSEC];
+	char shm_name[32];		// name of the shared memory segment holding this image (empty for a file).
+	uint64_t sum;		// checksum of the header, computed with sum=0.
+};
+
+/// \internal build options that change the content or meaning of the saved arrays.
+static int save_features()
+{
+	int f = 0;
+	#ifdef _OPENMP
+	f |= 1;
+	#endif
+	#ifdef SHTNS_MEM
+	f |= 2;
+	#endif
+	#ifdef HAVE_LIBCUFFT
+	f |= 4;
+	#endif
+	#ifdef SHTNS4MAGIC
+	f |= 8;
+	#endif
+	return f;
+}
+
+/// \internal Fletcher-like checksum of n bytes, read as 64-bit words (the last one padded with zeros).
+static uint64_t save_checksum(const void* p, size_t n)
+{
+	const uint64_t* w = (const uint64_t*) p;
+	uint64_t a = 1, b = 0;
+	size_t nw = n/8;
+	for (size_t i=0; i<nw; i++) {
+		a += w[i];		b += a;
+	}
+	if (n & 7) {
+		uint64_t x = 0;
+		memcpy(&x, w + nw, n & 7);
+		a += x;		b += a;
+	}
+	return a ^ (b << 29) ^ (b >> 35);
+}
+
+/// \internal index of the algorithm of function f for variant iv and type it (SAVE_ALG_NONE if not found).
+static unsigned char save_alg_index(void* f, int iv, int it)
+{
+	if (f)
+		for (int ia=0; ia<SHT_NALG; ia++)
+			if (sht_func[iv][ia][it] == f) return ia;
+	return SAVE_ALG_NONE;
+}
+
+struct save_out {
+	FILE* f;
+	uint64_t pos;		// end of data written so far.
+	uint64_t align;		// page size.
+	int ok;
+};
+
+/// \internal writes size bytes from p at the next page boundary, and records it in section s.
+static void save_section(struct save_out* o, struct save_sec_rec* s, const void* p, size_t size)
+{
+	static const char zero[8] = { 0 };
+	s->ofs = 0;		s->size = 0;		s->sum = 0;
+	if ((p == NULL) || (size == 0)) return;
+	uint64_t ofs = ((o->pos + o->align-1) / o->align) * o->align;
+	o->ok &= (fseeko(o->f, ofs, SEEK_SET) == 0);		// the gap is filled with zeros.
+	o->ok &= (fwrite(p, 1, size, o->f) == size);
+	if (size & 7) o->ok &= (fwrite(zero, 1, 8 - (size & 7), o->f) == 8 - (size & 7));
+	s->ofs = ofs;		s->size = size;
+	s->sum = save_checksum(p, size);
+	o->pos = ofs + ((size+7) & ~((uint64_t) 7));
+}
+
+/// \internal returns the byte offsets of the m-blocks of a precomputed matrix relative to its first block (-1 for missing blocks).
+static void save_mat_ofs(shtns_cfg shtns, void** mx, int64_t* ofs)
+{
+	for (int im=0; im<=MMAX; im++)
+		ofs[im] = ((mx) && (mx[im])) ? ((char*)mx[im] - (char*)mx[0]) : -1;
+}
+
+/// \internal writes the image of shtns to the stream f (see \ref shtns_save).
+/// Returns the size of the image in bytes, or 0 on error.
+static uint64_t save_image(shtns_cfg shtns, FILE* f, const char* shm_name)
+{
+	struct save_header h;
+	struct save_out o;
+	int64_t* mofs = NULL;
+	char* wisdom = NULL;
+
+	memset(&h, 0, sizeof(h));		// also clears padding, so that the checksum is reproducible.
+	memcpy(h.magic, SAVE_MAGIC, 8);
+	h.hdr_size = sizeof(h);		h.features = save_features();
+	strncpy(h.version, PACKAGE_VERSION, sizeof(h.version)-1);
+	strncpy(h.simd, _SIMD_NAME_, sizeof(h.simd)-1);
+	if (shm_name) strncpy(h.shm_name, shm_name, sizeof(h.shm_name)-1);
+	h.nlm = shtns->nlm;		h.nlm_cplx = shtns->nlm_cplx;
+	h.lmax = LMAX;		h.mmax = MMAX;		h.mres = MRES;
+	h.nphi = NPHI;		h.nlat = NLAT;		h.nlat_2 = NLAT_2;
+	h.nthreads = shtns->nthreads;		h.omp_msched = shtns->omp_msched;		h.omp_shells = shtns->omp_shells;
+	h.nlorder = shtns->nlorder;		h.grid = shtns->grid;		h.norm = shtns->norm;		h.layout = shtns->layout;
+	h.fftw_plan_mode = shtns->fftw_plan_mode;		h.cplx_fast = shtns->cplx_fast;		h.fused_sep = shtns->fused_sep;
+	h.ct_stride = shtns->st - shtns->ct;
+	h.fft_real = (shtns->fft != NULL);
+	h.ncplx_fft = shtns->ncplx_fft;
+	h.Y00_1 = shtns->Y00_1;		h.Y10_ct = shtns->Y10_ct;		h.Y11_st = shtns->Y11_st;
+	fill_sht_func(shtns);		// this thread may not have initialized shtns.
+	for (int it=0; it<SHT_NTYP; it++) {
+		for (int iv=0; iv<SHT_NVAR; iv++)
+			h.alg[iv][it] = save_alg_index(shtns->ftable[iv][it], iv, it);
+		h.alg_seq[it] = save_alg_index(shtns->fseq[it], SHT_STD, it);
+	}
+
+	o.f = f;
+	o.align = sysconf(_SC_PAGESIZE);
+	if (o.align < 4096) o.align = 4096;
+	o.pos = sizeof(h);		o.ok = 1;
+
+	const long nlm2 = 2*(long)NLM;
+	save_section(&o, &h.sec[SAVE_LMIDX], shtns->lmidx, sizeof(int)*(MMAX+1));
+	save_section(&o, &h.sec[SAVE_TM], shtns->tm, sizeof(unsigned short)*(MMAX+1));
+	save_section(&o, &h.sec[SAVE_LI], shtns->li, sizeof(unsigned short)*nlm2);		// li and mi
+	save_section(&o, &h.sec[SAVE_ALM], shtns->alm, sizeof(double)*nlm2);
+	if (shtns->blm != shtns->alm)
+		save_section(&o, &h.sec[SAVE_BLM], shtns->blm, sizeof(double)*nlm2);
+	save_section(&o, &h.sec[SAVE_L2], shtns->l_2, sizeof(double)*(LMAX+1));
+	save_section(&o, &h.sec[SAVE_CT], shtns->ct, sizeof(double)*3*h.ct_stride);		// ct, st and st_1
+	save_section(&o, &h.sec[SAVE_WG], shtns->wg, sizeof(double)*(NLAT_2 + 8*VSIZE2-1));		// same overflow as in grid_weights()
+	save_section(&o, &h.sec[SAVE_MX_STDT], shtns->mx_stdt, sizeof(double)*nlm2);
+	save_section(&o, &h.sec[SAVE_MX_VAN], shtns->mx_van, sizeof(double)*nlm2);
+
+	void** mx[4] = { (void**) shtns->ylm, (void**) shtns->dylm, (void**) shtns->zlm, (void**) shtns->dzlm };
+	if (mx[0] || mx[1] || mx[2] || mx[3]) {
+		mofs = (int64_t*) malloc(sizeof(int64_t) * 4*(MMAX+1));
+		for (int k=0; k<4; k++) {
+			save_mat_ofs(shtns, mx[k], mofs + k*(MMAX+1));
+			if (mx[k]) {
+				int m0_only = (MMAX > 0) && (mx[k][1] == NULL);		// reduced to m=0 by free_unused_matrices()
+				save_section(&o, &h.sec[SAVE_YLM + k], mx[k][0], mem_matrix_size(shtns, k, m0_only));
+			}
+		}
+		save_section(&o, &h.sec[SAVE_MAT_OFS], mofs, sizeof(int64_t) * 4*(MMAX+1));
+	}
+	if (NPHI > 1) {
+		cfg_lock();		// fftw is not thread-safe.
+		wisdom = fftw_export_wisdom_to_string();
+		cfg_unlock();
+		if (wisdom) save_section(&o, &h.sec[SAVE_WISDOM], wisdom, strlen(wisdom)+1);
+	}
+
+	h.sum = save_checksum(&h, sizeof(h));		// the header is written last: the image is not valid before.
+	o.ok &= (fseeko(o.f, 0, SEEK_SET) == 0);
+	o.ok &= (fwrite(&h, sizeof(h), 1, o.f) == 1);
+	o.ok &= (fflush(o.f) == 0);
+	if (mofs) free(mofs);
+	if (wisdom) free(wisdom);
+	return (o.ok) ? o.pos : 0;
+}
+
+/// \internal checks the header and all arrays of a mapped file of given size. Returns NULL if fine, or the reason of failure.
+static const char* save_check(const struct save_header* h, size_t size)
+{
+	struct save_header h2;
+
+	if ((size < sizeof(struct save_header)) || (memcmp(h->magic, SAVE_MAGIC, 8) != 0)) return "not a saved config";
+	if (h->hdr_size != sizeof(struct save_header)) return "incompatible build";
+	h2 = *h;	h2.sum = 0;
+	if (save_checksum(&h2, sizeof(h2)) != h->sum) return "corrupted header";
+	if (strncmp(h->version, PACKAGE_VERSION, sizeof(h->version)) != 0) return "saved by another version";
+	if (strncmp(h->simd, _SIMD_NAME_, sizeof(h->simd)) != 0) return "saved with another SIMD extension";
+	if (h->features != save_features()) return "saved with other build options";
+	for (int k=0; k<SAVE_NSEC; k++) {
+		const struct save_sec_rec* s = h->sec + k;
+		if (s->ofs == 0) continue;
+		if ((s->ofs > size) || (s->size > size - s->ofs)) return "truncated file";
+		if (save_checksum((const char*)h + s->ofs, s->size) != s->sum) return "corrupted data";
+	}
+	if ((h->sec[SAVE_LMIDX].ofs == 0) || (h->sec[SAVE_TM].ofs == 0) || (h->sec[SAVE_LI].ofs == 0)
+		|| (h->sec[SAVE_ALM].ofs == 0) || (h->sec[SAVE_CT].ofs == 0) || (h->sec[SAVE_WG].ofs == 0))
+		return "missing data";
+
+	// the arrays must have the sizes implied by the header, as load_image() relies on them.
+	if ((h->lmax < 0) || (h->mres < 1) || (h->mmax < 0) || (h->mmax*h->mres > h->lmax)
+		|| ((long) h->nlm != nlm_calc(h->lmax, h->mmax, h->mres))
+		|| (h->nlat < 1) || (h->nlat_2 != (h->nlat+1)/2) || (h->ct_stride < h->nlat))
+		return "inconsistent header";
+	const uint64_t nm = h->mmax + 1;
+	const uint64_t nlm2 = 2*(uint64_t) h->nlm;
+	const uint64_t sec_size[SAVE_MAT_OFS+1] = {
+		[SAVE_LMIDX] = sizeof(int)*nm,		[SAVE_TM] = sizeof(unsigned short)*nm,
+		[SAVE_LI] = sizeof(unsigned short)*nlm2,		[SAVE_ALM] = sizeof(double)*nlm2,		[SAVE_BLM] = sizeof(double)*nlm2,
+		[SAVE_L2] = sizeof(double)*(h->lmax+1),		[SAVE_CT] = sizeof(double)*3*(uint64_t)h->ct_stride,
+		[SAVE_WG] = sizeof(double)*(h->nlat_2 + 8*VSIZE2-1),
+		[SAVE_MX_STDT] = sizeof(double)*nlm2,		[SAVE_MX_VAN] = sizeof(double)*nlm2,
+		[SAVE_MAT_OFS] = sizeof(int64_t)*4*nm };
+	for (int k=0; k<=SAVE_MAT_OFS; k++) {
+		if ((k >= SAVE_YLM) && (k < SAVE_MAT_OFS)) continue;		// matrices, checked below.
+		if ((h->sec[k].ofs) && (h->sec[k].size != sec_size[k])) return "wrong array size";
+	}
+
+	// each m-block of a matrix must start inside its section (-1 for missing blocks).
+	const int64_t* mofs = (h->sec[SAVE_MAT_OFS].ofs) ? (const int64_t*) ((const char*)h + h->sec[SAVE_MAT_OFS].ofs) : NULL;
+	for (int k=0; k<4; k++) {
+		const uint64_t msize = h->sec[SAVE_YLM + k].size;
+		if (h->sec[SAVE_YLM + k].ofs == 0) continue;
+		if (mofs == NULL) return "missing data";
+		for (uint64_t im=0; im<nm; im++) {
+			const int64_t o = mofs[k*nm + im];
+			if ((o < -1) || (o >= (int64_t) msize) || ((im == 0) && (o != 0))) return "wrong matrix offset";
+		}
+	}
+	return NULL;
+}
+
+/// \internal sets up shtns from the image mapped at shtns->map_base, whose arrays are used in place.
+/// lmidx and tm must point to the memory of shtns (see \ref SIZEOF_SHTNS_INFO), and all other arrays must have been released.
+static void load_image(shtns_cfg shtns)
+{
+	const void* base = shtns->map_base;
+	const struct save_header* h = (const struct save_header*) base;
+	#define SAVE_SEC(k) ( (void*) ((char*)base + h->sec[k].ofs) )		// section known to be present (mandatory ones are checked by save_check).
+	#define SAVE_PTR(k) ( (h->sec[k].ofs) ? SAVE_SEC(k) : NULL )
+	const int mmax = h->mmax;
+
+	shtns->nlm = h->nlm;		shtns->nlm_cplx = h->nlm_cplx;
+	shtns->lmax = h->lmax;		shtns->mmax = h->mmax;		shtns->mres = h->mres;
+	shtns->nphi = h->nphi;		shtns->nlat = h->nlat;		shtns->nlat_2 = h->nlat_2;
+	shtns->nthreads = h->nthreads;		shtns->omp_msched = h->omp_msched;		shtns->omp_shells = h->omp_shells;
+	shtns->nlorder = h->nlorder;		shtns->grid = h->grid;		shtns->norm = h->norm;		shtns->layout = h->layout;
+	shtns->fftw_plan_mode = h->fftw_plan_mode;		shtns->cplx_fast = h->cplx_fast;		shtns->fused_sep = h->fused_sep;
+	shtns->Y00_1 = h->Y00_1;		shtns->Y10_ct = h->Y10_ct;		shtns->Y11_st = h->Y11_st;
+	memcpy(shtns->lmidx, SAVE_SEC(SAVE_LMIDX), sizeof(int)*(mmax+1));
+	memcpy(shtns->tm, SAVE_SEC(SAVE_TM), sizeof(unsigned short)*(mmax+1));
+
+	shtns->li = (unsigned short*) SAVE_SEC(SAVE_LI);		shtns->mi = shtns->li + NLM;
+	shtns->alm = (double*) SAVE_SEC(SAVE_ALM);
+	shtns->blm = (h->sec[SAVE_BLM].ofs) ? (double*) SAVE_SEC(SAVE_BLM) : shtns->alm;
+	shtns->l_2 = (double*) SAVE_PTR(SAVE_L2);
+	shtns->ct = (double*) SAVE_SEC(SAVE_CT);
+	shtns->st = shtns->ct + h->ct_stride;		shtns->st_1 = shtns->ct + 2*h->ct_stride;
+	shtns->wg = (double*) SAVE_SEC(SAVE_WG);
+	shtns->mx_stdt = (double*) SAVE_PTR(SAVE_MX_STDT);
+	shtns->mx_van = (double*) SAVE_PTR(SAVE_MX_VAN);
+
+	const int64_t* mofs = (const int64_t*) SAVE_PTR(SAVE_MAT_OFS);
+	void** mx[4] = { NULL, NULL, NULL, NULL };
+	for (int k=0; k<4; k++) {
+		char* m0 = (char*) SAVE_PTR(SAVE_YLM + k);
+		if ((m0) && (mofs)) {		// the array of pointers to each m is allocated, the data stays in the mapping.
+			mx[k] = (void**) malloc( (mmax+1)*sizeof(void*) );
+			for (int im=0; im<=mmax; im++)
+				mx[k][im] = (mofs[k*(mmax+1) + im] >= 0) ? m0 + mofs[k*(mmax+1) + im] : NULL;
+		}
+	}
+	shtns->ylm = (double**) mx[0];		shtns->dylm = (struct DtDp**) mx[1];
+	shtns->zlm = (double**) mx[2];		shtns->dzlm = (struct DtDp**) mx[3];
+
+	if (h->sec[SAVE_WISDOM].ofs)	fftw_import_wisdom_from_string((const char*) SAVE_SEC(SAVE_WISDOM));
+	planFFT(shtns, h->layout, !h->fft_real);		// the fftw plans must be rebuilt (instantly with the wisdom).
+	if ((h->ncplx_fft < 0) && (NPHI > 1)) shtns->ncplx_fft = -1;		// fft was disabled (see shtns_create_with_grid)
+	init_sht_array_func(shtns);
+	for (int it=0; it<SHT_NTYP; it++) {		// restore the chosen algorithms (only non-null pointers).
+		for (int iv=0; iv<SHT_NVAR; iv++)
+			if ((h->alg[iv][it] < SHT_NALG) && (sht_func[iv][h->alg[iv][it]][it]))
+				shtns->ftable[iv][it] = sht_func[iv][h->alg[iv][it]][it];
+		if ((h->alg_seq[it] < SHT_NALG) && (sht_func[SHT_STD][h->alg_seq[it]][it]))
+			shtns->fseq[it] = sht_func[SHT_STD][h->alg_seq[it]][it];
+	}
+	#undef SAVE_PTR
+	#undef SAVE_SEC
+  #ifdef _OPENMP
+	omp_mpartition(shtns);		// distribute m among threads (needs tm[]).
+  #endif
+}
+
+/* SHARED MEMORY SEGMENTS (SHT_SHARED_MEMORY) */
+
+#define SHM_WAIT_EMPTY 200		// number of 5ms waits for the process that created a segment to lock it.
+
+/// \internal name of the shared memory segment holding the image of a config, derived from
+/// the parameters requested in shtns_set_grid_auto() and the build (FNV-1a hash).
+static void shm_segment_name(shtns_cfg shtns, int req_flags, double eps, char* name)
+{
+	struct {
+		char version[16], simd[16];
+		int features, lmax, mmax, mres, norm, nlat, nphi, flags, nlorder, nthreads;
+		double eps;
+		long uid;
+	} key;
+	memset(&key, 0, sizeof(key));		// also clears padding.
+	strncpy(key.version, PACKAGE_VERSION, sizeof(key.version)-1);
+	strncpy(key.simd, _SIMD_NAME_, sizeof(key.simd)-1);
+	key.features = save_features();
+	key.lmax = LMAX;	key.mmax = MMAX;	key.mres = MRES;	key.norm = shtns->norm;
+	key.nlat = NLAT;	key.nphi = NPHI;	key.flags = req_flags;	key.nlorder = shtns->nlorder;
+	key.nthreads = shtns->nthreads;		key.eps = eps;
+	key.uid = getuid();		// segments are private to the user.
+
+	uint64_t hsh = 14695981039346656037ULL;
+	const unsigned char* c = (const unsigned char*) &key;
+	for (size_t i=0; i<sizeof(key); i++) {
+		hsh ^= c[i];		hsh *= 1099511628211ULL;
+	}
+	sprintf(name, "/shtns-%016llx", (unsigned long long) hsh);
+}
+
+/// \internal replaces all arrays of shtns by those of the valid image mapped at base, which is then shared by all processes.
+static void shm_adopt(shtns_cfg shtns, void* base, size_t size)
+{
+	shtns_unset_grid(shtns);		// release the grid, the matrices and the fftw plans...
+	free_unused(shtns, &shtns->mx_stdt);
+	free_unused(shtns, &shtns->mx_van);
+	free_unused(shtns, &shtns->l_2);		// ...and the arrays allocated by shtns_create.
+	if (shtns->blm != shtns->alm)
+		free_unused(shtns, &shtns->blm);
+	free_unused(shtns, &shtns->alm);
+	free_unused(shtns, &shtns->li);
+	shtns->map_base = base;		shtns->map_size = size;
+	load_image(shtns);
+}
+
+/// \internal removes the name of the invalid segment opened as f, unless it was already replaced by another segment.
+static void shm_unlink_stale(const char* name, int f)
+{
+	struct stat st, st2;
+	int f2 = shm_open(name, O_RDONLY, 0);
+	if (f2 < 0) return;
+	if ((fstat(f, &st) == 0) && (fstat(f2, &st2) == 0) && (st.st_dev == st2.st_dev) && (st.st_ino == st2.st_ino))
+		shm_unlink(name);		// the next process will create a new segment.
+	close(f2);
+}
+
+/// \internal a segment being created by a thread of this process. As fcntl() locks belong to the process, the other
+/// threads must not lock it: they wait until it leaves the list of segments in flight (which is protected by cfg_lock).
+struct shm_flight {
+	struct shm_flight* next;
+	char name[32];
+};
+static struct shm_flight* shm_in_flight = NULL;
+
+/// \internal returns the entry of segment name in the list of segments being created by this process, or NULL.
+static struct shm_flight** shm_flight_find(const char* name)
+{
+	struct shm_flight** p = &shm_in_flight;
+	while ((*p != NULL) && (strcmp((*p)->name, name) != 0))	p = &(*p)->next;
+	return (*p != NULL) ? p : NULL;
+}
+
+/// \internal adds (add=1) or removes (add=0) the segment name to the list of segments being created by this process.
+static void shm_flight_set(const char* name, int add)
+{
+	if (add) {
+		struct shm_flight* e = malloc(sizeof(struct shm_flight));
+		if (e == NULL) shtns_runerr("not enough memory.");
+		strcpy(e->name, name);
+		e->next = shm_in_flight;		shm_in_flight = e;
+	} else {
+		struct shm_flight** p = shm_flight_find(name);
+		if (p) {
+			struct shm_flight* e = *p;
+			*p = e->next;		free(e);
+		}
+	}
+}
+
+/// \internal waits for the fcntl() lock lk on f (retrying if interrupted), without holding cfg_lock meanwhile.
+static int shm_lock_wait(int f, struct flock* lk)
+{
+	int r;
+	cfg_unlock();		// other threads can create or destroy their configs while we wait for another process.
+	do {
+		r = fcntl(f, F_SETLKW, lk);
+	} while ((r == -1) && (errno == EINTR));
+	cfg_lock();
+	return r;
+}
+
+/// \internal with SHT_SHARED_MEMORY: if the segment name exists, waits until its creator has written it, and uses its arrays (returns 1).
+/// Otherwise, the segment is created and locked (returns 0 and sets *fd), and must be written by shm_publish() once the config is ready.
+/// Returns -1 if the segment cannot be used, the config being then initialized normally (an empty or invalid segment is also unlinked).
+static int shm_attach(shtns_cfg shtns, const char* name, int* fd)
+{
+	struct flock lk;
+	struct stat st;
+	const char* err = NULL;
+	void* base = MAP_FAILED;
+	size_t size = 0;
+
+	*fd = -1;
+	while (shm_flight_find(name)) {		// another thread of this process is creating this segment: wait until it is written.
+		cfg_unlock();	usleep(5000);	cfg_lock();
+	}
+	memset(&lk, 0, sizeof(lk));
+	lk.l_whence = SEEK_SET;		// l_start = l_len = 0 : lock the whole segment.
+	int f = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (f >= 0) {		// we create it : lock it until it is written.
+		shm_flight_set(name, 1);		// before releasing cfg_lock, so that other threads of this process do not lock it.
+		lk.l_type = F_WRLCK;
+		if (shm_lock_wait(f, &lk) == 0) {		// waits for processes that found the segment still empty (they release their lock immediately).
+			*fd = f;
+			return 0;
+		}
+		close(f);	shm_unlink(name);
+		shm_flight_set(name, 0);
+		err = "cannot lock segment";
+	} else if (errno != EEXIST) err = "cannot create segment";
+	else if ((f = shm_open(name, O_RDONLY, 0)) < 0) err = "cannot open segment";
+	else {
+		for (int k=0; ; k++) {
+			lk.l_type = F_RDLCK;
+			if (shm_lock_wait(f, &lk) == -1) {		// waits for the creator to finish.
+				err = "cannot lock segment";	break;
+			}
+			if (fstat(f, &st) != 0) {	err = "cannot read segment";	break;	}
+			size = st.st_size;
+			if ((size == 0) && (k < SHM_WAIT_EMPTY)) {		// not yet locked by its creator.
+				lk.l_type = F_UNLCK;	fcntl(f, F_SETLK, &lk);
+				cfg_unlock();	usleep(5000);	cfg_lock();
+				continue;
+			}
+			if (size >= sizeof(struct save_header)) base = mmap(NULL, size, PROT_READ, MAP_SHARED, f, 0);
+			err = (base == MAP_FAILED) ? "empty or truncated segment" : save_check((const struct save_header*) base, size);
+			if ((err) && ((size < sizeof(struct save_header)) || (base != MAP_FAILED)))	shm_unlink_stale(name, f);		// creator crashed, or corrupted.
+			break;
+		}
+		close(f);		// also releases the lock ; the mapping remains valid.
+	}
+	if (err) {
+		#if SHT_VERBOSE > 0
+			fprintf(stderr,"! Warning ! SHTns could not use shared memory segment %s : %s\n", name, err);
+		#endif
+		if (base != MAP_FAILED) munmap(base, size);
+		return -1;
+	}
+	shm_adopt(shtns, base, size);
+	#if SHT_VERBOSE > 0
+	if (verbose) printf("        + attached to shared memory segment %s (%.1f Mb)\n", name, size/(1024.*1024.));
+	#endif
+	return 1;
+}
+
+/// \internal writes the image of the initialized config shtns to the segment fd created by shm_attach(),
+/// then releases the lock (so that other processes can use it) and replaces the arrays of shtns by the shared ones.
+/// Called without cfg_lock, which is only taken for the list of segments in flight and the release of the arrays.
+static void shm_publish(shtns_cfg shtns, int fd, const char* name)
+{
+	void* base = MAP_FAILED;
+	uint64_t size = 0;
+
+	FILE* f = fdopen(fd, "w");
+	if (f) {
+		size = save_image(shtns, f, name);
+		if (size > 0) base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+		fclose(f);		// also closes fd and releases the lock.
+	} else close(fd);
+	cfg_lock();
+	shm_flight_set(name, 0);		// other threads of this process can now open it.
+	if (base == MAP_FAILED) {
+		shm_unlink(name);		// waiting processes will find an empty segment and initialize their own config.
+		cfg_unlock();
+		#if SHT_VERBOSE > 0
+			fprintf(stderr,"! Warning ! SHTns could not write shared memory segment %s\n", name);
+		#endif
+		return;
+	}
+	shm_adopt(shtns, base, size);
+	cfg_unlock();
+	#if SHT_VERBOSE > 0
+	if (verbose) printf("        + arrays moved to shared memory segment %s (%.1f Mb)\n", name, size/(1024.*1024.));
+	#endif
+}
+
+/* PUBLIC FUNCTIONS */
+
+/// Saves a fully initialized config (with its grid) to the file path, to be loaded later by \ref shtns_load.
+/// The file is written to a temporary file first, which then atomically replaces path.
+/// Returns 0 on success, or a negative value on error.
+int shtns_save(shtns_cfg shtns, const char* path)
+{
+	if (shtns->ct == NULL) return -1;		// no grid set.
+
+	cfg_lock();
+	char tmp[strlen(path) + 32];
+	sprintf(tmp, "%s.tmp%ld", path, (long) getpid());
+	FILE* f = fopen(tmp, "wb");
+	if (f == NULL) {	cfg_unlock();	return -2;	}
+	int ok = (save_image(shtns, f, NULL) > 0);
+	ok &= (fsync(fileno(f)) == 0);
+	ok &= (fclose(f) == 0);
+	cfg_unlock();
+	if ((ok) && (rename(tmp, path) == 0)) return 0;
+	unlink(tmp);
+	#if SHT_VERBOSE > 0
+		fprintf(stderr,"! Warning ! SHTns could not save config to %s\n", path);
+	#endif
+	return -3;
+}
+
+/// Loads a config saved by \ref shtns_save, which is ready to use (grid included).
+/// The precomputed arrays are mapped read-only from the file, and only the fftw plans are rebuilt
+/// (using the fftw wisdom stored in the file). The file must have been saved by the same version of SHTns,
+/// built with the same options and SIMD extension. The config uses the number of threads it was saved with.
+/// Returns NULL if the file cannot be loaded.
+shtns_cfg shtns_load(const char* path)
+{
+	struct stat st;
+	const char* err = NULL;
+	void* base = MAP_FAILED;
+	size_t size = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) err = "cannot open file";
+	else {
+		if (fstat(fd, &st) == 0) {
+			size = st.st_size;
+			if (size >= sizeof(struct save_header)) base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);		// the mapping remains valid.
+		err = (base == MAP_FAILED) ? "cannot map file" : save_check((const struct save_header*) base, size);
+	}
+	if (err) {
+		#if SHT_VERBOSE > 0
+			fprintf(stderr,"! Warning ! SHTns could not load config from %s : %s\n", path, err);
+		#endif
+		if (base != MAP_FAILED) munmap(base, size);
+		return NULL;
+	}
+
+	const int mmax = ((const struct save_header*) base)->mmax;
+	shtns_cfg shtns = malloc( SIZEOF_SHTNS_INFO(mmax) );
+	if (shtns == NULL) {	munmap(base, size);		return NULL;	}
+	cfg_lock();
+	memset(shtns, 0, SIZEOF_SHTNS_INFO(mmax));		// all pointers are NULL.
+	shtns->lmidx = (int*) (shtns + 1);		// lmidx is stored at the end of the struct...
+	shtns->tm = (unsigned short*) (shtns->lmidx + (mmax+1));		// and tm just after.
+	shtns->map_base = base;		shtns->map_size = size;
+	#ifdef SHTNS_STATS
+	stats_alloc(shtns);
+	#endif
+	load_image(shtns);
+	if ((LMAX == MMAX) && (MRES == 1))	SH_rotK90_init(shtns);
+	#if SHT_VERBOSE > 0
+	if (verbose) printf("        + config loaded from %s (%.1f Mb mapped)\n", path, size/(1024.*1024.));
+	#endif
+
+// save a pointer to this setup and return.
+	cfg_track(shtns);
+	cfg_ready(shtns);
+	cfg_unlock();
+	return shtns;
+}
+
+/// Removes the name of the shared memory segment used by shtns (see \ref SHT_SHARED_MEMORY).
+/// Configs using it remain valid, and the memory is released when the last process using it exits or destroys its config.
+/// Processes initialized afterwards will create a new segment. Call it once all processes have attached to the segment
+/// (e.g. after an MPI barrier), so that no memory is left behind. Returns 0 on success, -1 if shtns does not use a segment.
+int shtns_unlink_shared(shtns_cfg shtns)
+{
+	if (shtns->map_base == NULL) return -1;
+	const struct save_header* h = (const struct save_header*) shtns->map_base;
+	if (h->shm_name[0] != '/') return -1;		// mapped from a file.
+	return (shm_unlink(h->shm_name) == 0) ? 0 : -1;
+}
+
+/// Returns 1 if the arrays of shtns are in a shared memory segment (see \ref SHT_SHARED_MEMORY), 0 otherwise.
+int shtns_is_shared(shtns_cfg shtns)
+{
+	if (shtns->map_base == NULL) return 0;
+	const struct save_header* h = (const struct save_header*) shtns->map_base;
+	return (h->shm_name[0] == '/');		// not mapped from a file.
+}
@@ -0,0 +1,368 @@
+/*
+ * Copyright (c) 2010-2018 Centre National de la Recherche Scientifique.
+ * written by Nathanael Schaeffer (CNRS, ISTerre, Grenoble, France).
+ *
+ * nathanael.schaeffer@univ-grenoble-alpes.fr
+ *
+ * This software is governed by the CeCILL license under French law and
+ * abiding by the rules of distribution of free software. You can use,
+ * modify and/or redistribute the software under the terms of the CeCILL
+ * license as circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL license and that you accept its terms.
+ *
+ */
+
+/** \file sht_stats.c
+ * \brief Per-stage timing statistics of the transforms (included by sht_init.c).
+ *
+ * When compiled with ./configure --enable-stats, every transform measures with the cycle counter
+ * its total time, the time spent in FFTW and in the allocation of scratch buffers, and
+ * the time spent by each thread in its parallel region. The Legendre stage is what remains.
+ * A trace of these events can also be recorded in per-thread ring buffers (see \ref shtns_trace_start),
+ * and the hardware performance counters can be read in the same places (see sht_perf.c).
+ * Otherwise, \ref shtns_get_stats and \ref shtns_trace_start only report that nothing is available.
+ */
+
+#ifdef SHTNS_STATS
+
+__thread struct stats_tls stats_tls = { 0.0, 0.0 };
+
+/// \internal number of ticks per second, measured on first use.
+static double stats_tick_rate = 0.0;
+
+static void stats_clear(struct stats_rec* r)
+{
+	memset(r, 0, sizeof(struct stats_rec));
+	for (int k=0; k<STATS_NSTAGE; k++)		r->t[k][1] = HUGE_VAL;		// min
+}
+
+/// \internal atomic operations on the records of a config, which may be updated by several threads at the same time.
+static void stats_atomic_add(double* p, double v)
+{
+	double old, sum;
+	__atomic_load(p, &old, __ATOMIC_RELAXED);
+	do {
+		sum = old + v;
+	} while (!__atomic_compare_exchange(p, &old, &sum, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void stats_atomic_min(double* p, double v)
+{
+	double old;
+	__atomic_load(p, &old, __ATOMIC_RELAXED);
+	while ((v < old) && !__atomic_compare_exchange(p, &old, &v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static void stats_atomic_max(double* p, double v)
+{
+	double old;
+	__atomic_load(p, &old, __ATOMIC_RELAXED);
+	while ((v > old) && !__atomic_compare_exchange(p, &old, &v, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+/// \internal allocates the statistics of a new config.
+static void stats_alloc(shtns_cfg shtns)
+{
+	shtns->stats = (struct stats_rec*) malloc(SHT_NTYP * sizeof(struct stats_rec));
+	if (shtns->stats == NULL) shtns_runerr("not enough memory.");
+	for (int it=0; it<SHT_NTYP; it++)	stats_clear(shtns->stats + it);
+}
+
+/// \internal calibrates the cycle counter against the wall-clock (about 20ms).
+static double stats_ticks_per_second()
+{
+	if (stats_tick_rate == 0.0) {
+		const double wt0 = wall_time();
+		const ticks t0 = getticks();
+		double wt;
+		do {  wt = wall_time() - wt0;  } while (wt < 0.02);
+		stats_tick_rate = elapsed(getticks(), t0) / wt;
+	}
+	return stats_tick_rate;
+}
+
+/* TRACE */
+
+int sht_trace_on = 0;		///< 1 if the events are recorded (see shtns_trace_start).
+static unsigned trace_cap = 65536;		///< size of the ring buffer of new threads (number of events).
+static ticks trace_t0;					///< time origin of the trace.
+static int trace_nthreads = 0;			///< number of buffers created, used as thread id.
+
+struct trace_ev {
+	const char* name;
+	ticks t0, t1;
+	int arg;
+	short cat;
+};
+
+/// ring buffer of the events of a thread. Each thread writes only to its own buffer; buffers are chained once created, and never freed:
+/// the buffer of an exited thread is reused by a new thread once its events have been written (or discarded by \ref shtns_trace_start).
+struct trace_buf {
+	struct trace_buf* next;
+	unsigned long n;		///< number of events recorded (the last min(n,cap) are kept).
+	unsigned cap;
+	int tid;
+	int idle;		///< 1 if the thread owning this buffer has exited.
+	struct trace_ev ev[];
+};
+
+static struct trace_buf* trace_list = NULL;
+static __thread struct trace_buf* trace_tls = NULL;
+static pthread_key_t trace_key;		// only used for its destructor, releasing the buffer of exiting threads.
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+
+static void trace_thread_exit(void* p)
+{
+	__atomic_store_n(&((struct trace_buf*) p)->idle, 1, __ATOMIC_RELEASE);
+}
+
+static void trace_key_create()
+{
+	pthread_key_create(&trace_key, trace_thread_exit);
+}
+
+/// \internal returns the buffer of the calling thread: an idle buffer with no pending events, or a new one pushed to the list (lock-free).
+static struct trace_buf* trace_buf_get()
+{
+	struct trace_buf* b = trace_list;
+	while ((b != NULL) && !((__atomic_load_n(&b->idle, __ATOMIC_ACQUIRE)) && (b->n == 0) && (__sync_bool_compare_and_swap(&b->idle, 1, 0))))
+		b = b->next;
+	if (b == NULL) {
+		const unsigned cap = trace_cap;
+		b = (struct trace_buf*) malloc(sizeof(struct trace_buf) + cap * sizeof(struct trace_ev));
+		if (b == NULL) return NULL;
+		b->n = 0;		b->cap = cap;		b->idle = 0;
+		b->tid = __sync_fetch_and_add(&trace_nthreads, 1);
+		do {
+			b->next = trace_list;
+		} while (!__sync_bool_compare_and_swap(&trace_list, b->next, b));
+	}
+	pthread_once(&trace_key_once, trace_key_create);
+	pthread_setspecific(trace_key, b);		// the destructor marks the buffer as idle when the thread exits.
+	trace_tls = b;
+	return b;
+}
+
+/// names of the transform types in the trace (see enum sht_types).
+static const char* trace_name[SHT_NTYP] = { "SH_to_spat", "spat_to_SH", "SHsphtor_to_spat", "spat_to_SHsphtor",
+	"SHsph_to_spat", "SHtor_to_spat", "SHqst_to_spat", "spat_to_SHqst" };
+
+/// \internal records an event of the calling thread (name must be a static string).
+void trace_event(const char* name, int cat, int arg, ticks t0, ticks t1)
+{
+	struct trace_buf* b = trace_tls;
+	if (b == NULL) {		// first event of this thread.
+		b = trace_buf_get();
+		if (b == NULL) return;
+	}
+	struct trace_ev* e = b->ev + (b->n % b->cap);
+	e->name = name;		e->cat = cat;		e->arg = arg;
+	e->t0 = t0;		e->t1 = t1;
+	b->n++;
+}
+
+void stats_begin(struct stats_call* c)
+{
+	c->fft0 = stats_tls.fft;		c->alloc0 = stats_tls.alloc;
+	c->fft_other = 0.0;		c->nth = 0;
+	c->perf = sht_perf_on;
+	if (c->perf) {
+		for (int k=0; k<shtns_perf_ncounters; k++)	c->perf_other[k] = 0.0;
+		perf_read(c->perf0);
+	}
+	c->t0 = getticks();
+}
+
+/// \internal called by each thread at the end of the parallel region of a transform.
+void stats_thread_end(shtns_cfg shtns, struct stats_call* c, ticks t0, double fft0, const double* perf0)
+{
+	const ticks t1 = getticks();
+	const double t = elapsed(t1, t0);
+	int tid = 0;
+	int nth = 1;
+	#ifdef _OPENMP
+	tid = omp_get_thread_num();		nth = omp_get_num_threads();
+	#endif
+	if (sht_trace_on) trace_event("omp region", TRACE_REGION, tid, t0, t1);
+	if (tid < SHTNS_STATS_MAX_THREADS)	c->busy[tid] = t;
+	if (tid == 0) {
+		c->nth = nth;
+	} else {		// the master thread accounts for its own fft and counters in stats_end().
+		const double fft = stats_tls.fft - fft0;
+		#pragma omp atomic
+		c->fft_other += fft;
+		if (c->perf) {
+			double v[shtns_perf_ncounters];
+			perf_read(v);
+			for (int k=0; k<shtns_perf_ncounters; k++) {
+				#pragma omp atomic
+				c->perf_other[k] += v[k] - perf0[k];
+			}
+		}
+	}
+}
+
+/// \internal called at the end of a transform of type typ, truncated at degree llim.
+void stats_end(shtns_cfg shtns, int typ, long llim, struct stats_call* c)
+{
+	// number of spectral and spatial fields for each transform type (see enum sht_types).
+	static const char nspec[SHT_NTYP] = { 1,1, 2,2, 1,1, 3,3 };
+	static const char nspat[SHT_NTYP] = { 1,1, 2,2, 2,2, 3,3 };
+	double t[STATS_NSTAGE];
+
+	const ticks t1 = getticks();
+	double perf[shtns_perf_ncounters];
+	if (c->perf) {
+		perf_read(perf);
+		for (int k=0; k<shtns_perf_ncounters; k++)	perf[k] += c->perf_other[k] - c->perf0[k];
+	}
+	if (sht_trace_on) trace_event(trace_name[typ], TRACE_CALL, llim, c->t0, t1);
+	t[STATS_TOTAL] = elapsed(t1, c->t0);
+	t[STATS_FFT] = stats_tls.fft - c->fft0 + c->fft_other;
+	t[STATS_ALLOC] = stats_tls.alloc - c->alloc0;
+	double tthreads = t[STATS_TOTAL];		// time summed over threads
+	if (c->nth > 1) {
+		for (int i=1; i<c->nth && i<SHTNS_STATS_MAX_THREADS; i++)	tthreads += c->busy[i];
+	} else c->busy[0] = t[STATS_TOTAL];
+	t[STATS_LEGENDRE] = tthreads - t[STATS_FFT] - t[STATS_ALLOC];
+	if (t[STATS_LEGENDRE] < 0.0) t[STATS_LEGENDRE] = 0.0;
+
+	long mlim = (shtns->mmax*shtns->mres <= llim) ? shtns->mmax : llim/shtns->mres;
+	double bytes = nspec[typ] * nlm_calc(llim, mlim, shtns->mres) * 2*sizeof(double);
+	double spat = nspat[typ] * (double) shtns->nlat * shtns->nphi * sizeof(double);
+	if (shtns->fftc_mode > 0) spat *= 3;		// out-of-place fft: the Fourier buffer is written and read again.
+	bytes += spat;
+
+	struct stats_rec* r = shtns->stats + typ;		// updated with atomics: no lock between concurrent transforms.
+	__atomic_add_fetch(&r->calls, 1, __ATOMIC_RELAXED);
+	for (int k=0; k<STATS_NSTAGE; k++) {
+		stats_atomic_add(&r->t[k][0], t[k]);
+		stats_atomic_min(&r->t[k][1], t[k]);
+		stats_atomic_max(&r->t[k][2], t[k]);
+	}
+	stats_atomic_add(&r->bytes, bytes);
+	const int nth = (c->nth > 1) ? c->nth : 1;
+	int nth0 = __atomic_load_n(&r->nthreads, __ATOMIC_RELAXED);
+	while ((nth > nth0) && !__atomic_compare_exchange_n(&r->nthreads, &nth0, nth, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	for (int i=0; i<nth && i<SHTNS_STATS_MAX_THREADS; i++)	stats_atomic_add(&r->busy[i], c->busy[i]);
+	if (c->perf) {
+		__atomic_add_fetch(&r->perf_calls, 1, __ATOMIC_RELAXED);
+		for (int k=0; k<shtns_perf_ncounters; k++)	stats_atomic_add(&r->perf[k], perf[k]);
+	}
+}
+
+#endif
+
+/** \addtogroup init
+*/
+//@{
+
+/// Fill st with the timing statistics of the transforms of given type (see \ref shtns_stats_type) performed with config shtns.
+/// Returns 0 if the statistics are not available (SHTns compiled without ./configure --enable-stats, or invalid type), 1 otherwise.
+int shtns_get_stats(shtns_cfg shtns, int type, struct shtns_stats* st)
+{
+	memset(st, 0, sizeof(struct shtns_stats));
+  #ifdef SHTNS_STATS
+	if ((type < 0) || (type >= SHT_NTYP) || (shtns->stats == NULL)) return 0;
+	const double s = 1.0/stats_ticks_per_second();
+	struct stats_rec r = shtns->stats[type];		// copy (transforms running meanwhile may be partially accounted for).
+	st->calls = r.calls;
+	if (r.calls > 0) {
+		double* tt[STATS_NSTAGE] = { &st->t_total, &st->t_legendre, &st->t_fft, &st->t_alloc };
+		for (int k=0; k<STATS_NSTAGE; k++) {
+			tt[k][0] = r.t[k][0] * s;		tt[k][1] = r.t[k][1] * s;		tt[k][2] = r.t[k][2] * s;		// sum, min, max
+		}
+	}
+	st->bytes = r.bytes;
+	st->nthreads = r.nthreads;
+	for (int i=0; i<r.nthreads && i<SHTNS_STATS_MAX_THREADS; i++)	st->t_busy[i] = r.busy[i] * s;
+	perf_get_stats(&r, st);
+	return 1;
+  #else
+	return 0;
+  #endif
+}
+
+/// Start recording a trace of the transforms: the call of each transform, the parallel region of each thread,
+/// the work on each order m>0 of the multi-threaded transforms, each fft and allocation, and the timings of the
+/// algorithms performed during initialization.
+/// The events are kept in a ring buffer of nev events for each thread (0 for the default of 65536 events), allocated
+/// on first use (later calls cannot change the size of existing buffers). Previously recorded events are discarded.
+/// Returns 1 if tracing is available (compiled with ./configure --enable-stats), 0 otherwise.
+int shtns_trace_start(int nev)
+{
+  #ifdef SHTNS_STATS
+	if (nev > 0) trace_cap = nev;
+	for (struct trace_buf* b = trace_list; b != NULL; b = b->next)	b->n = 0;
+	stats_ticks_per_second();		// calibrate now, not while writing the trace.
+	trace_t0 = getticks();
+	sht_trace_on = 1;
+	return 1;
+  #else
+	return 0;
+  #endif
+}
+
+/// Stop recording the trace (the recorded events are kept until \ref shtns_trace_write).
+void shtns_trace_stop()
+{
+  #ifdef SHTNS_STATS
+	sht_trace_on = 0;
+  #endif
+}
+
+/// Write the recorded events to file fname, in the Chrome trace-event JSON format (that can be opened by
+/// chrome://tracing or https://ui.perfetto.dev), and clear the buffers.
+/// Should be called while no transform is running. Returns the number of events written, or -1 on error.
+long shtns_trace_write(const char* fname)
+{
+  #ifdef SHTNS_STATS
+	static const char* cat_name[] = { "transform", "omp", "m", "fft", "alloc", "tune" };
+	long nw = 0;
+	FILE* f = fopen(fname, "w");
+	if (f == NULL) return -1;
+	const double us = 1.e6/stats_ticks_per_second();
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (struct trace_buf* b = trace_list; b != NULL; b = b->next) {
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", (nw>0) ? ",\n" : "", b->tid, b->tid);
+		nw++;
+		unsigned long i0 = (b->n > b->cap) ? b->n - b->cap : 0;
+		for (unsigned long i = i0; i < b->n; i++) {
+			const struct trace_ev* e = b->ev + (i % b->cap);
+			double ts = elapsed(e->t0, trace_t0) * us;
+			double dur = elapsed(e->t1, e->t0) * us;
+			fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+				e->name, cat_name[e->cat], b->tid, ts, dur);
+			switch(e->cat) {
+				case TRACE_CALL :	fprintf(f, ",\"args\":{\"llim\":%d}", e->arg);	break;
+				case TRACE_REGION :	fprintf(f, ",\"args\":{\"thread\":%d}", e->arg);	break;
+				case TRACE_M :		fprintf(f, ",\"args\":{\"m\":%d}", e->arg);	break;
+				case TRACE_TUNE :	fprintf(f, ",\"args\":{\"type\":\"%s\"}", trace_name[e->arg]);	break;
+			}
+			fprintf(f, "}");
+			nw++;
+		}
+		b->n = 0;
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	if (fclose(f) != 0) return -1;
+	return nw;
+  #else
+	return -1;
+  #endif
+}
+
+/// Reset the timing statistics of all transform types of config shtns.
+/// Should be called while no transform is running with shtns (they could be partially accounted for).
+void shtns_reset_stats(shtns_cfg shtns)
+{
+  #ifdef SHTNS_STATS
+	if (shtns->stats == NULL) return;
+	for (int it=0; it<SHT_NTYP; it++)	stats_clear(shtns->stats + it);
+  #endif
+}
+
+//@}
@@ -50,6 +50,8 @@
       PARAMETER (SHT_REG_POLES=5)
       INTEGER SHT_GAUSS_FLY
       PARAMETER (SHT_GAUSS_FLY=6)
+      INTEGER SHT_PREDICT
+      PARAMETER (SHT_PREDICT=7)
 
       INTEGER SHT_SOUTH_POLE_FIRST
       PARAMETER (SHT_SOUTH_POLE_FIRST=8192)
@@ -57,3 +59,7 @@
       PARAMETER (SHT_SCALAR_ONLY=4096)
       INTEGER SHT_LOAD_SAVE_CFG
       PARAMETER (SHT_LOAD_SAVE_CFG=16384)
+      INTEGER SHT_PREDICT_CHECK
+      PARAMETER (SHT_PREDICT_CHECK=65536)
+      INTEGER SHT_SHARED_MEMORY
+      PARAMETER (SHT_SHARED_MEMORY=131072)
@@ -22,13 +22,17 @@
 #ifdef _COMPLEX_H
 	/// double precision complex number data type
 	typedef complex double cplx;
+	/// single precision complex number data type
+	typedef complex float cplxf;
 #else
   #ifdef __cplusplus
 	#include <complex>
 	typedef std::complex<double> cplx;
+	typedef std::complex<float> cplxf;
   #else
 	#include <complex.h>
 	typedef complex double cplx;
+	typedef complex float cplxf;
   #endif
 #endif
 
@@ -58,7 +62,8 @@ enum shtns_type {
 	sht_reg_dct,	///< slow initialization of a regular grid (self-tuning). The grid is equispaced and avoids the poles (Féjer quadrature).
 	sht_quick_init, ///< gauss grid, with minimum initialization time (useful for pre/post-processing)
 	sht_reg_poles,	///< quick initialization of a <b>regular grid including poles</b> (Clenshaw-Curtis quadrature). Useful for vizualisation.
-	sht_gauss_fly	///< legendre polynomials are recomputed on-the-fly for each transform (may be faster on some machines, saves memory and bandwidth).
+	sht_gauss_fly,	///< legendre polynomials are recomputed on-the-fly for each transform (may be faster on some machines, saves memory and bandwidth).
+	sht_predict		///< gauss grid, the algorithm being predicted by a cost model instead of being timed (fast and reproducible initialization). Precomputed matrices are used if the memory bandwidth measured by \ref shtns_calibrate makes them faster. See \ref SHT_PREDICT_CHECK.
 };
 #define SHT_NATIVE_LAYOUT 0			///< Tells shtns_init to use \ref native
 #define SHT_THETA_CONTIGUOUS 256	///< use \ref theta_fast
@@ -66,8 +71,11 @@ enum shtns_type {
 #define SHT_SOUTH_POLE_FIRST (256*32)	///< latitudinal data are stored starting from south pole.
 
 #define SHT_SCALAR_ONLY (256*16)	///< don't compute vector matrices. (add to flags in shtns_set_grid)
-#define SHT_LOAD_SAVE_CFG (256*64)	///< try to load and save the config. (add to flags in shtns_set_grid)
+#define SHT_LOAD_SAVE_CFG (256*64)	///< try to load and save the config, see \ref shtns_cfg_path. (add to flags in shtns_set_grid)
 #define SHT_ALLOW_GPU (256*128)		///< allows to use a GPU. This needs special care because the same plan cannot be used simultaneously by different threads anymore.
+#define SHT_PREDICT_CHECK (256*256)	///< with \ref sht_predict, time the two best predicted algorithms to choose between them. (add to flags in shtns_set_grid)
+#define SHT_SHARED_MEMORY (256*512)	///< share the precomputed arrays with other processes of the node through a shared memory segment, see \ref shm. (add to flags in shtns_set_grid)
+#define SHT_CPLX_NATIVE (256*1024)	///< experimental: transforms of complex fields by native kernels (one pass over m and -m) instead of two real transforms. They are currently not faster in general. (add to flags in shtns_set_grid)
 
 
 #ifndef SHTNS_PRIVATE
@@ -132,11 +140,66 @@ long nlm_calc(long lmax, long mmax, long mres);
 long nlm_cplx_calc(long lmax, long mmax, long mres);
 
 void shtns_verbose(int);			///< controls output during initialization: 0=no output (default), 1=some output, 2=degug (if compiled in)
+void shtns_tuning_budget(double seconds);	///< time budget (in seconds) for timing the algorithms of each transform type during initialization (0 for default).
 void shtns_print_version(void);		///< print version information to stdout.
 
 #ifndef SWIG
 
 void shtns_print_cfg(shtns_cfg);	///< print information about given config to stdout.
+/// name of the algorithm used by the transforms of given type (see \ref shtns_stats_type), and the truncated variants if ltr=1.
+const char* shtns_get_algorithm(shtns_cfg, int type, int ltr);
+/// measure (once) the memory bandwidth and peak flop rate of the machine, for the cost model and roofline of \ref shtns_print_cfg. Returns the machine balance (flop/byte).
+double shtns_calibrate(int force, double* bw, double* flops);
+
+/// \name timing statistics and traces (recorded only if compiled with ./configure --enable-stats)
+//@{
+#define SHTNS_STATS_MAX_THREADS 64	///< maximum number of threads for which the busy time is recorded.
+/// transform types for \ref shtns_get_stats
+enum shtns_stats_type {
+	shtns_stats_SH_to_spat, shtns_stats_spat_to_SH,				///< scalar synthesis and analysis
+	shtns_stats_SHsphtor_to_spat, shtns_stats_spat_to_SHsphtor,	///< 2D vector synthesis and analysis
+	shtns_stats_SHsph_to_spat, shtns_stats_SHtor_to_spat,		///< gradients
+	shtns_stats_SHqst_to_spat, shtns_stats_spat_to_SHqst,		///< 3D vector synthesis and analysis
+	shtns_stats_ntypes
+};
+/// hardware performance counters, see \ref shtns_perf_enable.
+enum shtns_perf_counter {
+	shtns_perf_cycles, shtns_perf_instructions,		///< cpu cycles and instructions retired
+	shtns_perf_l1d_misses, shtns_perf_l2_misses, shtns_perf_llc_misses,	///< data cache misses (L1 and last level: reads only)
+	shtns_perf_fp_ops,						///< double precision floating point operations retired (fma counts as 2)
+	shtns_perf_ncounters
+};
+/// timing statistics of one transform type, filled by \ref shtns_get_stats. All times are in seconds.
+/// The stages are summed over all threads: t_legendre is the time of the transform not spent in the fft (t_fft) nor in the allocation of buffers (t_alloc).
+struct shtns_stats {
+	unsigned long calls;		///< number of transforms.
+	double t_total, t_total_min, t_total_max;			///< wall-clock time of the transforms.
+	double t_legendre, t_legendre_min, t_legendre_max;	///< time of the Legendre stage (and in-place copies).
+	double t_fft, t_fft_min, t_fft_max;					///< time spent in FFTW.
+	double t_alloc, t_alloc_min, t_alloc_max;			///< time spent allocating scratch buffers.
+	double bytes;				///< estimated amount of memory read and written by the transforms (spectral and spatial arrays, and Fourier buffers).
+	int nthreads;				///< maximum number of threads used.
+	unsigned long perf_calls;	///< number of transforms measured with the hardware counters (see \ref shtns_perf_enable).
+	unsigned perf_mask;			///< bit k is set if counter k (see \ref shtns_perf_counter) has been measured.
+	double counter[shtns_perf_ncounters];	///< hardware counters, summed over all threads of the perf_calls transforms.
+	double ipc;					///< instructions per cycle.
+	double mem_bytes;			///< memory traffic estimated from the last level cache misses (64 bytes per miss).
+	double flops_per_byte;		///< floating point operations per byte of memory traffic.
+	double peak_fraction;		///< fraction of the nominal peak flop rate of the cores, over the cycles spent.
+	double t_busy[SHTNS_STATS_MAX_THREADS];		///< time spent by each thread (inside the parallel region for multi-threaded transforms).
+};
+/// fill st with the statistics of transform type (see \ref shtns_stats_type). Returns 0 if the statistics are not available (not compiled in, or invalid type), 1 otherwise.
+int shtns_get_stats(shtns_cfg, int type, struct shtns_stats* st);
+void shtns_reset_stats(shtns_cfg);	///< reset all statistics of the given config (they include the transforms timed during initialization).
+/// start (on=1) or stop (on=0) measuring the transforms with the hardware performance counters (Linux perf_event).
+/// Returns the set of available counters (bit k for counter k of \ref shtns_perf_counter), 0 if not available.
+unsigned shtns_perf_enable(int on);
+/// start recording a trace of the transforms in a ring buffer of nev events for each thread (0 for default). Returns 0 if not available.
+int shtns_trace_start(int nev);
+void shtns_trace_stop(void);		///< stop recording the trace (the recorded events are kept).
+/// write the recorded events to file fname in Chrome trace-event JSON format (for chrome://tracing or ui.perfetto.dev), and clear them. Returns the number of events written (-1 on error).
+long shtns_trace_write(const char* fname);
+//@}
 
 /// \name initialization
 //@{
@@ -155,6 +218,19 @@ int shtns_use_threads(int num_threads);
 /// Selects the gpu device (device_id % Num_devices). Must be called BEFORE any initialization. Internally calls cudaSetDevice(). Returns the actual device or -1 when no device found.
 int shtns_use_gpu(int device_id);
 
+/// Sets the path of the store of tuned configs used with \ref SHT_LOAD_SAVE_CFG (NULL = $SHTNS_CFG_PATH or "shtns_cfg.db" in the current directory).
+void shtns_cfg_path(const char* path);
+/// Loads the store of tuned configs (and fftw wisdom) in memory, so that subsequent initializations do not read the files. Returns the number of configs, or -1 if none.
+int shtns_cfg_preload(void);
+/// Saves a fully initialized config (including its grid and precomputed arrays) to a binary file. Returns 0 on success.
+int shtns_save(shtns_cfg, const char* path);
+/// Loads a config saved by \ref shtns_save, mapping its precomputed arrays read-only from the file. Returns NULL on failure.
+shtns_cfg shtns_load(const char* path);
+/// Removes the name of the shared memory segment used by the config (see \ref SHT_SHARED_MEMORY), once all processes have attached to it. Returns 0 on success.
+int shtns_unlink_shared(shtns_cfg);
+/// Returns 1 if the arrays of the config are in a shared memory segment (see \ref SHT_SHARED_MEMORY), 0 otherwise.
+int shtns_is_shared(shtns_cfg);
+
 void shtns_reset(void);				///< destroy all configs, free memory, and go back to initial state.
 void shtns_destroy(shtns_cfg);		///< free memory of given config, which cannot be used afterwards.
 void shtns_unset_grid(shtns_cfg);	///< unset the grid.
@@ -162,6 +238,7 @@ void shtns_unset_grid(shtns_cfg);	///< unset the grid.
 
 void* shtns_malloc(size_t bytes);	///< alloc appropriate memory (pinned for gpu, aligned for avx, ...). Use \ref shtns_free to free it.
 void shtns_free(void* p);			///< free memory allocated with \ref shtns_malloc
+void shtns_release_scratch(void);	///< free the scratch memory kept by the calling thread to avoid allocations in transforms (called by \ref shtns_reset).
 
 
 //@}
@@ -227,6 +304,7 @@ void SH_to_spat(shtns_cfg shtns, cplx *Qlm, double *Vr);
 /// \param[in] shtns = a configuration created by \ref shtns_create with a grid set by \ref shtns_set_grid or \ref shtns_set_grid_auto
 /// \param[in] alm[l*(l+1)+m] is the SH coefficient of order l and degree m (with -l <= m <= l) [total of (LMAX+1)^2 coefficients]
 /// \param[out] z = complex spatial field
+/// The complex transforms are done by two real transforms, unless the native kernels are enabled by \ref SHT_CPLX_NATIVE (experimental).
 void SH_to_spat_cplx(shtns_cfg shtns, cplx *alm, cplx *z);
 /// complex scalar analysis.
 /// \param[in] shtns = a configuration created by \ref shtns_create with a grid set by \ref shtns_set_grid or \ref shtns_set_grid_auto
@@ -315,6 +393,82 @@ void SHqst_to_spat_ml(shtns_cfg, int im, cplx *Ql, cplx *Sl, cplx *Tl, cplx *Vr,
 /// Compute the spatial representation of the gradient of a scalar SH field. Alias for \ref SHsph_to_spat_l
 #define SH_to_grad_spat_ml(shtns, im, S,Gt,Gp,ltr) SHsph_to_spat_ml(shtns, im, S, Gt, Gp, ltr)
 
+/// \name Legendre transforms between spectral and Fourier space, for a list of orders (no fft)
+/// These perform only the Legendre stage of the transforms, so that the fft (and e.g. the transposes of distributed-memory codes)
+/// can be done by the caller. im_list[i] is the order index im (m = im*mres) of the i-th order, any subset of 0 <= im <= mmax in any order.
+/// Spectral arrays are full arrays (standard layout, l <= ltr used, other orders untouched by the analysis).
+/// Fourier arrays hold nm blocks of nlat complex numbers: the block for im_list[i] starts at F + i*shtns->nlat,
+/// with the latitudes ordered as in shtns->ct. For a field v sampled at nphi equispaced longitudes phi_j = 2*pi*j/(nphi*mres):
+///   F_im(theta) = 1/nphi * sum_j v(theta,phi_j) exp(-I*im*2*pi*j/nphi)
+/// that is, the synthesis output is the input of an unnormalized complex-to-real fft (e.g. fftw_plan_dft_c2r_1d),
+/// and the analysis input is the output of a real-to-complex fft divided by nphi. For m=0, only the real part is used.
+/// With several threads, the orders are distributed among threads (call from a single thread).
+//@{
+void SH_to_fourier(shtns_cfg, int nm, const int *im_list, cplx *Qlm, cplx *Vr, int ltr);
+void fourier_to_SH(shtns_cfg, int nm, const int *im_list, cplx *Vr, cplx *Qlm, int ltr);
+void SHsphtor_to_fourier(shtns_cfg, int nm, const int *im_list, cplx *Slm, cplx *Tlm, cplx *Vt, cplx *Vp, int ltr);
+void fourier_to_SHsphtor(shtns_cfg, int nm, const int *im_list, cplx *Vt, cplx *Vp, cplx *Slm, cplx *Tlm, int ltr);
+void SHqst_to_fourier(shtns_cfg, int nm, const int *im_list, cplx *Qlm, cplx *Slm, cplx *Tlm, cplx *Vr, cplx *Vt, cplx *Vp, int ltr);
+void fourier_to_SHqst(shtns_cfg, int nm, const int *im_list, cplx *Vr, cplx *Vt, cplx *Vp, cplx *Qlm, cplx *Slm, cplx *Tlm, int ltr);
+void SH_to_spat_ml_batch(shtns_cfg, int nm, const int *im_list, cplx *Qlm, cplx *Vr, int ltr);		///< same as \ref SH_to_fourier
+void spat_to_SH_ml_batch(shtns_cfg, int nm, const int *im_list, cplx *Vr, cplx *Qlm, int ltr);		///< same as \ref fourier_to_SH
+//@}
+
+/// \name Batched transforms of several independent fields
+/// The same transform is applied to the nfields arrays pointed to by each argument (e.g. Qlm[0..nfields-1]).
+/// The associated Legendre functions are computed only once for all fields, which is faster than successive calls.
+//@{
+void SH_to_spat_batch(shtns_cfg, int nfields, cplx **Qlm, double **Vr);
+void spat_to_SH_batch(shtns_cfg, int nfields, double **Vr, cplx **Qlm);
+void SHsphtor_to_spat_batch(shtns_cfg, int nfields, cplx **Slm, cplx **Tlm, double **Vt, double **Vp);
+void spat_to_SHsphtor_batch(shtns_cfg, int nfields, double **Vt, double **Vp, cplx **Slm, cplx **Tlm);
+//@}
+
+/// \name Multi-shell transforms (e.g. all radial levels of a spherical shell)
+/// The same transform is applied to nr fields stored one after the other: shell ir starts at Qlm + ir*lm_stride (in complex numbers)
+/// and at Vr + ir*spat_stride (in doubles). Typically lm_stride = shtns->nlm and spat_stride = \ref NSPAT_ALLOC(shtns), which keeps the alignment.
+/// With several threads, the shells are either distributed among threads or transformed one after the other using all threads, whichever was found faster at initialization.
+//@{
+void SH_to_spat_shells(shtns_cfg, int nr, cplx *Qlm, long lm_stride, double *Vr, long spat_stride);
+void spat_to_SH_shells(shtns_cfg, int nr, double *Vr, long spat_stride, cplx *Qlm, long lm_stride);
+void SHqst_to_spat_shells(shtns_cfg, int nr, cplx *Qlm, cplx *Slm, cplx *Tlm, long lm_stride, double *Vr, double *Vt, double *Vp, long spat_stride);
+void spat_to_SHqst_shells(shtns_cfg, int nr, double *Vr, double *Vt, double *Vp, long spat_stride, cplx *Qlm, cplx *Slm, cplx *Tlm, long lm_stride);
+//@}
+
+/// \name Single precision transforms
+/// Same as the regular transforms, but spectral and spatial data are stored as float (spatial fields of size shtns->nspat).
+/// The Legendre functions are still computed in double precision, one order at a time, while the fft is performed in single precision if fftw3f is available.
+/// The spatial fields and the Fourier coefficients are then only stored as float, which halves the memory traffic of the arrays of the size of the grid.
+/// The relative accuracy is about 1e-6.
+/// As for the double precision transforms, the analysis may overwrite its spatial input (the fft is done in place when latitudes are contiguous).
+/// The spatial arrays must have the same alignment as those returned by \ref shtns_malloc, which is required by the single precision fft.
+//@{
+void SH_to_spatf(shtns_cfg, cplxf *Qlm, float *Vr);
+void spat_to_SHf(shtns_cfg, float *Vr, cplxf *Qlm);
+void SHsphtor_to_spatf(shtns_cfg, cplxf *Slm, cplxf *Tlm, float *Vt, float *Vp);
+void spat_to_SHsphtorf(shtns_cfg, float *Vt, float *Vp, cplxf *Slm, cplxf *Tlm);
+void SHqst_to_spatf(shtns_cfg, cplxf *Qlm, cplxf *Slm, cplxf *Tlm, float *Vr, float *Vt, float *Vp);
+void spat_to_SHqstf(shtns_cfg, float *Vr, float *Vt, float *Vp, cplxf *Qlm, cplxf *Slm, cplxf *Tlm);
+//@}
+
+/// \name Fused synthesis, pointwise operation and analysis (non-linear terms)
+/// The input fields are synthesized by blocks of latitudes, handed to a user function, and the fields it returns
+/// are analysed right away. The full spatial fields are never stored, which saves memory bandwidth.
+/// For small grids where separate transforms were timed faster when the grid was set, the user function is instead called once
+/// with the whole grid, between separate transforms. Large grids (above 8 Mb per field) are always processed by blocks.
+//@{
+/// User function called by \ref SH_to_spat_op_to_SH for each block of nlat_blk latitudes (and all longitudes).
+/// With several threads, it is called concurrently on different blocks (by different threads).
+/// Vin holds the synthesized fields, and the function must write all the values of the fields to analyse in Vout.
+/// Scalar fields come first, followed by the theta and phi components of each vector field.
+/// The output spectra must not overlap the input ones.
+/// In each field, the value at longitude index ip and block row j is V[ip*nlat_blk + j], located at the latitude index lat[j]
+/// of the grid (i.e. cos(theta) = shtns->ct[lat[j]]).
+typedef void (*shtns_spat_op)(void* data, int nlat_blk, const int *lat, double **Vin, double **Vout);
+void SH_to_spat_op_to_SH(shtns_cfg, int nqi, cplx **Qi, int nvi, cplx **Si, cplx **Ti,
+		shtns_spat_op op, void* data, int nqo, cplx **Qo, int nvo, cplx **So, cplx **To);
+//@}
+
 //@}
 
 /// \name Local and partial evalutions of a SH representation :
@@ -325,6 +479,18 @@ void SH_to_grad_point(shtns_cfg, cplx *DrSlm, cplx *Slm,
 					double cost, double phi, double *vr, double *vt, double *vp);
 void SHqst_to_point(shtns_cfg, cplx *Qlm, cplx *Slm, cplx *Tlm,
 					double cost, double phi, double *vr, double *vt, double *vp);
+void SH_to_points(shtns_cfg, cplx *Qlm, long int n, const double *cost, const double *phi, double *vr);
+void SH_to_grad_points(shtns_cfg, cplx *DrSlm, cplx *Slm, long int n,
+					const double *cost, const double *phi, double *vr, double *vt, double *vp);
+void SHqst_to_points(shtns_cfg, cplx *Qlm, cplx *Slm, cplx *Tlm, long int n,
+					const double *cost, const double *phi, double *vr, double *vt, double *vp);
+
+/// a planned synthesis at scattered points (and its adjoint), see \ref shtns_points_plan_create
+typedef struct shtns_points_plan_s* shtns_points_plan;
+shtns_points_plan shtns_points_plan_create(shtns_cfg, long int n, const double *cost, const double *phi, double eps);
+void shtns_points_plan_destroy(shtns_points_plan);
+void SH_to_points_fast(shtns_points_plan, cplx *Qlm, double *vr);
+void SH_to_points_adjoint(shtns_points_plan, const double *vr, cplx *Qlm);
 
 void SH_to_lat(shtns_cfg shtns, cplx *Qlm, double cost,
 					double *vr, int nphi, int ltr, int mtr);
@@ -26,6 +26,68 @@ test1 "7975 -mres=145 -quickinit -iter=1"
 # without threads
 test1 "2047 -mres=15 -quickinit -iter=1 -nth=1"
 
+# batched transforms
+test1 "255 -mres=3 -quickinit -iter=2 -batch=5"
+test1 "63 -transpose -iter=2 -batch=3"
+
+# single precision transforms
+test1 "255 -mres=3 -quickinit -iter=2 -float"
+test1 "63 -transpose -iter=2 -float"
+test1 "63 -oop -iter=2 -float"
+
+# fused synthesis, pointwise products and analysis
+test1 "255 -mres=3 -quickinit -iter=2 -fused"
+test1 "63 -nlat=96 -transpose -iter=2 -fused"
+test1 "127 -iter=2 -fused -nth=3"
+
+# multi-shell transforms
+test1 "127 -quickinit -iter=2 -shells=7"
+test1 "63 -oop -iter=2 -shells=5 -nth=4"
+
+# axisymmetric transforms with threads (latitudes split among threads)
+test1 "1023 -mmax=0 -quickinit -iter=2 -nth=4"
+test1 "1023 -mmax=0 -nlat=1090 -ltr=700 -quickinit -iter=2 -nth=3"
+
+# fixed-m legendre transforms (threaded, and all orders in fourier space)
+test1 "255 -quickinit -iter=2 -ml -vector -nth=4"
+test1 "101 -mres=3 -nlat=152 -quickinit -iter=2 -ml -vector -nth=3"
+test1 "511 -quickinit -iter=1 -ml -vector -nth=4 -polaropt=1e-6"
+
+# algorithm predicted by a cost model (without timing, and with timing of the two best candidates)
+test1 "511 -predict -iter=2 -vector -nth=4"
+test1 "127 -mres=2 -nlat=136 -predictcheck -iter=2 -vector"
+test1 "200 -predict -roofline -iter=2 -vector"
+
+# autotuning with a larger time budget (timing trials, with truncated variants)
+test1 "255 -gauss -budget=0.5 -iter=2 -vector -nth=2"
+
+# per-stage statistics (only printed if configured with --enable-stats)
+test1 "200 -reg -iter=2 -vector -stats -nth=2"
+test1 "120 -quickinit -iter=2 -perf -nth=2"
+
+# transforms of complex fields (two real transforms, and experimental native kernels), and fallback on regular grids
+test1 "255 -quickinit -iter=2 -cplx -vector -nth=2"
+test1 "255 -quickinit -iter=2 -cplxnative -vector -nth=2"
+test1 "127 -transpose -iter=2 -cplxnative -vector"
+test1 "64 -reg -quickinit -iter=2 -cplx -vector"
+
+# evaluation at scattered points (compared to point by point evaluation, also for high orders with lmax>2047), and planned synthesis with its adjoint
+test1 "255 -mres=3 -quickinit -iter=1 -points=20000 -vector -nth=2"
+test1 "60 -mmax=20 -mres=2 -schmidt -quickinit -iter=1 -points=3000 -vector"
+test1 "3000 -mmax=25 -mres=100 -quickinit -iter=1 -points=4000"
+
+# several threads using a new config at the same time (ffts planned on first use, per-thread caches)
+test1 "255 -mres=3 -quickinit -iter=1 -concurrent=4"
+test1 "127 -iter=1 -concurrent=3 -nth=2"
+
+# config saved to a file and loaded back (mapped read-only)
+test1 "127 -gauss -iter=2 -saveload"
+test1 "255 -mres=2 -4pi -quickinit -iter=2 -saveload -nth=2"
+
+# arrays shared with a second process through a shared memory segment
+test1 "127 -gauss -iter=2 -shared"
+test1 "255 -mres=2 -quickinit -iter=2 -shared -nth=2"
+
 for switch in "" "-oop" "-transpose" "-schmidt" "-4pi"
 do
   for mode in "-quickinit" "-gauss" "-reg" "-fly" "-gauss -nth=1"
@@ -21,6 +21,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <pthread.h>
 #include <complex.h>
 #include <math.h>
 #include "fftw3/fftw3.h"
@@ -498,6 +501,715 @@ void test_SHT_vect3d()
 	return;
 }
 
+/// single precision transforms (float32 data, double precision recurrence).
+void test_SHT_float(int vector)
+{
+	long int jj,i;
+	double ts, ta;
+	struct timeval t1, t2;
+	complex float *Qf = (complex float *) shtns_malloc(sizeof(complex float)* NLM);
+	complex float *Sf = (complex float *) shtns_malloc(sizeof(complex float)* NLM);
+	complex float *Tf = (complex float *) shtns_malloc(sizeof(complex float)* NLM);
+	complex float *Uf = (complex float *) shtns_malloc(sizeof(complex float)* NLM);
+	float *Vf = (float *) shtns_malloc( 2*(NPHI/2+1) * NLAT * sizeof(float));
+	float *Vtf = (float *) shtns_malloc( 2*(NPHI/2+1) * NLAT * sizeof(float));
+	float *Vpf = (float *) shtns_malloc( 2*(NPHI/2+1) * NLAT * sizeof(float));
+	complex double *Q2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *T2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+
+	for (i=0;i<NLM;i++) Qf[i] = Slm0[i];
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_spatf(shtns, Qf, Vf);
+	}
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2);
+	SH_to_spat(shtns, Slm0, Sh);		// the float synthesis must match the double one.
+	double dmax = 0.0,  vmax = 0.0;
+	for (i=0; i<NLAT*NPHI; i++) {
+		if (fabs(Vf[i] - Sh[i]) > dmax) dmax = fabs(Vf[i] - Sh[i]);
+		if (fabs(Sh[i]) > vmax) vmax = fabs(Sh[i]);
+	}
+	gettimeofday(&t1, NULL);
+	spat_to_SHf(shtns, Vf, Qf);		// the analysis may overwrite its spatial input: keep only the first result.
+	for (jj=1; jj< SHT_ITER; jj++) {
+		spat_to_SHf(shtns, Vf, Tf);
+	}
+	gettimeofday(&t2, NULL);
+	ta = tdiff(&t1, &t2);
+	printf("   float scalar SHT : \t synthesis %f ms \t analysis %f ms\n", ts, ta);
+	printf("   => max difference with the double precision synthesis = %g (relative)\n", dmax/vmax);
+	for (i=0;i<NLM;i++) Q2[i] = Qf[i];
+	scal_error(Q2, Slm0, LMAX);
+
+	if (vector) {
+		for (i=0;i<NLM;i++) {	Sf[i] = Slm0[i];	Tf[i] = Tlm0[i];	}
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			SHsphtor_to_spatf(shtns, Sf, Tf, Vtf, Vpf);
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		spat_to_SHsphtorf(shtns, Vtf, Vpf, Sf, Tf);
+		for (jj=1; jj< SHT_ITER; jj++) {
+			spat_to_SHsphtorf(shtns, Vtf, Vpf, Qf, Uf);
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   float vector SHT : \t synthesis %f ms \t analysis %f ms\n", ts, ta);
+		for (i=0;i<NLM;i++) {	Q2[i] = Sf[i];	T2[i] = Tf[i];	}
+		vect_error(Q2, T2, Slm0, Tlm0, LMAX);
+
+		for (i=0;i<NLM;i++) {	Qf[i] = Tlm0[i];	Sf[i] = Slm0[i];	Tf[i] = Tlm0[i];	}
+		SHqst_to_spatf(shtns, Qf, Sf, Tf, Vf, Vtf, Vpf);
+		spat_to_SHqstf(shtns, Vf, Vtf, Vpf, Qf, Sf, Tf);
+		for (i=0;i<NLM;i++) {	Q2[i] = Sf[i];	T2[i] = Tf[i];	}
+		vect_error(Q2, T2, Slm0, Tlm0, LMAX);
+		for (i=0;i<NLM;i++) Q2[i] = Qf[i];
+		scal_error(Q2, Tlm0, LMAX);
+	}
+
+	shtns_free(T2);		shtns_free(Q2);
+	shtns_free(Vpf);	shtns_free(Vtf);	shtns_free(Vf);
+	shtns_free(Uf);		shtns_free(Tf);		shtns_free(Sf);		shtns_free(Qf);
+}
+
+/// pointwise products used to test the fused transforms: Vin = (q, vt, vp) -> Vout = (q*q, q*vt, q*vp).
+void fused_products(void* data, int nlat_blk, const int *lat, double **Vin, double **Vout)
+{
+	int vector = *(int*) data;
+	long int n = (long int) nlat_blk * NPHI;
+	for (long int i=0; i<n; i++) {
+		double q = Vin[0][i];
+		Vout[0][i] = q*q;
+		if (vector) {	Vout[1][i] = q*Vin[1][i];	Vout[2][i] = q*Vin[2][i];	}
+	}
+}
+
+/// fused synthesis, pointwise products and analysis, compared to separate transforms.
+void test_SHT_fused(int vector)
+{
+	long int jj,i;
+	double tf, tu;
+	struct timeval t1, t2;
+	const long int nspat = 2*(NPHI/2+1) * NLAT;
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *S = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *T = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *Q2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *S2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *T2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *Q3 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *S3 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *T3 = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	double *V = (double *) shtns_malloc( 3*nspat * sizeof(double));
+	double *Vt = V + nspat;		double *Vp = V + 2*nspat;
+	double *Vin[3] = { V, Vt, Vp };
+
+	for (i=0;i<NLM;i++) Q[i] = Slm0[i];
+	if (vector) for (i=0;i<NLM;i++) {	S[i] = Tlm0[i];		T[i] = Slm0[i];		}
+
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_spat(shtns, Q, V);
+		if (vector) SHsphtor_to_spat(shtns, S, T, Vt, Vp);
+		fused_products(&vector, NLAT, NULL, Vin, Vin);
+		spat_to_SH(shtns, V, Q2);
+		if (vector) spat_to_SHsphtor(shtns, Vt, Vp, S2, T2);
+	}
+	gettimeofday(&t2, NULL);
+	tu = tdiff(&t1, &t2);
+
+	SH_to_spat_op_to_SH(shtns, 1, &Q, vector, &S, &T, fused_products, &vector, 1, &Q3, vector, &S3, &T3);		// plans the block ffts.
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_spat_op_to_SH(shtns, 1, &Q, vector, &S, &T, fused_products, &vector, 1, &Q3, vector, &S3, &T3);
+	}
+	gettimeofday(&t2, NULL);
+	tf = tdiff(&t1, &t2);
+	printf("   fused %s products : \t %f ms (separate transforms: %f ms)\n", (vector) ? "scalar and vector" : "scalar", tf, tu);
+
+	scal_error(Q3, Q2, LMAX);
+	if (vector) vect_error(S3, T3, S2, T2, LMAX);
+
+	shtns_free(V);
+	shtns_free(T3);		shtns_free(S3);		shtns_free(Q3);
+	shtns_free(T2);		shtns_free(S2);		shtns_free(Q2);
+	shtns_free(T);		shtns_free(S);		shtns_free(Q);
+}
+
+double cplx_error(const char* name, complex double *a, complex double *b, long int n)
+{
+	double tmax = 0;
+	for (long int i=0; i<n; i++) {
+		double t = cabs(a[i]-b[i]);
+		if (t > tmax) tmax = t;
+	}
+	printf("   %s => max error = %g", name, tmax);
+	if (tmax > 1e-3) printf("    **** ERROR ****\n");
+	else printf("\n");
+	return tmax;
+}
+
+/// max difference between the n real values of a and b (same tolerance as cplx_error).
+double real_error(const char* name, double *a, double *b, long int n)
+{
+	double tmax = 0;
+	for (long int i=0; i<n; i++) {
+		double t = fabs(a[i]-b[i]);
+		if (t > tmax) tmax = t;
+	}
+	printf("   %s => max error = %g", name, tmax);
+	if (tmax > 1e-3) printf("    **** ERROR ****\n");
+	else printf("\n");
+	return tmax;
+}
+
+/// batched transforms of nf fields, compared to nf successive single-field transforms.
+void test_SHT_batch(int nf, int vector)
+{
+	long int jj,i;
+	int f;
+	double ts, ta, ts1, ta1;
+	struct timeval t1, t2;
+	complex double *Q[nf], *S[nf], *T[nf], *Q1[nf], *S1[nf], *T1[nf], *Q2[nf], *S2[nf], *T2[nf];
+	double *V[nf], *Vt[nf], *Vp[nf], *V1[nf], *Vt1[nf], *Vp1[nf];
+	const long int nspat = NSPAT_ALLOC(shtns);
+	const long int npts = (long int) NLAT*NPHI;
+	const double t = 1.0 / (RAND_MAX/2);
+	char name[64];
+
+	for (f=0; f<nf; f++) {		// distinct random fields, so that a mix-up between fields is detected.
+		Q[f] = (complex double *) shtns_malloc(sizeof(complex double)* 3*NLM);
+		Q1[f] = Q[f] + NLM;		Q2[f] = Q[f] + 2*NLM;
+		V[f] = (double *) shtns_malloc( 2*nspat * sizeof(double));
+		V1[f] = V[f] + nspat;
+		for (i=0;i<NLM;i++) Q[f][i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));
+		for (i=0;i<=LMAX;i++) Q[f][LM(shtns,i,0)] = creal(Q[f][LM(shtns,i,0)]);		// real field: m=0 coefficients are real.
+		if (vector) {
+			S[f] = (complex double *) shtns_malloc(sizeof(complex double)* 6*NLM);
+			T[f] = S[f] + NLM;		S1[f] = S[f] + 2*NLM;		T1[f] = S[f] + 3*NLM;
+			S2[f] = S[f] + 4*NLM;		T2[f] = S[f] + 5*NLM;
+			Vt[f] = (double *) shtns_malloc( 4*nspat * sizeof(double));
+			Vp[f] = Vt[f] + nspat;		Vt1[f] = Vt[f] + 2*nspat;		Vp1[f] = Vt[f] + 3*nspat;
+			for (i=0;i<NLM;i++) {
+				S[f][i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));
+				T[f][i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));
+			}
+			for (i=0;i<=LMAX;i++) {
+				S[f][LM(shtns,i,0)] = creal(S[f][LM(shtns,i,0)]);		T[f][LM(shtns,i,0)] = creal(T[f][LM(shtns,i,0)]);
+			}
+			S[f][LM(shtns,0,0)] = 0.0;		T[f][LM(shtns,0,0)] = 0.0;		// l=0 has no meaning for sph/tor
+		}
+	}
+
+	// timings first: analysis may overwrite its spatial input, so these results are discarded.
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (f=0; f<nf; f++) SH_to_spat(shtns, Q[f], V1[f]);
+	}
+	gettimeofday(&t2, NULL);
+	ts1 = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (f=0; f<nf; f++) spat_to_SH(shtns, V1[f], Q1[f]);
+	}
+	gettimeofday(&t2, NULL);
+	ta1 = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_spat_batch(shtns, nf, Q, V);
+	}
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		spat_to_SH_batch(shtns, nf, V, Q2);
+	}
+	gettimeofday(&t2, NULL);
+	ta = tdiff(&t1, &t2);
+	printf("   batch of %d scalar SHT : \t synthesis %f ms (single: %f ms) \t analysis %f ms (single: %f ms)\n", nf, ts, ts1, ta, ta1);
+
+	for (f=0; f<nf; f++) SH_to_spat(shtns, Q[f], V1[f]);
+	SH_to_spat_batch(shtns, nf, Q, V);
+	for (f=0; f<nf; f++) {		// each field against the unbatched transform of the same field.
+		sprintf(name, "field %d, synthesis vs single", f);		real_error(name, V[f], V1[f], npts);
+		spat_to_SH(shtns, V1[f], Q1[f]);
+	}
+	spat_to_SH_batch(shtns, nf, V, Q2);
+	for (f=0; f<nf; f++) {
+		sprintf(name, "field %d, analysis vs single", f);		cplx_error(name, Q2[f], Q1[f], NLM);
+		scal_error(Q2[f], Q[f], LMAX);
+	}
+
+	if (vector) {
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			SHsphtor_to_spat_batch(shtns, nf, S, T, Vt, Vp);
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			spat_to_SHsphtor_batch(shtns, nf, Vt, Vp, S2, T2);
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   batch of %d vector SHT : \t synthesis %f ms \t analysis %f ms\n", nf, ts, ta);
+
+		for (f=0; f<nf; f++) SHsphtor_to_spat(shtns, S[f], T[f], Vt1[f], Vp1[f]);
+		SHsphtor_to_spat_batch(shtns, nf, S, T, Vt, Vp);
+		for (f=0; f<nf; f++) {
+			sprintf(name, "field %d, synthesis vs single (theta)", f);		real_error(name, Vt[f], Vt1[f], npts);
+			sprintf(name, "field %d, synthesis vs single (phi)", f);		real_error(name, Vp[f], Vp1[f], npts);
+			spat_to_SHsphtor(shtns, Vt1[f], Vp1[f], S1[f], T1[f]);
+		}
+		spat_to_SHsphtor_batch(shtns, nf, Vt, Vp, S2, T2);
+		for (f=0; f<nf; f++) {
+			sprintf(name, "field %d, analysis vs single (sph)", f);		cplx_error(name, S2[f], S1[f], NLM);
+			sprintf(name, "field %d, analysis vs single (tor)", f);		cplx_error(name, T2[f], T1[f], NLM);
+			vect_error(S2[f], T2[f], S[f], T[f], LMAX);
+		}
+	}
+
+	for (f=0; f<nf; f++) {
+		shtns_free(V[f]);	shtns_free(Q[f]);
+		if (vector) {
+			shtns_free(Vt[f]);	shtns_free(S[f]);
+		}
+	}
+	return;
+}
+
+/// complex coefficients Z[LM_cplx(l,m)] of the complex field f1 + I*f2, where f1 and f2 are the real fields of coefficients Q1 and Q2.
+void real_to_cplx_coeffs(complex double *Q1, complex double *Q2, complex double *Z)
+{
+	for (int m=0; m<=MMAX; m++) {
+		const double parity = (m&1) ? -1.0 : 1.0;
+		for (int l=m; l<=LMAX; l++) {
+			complex double a = Q1[LM(shtns,l,m)];
+			complex double b = Q2[LM(shtns,l,m)];
+			if (m==0) {
+				Z[LM_cplx(shtns,l,0)] = creal(a) + I*creal(b);
+			} else {
+				Z[LM_cplx(shtns,l,m)] = a + I*b;
+				Z[LM_cplx(shtns,l,-m)] = (conj(a) + I*conj(b)) * parity;
+			}
+		}
+	}
+}
+
+
+/// transforms of complex fields, compared to the real transforms of their real and imaginary parts.
+void test_SHT_cplx(int vector)
+{
+	long int jj,i;
+	double ts, ta, ts2, ta2;
+	struct timeval t1, t2;
+	const long int nlmc = shtns->nlm_cplx;
+	const long int nspat = NSPAT_ALLOC(shtns);
+	const long int npts = (long int) NLAT*NPHI;
+	complex double *Q1 = (complex double *) shtns_malloc(sizeof(complex double)* 4*NLM);
+	complex double *Q2 = Q1 + NLM;		complex double *Q3 = Q1 + 2*NLM;		complex double *Q4 = Q1 + 3*NLM;
+	complex double *Z = (complex double *) shtns_malloc(sizeof(complex double)* 4*nlmc);
+	complex double *Z2 = Z + nlmc;		complex double *Z3 = Z + 2*nlmc;		complex double *Z4 = Z + 3*nlmc;
+	complex double *z = (complex double *) shtns_malloc(sizeof(complex double)* 3*nspat);
+	complex double *zt = z + nspat;		complex double *zp = z + 2*nspat;
+	double *re = (double *) shtns_malloc(sizeof(double)* 4*nspat);
+	double *im = re + nspat;		double *re2 = re + 2*nspat;		double *im2 = re + 3*nspat;
+
+	const double t = 1.0 / (RAND_MAX/2);
+	for (i=0;i<4*NLM;i++) Q1[i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));
+	real_to_cplx_coeffs(Q1, Q2, Z);
+
+	SH_to_spat_cplx(shtns, Z, z);		// plans the ffts.
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++)	SH_to_spat_cplx(shtns, Z, z);
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++)	spat_cplx_to_SH(shtns, z, Z2);
+	gettimeofday(&t2, NULL);
+	ta = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {	SH_to_spat(shtns, Q1, re);		SH_to_spat(shtns, Q2, im);	}
+	gettimeofday(&t2, NULL);
+	ts2 = tdiff(&t1, &t2);
+	for (i=0; i<npts; i++) zt[i] = re[i] + I*im[i];
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {	spat_to_SH(shtns, re, Q3);		spat_to_SH(shtns, im, Q4);	}
+	gettimeofday(&t2, NULL);
+	ta2 = tdiff(&t1, &t2);
+	printf("   complex scalar SHT : \t synthesis %f ms \t analysis %f ms \t (two real SHT: %f ms, %f ms)\n", ts, ta, ts2, ta2);
+	cplx_error("spatial", z, zt, npts);
+	cplx_error("spectral", Z2, Z, nlmc);
+
+	if (vector) {
+		for (i=0;i<4*NLM;i++) Q1[i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));		// Q3 and Q4 were overwritten by the analysis.
+		Q1[LM(shtns,0,0)] = 0.0;		Q2[LM(shtns,0,0)] = 0.0;		// l=0 has no meaning for sph/tor
+		Q3[LM(shtns,0,0)] = 0.0;		Q4[LM(shtns,0,0)] = 0.0;
+		real_to_cplx_coeffs(Q1, Q2, Z);
+		real_to_cplx_coeffs(Q3, Q4, Z2);
+		SHsphtor_to_spat_cplx(shtns, Z, Z2, zt, zp);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++)	SHsphtor_to_spat_cplx(shtns, Z, Z2, zt, zp);
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++)	spat_cplx_to_SHsphtor(shtns, zt, zp, Z3, Z4);
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {	SHsphtor_to_spat(shtns, Q1, Q3, re, re2);		SHsphtor_to_spat(shtns, Q2, Q4, im, im2);	}
+		gettimeofday(&t2, NULL);
+		ts2 = tdiff(&t1, &t2);
+		printf("   complex vector SHT : \t synthesis %f ms \t analysis %f ms \t (two real SHT: %f ms)\n", ts, ta, ts2);
+		for (i=0; i<npts; i++) z[i] = re[i] + I*im[i];
+		cplx_error("spatial theta", zt, z, npts);
+		for (i=0; i<npts; i++) z[i] = re2[i] + I*im2[i];
+		cplx_error("spatial phi", zp, z, npts);
+		cplx_error("spheroidal", Z3, Z, nlmc);
+		cplx_error("toroidal", Z4, Z2, nlmc);
+
+		SHsphtor_to_spat_cplx_xsint(shtns, Z, Z2, zt, zp);
+		spat_cplx_xsint_to_SHsphtor(shtns, zt, zp, Z3, Z4);
+		cplx_error("xsint spheroidal", Z3, Z, nlmc);
+		cplx_error("xsint toroidal", Z4, Z2, nlmc);
+	}
+
+	shtns_free(re);		shtns_free(z);
+	shtns_free(Z);		shtns_free(Q1);
+}
+
+/// evaluation at n scattered points, compared to the evaluation point by point (on a subset of the points).
+/// Half of the points are random, the other half share a few latitudes (and their mirror images).
+void test_SHT_points(long int n, int vector)
+{
+	long int i;
+	double ts, ts1;
+	struct timeval t1, t2;
+	const long int nref = (n < 2000) ? n : 2000;		// number of points checked against the point by point evaluation.
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* 3*NLM);
+	complex double *S = Q + NLM;		complex double *T = Q + 2*NLM;
+	double *cost = (double *) malloc(sizeof(double)* 5*n);
+	double *phi = cost + n;		double *vr = cost + 2*n;		double *vt = cost + 3*n;		double *vp = cost + 4*n;
+	double vr1, vt1, vp1, err, errv, vmaxv;
+
+	const double t = 1.0 / (RAND_MAX/2);
+	for (i=0;i<3*NLM;i++) Q[i] = t*((double) (rand() - RAND_MAX/2)) + I*t*((double) (rand() - RAND_MAX/2));
+	for (i=0;i<=LMAX;i++) {	Q[i] = creal(Q[i]);		S[i] = creal(S[i]);		T[i] = creal(T[i]);	}		// m=0 is real.
+	for (i=0; i<n; i++) {
+		phi[i] = rand() * (2.*M_PI/RAND_MAX);
+		if (i&1) {
+			cost[i] = cos(((i/2) % 17) * (M_PI/16));		// shared latitudes, including the poles.
+			if ((i/2) % 3 == 0) cost[i] = -cost[i];
+		} else cost[i] = rand() * (2.0/RAND_MAX) - 1.0;
+	}
+
+	gettimeofday(&t1, NULL);
+	SH_to_points(shtns, Q, n, cost, phi, vr);
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2) * SHT_ITER;		// single call.
+	err = 0;
+	gettimeofday(&t1, NULL);
+	for (i=0; i<nref; i++) {
+		double e = fabs(SH_to_point(shtns, Q, cost[i], phi[i]) - vr[i]);
+		if (e > err) err = e;
+	}
+	gettimeofday(&t2, NULL);
+	ts1 = tdiff(&t1, &t2) * SHT_ITER * n / nref;
+	printf("   SH_to_points : %ld points in %f ms (%f ms point by point)\n", n, ts, ts1);
+	printf("     max error = %g", err);
+	if (err > 1e-10*LMAX) printf("    **** ERROR ****\n");
+	else printf("\n");
+
+	if (vector) {
+		gettimeofday(&t1, NULL);
+		SHqst_to_points(shtns, Q, S, T, n, cost, phi, vr, vt, vp);
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2) * SHT_ITER;		// single call.
+		errv = 0;		vmaxv = 0;		// the derivatives grow with l: the error is relative to the max value.
+		gettimeofday(&t1, NULL);
+		for (i=0; i<nref; i++) {
+			SHqst_to_point(shtns, Q, S, T, cost[i], phi[i], &vr1, &vt1, &vp1);
+			double e = fabs(vr1 - vr[i]) + fabs(vt1 - vt[i]) + fabs(vp1 - vp[i]);
+			if (e > errv) errv = e;
+			e = fabs(vr1) + fabs(vt1) + fabs(vp1);
+			if (e > vmaxv) vmaxv = e;
+		}
+		gettimeofday(&t2, NULL);
+		ts1 = tdiff(&t1, &t2) * SHT_ITER * n / nref;
+		SH_to_grad_points(shtns, Q, S, n, cost, phi, vr, vt, vp);
+		for (i=0; i<nref; i++) {
+			SH_to_grad_point(shtns, Q, S, cost[i], phi[i], &vr1, &vt1, &vp1);
+			double e = fabs(vr1 - vr[i]) + fabs(vt1 - vt[i]) + fabs(vp1 - vp[i]);
+			if (e > errv) errv = e;
+			e = fabs(vr1) + fabs(vt1) + fabs(vp1);
+			if (e > vmaxv) vmaxv = e;
+		}
+		printf("   SHqst_to_points : %ld points in %f ms (%f ms point by point)\n", n, ts, ts1);
+		printf("     max error = %g (relative to max value)", errv/vmaxv);
+		if (errv > 1e-11*vmaxv) printf("    **** ERROR ****\n");
+		else printf("\n");
+	}
+
+	// planned synthesis through an oversampled grid, and its adjoint.
+	const double eps = 1e-10;
+	gettimeofday(&t1, NULL);
+	shtns_points_plan pl = shtns_points_plan_create(shtns, n, cost, phi, eps);
+	gettimeofday(&t2, NULL);
+	ts1 = tdiff(&t1, &t2) * SHT_ITER;
+	SH_to_points(shtns, Q, n, cost, phi, vr);
+	gettimeofday(&t1, NULL);
+	SH_to_points_fast(pl, Q, vt);
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2) * SHT_ITER;
+	double vmax = 0;
+	err = 0;
+	for (i=0; i<n; i++) {
+		if (fabs(vr[i]) > vmax) vmax = fabs(vr[i]);
+		if (fabs(vt[i]-vr[i]) > err) err = fabs(vt[i]-vr[i]);
+	}
+	printf("   SH_to_points_fast : %ld points in %f ms (planned in %f ms)\n", n, ts, ts1);
+	printf("     max error = %g (relative to max value, eps=%g)", err/vmax, eps);
+	if (err > 10*eps*vmax) printf("    **** ERROR ****\n");
+	else printf("\n");
+	for (i=0; i<n; i++) vp[i] = rand() * (2.0/RAND_MAX) - 1.0;
+	gettimeofday(&t1, NULL);
+	SH_to_points_adjoint(pl, vp, S);
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2) * SHT_ITER;
+	double s1 = 0, s2 = 0, s0 = 0;		// check that <Q, adjoint(v)> = <synth(Q), v>
+	for (i=0; i<NLM; i++) s1 += creal(conj(Q[i]) * S[i]);
+	for (i=0; i<n; i++) {	s2 += vt[i]*vp[i];		s0 += fabs(vt[i]*vp[i]);	}
+	printf("   SH_to_points_adjoint : %ld points in %f ms\n", n, ts);
+	printf("     adjoint test error = %g", fabs(s1-s2)/s0);
+	if (fabs(s1-s2) > 1e-10*s0) printf("    **** ERROR ****\n");
+	else printf("\n");
+	shtns_points_plan_destroy(pl);
+
+	// single high orders, for which sin(theta)^m spans a huge range within the latitudes evaluated together.
+	err = 0;		vmax = 0;
+	for (int k=1; k<=4; k++) {
+		const int m0 = ((MMAX*k)/4) * MRES;
+		for (i=0; i<NLM; i++) Q[i] = 0.0;
+		for (int l=m0; l<=LMAX; l++) Q[LM(shtns,l,m0)] = 1.0;
+		SH_to_points(shtns, Q, nref, cost, phi, vr);
+		for (i=0; i<nref; i++) {
+			const double v = SH_to_point(shtns, Q, cost[i], phi[i]);
+			if (fabs(v) > vmax) vmax = fabs(v);
+			if (fabs(v - vr[i]) > err) err = fabs(v - vr[i]);
+		}
+	}
+	printf("   SH_to_points (single orders) : max error = %g (max value %g)", err, vmax);
+	if (err > 1e-10*LMAX) printf("    **** ERROR ****\n");
+	else printf("\n");
+
+	free(cost);		shtns_free(Q);
+}
+
+/// multi-shell transforms of nr fields stored contiguously, compared to nr successive single-field transforms.
+void test_SHT_shells(int nr, int vector)
+{
+	long int jj,i;
+	int ir;
+	double ts, ta, ts1, ta1;
+	struct timeval t1, t2;
+	const long int nspat = NSPAT_ALLOC(shtns);
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* NLM * nr);
+	complex double *Q2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM * nr);
+	double *V = (double *) shtns_malloc(sizeof(double) * nspat * nr);
+	complex double *S = NULL, *T = NULL;
+	double *Vt = NULL, *Vp = NULL;
+
+	for (ir=0; ir<nr; ir++)
+		for (i=0;i<NLM;i++) Q[ir*NLM + i] = Slm0[i]*(ir+1);
+
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (ir=0; ir<nr; ir++) SH_to_spat(shtns, Q + ir*NLM, V + ir*nspat);
+	}
+	gettimeofday(&t2, NULL);
+	ts1 = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (ir=0; ir<nr; ir++) spat_to_SH(shtns, V + ir*nspat, Q2 + ir*NLM);
+	}
+	gettimeofday(&t2, NULL);
+	ta1 = tdiff(&t1, &t2);
+
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_spat_shells(shtns, nr, Q, NLM, V, nspat);
+	}
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+		spat_to_SH_shells(shtns, nr, V, nspat, Q, NLM);
+	for (jj=1; jj< SHT_ITER; jj++) {
+		spat_to_SH_shells(shtns, nr, V, nspat, Q2, NLM);
+	}
+	gettimeofday(&t2, NULL);
+	ta = tdiff(&t1, &t2);
+	printf("   %d shells, scalar SHT : \t synthesis %f ms (single: %f ms) \t analysis %f ms (single: %f ms)\n", nr, ts, ts1, ta, ta1);
+	for (ir=0; ir<nr; ir++) {
+		for (i=0;i<NLM;i++) Q2[i] = Q[ir*NLM + i]/(ir+1);
+		scal_error(Q2, Slm0, LMAX);
+	}
+
+	if (vector) {
+		complex double *S2 = (complex double *) shtns_malloc(sizeof(complex double)* NLM * 2*nr);
+		S = (complex double *) shtns_malloc(sizeof(complex double)* NLM * nr);
+		T = (complex double *) shtns_malloc(sizeof(complex double)* NLM * nr);
+		Vt = (double *) shtns_malloc(sizeof(double) * nspat * nr);
+		Vp = (double *) shtns_malloc(sizeof(double) * nspat * nr);
+		for (ir=0; ir<nr; ir++)
+			for (i=0;i<NLM;i++) {	Q[ir*NLM + i] = Tlm0[i]*(ir+1);		S[ir*NLM + i] = Slm0[i]*(ir+1);		T[ir*NLM + i] = Tlm0[i]*(ir+1);	}
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			SHqst_to_spat_shells(shtns, nr, Q, S, T, NLM, V, Vt, Vp, nspat);
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+			spat_to_SHqst_shells(shtns, nr, V, Vt, Vp, nspat, Q, S, T, NLM);
+		for (jj=1; jj< SHT_ITER; jj++) {
+			spat_to_SHqst_shells(shtns, nr, V, Vt, Vp, nspat, Q2, S2, S2 + nr*NLM, NLM);
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   %d shells, 3D vector SHT : \t synthesis %f ms \t analysis %f ms\n", nr, ts, ta);
+		for (ir=0; ir<nr; ir++) {
+			for (i=0;i<NLM;i++) {	Q2[i] = S[ir*NLM + i]/(ir+1);	S2[i] = T[ir*NLM + i]/(ir+1);	}
+			vect_error(Q2, S2, Slm0, Tlm0, LMAX);
+			for (i=0;i<NLM;i++) Q2[i] = Q[ir*NLM + i]/(ir+1);
+			scal_error(Q2, Tlm0, LMAX);
+		}
+		shtns_free(Vp);		shtns_free(Vt);
+		shtns_free(T);		shtns_free(S);		shtns_free(S2);
+	}
+
+	shtns_free(V);		shtns_free(Q2);		shtns_free(Q);
+}
+
+/// Legendre transforms at fixed m (no fft), one order after the other (with the latitudes split among threads),
+/// and for all orders with a single call to SH_to_fourier and friends.
+void test_SHT_ml(int vector)
+{
+	long int jj;
+	int im;
+	double ts, ta, ts1, ta1;
+	struct timeval t1, t2;
+	const int nm = MMAX+1;
+	int *im_list = (int *) malloc(sizeof(int) * nm);
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *T = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *R = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	complex double *V = (complex double *) shtns_malloc(sizeof(complex double)* NLAT * nm);
+	complex double *W = (complex double *) shtns_malloc(sizeof(complex double)* NLAT * nm);
+	complex double *X = (complex double *) shtns_malloc(sizeof(complex double)* NLAT * nm);
+
+	for (im=0; im<nm; im++) im_list[im] = MMAX-im;		// any order is allowed.
+
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (im=0; im<nm; im++) SH_to_spat_ml(shtns, im, Slm0 + LiM(shtns, im*MRES, im), V + im*NLAT, LMAX);
+	}
+	gettimeofday(&t2, NULL);
+	ts1 = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		for (im=0; im<nm; im++) spat_to_SH_ml(shtns, im, V + im*NLAT, Q + LiM(shtns, im*MRES, im), LMAX);
+	}
+	gettimeofday(&t2, NULL);
+	ta1 = tdiff(&t1, &t2);
+	scal_error(Q, Slm0, LMAX);
+	printf("\n");
+
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		SH_to_fourier(shtns, nm, im_list, Slm0, V, LMAX);
+	}
+	gettimeofday(&t2, NULL);
+	ts = tdiff(&t1, &t2);
+	gettimeofday(&t1, NULL);
+	for (jj=0; jj< SHT_ITER; jj++) {
+		fourier_to_SH(shtns, nm, im_list, V, Q, LMAX);
+	}
+	gettimeofday(&t2, NULL);
+	ta = tdiff(&t1, &t2);
+	printf("   fixed m, scalar : \t synthesis %f ms (all m: %f ms) \t analysis %f ms (all m: %f ms)\n", ts1, ts, ta1, ta);
+	scal_error(Q, Slm0, LMAX);
+	printf("\n");
+
+	if (vector) {
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			for (im=0; im<nm; im++) {
+				const long lm = LiM(shtns, im*MRES, im);
+				SHsphtor_to_spat_ml(shtns, im, Slm0 + lm, Tlm0 + lm, V + im*NLAT, W + im*NLAT, LMAX);
+			}
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			for (im=0; im<nm; im++) {
+				const long lm = LiM(shtns, im*MRES, im);
+				spat_to_SHsphtor_ml(shtns, im, V + im*NLAT, W + im*NLAT, Q + lm, T + lm, LMAX);
+			}
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   fixed m, vector : \t synthesis %f ms \t analysis %f ms\n", ts, ta);
+		vect_error(Q, T, Slm0, Tlm0, LMAX);
+		printf("\n");
+
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			for (im=0; im<nm; im++) {
+				const long lm = LiM(shtns, im*MRES, im);
+				SHqst_to_spat_ml(shtns, im, Tlm0 + lm, Slm0 + lm, Tlm0 + lm, X + im*NLAT, V + im*NLAT, W + im*NLAT, LMAX);
+			}
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			for (im=0; im<nm; im++) {
+				const long lm = LiM(shtns, im*MRES, im);
+				spat_to_SHqst_ml(shtns, im, X + im*NLAT, V + im*NLAT, W + im*NLAT, R + lm, Q + lm, T + lm, LMAX);
+			}
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   fixed m, 3D vector : \t synthesis %f ms \t analysis %f ms\n", ts, ta);
+		scal_error(R, Tlm0, LMAX);
+		vect_error(Q, T, Slm0, Tlm0, LMAX);
+		printf("\n");
+
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			SHsphtor_to_fourier(shtns, nm, im_list, Slm0, Tlm0, V, W, LMAX);
+		}
+		gettimeofday(&t2, NULL);
+		ts = tdiff(&t1, &t2);
+		gettimeofday(&t1, NULL);
+		for (jj=0; jj< SHT_ITER; jj++) {
+			fourier_to_SHsphtor(shtns, nm, im_list, V, W, Q, T, LMAX);
+		}
+		gettimeofday(&t2, NULL);
+		ta = tdiff(&t1, &t2);
+		printf("   fixed m, vector (all m) : \t synthesis %f ms \t analysis %f ms\n", ts, ta);
+		vect_error(Q, T, Slm0, Tlm0, LMAX);
+		printf("\n");
+	}
+
+	shtns_free(X);		shtns_free(W);		shtns_free(V);
+	shtns_free(R);		shtns_free(T);		shtns_free(Q);		free(im_list);
+}
+
 /*
 fftw_plan ifft_in, ifft_out;
 fftw_plan fft_in, fft_out;
@@ -609,6 +1321,173 @@ do_fft_tests()
 }
 */
 
+/// print the hardware counters recorded by the library (if enabled by shtns_perf_enable), per call and summed over threads.
+void print_perf(shtns_cfg shtns)
+{
+	const char* tname[shtns_stats_ntypes] = { "syn", "ana", "vsy", "van", "gsp", "gto", "v3s", "v3a" };
+	const char* cname[shtns_perf_ncounters] = { "Mcycles", "Minstr", "L1miss(k)", "L2miss(k)", "LLCmiss(k)", "Mflop" };
+	const double cscale[shtns_perf_ncounters] = { 1.e-6, 1.e-6, 1.e-3, 1.e-3, 1.e-3, 1.e-6 };
+	struct shtns_stats st;
+	int header = 0;
+
+	for (int it=0; it<shtns_stats_ntypes; it++) {
+		shtns_get_stats(shtns, it, &st);
+		if (st.perf_calls == 0) continue;
+		if (!header) {
+			printf("** hardware counters (per call) ");
+			for (int k=0; k<shtns_perf_ncounters; k++)	printf(" %10s", cname[k]);
+			printf("   IPC flop/byte %%peak  DRAM GB/s\n");
+			header = 1;
+		}
+		printf("   %s %28s", tname[it], "");
+		for (int k=0; k<shtns_perf_ncounters; k++) {
+			if (st.perf_mask & (1U<<k))		printf(" %10.3f", st.counter[k] * cscale[k] / st.perf_calls);
+			else printf(" %10s", "n/a");
+		}
+		const unsigned m_ipc = (1U<<shtns_perf_cycles) | (1U<<shtns_perf_instructions);
+		const unsigned m_fpb = (1U<<shtns_perf_fp_ops) | (1U<<shtns_perf_llc_misses);
+		const unsigned m_peak = (1U<<shtns_perf_fp_ops) | (1U<<shtns_perf_cycles);
+		if ((st.perf_mask & m_ipc) == m_ipc)	printf(" %5.2f", st.ipc);		else printf(" %5s", "n/a");
+		if ((st.perf_mask & m_fpb) == m_fpb)	printf(" %9.2f", st.flops_per_byte);		else printf(" %9s", "n/a");
+		if ((st.perf_mask & m_peak) == m_peak)	printf(" %5.1f", st.peak_fraction*100);		else printf(" %5s", "n/a");
+		// the counters are measured only for the perf_calls last calls, assumed to take the average time.
+		if (st.perf_mask & (1U<<shtns_perf_llc_misses))	printf(" %10.2f", st.mem_bytes*1.e-9 / (st.t_total * st.perf_calls / st.calls));
+		else printf(" %10s", "n/a");
+		printf("\n");
+	}
+}
+
+/// print the per-stage timing statistics recorded by the library (if compiled with --enable-stats).
+/// The scalar synthesis and analysis have been performed by time_SHT, so they must have been recorded.
+void print_stats(shtns_cfg shtns)
+{
+	const char* tname[shtns_stats_ntypes] = { "syn", "ana", "vsy", "van", "gsp", "gto", "v3s", "v3a" };
+	struct shtns_stats st;
+
+	if (shtns_get_stats(shtns, shtns_stats_SH_to_spat, &st) == 0) {
+		printf("** no statistics available (configure with --enable-stats)\n");
+		return;
+	}
+	printf("** statistics (ms per call)  calls   total  legendre     fft   alloc   GB/s  busy(min/max thread)\n");
+	for (int it=0; it<shtns_stats_ntypes; it++) {
+		shtns_get_stats(shtns, it, &st);
+		if (st.calls == 0) continue;
+		double bmin = st.t_busy[0];		double bmax = st.t_busy[0];
+		for (int i=1; i<st.nthreads && i<SHTNS_STATS_MAX_THREADS; i++) {
+			if (st.t_busy[i] < bmin) bmin = st.t_busy[i];
+			if (st.t_busy[i] > bmax) bmax = st.t_busy[i];
+		}
+		const double c = 1.e3/st.calls;
+		printf("   %s %34lu %7.3f %9.3f %7.3f %7.3f %6.2f  %.3f/%.3f (%d threads)\n", tname[it], st.calls,
+			st.t_total*c, st.t_legendre*c, st.t_fft*c, st.t_alloc*c, st.bytes*1.e-9/st.t_total, bmin*c, bmax*c, st.nthreads);
+	}
+	for (int it=shtns_stats_SH_to_spat; it<=shtns_stats_spat_to_SH; it++) {
+		shtns_get_stats(shtns, it, &st);
+		if ((st.calls == 0) || (st.t_total <= 0.0) || (st.bytes <= 0.0) || (st.nthreads < 1))
+			printf("   %s : transforms not recorded    **** ERROR ****\n", tname[it]);
+	}
+	print_perf(shtns);
+}
+
+/// work of each thread in test_SHT_concurrent.
+struct concurrent_job {
+	shtns_cfg c;
+	int id;
+	double err[3];		// max error of the synthesis at a latitude, and of the float and complex transforms.
+};
+
+void* concurrent_worker(void* arg)
+{
+	struct concurrent_job* job = (struct concurrent_job*) arg;
+	shtns_cfg c = job->c;
+	const long int nlm = c->nlm;
+	const long int nlmc = c->nlm_cplx;
+	const long int nspat = NSPAT_ALLOC(c);
+	const int nphi = 2*(c->mmax*c->mres + 1);
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* (nlm + 2*nlmc));
+	complex double *Z = Q + nlm;		complex double *Z2 = Z + nlmc;
+	complex double *z = (complex double *) shtns_malloc(sizeof(complex double)* nspat);
+	complex float *Qf = (complex float *) shtns_malloc(sizeof(complex float)* nlm);
+	float *Vf = (float *) shtns_malloc(sizeof(float)* nspat);
+	double *vr = (double *) malloc(sizeof(double)* nphi);
+	long int i;
+
+	for (i=0; i<nlm; i++) Q[i] = cos(i*(job->id+1.3)) + I*sin(i*(job->id+0.7));		// a different field for each thread.
+	for (i=0; i<=c->lmax; i++) Q[LM(c,i,0)] = creal(Q[LM(c,i,0)]);
+	for (i=0; i<3; i++) job->err[i] = 0.0;
+
+	// synthesis at a latitude (Legendre functions and fft plan kept by each thread), compared to point evaluation.
+	const double cost = cos(0.3 + 0.2*job->id);
+	SH_to_lat(c, Q, cost, vr, nphi, c->lmax, c->mmax);
+	for (i=0; i<nphi; i++) {
+		double e = fabs(vr[i] - SH_to_point(c, Q, cost, (2.*M_PI*i)/nphi));
+		if (e > job->err[0]) job->err[0] = e;
+	}
+
+	// float transforms (ffts planned by the first thread needing them).
+	for (i=0; i<nlm; i++) Qf[i] = Q[i];
+	SH_to_spatf(c, Qf, Vf);
+	spat_to_SHf(c, Vf, Qf);
+	for (i=0; i<nlm; i++) {
+		double e = cabs(Qf[i] - Q[i]);
+		if (e > job->err[1]) job->err[1] = e;
+	}
+
+	// complex transforms (ffts planned by the first thread needing them).
+	if (c->mres == 1) {
+		for (i=0; i<nlmc; i++) Z[i] = sin(i*(job->id+0.4)) + I*cos(i*(job->id+1.1));
+		SH_to_spat_cplx(c, Z, z);
+		spat_cplx_to_SH(c, z, Z2);
+		for (i=0; i<nlmc; i++) {
+			double e = cabs(Z2[i] - Z[i]);
+			if (e > job->err[2]) job->err[2] = e;
+		}
+	}
+
+	free(vr);		shtns_free(Vf);		shtns_free(Qf);		shtns_free(z);		shtns_free(Q);
+	return NULL;
+}
+
+/// transforms of a new config by nth threads at the same time (concurrent first use of the lazily planned ffts),
+/// and synthesis at a latitude with a new config allocated at the address of a destroyed one.
+void test_SHT_concurrent(int nth)
+{
+	const int nphi = 2*(MMAX*MRES + 1);
+	const double cost = 0.6;
+	double *vr = (double *) malloc(sizeof(double)* 2*nphi);
+	double *vr1 = vr + nphi;
+	complex double *Q = (complex double *) shtns_malloc(sizeof(complex double)* NLM);
+	pthread_t th[nth];
+	struct concurrent_job job[nth];
+	int i;
+
+	for (i=0; i<NLM; i++) Q[i] = Slm0[i];
+	for (i=0; i<=LMAX; i++) Q[LM(shtns,i,0)] = creal(Q[LM(shtns,i,0)]);
+	shtns_cfg a = shtns_create(LMAX, MMAX, MRES, sht_orthonormal);
+	SH_to_lat(a, Q, cost, vr, nphi, LMAX, MMAX);
+	shtns_destroy(a);
+	shtns_cfg b = shtns_create(LMAX, MMAX, MRES, sht_schmidt);		// different Legendre functions, probably at the same address.
+	SH_to_lat(b, Q, cost, vr, nphi, LMAX, MMAX);
+	for (i=0; i<nphi; i++) vr1[i] = SH_to_point(b, Q, cost, (2.*M_PI*i)/nphi);
+	real_error("latitude synthesis with a new config", vr, vr1, nphi);
+	shtns_destroy(b);
+
+	shtns_cfg c = shtns_create(LMAX, MMAX, MRES, sht_orthonormal);
+	shtns_set_grid(c, sht_quick_init, 1.e-10, NLAT, NPHI);
+	for (i=0; i<nth; i++) {
+		job[i].c = c;		job[i].id = i;
+		if (pthread_create(&th[i], NULL, concurrent_worker, &job[i]))	runerr("pthread_create failed");
+	}
+	for (i=0; i<nth; i++) {
+		pthread_join(th[i], NULL);
+		printf("   thread %d => max error = %g (latitude), %g (float), %g (complex)", i, job[i].err[0], job[i].err[1], job[i].err[2]);
+		if ((job[i].err[0] > 1e-3) || (job[i].err[1] > 1e-3) || (job[i].err[2] > 1e-3)) printf("    **** ERROR ****\n");
+		else printf("\n");
+	}
+	shtns_destroy(c);
+	shtns_free(Q);		free(vr);
+}
+
 void usage()
 {
 	printf("\nUsage: time_SHT lmax [options] \n");
@@ -623,7 +1502,26 @@ void usage()
 	printf(" -gauss : force gauss grid\n");
 	printf(" -fly : force gauss grid with on-the-fly computations only\n");
 	printf(" -quickinit : force gauss grid and fast initialiation time (but suboptimal fourier transforms)\n");
+	printf(" -budget=<s> : time budget in seconds for the tuning of each transform type (default 0.2)\n");
+	printf(" -predict : force gauss grid with on-the-fly algorithm predicted by a cost model (no timing)\n");
+	printf(" -predictcheck : same as -predict, but time the two best predicted algorithms to choose between them\n");
+	printf(" -loadsave : load the tuned config from the store (shtns_cfg.db or $SHTNS_CFG_PATH), or save it there\n");
+	printf(" -saveload : save the initialized config to shtns_image.bin, and run the tests with the config loaded back from it\n");
+	printf(" -shared : initialize the config in a shared memory segment, simultaneously with a second process\n");
 	printf(" -vector : time and test also vector transforms (2D and 3D)\n");
+	printf(" -batch=<n> : time and test also batched transforms of n fields\n");
+	printf(" -float : time and test also single precision transforms\n");
+	printf(" -fused : time and test also fused synthesis, pointwise products and analysis\n");
+	printf(" -cplx : time and test also the transforms of complex fields (requires mres=1)\n");
+	printf(" -cplxnative : same as -cplx, with the native complex kernels enabled (experimental, see SHT_CPLX_NATIVE)\n");
+	printf(" -shells=<n> : time and test also multi-shell transforms of n fields\n");
+	printf(" -points=<n> : time and test also the evaluation at n scattered points (direct, and planned with an oversampled grid)\n");
+	printf(" -ml : time and test also fixed m Legendre transforms (single order, and all orders with SH_to_fourier)\n");
+	printf(" -concurrent=<n> : test also n threads using a new config at the same time\n");
+	printf(" -stats : print the time spent in the Legendre and fft stages of the transforms (requires ./configure --enable-stats)\n");
+	printf(" -roofline : measure the memory bandwidth and peak flop rate, and print the roofline placement of each transform\n");
+	printf(" -perf : print also the hardware performance counters of the transforms (requires ./configure --enable-stats on Linux)\n");
+	printf(" -trace : write a trace of the initialization and transforms to shtns_trace.json (requires ./configure --enable-stats)\n");
 	printf(" -reg : use regular grid\n");
 	printf(" -regpoles : use regular grid including poles\n");
 	printf(" -oop : force out-of-place transform\n");
@@ -653,6 +1551,20 @@ int main(int argc, char *argv[])
 	int point = 0;
 	int vector = 0;
 	int loadsave = 0;
+	int saveload = 0;
+	int shared = 0;
+	int batch = 0;
+	int shells = 0;
+	int points = 0;
+	int ml = 0;
+	int concurrent = 0;
+	int sp_float = 0;
+	int fused = 0;
+	int cplx = 0;
+	int stats = 0;
+	int trace = 0;
+	int roofline = 0;
+	int perf = 0;
 	char name[20];
 	FILE* fw;
 
@@ -677,11 +1589,14 @@ int main(int argc, char *argv[])
 		if (strcmp(name,"polaropt") == 0) polaropt = t;
 		if (strcmp(name,"iter") == 0) SHT_ITER = t;
 		if (strcmp(name,"nth") == 0) nthreads = t;
+		if (strcmp(name,"budget") == 0) shtns_tuning_budget(t);
 		if (strcmp(name,"gauss") == 0) shtmode = sht_gauss;		// force gauss grid.
 		if (strcmp(name,"fly") == 0) shtmode = sht_gauss_fly;		// force gauss grid with on-the-fly computation.
 		if (strcmp(name,"reg") == 0) shtmode = sht_reg_fast;	// force regular grid.
 		if (strcmp(name,"regpoles") == 0) shtmode = sht_reg_poles;	// force regular grid.
 		if (strcmp(name,"quickinit") == 0) shtmode = sht_quick_init;	// Gauss grid and fast initialization time, but suboptimal fourier transforms.
+		if (strcmp(name,"predict") == 0) shtmode = sht_predict;		// Gauss grid, on-the-fly algorithm predicted without timing.
+		if (strcmp(name,"predictcheck") == 0) shtmode = sht_predict | SHT_PREDICT_CHECK;	// same, but time the two best candidates.
 		if (strcmp(name,"schmidt") == 0) shtnorm = sht_schmidt | SHT_NO_CS_PHASE;
 		if (strcmp(name,"4pi") == 0) shtnorm = sht_fourpi | SHT_REAL_NORM;
 		if (strcmp(name,"oop") == 0) layout = SHT_THETA_CONTIGUOUS;
@@ -690,19 +1605,73 @@ int main(int argc, char *argv[])
 		if (strcmp(name,"vector") == 0) vector = 1;
 		if (strcmp(name,"point") == 0) point = 1;
 		if (strcmp(name,"loadsave") == 0) loadsave = 1;
+		if (strcmp(name,"saveload") == 0) saveload = 1;
+		if (strcmp(name,"shared") == 0) shared = 1;
+		if (strcmp(name,"batch") == 0) batch = t;
+		if (strcmp(name,"shells") == 0) shells = t;
+		if (strcmp(name,"points") == 0) points = t;
+		if (strcmp(name,"ml") == 0) ml = 1;
+		if (strcmp(name,"concurrent") == 0) concurrent = t;
+		if (strcmp(name,"float") == 0) sp_float = 1;
+		if (strcmp(name,"fused") == 0) fused = 1;
+		if (strcmp(name,"cplx") == 0) cplx = 1;
+		if (strcmp(name,"cplxnative") == 0) cplx = 2;
+		if (strcmp(name,"stats") == 0) stats = 1;
+		if (strcmp(name,"trace") == 0) trace = 1;
+		if (strcmp(name,"roofline") == 0) roofline = 1;
+		if (strcmp(name,"perf") == 0) { stats = 1;	perf = 1; }
 	}
 
 	if (vector == 0) layout |= SHT_SCALAR_ONLY;
+	if (cplx == 2) layout |= SHT_CPLX_NATIVE;
 	printf("loadsave = %d\n", loadsave);
-	if (loadsave) layout |= SHT_LOAD_SAVE_CFG;
+	if (loadsave) {
+		layout |= SHT_LOAD_SAVE_CFG;
+		printf("%d saved configs preloaded\n", shtns_cfg_preload());
+	}
 	layout |= SHT_ALLOW_GPU;			// Allow GPU transforms if possible.
 	if (MMAX == -1) MMAX=LMAX/MRES;
+	pid_t child = -1;
+	if (shared) {
+		layout |= SHT_SHARED_MEMORY;
+		fflush(stdout);
+		child = fork();		// a second process requests the same config at the same time: one writes the segment, the other waits and attaches.
+		if (child < 0) runerr("fork failed");
+	}
 	shtns_use_threads(nthreads);		// 0 : means automatically chooses the number of threads.
+	if (trace) shtns_trace_start(0);		// record also the initialization.
 	shtns = shtns_create(LMAX, MMAX, MRES, shtnorm);
 	NLM = shtns->nlm;
 	shtns_set_grid_auto(shtns, shtmode | layout, polaropt, nlorder, &NLAT, &NPHI);
+	if (shared) {
+		if (child == 0) {		// second process : done.
+			int ok = (shtns->nspat > 0) && shtns_is_shared(shtns);
+			shtns_destroy(shtns);
+			exit(ok ? 0 : 1);
+		}
+		int status;
+		if ((waitpid(child, &status, 0) != child) || (!WIFEXITED(status)) || (WEXITSTATUS(status) != 0)) runerr("second process failed or did not use the segment");
+		if (!shtns_is_shared(shtns)) runerr("config not in a shared memory segment");
+		if (shtns_unlink_shared(shtns) != 0) runerr("shtns_unlink_shared failed");
+		printf("** config shared with a second process, segment unlinked\n");
+	}
+	if (saveload) {
+		struct timeval t0, t1, t2;
+		gettimeofday(&t0, NULL);
+		if (shtns_save(shtns, "shtns_image.bin") != 0) runerr("shtns_save failed");
+		gettimeofday(&t1, NULL);
+		shtns_destroy(shtns);
+		shtns = shtns_load("shtns_image.bin");
+		if (shtns == NULL) runerr("shtns_load failed");
+		gettimeofday(&t2, NULL);
+		printf("** config saved in %g ms, and loaded back in %g ms\n", tdiff(&t0,&t1)*SHT_ITER, tdiff(&t1,&t2)*SHT_ITER);
+		NLM = shtns->nlm;		NLAT = shtns->nlat;		NPHI = shtns->nphi;
+	}
 
+	if (roofline) printf("** machine balance = %.2f flop/byte\n", shtns_calibrate(0, NULL, NULL));
 	shtns_print_cfg(shtns);
+	if (stats) shtns_reset_stats(shtns);		// forget the transforms timed during initialization.
+	if ((perf) && (shtns_perf_enable(1) == 0)) printf("** hardware counters not available (configure with --enable-stats, and check /proc/sys/kernel/perf_event_paranoid)\n");
 
 /*
 	t1 = 1.0+2.0*I;
@@ -852,6 +1821,49 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	if (batch > 0) {
+		printf("** performing %d batched SHT\n", SHT_ITER);
+		test_SHT_batch(batch, vector);
+	}
+
+	if (sp_float) {
+		printf("** performing %d single precision SHT\n", SHT_ITER);
+		test_SHT_float(vector);
+	}
+
+	if (fused) {
+		printf("** performing %d fused SHT\n", SHT_ITER);
+		test_SHT_fused(vector);
+	}
+
+	if ((cplx) && (MRES == 1)) {
+		printf("** performing %d complex SHT\n", SHT_ITER);
+		test_SHT_cplx(vector);
+	}
+
+	if (points > 0) {
+		printf("** performing evaluation at %d points\n", points);
+		test_SHT_points(points, vector);
+	}
+
+	if (shells > 0) {
+		printf("** performing %d multi-shell SHT\n", SHT_ITER);
+		test_SHT_shells(shells, vector);
+	}
+
+	if (ml) {
+		printf("** performing %d fixed m Legendre transforms\n", SHT_ITER);
+		test_SHT_ml(vector);
+	}
+
+	if (concurrent > 0) {
+		printf("** performing transforms in %d threads at the same time\n", concurrent);
+		test_SHT_concurrent(concurrent);
+	}
+
+
+	if (stats) print_stats(shtns);
+	if (trace) printf("** %ld trace events written to shtns_trace.json\n", shtns_trace_write("shtns_trace.json"));
 
 	shtns_create(LMAX, MMAX, MRES, shtnorm);		// test memory allocation and management.
 //	shtns_create_with_grid(shtns, MMAX/2, 1);